@@ -0,0 +1,131 @@
+import os
+import gzip
+import bz2
+import lzma
+import time
+import subprocess
+
+# Decode throughput: every codec restores the same log, timed on its own,
+# and the ULC engines' output must match the original byte for byte
+
+# Use absolute paths from script location
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+BASE_DIR = os.path.dirname(SCRIPT_DIR)  # benchmarks/
+FINAL_DIR = os.path.dirname(BASE_DIR)   # repository root
+
+LOG_FILES = {
+    "test_log_web.txt": os.path.join(FINAL_DIR, "test_log_web.txt"),
+    "test_log_sys.txt": os.path.join(FINAL_DIR, "test_log_sys.txt"),
+    "test_log_app.txt": os.path.join(FINAL_DIR, "test_log_app.txt")
+}
+
+ENGINES = {
+    "ULC-C": (os.path.join(FINAL_DIR, "ulc-c", "ulc.exe"), ".ulc"),
+    "ULC-Ultra": (os.path.join(FINAL_DIR, "ulc-ultra", "ulc-ultra.exe"), ".ulcu"),
+    "ULC-Hyper": (os.path.join(FINAL_DIR, "ulc-hyper", "ulc-hyper.exe"), ".ulch"),
+}
+
+# Best of this many decode runs
+RUNS = 3
+
+RESULTS = {}
+
+def best_time(func):
+    best = float('inf')
+    for _ in range(RUNS):
+        start = time.perf_counter()
+        func()
+        best = min(best, time.perf_counter() - start)
+    return best
+
+def mb_per_s(size, duration):
+    return (size / duration) / (1024 * 1024) if duration > 0 else 0
+
+def benchmark():
+    print("Starting decode benchmark...")
+    print(f"Base directory: {BASE_DIR}")
+    
+    for filename, log_path in LOG_FILES.items():
+        if not os.path.exists(log_path):
+            print(f"SKIP: {filename} not found at {log_path}")
+            continue
+        
+        with open(log_path, 'rb') as f:
+            original = f.read()
+        orig_size = len(original)
+        RESULTS[filename] = {"Original": orig_size}
+        print(f"\n{'='*60}")
+        print(f"Decoding: {filename} ({orig_size:,} bytes)")
+        print(f"{'='*60}")
+        
+        # Standard codecs, decoded in memory
+        for name, compress, decompress in [
+            ("Gzip", lambda d: gzip.compress(d, compresslevel=9), gzip.decompress),
+            ("Bzip2", lambda d: bz2.compress(d, compresslevel=9), bz2.decompress),
+            ("LZMA", lambda d: lzma.compress(d, preset=9 | lzma.PRESET_EXTREME), lzma.decompress),
+        ]:
+            print(f"  Testing {name}...", end=" ")
+            packed = compress(original)
+            duration = best_time(lambda: decompress(packed))
+            RESULTS[filename][name] = (True, duration)
+            print(f"{duration:.3f}s ({mb_per_s(orig_size, duration):.1f} MB/s)")
+        
+        # ULC engines: compress once, then time the decompress command
+        for name, (exe, ext) in ENGINES.items():
+            if not os.path.exists(exe):
+                continue
+            print(f"  Testing {name}...", end=" ")
+            packed_file = os.path.join(BASE_DIR, "temp_decode" + ext)
+            restored_file = os.path.join(BASE_DIR, "temp_decode.log")
+            try:
+                subprocess.run([exe, "compress", log_path, "-o", packed_file],
+                               capture_output=True, text=True, timeout=300)
+                duration = best_time(lambda: subprocess.run(
+                    [exe, "decompress", packed_file, "-o", restored_file],
+                    capture_output=True, text=True, timeout=300))
+                with open(restored_file, 'rb') as f:
+                    exact = f.read() == original
+                RESULTS[filename][name] = (exact, duration)
+                print(f"{duration:.3f}s ({mb_per_s(orig_size, duration):.1f} MB/s){'' if exact else ' MISMATCH'}")
+            except Exception as e:
+                print(f"FAILED: {e}")
+                RESULTS[filename][name] = (False, 0)
+            for path in (packed_file, restored_file):
+                if os.path.exists(path):
+                    os.remove(path)
+
+def generate_report():
+    if not RESULTS:
+        print("No results to report!")
+        return
+    
+    md_path = os.path.join(BASE_DIR, "results", "decode.md")
+    with open(md_path, "w") as f:
+        f.write("# Log Decode Benchmark\n\n")
+        f.write(f"**Generated:** {time.strftime('%Y-%m-%d %H:%M:%S')}\n\n")
+        f.write(f"Best of {RUNS} runs; ULC times include process start-up and writing the restored file.\n\n")
+        
+        for filename, data in RESULTS.items():
+            orig = data["Original"]
+            f.write(f"## {filename}\n")
+            f.write(f"**Original Size:** {orig:,} bytes\n\n")
+            f.write("| Algorithm | Time (s) | Throughput | Exact |\n")
+            f.write("|-----------|----------|------------|-------|\n")
+            
+            algos = [(k, v) for k, v in data.items() if k != "Original"]
+            algos.sort(key=lambda x: x[1][1] if x[1][1] > 0 else float('inf'))
+            for algo, (exact, duration) in algos:
+                if duration == 0:
+                    f.write(f"| {algo} | FAILED | - | - |\n")
+                    continue
+                f.write(f"| {algo} | {duration:.3f} | {mb_per_s(orig, duration):.1f} MB/s | {'yes' if exact else '**no**'} |\n")
+            f.write("\n")
+    
+    print(f"\nMarkdown report saved to: {md_path}")
+
+if __name__ == "__main__":
+    benchmark()
+    generate_report()
+    print("\n" + "="*60)
+    print("BENCHMARK COMPLETE")
+    print("="*60)
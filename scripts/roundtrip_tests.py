@@ -0,0 +1,127 @@
+import os
+import random
+import sys
+import tempfile
+import subprocess
+
+# Round-trip regression cases: each input is compressed and restored by
+# the engines it names, and the output must match it byte for byte
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+ROOT_DIR = os.path.dirname(SCRIPT_DIR)
+
+ENGINES = {
+    "ULC-C": (os.path.join(ROOT_DIR, "ulc-c", "ulc"), ".ulc"),
+    "ULC-Ultra": (os.path.join(ROOT_DIR, "ulc-ultra", "ulc-ultra"), ".ulcu"),
+    "ULC-Hyper": (os.path.join(ROOT_DIR, "ulc-hyper", "ulc-hyper"), ".ulch"),
+}
+
+def engine_path(name):
+    base = ENGINES[name][0]
+    for path in (base + ".exe", base):
+        if os.path.exists(path):
+            return path
+    return None
+
+def logfmt_lines(count):
+    return [f"time=2024-03-01T10:{i // 60 % 60:02d}:{i % 60:02d}Z level=info msg=\"request {i}\" dur={i % 97}ms"
+            .encode() for i in range(count)]
+
+def cri_lines(count):
+    return [f"2025-11-24T18:55:{i % 60:02d}.{i:09d}Z stdout F {{\"level\":\"info\",\"msg\":\"tick {i}\"}}"
+            .encode() for i in range(count)]
+
+def skewed_lines(count):
+    # Two symbols above 2^20 occurrences each, one rarer one
+    rng = random.Random(7)
+    return [b"a=x b=" + rng.choice(b"iiiiiiiiiwwwwwwwwwe").to_bytes(1, "little") for _ in range(count)]
+
+def bare_key_lines(count):
+    return [f"level=info{' debug' if i % 3 else ''} msg=\"request {i}\" cached{' ' if i % 5 == 0 else ''}"
+            .encode() for i in range(count)]
+
+def java_lines(count, frame_end=b""):
+    lines = []
+    for i in range(count):
+        lines.append(f"2024-03-01 10:{i // 60 % 60:02d}:{i % 60:02d},{i % 1000:03d} INFO [main] com.example.Service - "
+                     f"request {i} done".encode())
+        if i % 10 == 0:
+            lines += [f"2024-03-01 10:{i // 60 % 60:02d}:{i % 60:02d},500 ERROR [main] com.example.Service - failed"
+                      .encode(),
+                      f"java.lang.IllegalStateException: request {i}".encode(),
+                      b"\tat com.example.Service.run(Service.java:42)" + frame_end,
+                      b"\tat java.lang.Thread.run(Thread.java:750)"]
+    return lines
+
+def docker_lines(count):
+    lines = []
+    for i in range(count):
+        time = f"2025-11-24T18:55:{i % 60:02d}.{i:09d}Z"
+        if i % 7 == 0:
+            lines.append(f'{{"log":"{{\\"msg\\":\\"long {i} ","stream":"stdout","time":"{time}"}}'.encode())
+        lines.append(f'{{"log":"{{\\"msg\\":\\"tick {i}\\"}}\\n","stream":"stdout","time":"{time}"}}'.encode())
+    return lines
+
+# name -> (engines, input bytes, largest packed size or None)
+CASES = {
+    # A line whose first byte is the span-layout tag stays a raw row
+    "span-tag-byte": (["ULC-C", "ULC-Ultra"],
+                      b"\n".join(logfmt_lines(150) + [b"\x06" + logfmt_lines(1)[0]] + logfmt_lines(50)) + b"\n", None),
+    # A P/F run whose F time contains the fragment tag separator
+    "cri-comma-time": (["ULC-C", "ULC-Ultra"],
+                       b"\n".join(cri_lines(100) + [
+                           b"2025-11-24T18:55:22.000000643Z stdout P {\"msg\":\"part",
+                           b"2025-11-24T18:55:22.000000644,Z stdout F one\"}",
+                           b"2025-11-24T18:55:23.000000001Z stdout P {\"msg\":\"part",
+                           b"2025-11-24T18:55:23.000000002Z stdout F two\"}",
+                       ] + cri_lines(50)) + b"\n", None),
+    # Docker partial lines, joined and cut again, in LF and CRLF files
+    "docker-partials": (["ULC-C", "ULC-Ultra"], b"\n".join(docker_lines(150)) + b"\n", None),
+    "docker-partials-crlf": (["ULC-C", "ULC-Ultra"], b"\r\n".join(docker_lines(150)) + b"\r\n", None),
+    # logfmt with bare keys (flags) between pairs and at the line end
+    "logfmt-bare-keys": (["ULC-C", "ULC-Ultra"], b"\n".join(bare_key_lines(200)) + b"\n", None),
+    # Stack traces in a CRLF file, and continuation lines with a lone CR
+    "trace-crlf": (["ULC-C", "ULC-Ultra"], b"\r\n".join(java_lines(150)) + b"\r\n", None),
+    "trace-lone-cr": (["ULC-C", "ULC-Ultra"], b"\n".join(java_lines(150, b"\r")) + b"\n", None),
+    # NUL bytes mid-line, at line starts and ends, and as a whole line
+    "nul-bytes": (["ULC-C"],
+                  b"\n".join(logfmt_lines(100) + [b"level=info msg=a\x00b", b"\x00level=warn", b"\x00", b"x\x00\x00",
+                                                    b"\x7f\x00\x7f"] + logfmt_lines(20)) + b"\n", None),
+    # rANS frequencies for a column of more than 2^20 ids (~1.25 bits each)
+    "rans-large-counts": (["ULC-Ultra"], b"\n".join(skewed_lines(2600000)) + b"\n", 500000),
+}
+
+def run_case(name, engine, data, size_limit, work_dir):
+    exe = engine_path(engine)
+    if not exe:
+        return None
+    source = os.path.join(work_dir, name + ".log")
+    packed = source + ENGINES[engine][1]
+    restored = source + ".out"
+    with open(source, "wb") as f:
+        f.write(data)
+    for args in ([exe, "compress", source, "-o", packed], [exe, "decompress", packed, "-o", restored]):
+        result = subprocess.run(args, capture_output=True, timeout=600)
+        if result.returncode != 0:
+            return f"exit {result.returncode} on {args[1]}"
+    if size_limit and os.path.getsize(packed) > size_limit:
+        return f"packed to {os.path.getsize(packed)} bytes, expected at most {size_limit}"
+    with open(restored, "rb") as f:
+        return None if f.read() == data else "output differs"
+
+def main():
+    failures = 0
+    with tempfile.TemporaryDirectory() as work_dir:
+        for name, (engines, data, size_limit) in CASES.items():
+            for engine in engines:
+                if not engine_path(engine):
+                    print(f"SKIP {name} [{engine}]: not built")
+                    continue
+                error = run_case(name, engine, data, size_limit, work_dir)
+                print(f"{'FAIL' if error else 'ok  '} {name} [{engine}]{': ' + error if error else ''}")
+                failures += error is not None
+    print(f"\n{failures} failure(s)")
+    return 1 if failures else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -11,6 +11,38 @@ echo Compiling ulc_utils.c...
 gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_utils.c -o build/ulc_utils.o
 if errorlevel 1 goto error
 
+echo Compiling ulc_arena.c...
+gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_arena.c -o build/ulc_arena.o
+if errorlevel 1 goto error
+
+echo Compiling ulc_addr.c...
+gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_addr.c -o build/ulc_addr.o
+if errorlevel 1 goto error
+
+echo Compiling ulc_json.c...
+gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_json.c -o build/ulc_json.o
+if errorlevel 1 goto error
+
+echo Compiling ulc_logfmt.c...
+gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_logfmt.c -o build/ulc_logfmt.o
+if errorlevel 1 goto error
+
+echo Compiling ulc_frame.c...
+gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_frame.c -o build/ulc_frame.o
+if errorlevel 1 goto error
+
+echo Compiling ulc_envelope.c...
+gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_envelope.c -o build/ulc_envelope.o
+if errorlevel 1 goto error
+
+echo Compiling ulc_spec.c...
+gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_spec.c -o build/ulc_spec.o
+if errorlevel 1 goto error
+
+echo Compiling ulc_stream.c...
+gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_stream.c -o build/ulc_stream.o
+if errorlevel 1 goto error
+
 echo Compiling ulc_parser.c...
 gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_parser.c -o build/ulc_parser.o
 if errorlevel 1 goto error
@@ -25,7 +57,7 @@ if errorlevel 1 goto error
 
 REM Link executable
 echo Linking ulc.exe...
-gcc build/ulc_utils.o build/ulc_parser.o build/ulc_compress.o build/ulc_cli.o -llzma -o ulc.exe
+gcc build/ulc_utils.o build/ulc_arena.o build/ulc_addr.o build/ulc_json.o build/ulc_logfmt.o build/ulc_frame.o build/ulc_envelope.o build/ulc_spec.o build/ulc_stream.o build/ulc_parser.o build/ulc_compress.o build/ulc_cli.o -llzma -lpthread -o ulc.exe
 if errorlevel 1 goto error
 
 echo.
@@ -0,0 +1,54 @@
+#ifndef ULC_ADDR_H
+#define ULC_ADDR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Longest textual address we render ("ffff:...:255.255.255.255" is 45 chars)
+#define ADDR_MAX_TEXT 64
+
+// Longest encoded header produced by addr_encode (tag + two 64-bit varints)
+#define ADDR_MAX_ENCODED 24
+
+// Address family tags as stored in address columns
+typedef enum {
+    ADDR_FAMILY_NONE = 0,     // Not an address, stored verbatim
+    ADDR_FAMILY_V4,
+    ADDR_FAMILY_V6,
+    ADDR_FAMILY_V6_UPPER      // IPv6 written with upper-case hex digits
+} AddrFamily;
+
+// Parsed address (IPv4 lives in the low 32 bits of lo)
+typedef struct {
+    AddrFamily family;
+    uint64_t hi;
+    uint64_t lo;
+} Address;
+
+// XOR state for an address column (previous address per family)
+typedef struct {
+    uint32_t prev_v4;
+    uint64_t prev_hi;
+    uint64_t prev_lo;
+} AddrCodec;
+
+// Parse IPv4 or IPv6 text. Only succeeds when addr_format reproduces the
+// input byte for byte, so decoding never changes the original text.
+int addr_parse(const char* str, size_t len, Address* out);
+
+// Render an address (canonical RFC 5952 form for IPv6), returns length
+size_t addr_format(const Address* addr, char* buf);
+
+void addr_codec_init(AddrCodec* codec);
+
+// Encode one column value into out and return the number of bytes written.
+// Values that are not addresses get a length header only and *verbatim is
+// set; the caller appends the original bytes right after it.
+size_t addr_encode(AddrCodec* codec, const char* str, size_t len, uint8_t* out, int* verbatim);
+
+// Decode one column value. Addresses are rendered into text and their family
+// returned; for ADDR_FAMILY_NONE *len is the length of the verbatim bytes that
+// follow at data + *offset (not consumed).
+AddrFamily addr_decode(AddrCodec* codec, const uint8_t* data, size_t* offset, char* text, size_t* len);
+
+#endif // ULC_ADDR_H
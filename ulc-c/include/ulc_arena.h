@@ -0,0 +1,58 @@
+#ifndef ULC_ARENA_H
+#define ULC_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Storage for the values of a file: an arena and string columns. Like
+// ulc_cm it has no dependency on ulc_utils, so Hyper links it next to its
+// own ByteArray.
+
+// Bump allocator for the lines, fields, tokens and dictionary keys of a
+// file (or of one column); everything in it goes at once
+
+#define ARENA_BLOCK_SIZE (256 * 1024)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;
+    size_t size;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;
+    size_t blocks;      // Blocks allocated over the arena's life
+} Arena;
+
+void arena_init(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_strndup(Arena* arena, const char* str, size_t len);
+void arena_reset(Arena* arena);     // Empty it but keep the newest block
+void arena_free(Arena* arena);
+
+// Column of strings stored back to back in one blob, each NUL-terminated:
+// row i starts at data + offsets[i] and is offsets[i + 1] - offsets[i] - 1
+// bytes long. Rows without a value hold "" and are flagged in missing
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    size_t* offsets;        // count + 1 entries
+    size_t count;
+    size_t row_capacity;
+    uint8_t* missing;       // NULL until a row is missing
+} StringColumn;
+
+void string_column_init(StringColumn* col);
+void string_column_push(StringColumn* col, const char* value, size_t len);
+// Value of a row that may be ahead of the column: the rows in between are
+// missing, and a row that already has a value keeps it
+void string_column_put(StringColumn* col, size_t row, const char* value, size_t len);
+void string_column_pad(StringColumn* col, size_t rows);   // Missing rows up to rows
+void string_column_free(StringColumn* col);
+
+#define string_column_value(col, i) ((col)->data + (col)->offsets[i])
+#define string_column_length(col, i) ((col)->offsets[(i) + 1] - (col)->offsets[i] - 1)
+#define string_column_missing(col, i) ((col)->missing && (col)->missing[i])
+
+#endif // ULC_ARENA_H
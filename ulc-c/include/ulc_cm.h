@@ -0,0 +1,30 @@
+#ifndef ULC_CM_H
+#define ULC_CM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Context-mixing backend for serialized column streams ("max" mode).
+// Shared by the engines that normally finish with LZMA; it has no
+// dependency on ulc_utils so Hyper can link it next to its own ByteArray.
+
+#define CM_MAGIC "ULCX"
+#define CM_MAGIC_LEN 4
+
+// Blocks are modeled independently, one thread each
+#define CM_BLOCK_SIZE (4 * 1024 * 1024)
+#define CM_THREADS 4
+
+// Compress data; sections are the offsets where each column section starts
+// (ascending, may be NULL). Returns a malloc'd stream of *out_len bytes.
+uint8_t* cm_compress(const uint8_t* data, size_t len, const size_t* sections, size_t section_count,
+                     size_t* out_len);
+
+// Decompress a stream produced by cm_compress. *consumed is set to the
+// number of input bytes the stream occupies.
+uint8_t* cm_decompress(const uint8_t* data, size_t len, size_t* consumed, size_t* out_len);
+
+// Whether data starts with a CM stream
+int cm_is_stream(const uint8_t* data, size_t len);
+
+#endif // ULC_CM_H
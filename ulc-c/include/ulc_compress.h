@@ -2,12 +2,22 @@
 #define ULC_COMPRESS_H
 
 #include "ulc_types.h"
+#include "ulc_spec.h"
 
 // Compress log lines to file
 int ulc_compress_file(const char* input_path, const char* output_path, 
                       size_t* orig_size, size_t* comp_size, double* duration);
 
+// Compress lines of a declared format: matching lines split on the spec and
+// its field types replace per-column type detection
+int ulc_compress_file_spec(const char* input_path, const char* output_path, const FormatSpec* spec,
+                           size_t* orig_size, size_t* comp_size, double* duration);
+
 // Decompress file to log lines
 int ulc_decompress_file(const char* input_path, const char* output_path, double* duration);
 
+// Values of one field, one per row, to a file; with per-column streams only
+// the field table's and the field's groups are inflated
+int ulc_extract_field(const char* input_path, const char* field, const char* output_path, double* duration);
+
 #endif // ULC_COMPRESS_H
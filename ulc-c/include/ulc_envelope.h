@@ -0,0 +1,48 @@
+#ifndef ULC_ENVELOPE_H
+#define ULC_ENVELOPE_H
+
+#include <stddef.h>
+
+// Container log envelopes: Kubernetes CRI lines
+// ("2025-11-24T18:55:22.123456789Z stdout F <payload>") and Docker json-file
+// lines ({"log":"<payload>\n","stream":"stdout","time":"..."}). The envelope
+// splits into time, stream and tag; the payload goes to the inner parsers.
+// A split is only accepted when envelope_render gives back the exact line.
+
+#define ENVELOPE_CRI_TAG 0x04
+#define ENVELOPE_DOCKER_TAG 0x05
+
+#define ENVELOPE_FIELD_TIME "@time"
+#define ENVELOPE_FIELD_STREAM "@stream"
+#define ENVELOPE_FIELD_TAG "@tag"
+
+typedef struct {
+    char kind;      // ENVELOPE_CRI_TAG or ENVELOPE_DOCKER_TAG
+    char* time;
+    char* stream;   // "stdout" or "stderr"
+    char* tag;      // "F" for a full line, "P" for a partial one
+    char* payload;  // Docker: unescaped, without the line's trailing "\n"
+} Envelope;
+
+// Split a CRI or Docker line; returns 0 (nothing allocated) otherwise
+int envelope_split(const char* line, Envelope* env);
+void envelope_free(Envelope* env);
+
+// Lines of an envelope (malloc'd). A tag of the form "P,<len>,<time>,..."
+// from envelope_reassemble renders one line per fragment: the payload is
+// cut after each <len> bytes, the next fragment gets the <time> that
+// follows, and every fragment but the last is tagged P.
+char* envelope_render(char kind, const char* time, const char* stream, const char* tag, const char* payload);
+
+// Partial-line reassembly: each run of P lines on one stream closed by an F
+// line becomes a single full line carrying the joined payload, with the
+// run's fragment tag in tags[] (NULL for lines left alone; tags is
+// calloc'd, or NULL when nothing was joined). A run is only joined when its
+// tag renders the original lines back. Returns the new line count.
+size_t envelope_reassemble(char** lines, size_t count, char*** tags);
+
+// Whether a line may be a partial one (a CRI P line, or a Docker line whose
+// log lacks its "\n"): a cheap check for skipping envelope_reassemble
+int envelope_maybe_partial(const char* line);
+
+#endif // ULC_ENVELOPE_H
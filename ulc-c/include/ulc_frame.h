@@ -0,0 +1,23 @@
+#ifndef ULC_FRAME_H
+#define ULC_FRAME_H
+
+#include <stddef.h>
+
+// Multi-line record framing: continuation lines (stack frames, "Caused by:",
+// indented text, Java exception headers) belong to the record above them.
+// A record's continuation block splits into a frame skeleton (frame lines
+// verbatim, FRAME_MESSAGE_SLOT in place of every other line) and the other
+// lines, so a recurring trace costs one dictionary reference.
+
+#define FRAME_MESSAGE_SLOT '\x01'
+
+// Whether the line continues the record above it
+int frame_is_continuation(const char* line);
+
+// Split continuation lines into skeleton and messages ('\n'-joined, malloc'd)
+void frame_split(char* const* lines, size_t count, char** skeleton, char** messages);
+
+// Continuation lines of a skeleton and its messages, '\n'-joined (malloc'd)
+char* frame_join(const char* skeleton, const char* messages);
+
+#endif // ULC_FRAME_H
@@ -0,0 +1,51 @@
+#ifndef ULC_JSON_H
+#define ULC_JSON_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// JSON log columnarization: a structural index over the line (simdjson-style
+// quote/escape/brace classification, 64 bytes at a time) drives a flattener
+// that splits an object into a layout and one value per leaf key path.
+// The layout is the original line with every value replaced by a marker, so
+// key order, whitespace and which keys are present restore byte-exact.
+
+// Layout markers; control bytes cannot appear unescaped in valid JSON
+#define JSON_MARK_STRING 0x01   // Quoted value, column holds the raw contents
+#define JSON_MARK_RAW 0x02      // Number, literal or array, column holds the token
+
+// Field name of the layout column in parsed entries
+#define JSON_LAYOUT_FIELD "_layout"
+
+// Positions of structural characters ({}[]:,) and string quotes
+typedef struct {
+    uint32_t* positions;
+    size_t count;
+} JsonIndex;
+
+// Flattened object
+typedef struct {
+    char* layout;
+    char** paths;       // Key paths joined with '.' ("a.b.c")
+    char** values;
+    size_t count;
+} JsonRow;
+
+// Build the structural index of len bytes; returns 0 on unterminated strings
+int json_index_build(const char* data, size_t len, JsonIndex* index);
+void json_index_free(JsonIndex* index);
+
+// Flatten a JSON object line; returns 0 if it is not a single object (or a
+// key path repeats), in which case the line should be kept raw
+int json_flatten(const char* line, size_t len, JsonRow* row);
+void json_row_free(JsonRow* row);
+
+// Key paths of a layout's markers, in order. Returns the count; *paths is
+// malloc'd, free with json_paths_free
+size_t json_layout_paths(const char* layout, char*** paths);
+void json_paths_free(char** paths, size_t count);
+
+// Rebuild the original line from a layout and its values in marker order
+char* json_restore(const char* layout, const char* const* values, size_t count);
+
+#endif // ULC_JSON_H
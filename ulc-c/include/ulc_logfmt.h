@@ -0,0 +1,25 @@
+#ifndef ULC_LOGFMT_H
+#define ULC_LOGFMT_H
+
+#include "ulc_json.h"
+
+// logfmt lines (key=value key2="quoted value") split like JSON objects: a
+// layout holding the keys and separators with each value replaced by a JSON
+// marker, plus one value per key. The layout starts with LOGFMT_LAYOUT_TAG so
+// both kinds can share a layout column; json_restore(layout + 1, ...) brings
+// back the original line. A bare key (a flag, "level=info debug msg=x")
+// stays in the layout as it is and has no value.
+
+#define LOGFMT_LAYOUT_TAG 0x03
+#define LOGFMT_MIN_PAIRS 2
+
+// Split a logfmt line into row (paths are the keys); returns 0 unless every
+// token is a key=value pair or a bare key, there are at least
+// LOGFMT_MIN_PAIRS pairs and no key of a pair repeats
+int logfmt_split(const char* line, size_t len, JsonRow* row);
+
+// Keys of a tagged layout's markers, in order. Returns the count; free with
+// json_paths_free
+size_t logfmt_layout_keys(const char* layout, char*** keys);
+
+#endif // ULC_LOGFMT_H
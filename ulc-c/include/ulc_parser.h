@@ -2,14 +2,107 @@
 #define ULC_PARSER_H
 
 #include "ulc_types.h"
+#include "ulc_spec.h"
 
-// Parse a single log line
-LogEntry* parse_log_line(const char* line);
+// --- Format-locked fast path ---
 
-// Free log entry
-void log_entry_free(LogEntry* entry);
+// Lines voted on before the format is locked
+#define PARSER_SAMPLE_LINES 100
+#define PARSER_MAX_SPANS 8
 
-// Add field to log entry
-void log_entry_add_field(LogEntry* entry, const char* field, const char* value);
+// Field value as a span into the input line
+typedef struct {
+    const char* start;
+    size_t length;
+    int joined;   // Tokens the sscanf chain joins with single spaces
+} FieldSpan;
+
+// Parser that detects the dominant format once, then runs that format's
+// hand-written scanner on every line and falls back to parse_log_line
+// only when a line misses
+typedef struct {
+    LogFormat format;        // Locked format, LOG_FORMAT_RAW until locked
+    int locked;
+    size_t sampled;
+    size_t votes[LOG_FORMAT_RAW + 1];
+    size_t fast_hits;
+    size_t fallbacks;
+    const FormatSpec* spec;  // Declared format, tried before anything else
+    size_t spec_hits;        // Lines that matched it
+    int layouts;             // Every entry keyed: positional lines become span layouts
+    unsigned span_formats;   // 1 << LogFormat of formats whose lines become span layouts anyway
+    Schema schema;           // Field names of every entry parsed so far
+    Arena arena;             // The entries themselves
+} LogParser;
+
+void log_parser_init(LogParser* parser);
+
+// Frees the parser along with every entry it returned
+void log_parser_free(LogParser* parser);
+
+// Name of an entry's k-th field
+#define log_entry_field(parser, entry, k) ((parser)->schema.names[(entry)->ids[k]])
+
+// Lock the parser to a declared format: no sampling, and lines that match
+// the spec become keyed rows whose layout is SPEC_LAYOUT_TAG + the spec
+// text. Lines that miss go through the usual scanners. The spec must
+// outlive the parser
+void log_parser_set_spec(LogParser* parser, const FormatSpec* spec);
+
+// With parser->layouts set, entries of positional formats are keyed rows
+// too: a span layout (below) and the fields, or a raw layout holding the
+// whole line when no scanner takes it exactly. Every row then restores
+// through layout_plan_render. Formats in parser->span_formats get span
+// layouts without the rest: their lines restore exactly, other lines
+// parse as usual.
+
+// Parse a line, voting on the first PARSER_SAMPLE_LINES lines
+LogEntry* log_parser_parse(LogParser* parser, const char* line);
+
+// Parse a line with the full detection chain, without voting or locking
+LogEntry* parse_log_line(LogParser* parser, const char* line);
+
+// Add a field to an entry
+void log_entry_add_field(LogParser* parser, LogEntry* entry, const char* field, const char* value);
+
+// Set an envelope entry's tag, e.g. to a fragment tag from envelope_reassemble
+void log_entry_set_envelope_tag(LogParser* parser, LogEntry* entry, const char* tag);
+
+// Scan a line of the given format into spans. Returns the field count and
+// the field names, or 0 when the line needs the generic parser. Accepted
+// lines parse exactly as they would through parse_log_line.
+size_t scan_log_line(LogFormat format, const char* line, FieldSpan* spans, const char* const** names);
+
+// Layout of a container payload that a scanner accepted (or that stays raw):
+// PARSER_SPAN_TAG, '0' + its LogFormat, then the payload with every field
+// replaced by JSON_MARK_RAW. json_restore(layout + 2, ...) restores it.
+#define PARSER_SPAN_TAG 0x06
+
+// Field names of a span layout's markers, in order. Returns the count; free
+// with json_paths_free
+size_t span_layout_fields(const char* layout, char*** fields);
+
+// --- Keyed row restore ---
+
+// How the rows of one layout restore: the fields its markers stand for and
+// the envelope around them. body points into the layout, which must
+// outlive the plan
+typedef struct {
+    char envelope;          // ENVELOPE_CRI_TAG or ENVELOPE_DOCKER_TAG, or 0
+    const char* body;       // Marker text for json_restore
+    FormatSpec* spec;       // Spec rows render through their spec instead
+    char** fields;          // Field names in marker order
+    size_t count;
+} LayoutPlan;
+
+// Plan a keyed row's layout (not a JSON_MARK_RAW raw row); returns 0 when
+// a spec layout does not compile
+int layout_plan_init(LayoutPlan* plan, const char* layout);
+
+// Line of a row from its values in field order and, for envelopes, the
+// time, stream and tag (malloc'd)
+char* layout_plan_render(const LayoutPlan* plan, const char* const* values, const char* const* envelope);
+
+void layout_plan_free(LayoutPlan* plan);
 
 #endif // ULC_PARSER_H
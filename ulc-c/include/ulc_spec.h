@@ -0,0 +1,50 @@
+#ifndef ULC_SPEC_H
+#define ULC_SPEC_H
+
+#include "ulc_types.h"
+
+// User-declared line formats, compiled once into a scanner and a column
+// schema. nginx log_format syntax ($remote_addr, ${status:int}) or Apache
+// LogFormat directives (%h %l %u %t \"%r\" %>s %b). A field runs up to the
+// first occurrence of the text that follows it (the last field up to the
+// trailing text at the end of the line), so a matched line is exactly its
+// literals and values in turn.
+
+// Layout tag of a spec row: the tag, then the spec text itself
+#define SPEC_LAYOUT_TAG 0x07
+#define SPEC_MAX_FIELDS 64
+
+typedef struct {
+    char* name;
+    ColumnType type;    // STRING, INT (canonical integers only) or IP
+    char* literal;      // Text between this field and the next
+    size_t literal_len;
+} SpecField;
+
+typedef struct FormatSpec {
+    char* text;         // Spec as given
+    char* prefix;       // Text before the first field
+    size_t prefix_len;
+    SpecField* fields;
+    size_t count;
+} FormatSpec;
+
+// Compile a spec string; on error returns NULL with *error malloc'd
+FormatSpec* format_spec_compile(const char* text, char** error);
+
+// Spec from the first line of a file that is neither empty nor a # comment
+FormatSpec* format_spec_load(const char* path, char** error);
+
+void format_spec_free(FormatSpec* spec);
+
+// Match a line: offsets and lengths of every field. Returns 0 when the
+// literals are not there or an INT field is not a canonical integer
+int format_spec_match(const FormatSpec* spec, const char* line, size_t* starts, size_t* lengths);
+
+// The line for values in field order (malloc'd)
+char* format_spec_render(const FormatSpec* spec, const char* const* values);
+
+// Declared type of a field name, or -1 if the spec has no such field
+int format_spec_type(const FormatSpec* spec, const char* name);
+
+#endif // ULC_SPEC_H
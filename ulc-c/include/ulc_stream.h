@@ -0,0 +1,47 @@
+#ifndef ULC_STREAM_H
+#define ULC_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Per-column streams: a serialized column buffer cut at its section starts
+// and each piece compressed on its own, with the backend that suits it,
+// behind a directory. Like ulc_cm it has no dependency on ulc_utils.
+//
+// Part 0 is what precedes the first section (the engine's header fields),
+// part k + 1 is section k. Neighbouring parts under STREAM_GROUP_MIN bytes
+// share a group so small columns keep a common LZMA window; a group is the
+// unit that is compressed, threaded and fetched.
+
+#define STREAM_MAGIC "ULCS"
+#define STREAM_MAGIC_LEN 4
+
+#define STREAM_GROUP_MIN (64 * 1024)
+#define STREAM_PROBE (64 * 1024)    // Bytes of a group each backend is tried on
+#define STREAM_THREADS 4
+
+typedef enum {
+    STREAM_STORE = 0,   // Incompressible: the bytes as they are
+    STREAM_TEXT,        // LZMA2 with literal context (lc=4, pb=0): strings
+    STREAM_BINARY,      // LZMA2 without literal context (lc=0, pb=0): ids, varints
+    STREAM_DELTA,       // Byte delta filter + binary LZMA2: fixed-width integers
+    STREAM_CODECS
+} StreamCodec;
+
+// Compress data; sections are the offsets where each column section starts
+// (ascending). Returns a malloc'd stream of *out_len bytes; codec_counts
+// (STREAM_CODECS entries, may be NULL) receives how many groups use each.
+uint8_t* streams_compress(const uint8_t* data, size_t len, const size_t* sections, size_t section_count,
+                          size_t* codec_counts, size_t* out_len);
+
+// Decompress a whole stream produced by streams_compress. *consumed is set
+// to the number of input bytes the stream occupies.
+uint8_t* streams_decompress(const uint8_t* data, size_t len, size_t* consumed, size_t* out_len);
+
+// One part alone, decoding only the group that holds it (NULL when out of range)
+uint8_t* streams_extract(const uint8_t* data, size_t len, size_t part, size_t* out_len);
+
+// Whether data starts with a stream directory
+int streams_is_stream(const uint8_t* data, size_t len);
+
+#endif // ULC_STREAM_H
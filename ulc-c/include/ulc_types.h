@@ -3,9 +3,12 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "ulc_arena.h"
 
-// Magic header for ULC files
-#define ULC_MAGIC "ULC1"
+// Magic header for ULC files. ULC1 files (before every row carried a
+// layout) do not keep the original lines and cannot be decompressed
+#define ULC_MAGIC "ULC2"
+#define ULC_MAGIC_V1 "ULC1"
 #define ULC_MAGIC_LEN 4
 
 // Log format types
@@ -17,6 +20,8 @@ typedef enum {
     LOG_FORMAT_JAVA,
     LOG_FORMAT_GENERIC,
     LOG_FORMAT_LOGFMT,
+    LOG_FORMAT_CONTAINER,   // CRI/Docker envelope around another format
+    LOG_FORMAT_CUSTOM,      // User-declared format spec (see ulc_spec.h)
     LOG_FORMAT_RAW
 } LogFormat;
 
@@ -25,9 +30,26 @@ typedef enum {
     COL_TYPE_STRING = 0,
     COL_TYPE_INT,
     COL_TYPE_TIMESTAMP,
-    COL_TYPE_IP
+    COL_TYPE_IP         // IPv4/IPv6 address (see ulc_addr.h)
 } ColumnType;
 
+// Timestamp text shapes that format back byte for byte (see
+// timestamp_parse); a TIMESTAMP column holds one shape
+typedef enum {
+    TS_SHAPE_ISO = 1,   // 2025-11-24T18:55:22.123Z, 2025-11-24 18:55:22
+    TS_SHAPE_CLF,       // 24/Nov/2025:18:55:22 +0000
+    TS_SHAPE_SYSLOG     // Nov  5 18:55:22 (no year)
+} TimestampKind;
+
+typedef struct {
+    uint8_t kind;       // TimestampKind
+    uint8_t digits;     // Fraction digits (ISO)
+    char sep;           // 'T' or ' ' between date and time (ISO); ' ' when
+                        // days pad with a space, 0 when not (syslog)
+    char point;         // '.' or ',' before the fraction (ISO)
+    char suffix[7];     // Zone text after the time ("Z", " +0000", ...)
+} TimestampShape;
+
 // Dynamic string
 typedef struct {
     char* data;
@@ -62,12 +84,22 @@ typedef struct {
     ByteArray data;
 } Column;
 
-// Parsed log entry
+// Field names, interned once: entries refer to them by id
+typedef struct {
+    char** names;       // Id -> name
+    size_t count;
+    size_t capacity;
+    int* slots;         // Open-addressed hash of ids, -1 when empty
+    size_t slot_count;
+} Schema;
+
+// Parsed log entry; the arrays and values live in the parser's arena
 typedef struct {
-    char** fields;      // Field names
+    int* ids;           // Schema id of each field
     char** values;      // Field values
     size_t field_count;
     LogFormat format;
+    int span;           // values[0] is a span layout (a positional line in layouts mode)
 } LogEntry;
 
 // Compressor state
@@ -19,6 +19,12 @@ Dictionary* dict_new(size_t initial_capacity);
 int dict_get_or_add(Dictionary* dict, const char* key);
 void dict_free(Dictionary* dict);
 
+// Schema utilities
+void schema_init(Schema* schema);
+int schema_intern(Schema* schema, const char* name);
+int schema_find(const Schema* schema, const char* name);   // -1 if absent
+void schema_free(Schema* schema);
+
 // Varint encoding
 void encode_varint(ByteArray* out, uint64_t value);
 uint64_t decode_varint(const uint8_t* data, size_t* offset);
@@ -27,8 +33,13 @@ uint64_t decode_varint(const uint8_t* data, size_t* offset);
 void encode_delta(ByteArray* out, int64_t* values, size_t count);
 void decode_delta(const uint8_t* data, size_t data_len, int64_t** out_values, size_t* out_count);
 
-// Timestamp parsing
-int64_t parse_timestamp(const char* ts_str);
+// Timestamp parsing: ticks are seconds since the epoch (the text's own
+// clock, no zone conversion) scaled by the fraction digits. Only succeeds
+// when timestamp_format reproduces the text exactly
+#define TIMESTAMP_MAX_TEXT 48
+int timestamp_parse(const char* text, TimestampShape* shape, int64_t* ticks);
+size_t timestamp_format(const TimestampShape* shape, int64_t ticks, char* out);
+int timestamp_shape_equal(const TimestampShape* a, const TimestampShape* b);
 
 // IP parsing
 uint32_t parse_ip(const char* ip_str);
@@ -0,0 +1,35 @@
+#ifndef ULC_VARINT_H
+#define ULC_VARINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Varints on plain buffers, for the modules the other engines link
+// (ulc_addr, ulc_cm, ulc_stream): those engines bring their own ByteArray,
+// so these helpers do not use the one in ulc_utils.
+
+// Writes value at out (at most 10 bytes); returns the bytes written
+static inline size_t put_varint(uint8_t* out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// Reads a value at data + *offset and advances *offset past it
+static inline uint64_t get_varint(const uint8_t* data, size_t* offset) {
+    uint64_t value = 0;
+    int shift = 0;
+    while (1) {
+        uint8_t byte = data[(*offset)++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+        shift += 7;
+    }
+    return value;
+}
+
+#endif
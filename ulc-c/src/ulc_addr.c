@@ -0,0 +1,257 @@
+#include "../include/ulc_addr.h"
+#include "../include/ulc_varint.h"
+#include <string.h>
+
+static const char hex_lower[] = "0123456789abcdef";
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Dotted quad, no leading zeros, exactly four octets
+static int parse_v4(const char* s, size_t len, uint32_t* out) {
+    uint32_t ip = 0;
+    size_t i = 0;
+    for (int octet = 0; octet < 4; octet++) {
+        if (octet > 0) {
+            if (i >= len || s[i] != '.') return 0;
+            i++;
+        }
+        size_t start = i;
+        unsigned int v = 0;
+        while (i < len && s[i] >= '0' && s[i] <= '9' && i - start < 3) {
+            v = v * 10 + (unsigned int)(s[i] - '0');
+            i++;
+        }
+        size_t digits = i - start;
+        if (digits == 0 || v > 255 || (digits > 1 && s[start] == '0')) return 0;
+        ip = (ip << 8) | v;
+    }
+    if (i != len) return 0;
+    *out = ip;
+    return 1;
+}
+
+static int parse_v6(const char* s, size_t len, uint16_t groups[8]) {
+    uint16_t head[8], tail[8];
+    size_t nh = 0, nt = 0;
+    int seen_gap = 0;
+    size_t i = 0;
+
+    if (len >= 2 && s[0] == ':' && s[1] == ':') {
+        seen_gap = 1;
+        i = 2;
+    } else if (len > 0 && s[0] == ':') {
+        return 0;
+    }
+
+    while (i < len) {
+        if (nh + nt >= 8) return 0;
+        size_t start = i;
+        unsigned int v = 0;
+        while (i < len && i - start < 4) {
+            int d = hex_digit(s[i]);
+            if (d < 0) break;
+            v = (v << 4) | (unsigned int)d;
+            i++;
+        }
+
+        if (i < len && s[i] == '.') {
+            // Embedded IPv4 tail takes the last two groups
+            uint32_t v4;
+            if (nh + nt > 6 || !parse_v4(s + start, len - start, &v4)) return 0;
+            uint16_t* dst = seen_gap ? tail : head;
+            size_t* n = seen_gap ? &nt : &nh;
+            dst[(*n)++] = (uint16_t)(v4 >> 16);
+            dst[(*n)++] = (uint16_t)(v4 & 0xFFFF);
+            i = len;
+            break;
+        }
+
+        if (i == start) return 0;
+        if (seen_gap) tail[nt++] = (uint16_t)v;
+        else head[nh++] = (uint16_t)v;
+
+        if (i == len) break;
+        if (s[i] != ':') return 0;
+        i++;
+        if (i < len && s[i] == ':') {
+            if (seen_gap) return 0;
+            seen_gap = 1;
+            i++;
+        } else if (i == len) {
+            return 0;   // Trailing single colon
+        }
+    }
+
+    if (seen_gap ? (nh + nt > 7) : (nh + nt != 8)) return 0;
+
+    memset(groups, 0, sizeof(uint16_t) * 8);
+    memcpy(groups, head, sizeof(uint16_t) * nh);
+    memcpy(groups + 8 - nt, tail, sizeof(uint16_t) * nt);
+    return 1;
+}
+
+static size_t format_v4(uint32_t ip, char* buf) {
+    size_t n = 0;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        unsigned int v = (ip >> shift) & 0xFF;
+        if (v >= 100) buf[n++] = (char)('0' + v / 100);
+        if (v >= 10) buf[n++] = (char)('0' + (v / 10) % 10);
+        buf[n++] = (char)('0' + v % 10);
+        if (shift > 0) buf[n++] = '.';
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+size_t addr_format(const Address* addr, char* buf) {
+    if (addr->family == ADDR_FAMILY_V4) {
+        return format_v4((uint32_t)addr->lo, buf);
+    }
+
+    // IPv4-mapped addresses keep the dotted tail (RFC 5952 section 5)
+    if (addr->hi == 0 && (addr->lo >> 32) == 0xFFFF) {
+        memcpy(buf, "::ffff:", 7);
+        return 7 + format_v4((uint32_t)addr->lo, buf + 7);
+    }
+
+    uint16_t g[8];
+    for (int k = 0; k < 4; k++) {
+        g[k] = (uint16_t)(addr->hi >> (48 - 16 * k));
+        g[k + 4] = (uint16_t)(addr->lo >> (48 - 16 * k));
+    }
+
+    // Longest run of zero groups (first one wins ties, single groups stay)
+    int best_start = -1, best_len = 1;
+    for (int k = 0; k < 8; ) {
+        if (g[k] != 0) { k++; continue; }
+        int run = k;
+        while (run < 8 && g[run] == 0) run++;
+        if (run - k > best_len) {
+            best_start = k;
+            best_len = run - k;
+        }
+        k = run;
+    }
+
+    const char* digits = hex_lower;
+    size_t n = 0;
+    for (int k = 0; k < 8; k++) {
+        if (k == best_start) {
+            buf[n++] = ':';
+            if (k == 0) buf[n++] = ':';
+            k += best_len - 1;
+            continue;
+        }
+        int started = 0;
+        for (int shift = 12; shift >= 0; shift -= 4) {
+            unsigned int d = (g[k] >> shift) & 0xF;
+            if (d || started || shift == 0) {
+                buf[n++] = digits[d];
+                started = 1;
+            }
+        }
+        if (k < 7) buf[n++] = ':';
+    }
+    buf[n] = '\0';
+
+    if (addr->family == ADDR_FAMILY_V6_UPPER) {
+        for (size_t k = 0; k < n; k++) {
+            if (buf[k] >= 'a' && buf[k] <= 'f') buf[k] = (char)(buf[k] - 'a' + 'A');
+        }
+    }
+    return n;
+}
+
+int addr_parse(const char* str, size_t len, Address* out) {
+    if (len == 0 || len >= ADDR_MAX_TEXT) return 0;
+
+    if (!memchr(str, ':', len)) {
+        uint32_t v4;
+        if (!parse_v4(str, len, &v4)) return 0;
+        out->family = ADDR_FAMILY_V4;
+        out->hi = 0;
+        out->lo = v4;
+        return 1;
+    }
+
+    uint16_t g[8];
+    if (!parse_v6(str, len, g)) return 0;
+
+    int has_lower = 0, has_upper = 0;
+    for (size_t k = 0; k < len; k++) {
+        if (str[k] >= 'a' && str[k] <= 'f') has_lower = 1;
+        else if (str[k] >= 'A' && str[k] <= 'F') has_upper = 1;
+    }
+    if (has_lower && has_upper) return 0;
+
+    out->family = has_upper ? ADDR_FAMILY_V6_UPPER : ADDR_FAMILY_V6;
+    out->hi = ((uint64_t)g[0] << 48) | ((uint64_t)g[1] << 32) | ((uint64_t)g[2] << 16) | g[3];
+    out->lo = ((uint64_t)g[4] << 48) | ((uint64_t)g[5] << 32) | ((uint64_t)g[6] << 16) | g[7];
+
+    // Reject spellings we would not reproduce (leading zeros, uncompressed runs, ...)
+    char canon[ADDR_MAX_TEXT];
+    size_t canon_len = addr_format(out, canon);
+    return canon_len == len && memcmp(canon, str, len) == 0;
+}
+
+void addr_codec_init(AddrCodec* codec) {
+    codec->prev_v4 = 0;
+    codec->prev_hi = 0;
+    codec->prev_lo = 0;
+}
+
+size_t addr_encode(AddrCodec* codec, const char* str, size_t len, uint8_t* out, int* verbatim) {
+    Address addr;
+    *verbatim = 0;
+
+    if (!addr_parse(str, len, &addr)) {
+        *verbatim = 1;
+        return put_varint(out, ((uint64_t)len << 2) | ADDR_FAMILY_NONE);
+    }
+
+    if (addr.family == ADDR_FAMILY_V4) {
+        uint32_t ip = (uint32_t)addr.lo;
+        size_t n = put_varint(out, ((uint64_t)(ip ^ codec->prev_v4) << 2) | ADDR_FAMILY_V4);
+        codec->prev_v4 = ip;
+        return n;
+    }
+
+    // IPv6: tag, then XOR of both halves against the previous IPv6 address
+    size_t n = put_varint(out, addr.family);
+    n += put_varint(out + n, addr.hi ^ codec->prev_hi);
+    n += put_varint(out + n, addr.lo ^ codec->prev_lo);
+    codec->prev_hi = addr.hi;
+    codec->prev_lo = addr.lo;
+    return n;
+}
+
+AddrFamily addr_decode(AddrCodec* codec, const uint8_t* data, size_t* offset, char* text, size_t* len) {
+    uint64_t header = get_varint(data, offset);
+    AddrFamily family = (AddrFamily)(header & 3);
+    Address addr;
+
+    if (family == ADDR_FAMILY_NONE) {
+        *len = (size_t)(header >> 2);
+        return family;
+    }
+
+    addr.family = family;
+    if (family == ADDR_FAMILY_V4) {
+        codec->prev_v4 ^= (uint32_t)(header >> 2);
+        addr.hi = 0;
+        addr.lo = codec->prev_v4;
+    } else {
+        codec->prev_hi ^= get_varint(data, offset);
+        codec->prev_lo ^= get_varint(data, offset);
+        addr.hi = codec->prev_hi;
+        addr.lo = codec->prev_lo;
+    }
+
+    *len = addr_format(&addr, text);
+    return family;
+}
@@ -0,0 +1,110 @@
+#include "../include/ulc_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// --- Arena ---
+
+void arena_init(Arena* arena) {
+    arena->head = NULL;
+    arena->blocks = 0;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    ArenaBlock* block = arena->head;
+    if (!block || block->used + size > block->size) {
+        // Oversized requests get a block of their own
+        size_t block_size = size > ARENA_BLOCK_SIZE / 4 ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(ArenaBlock) + block_size);
+        block->used = 0;
+        block->size = block_size;
+        arena->blocks++;
+        if (block_size == size && arena->head) {
+            // Keep filling the current block
+            block->next = arena->head->next;
+            arena->head->next = block;
+        } else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+    void* out = (char*)(block + 1) + block->used;
+    block->used += size;
+    return out;
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t len) {
+    char* out = arena_alloc(arena, len + 1);
+    memcpy(out, str, len);
+    out[len] = '\0';
+    return out;
+}
+
+// The newest block is kept for the next file or column
+void arena_reset(Arena* arena) {
+    if (!arena->head) return;
+    ArenaBlock* block = arena->head->next;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+}
+
+void arena_free(Arena* arena) {
+    arena_reset(arena);
+    free(arena->head);
+    arena->head = NULL;
+}
+
+// --- String columns ---
+
+void string_column_init(StringColumn* col) {
+    col->capacity = 4096;
+    col->data = malloc(col->capacity);
+    col->length = 0;
+    col->row_capacity = 1024;
+    col->offsets = malloc(sizeof(size_t) * (col->row_capacity + 1));
+    col->offsets[0] = 0;
+    col->count = 0;
+    col->missing = NULL;
+}
+
+void string_column_push(StringColumn* col, const char* value, size_t len) {
+    if (col->length + len + 1 > col->capacity) {
+        while (col->length + len + 1 > col->capacity) col->capacity *= 2;
+        col->data = realloc(col->data, col->capacity);
+    }
+    if (col->count >= col->row_capacity) {
+        col->row_capacity *= 2;
+        col->offsets = realloc(col->offsets, sizeof(size_t) * (col->row_capacity + 1));
+        if (col->missing) col->missing = realloc(col->missing, col->row_capacity);
+    }
+    memcpy(col->data + col->length, value, len);
+    col->length += len;
+    col->data[col->length++] = '\0';
+    if (col->missing) col->missing[col->count] = 0;
+    col->offsets[++col->count] = col->length;
+}
+
+void string_column_pad(StringColumn* col, size_t rows) {
+    while (col->count < rows) {
+        if (!col->missing) col->missing = calloc(col->row_capacity, 1);
+        string_column_push(col, "", 0);
+        col->missing[col->count - 1] = 1;
+    }
+}
+
+void string_column_put(StringColumn* col, size_t row, const char* value, size_t len) {
+    if (col->count > row) return;
+    string_column_pad(col, row);
+    string_column_push(col, value, len);
+}
+
+void string_column_free(StringColumn* col) {
+    free(col->data);
+    free(col->offsets);
+    free(col->missing);
+}
@@ -6,13 +6,19 @@
 static void print_usage(const char* prog_name) {
     printf("Ultra Log Compressor (ULC) - C Implementation\n\n");
     printf("Usage:\n");
-    printf("  %s compress <input> [-o <output>]\n", prog_name);
+    printf("  %s compress <input> [-o <output>] [--format-spec <spec> | --format-spec-file <file>]\n", prog_name);
     printf("  %s decompress <input> [-o <output>]\n", prog_name);
+    printf("  %s extract <input> --field <name> [-o <output>]\n", prog_name);
     printf("  %s info <input>\n\n", prog_name);
     printf("Commands:\n");
     printf("  compress    Compress a log file\n");
     printf("  decompress  Decompress a .ulc file\n");
-    printf("  info        Show file information\n");
+    printf("  extract     Write one field's values, one line per row\n");
+    printf("  info        Show file information\n\n");
+    printf("Options:\n");
+    printf("  --format-spec <spec>       Declared line format (nginx log_format or Apache\n");
+    printf("                             LogFormat syntax); ${name:int|ip|str} sets a type\n");
+    printf("  --format-spec-file <file>  First non-comment line of <file> as the spec\n");
 }
 
 static const char* format_size(size_t bytes, char* buffer, size_t buffer_size) {
@@ -29,7 +35,7 @@ static const char* format_size(size_t bytes, char* buffer, size_t buffer_size) {
     return buffer;
 }
 
-static int cmd_compress(const char* input, const char* output) {
+static int cmd_compress(const char* input, const char* output, const FormatSpec* spec) {
     char output_path[512];
     if (!output) {
         snprintf(output_path, sizeof(output_path), "%s.ulc", input);
@@ -42,7 +48,7 @@ static int cmd_compress(const char* input, const char* output) {
     size_t orig_size, comp_size;
     double duration;
     
-    int result = ulc_compress_file(input, output, &orig_size, &comp_size, &duration);
+    int result = ulc_compress_file_spec(input, output, spec, &orig_size, &comp_size, &duration);
     
     if (result != 0) {
         fprintf(stderr, "Compression failed\n");
@@ -84,8 +90,42 @@ static int cmd_decompress(const char* input, const char* output) {
         return 1;
     }
     
+    // Decode throughput is measured on the restored text
+    size_t restored_size = 0;
+    FILE* fp = fopen(output, "rb");
+    if (fp) {
+        fseek(fp, 0, SEEK_END);
+        restored_size = (size_t)ftell(fp);
+        fclose(fp);
+    }
+    
+    char size_buf[64];
     printf("\nDecompression complete!\n");
-    printf("  Time: %.3fs\n", duration);
+    printf("  Restored size: %s\n", format_size(restored_size, size_buf, sizeof(size_buf)));
+    printf("  Time:          %.3fs\n", duration);
+    if (duration > 0) printf("  Speed:         %.2f MB/s\n", (restored_size / duration) / (1024.0 * 1024.0));
+    
+    return 0;
+}
+
+static int cmd_extract(const char* input, const char* field, const char* output) {
+    char output_path[512];
+    if (!output) {
+        snprintf(output_path, sizeof(output_path), "%s.%s", input, field);
+        output = output_path;
+    }
+    
+    printf("Extracting field '%s' from: %s\n", field, input);
+    printf("Output: %s\n", output);
+    
+    double duration;
+    if (ulc_extract_field(input, field, output, &duration) != 0) {
+        fprintf(stderr, "Extraction failed\n");
+        return 1;
+    }
+    
+    printf("\nExtraction complete!\n");
+    printf("  Time:          %.3fs\n", duration);
     
     return 0;
 }
@@ -113,12 +153,29 @@ int main(int argc, char* argv[]) {
         
         const char* input = argv[2];
         const char* output = NULL;
+        FormatSpec* spec = NULL;
+        char* error = NULL;
         
-        if (argc >= 5 && strcmp(argv[3], "-o") == 0) {
-            output = argv[4];
+        for (int i = 3; i < argc && !error; i++) {
+            if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                output = argv[++i];
+            } else if (strcmp(argv[i], "--format-spec") == 0 && i + 1 < argc) {
+                format_spec_free(spec);
+                spec = format_spec_compile(argv[++i], &error);
+            } else if (strcmp(argv[i], "--format-spec-file") == 0 && i + 1 < argc) {
+                format_spec_free(spec);
+                spec = format_spec_load(argv[++i], &error);
+            }
+        }
+        if (error) {
+            fprintf(stderr, "Error: Invalid format spec (%s)\n", error);
+            free(error);
+            return 1;
         }
         
-        return cmd_compress(input, output);
+        int result = cmd_compress(input, output, spec);
+        format_spec_free(spec);
+        return result;
     } else if (strcmp(command, "decompress") == 0) {
         if (argc < 3) {
             fprintf(stderr, "Error: Missing input file\n");
@@ -134,6 +191,29 @@ int main(int argc, char* argv[]) {
         }
         
         return cmd_decompress(input, output);
+    } else if (strcmp(command, "extract") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Error: Missing input file\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+        
+        const char* output = NULL;
+        const char* field = NULL;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                output = argv[++i];
+            } else if (strcmp(argv[i], "--field") == 0 && i + 1 < argc) {
+                field = argv[++i];
+            }
+        }
+        if (!field) {
+            fprintf(stderr, "Error: Missing --field\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+        
+        return cmd_extract(argv[2], field, output);
     } else if (strcmp(command, "info") == 0) {
         if (argc < 3) {
             fprintf(stderr, "Error: Missing input file\n");
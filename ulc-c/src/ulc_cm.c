@@ -0,0 +1,436 @@
+#include "../include/ulc_cm.h"
+#include "../include/ulc_varint.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Model inputs: column order-0, order 1, 2, 3, 4, 6, column + order 2,
+// match within the current column section, bias
+#define CM_INPUTS 9
+#define CM_HASHED 5             // Orders 2, 3, 4, 6 and column + order 2
+#define CM_HASH_BITS 21
+#define CM_MATCH_BITS 20
+#define CM_MATCH_MAX 64
+#define CM_LIMIT 1023           // Adaptation count cap for probability slots
+
+// --- Logistic helpers (12-bit probabilities, stretch domain +-2047) ---
+
+static int squash(int x) {
+    static const int t[33] = {
+        1, 2, 3, 6, 10, 16, 27, 45, 73, 120, 194, 310, 488, 747, 1101, 1546,
+        2047, 2549, 2994, 3348, 3607, 3785, 3901, 3975, 4022, 4050, 4068, 4079,
+        4085, 4089, 4092, 4093, 4094
+    };
+    if (x > 2047) return 4095;
+    if (x < -2047) return 1;
+    int w = x & 127;
+    x = (x >> 7) + 16;
+    return (t[x] * (128 - w) + t[x + 1] * w + 64) >> 7;
+}
+
+static short stretch_table[4096];
+static int dt_table[CM_LIMIT + 1];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void init_tables(void) {
+    // Inverse of squash
+    int pi = 0;
+    for (int x = -2047; x <= 2047; x++) {
+        int v = squash(x);
+        for (int k = pi; k <= v; k++) stretch_table[k] = (short)x;
+        pi = v + 1;
+    }
+    for (int k = pi; k < 4096; k++) stretch_table[k] = 2047;
+    for (int i = 0; i <= CM_LIMIT; i++) dt_table[i] = 16384 / (i + i + 3);
+}
+
+static inline int stretch(int p) {
+    return stretch_table[p];
+}
+
+// Probability slot: 22-bit probability, 10-bit hit count
+static inline int slot_p(uint32_t slot) {
+    return (int)(slot >> 20);
+}
+
+static inline void slot_update(uint32_t* slot, int bit) {
+    uint32_t s = *slot;
+    int n = s & 1023;
+    int p = (int)(s >> 10);
+    if (n < CM_LIMIT) s++;
+    else s = (s & 0xFFFFFC00u) | CM_LIMIT;
+    s += (uint32_t)((int64_t)(((bit << 22) - p) >> 3) * dt_table[n]) & 0xFFFFFC00u;
+    *slot = s;
+}
+
+// --- Model ---
+
+typedef struct {
+    uint32_t order0[1 << 16];          // (column, partial byte)
+    uint32_t order1[1 << 16];          // (previous byte, partial byte)
+    uint32_t* hashed[CM_HASHED];
+    uint32_t context[CM_HASHED];       // Byte-level context hashes
+    uint32_t match_slots[CM_MATCH_MAX * 2];
+    int32_t* match_table;
+    int weights[2 * 256][CM_INPUTS];   // (match active, partial byte)
+    uint16_t apm[(1 << 16) * 33];      // SSE on (previous byte, partial byte)
+
+    // Per-byte state
+    const uint8_t* buf;                // Block bytes seen so far
+    size_t pos;
+    size_t section_start;              // Block-relative start of the current section
+    uint32_t column;                   // Hash of the current section index
+    uint32_t c4;                       // Last four bytes
+    uint32_t c8;                       // The four before that
+    int c0;                            // Partial byte with leading 1
+    int bit_pos;
+    size_t match_ptr;
+    int match_len;
+
+    // Per-bit scratch
+    uint32_t* active[CM_HASHED + 2];
+    int inputs[CM_INPUTS];
+    int match_slot;
+    int weight_set;
+    int apm_index;
+    int pr;
+} CmModel;
+
+static CmModel* model_new(void) {
+    pthread_once(&tables_once, init_tables);
+    CmModel* m = calloc(1, sizeof(CmModel));
+    for (int i = 0; i < (1 << 16); i++) m->order0[i] = m->order1[i] = 1u << 31;
+    for (int k = 0; k < CM_HASHED; k++) {
+        m->hashed[k] = malloc(sizeof(uint32_t) << CM_HASH_BITS);
+        for (size_t i = 0; i < ((size_t)1 << CM_HASH_BITS); i++) m->hashed[k][i] = 1u << 31;
+    }
+    for (int i = 0; i < CM_MATCH_MAX * 2; i++) m->match_slots[i] = 1u << 31;
+    m->match_table = calloc((size_t)1 << CM_MATCH_BITS, sizeof(int32_t));
+    for (int c = 0; c < (1 << 16); c++) {
+        for (int j = 0; j < 33; j++) m->apm[c * 33 + j] = (uint16_t)(squash((j - 16) * 128) * 16);
+    }
+    for (int c = 0; c < 2 * 256; c++) {
+        for (int i = 0; i < CM_INPUTS; i++) m->weights[c][i] = 1 << 14;
+    }
+    m->c0 = 1;
+    return m;
+}
+
+static void model_free(CmModel* m) {
+    for (int k = 0; k < CM_HASHED; k++) free(m->hashed[k]);
+    free(m->match_table);
+    free(m);
+}
+
+static inline uint32_t hash32(uint32_t a, uint32_t b) {
+    uint32_t h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u) * 0x85EBCA6Bu;
+    return h ^ (h >> 15);
+}
+
+// Recompute byte-level contexts after a whole byte
+static void model_byte_update(CmModel* m) {
+    m->context[0] = hash32(m->c4 & 0xFFFF, 2);
+    m->context[1] = hash32(m->c4 & 0xFFFFFF, 3);
+    m->context[2] = hash32(m->c4, 4);
+    m->context[3] = hash32(m->c4 ^ (m->c8 & 0xFFFF) * 0x2F0F1C3Bu, 6);
+    m->context[4] = hash32((m->c4 & 0xFFFF) ^ m->column, 7);
+
+    // Match model: follow the current match or look up the last occurrence
+    // of the order-6 context inside the same column section. In columnar
+    // layout that is usually an earlier row of this column.
+    uint32_t h = m->context[3] >> (32 - CM_MATCH_BITS);
+    if (m->match_len > 0 && m->match_ptr < m->pos && m->buf[m->match_ptr] == m->buf[m->pos - 1]) {
+        m->match_ptr++;
+        if (m->match_len < CM_MATCH_MAX - 1) m->match_len++;
+    } else {
+        m->match_len = 0;
+        int32_t candidate = m->match_table[h];
+        if (candidate > 0 && (size_t)candidate >= m->section_start) {
+            m->match_ptr = (size_t)candidate;
+            int len = 0;
+            while (len < CM_MATCH_MAX - 1 && (size_t)len < m->match_ptr &&
+                   m->buf[m->match_ptr - 1 - len] == m->buf[m->pos - 1 - len]) {
+                len++;
+            }
+            m->match_len = len;
+        }
+    }
+    m->match_table[h] = (int32_t)m->pos;
+}
+
+static int model_predict(CmModel* m) {
+    int c0 = m->c0;
+    m->active[0] = &m->order0[((m->column & 0xFF) << 8) | c0];
+    m->active[1] = &m->order1[((m->c4 & 0xFF) << 8) | c0];
+    for (int k = 0; k < CM_HASHED; k++) {
+        uint32_t index = hash32(m->context[k], (uint32_t)c0) >> (32 - CM_HASH_BITS);
+        m->active[k + 2] = &m->hashed[k][index];
+    }
+    for (int i = 0; i < CM_HASHED + 2; i++) m->inputs[i] = stretch(slot_p(*m->active[i]));
+
+    // Match input only while the predicted byte agrees with the bits so far
+    m->match_slot = -1;
+    m->inputs[CM_HASHED + 2] = 0;
+    if (m->match_len > 0) {
+        int expected = m->buf[m->match_ptr] | 0x100;
+        if ((expected >> (8 - m->bit_pos)) == c0) {
+            int bit = (expected >> (7 - m->bit_pos)) & 1;
+            m->match_slot = m->match_len * 2 + bit;
+            m->inputs[CM_HASHED + 2] = stretch(slot_p(m->match_slots[m->match_slot]));
+        } else {
+            m->match_len = 0;
+        }
+    }
+    m->inputs[CM_INPUTS - 1] = 256;
+
+    // Logistic mix, weights selected by match state and partial byte
+    m->weight_set = (m->match_slot >= 0) * 256 + c0;
+    const int* w = m->weights[m->weight_set];
+    int64_t dot = 0;
+    for (int i = 0; i < CM_INPUTS; i++) dot += (int64_t)m->inputs[i] * w[i];
+    int pr = squash((int)(dot >> 16));
+
+    // Refine with an adaptive probability map, interpolating between buckets
+    int s = stretch(pr) + 2048;
+    int w8 = s & 127;
+    int index = (((m->c4 & 0xFF) << 8) | c0) * 33 + (s >> 7);
+    int refined = (m->apm[index] * (128 - w8) + m->apm[index + 1] * w8) >> 11;
+    m->apm_index = index + (w8 >> 6);
+    pr = (pr + 3 * refined) >> 2;
+    if (pr < 1) pr = 1;
+    if (pr > 4095) pr = 4095;
+    m->pr = pr;
+    return pr;
+}
+
+static void model_update(CmModel* m, int bit) {
+    int err = ((bit << 12) - m->pr) * 6;
+    int* w = m->weights[m->weight_set];
+    for (int i = 0; i < CM_INPUTS; i++) w[i] += (m->inputs[i] * err) >> 10;
+
+    int g = (bit << 16) + (bit << 7) - bit - bit;
+    m->apm[m->apm_index] += (g - m->apm[m->apm_index]) >> 7;
+
+    for (int i = 0; i < CM_HASHED + 2; i++) slot_update(m->active[i], bit);
+    if (m->match_slot >= 0) slot_update(&m->match_slots[m->match_slot], bit);
+
+    m->c0 = (m->c0 << 1) | bit;
+    m->bit_pos++;
+    if (m->bit_pos == 8) {
+        uint8_t byte = (uint8_t)m->c0;
+        m->c8 = (m->c8 << 8) | (m->c4 >> 24);
+        m->c4 = (m->c4 << 8) | byte;
+        m->c0 = 1;
+        m->bit_pos = 0;
+        m->pos++;
+        model_byte_update(m);
+    }
+}
+
+// --- Blocks ---
+
+typedef struct {
+    const uint8_t* data;      // Raw block (encoder input / decoder output)
+    uint8_t* raw;
+    size_t len;
+    const uint8_t* packed;    // Coded block (decoder input)
+    size_t packed_len;
+    uint8_t* out;             // Coded block (encoder output)
+    size_t out_len;
+    const size_t* sections;   // Block-relative section starts
+    size_t section_count;
+} CmJob;
+
+// Advance to the section containing pos
+static void model_section(CmModel* m, const CmJob* job, size_t* next_section) {
+    while (*next_section < job->section_count && job->sections[*next_section] <= m->pos) {
+        m->section_start = job->sections[*next_section];
+        m->column = hash32((uint32_t)*next_section, 11);
+        (*next_section)++;
+    }
+}
+
+static void* cm_encode_worker(void* arg) {
+    CmJob* job = arg;
+    CmModel* m = model_new();
+    m->buf = job->data;
+    model_byte_update(m);
+
+    size_t capacity = job->len + job->len / 2 + 64;
+    uint8_t* out = malloc(capacity);
+    size_t n = 0;
+    uint32_t x1 = 0, x2 = 0xFFFFFFFFu;
+    size_t next_section = 0;
+
+    for (size_t i = 0; i < job->len; i++) {
+        model_section(m, job, &next_section);
+        int c = job->data[i];
+        for (int b = 7; b >= 0; b--) {
+            int bit = (c >> b) & 1;
+            int p = model_predict(m);
+            uint32_t xmid = x1 + (uint32_t)(((uint64_t)(x2 - x1) * (uint32_t)p) >> 12);
+            if (bit) x2 = xmid;
+            else x1 = xmid + 1;
+            model_update(m, bit);
+            while (((x1 ^ x2) & 0xFF000000u) == 0) {
+                if (n + 4 >= capacity) {
+                    capacity *= 2;
+                    out = realloc(out, capacity);
+                }
+                out[n++] = (uint8_t)(x2 >> 24);
+                x1 <<= 8;
+                x2 = (x2 << 8) | 0xFF;
+            }
+        }
+    }
+    if (n + 4 >= capacity) out = realloc(out, capacity + 4);
+    for (int k = 0; k < 4; k++) out[n++] = (uint8_t)(x1 >> (24 - 8 * k));
+
+    model_free(m);
+    job->out = out;
+    job->out_len = n;
+    return NULL;
+}
+
+static void* cm_decode_worker(void* arg) {
+    CmJob* job = arg;
+    CmModel* m = model_new();
+    m->buf = job->raw;
+    model_byte_update(m);
+
+    const uint8_t* in = job->packed;
+    size_t in_len = job->packed_len, k = 0;
+    uint32_t x1 = 0, x2 = 0xFFFFFFFFu, x = 0;
+    for (int b = 0; b < 4; b++) x = (x << 8) | (k < in_len ? in[k++] : 0xFF);
+    size_t next_section = 0;
+
+    for (size_t i = 0; i < job->len; i++) {
+        model_section(m, job, &next_section);
+        for (int b = 0; b < 8; b++) {
+            int p = model_predict(m);
+            uint32_t xmid = x1 + (uint32_t)(((uint64_t)(x2 - x1) * (uint32_t)p) >> 12);
+            int bit = x <= xmid;
+            if (bit) x2 = xmid;
+            else x1 = xmid + 1;
+            // The model reads the byte being built, so store it before the update
+            if (b == 7) job->raw[i] = (uint8_t)((m->c0 << 1) | bit);
+            model_update(m, bit);
+            while (((x1 ^ x2) & 0xFF000000u) == 0) {
+                x1 <<= 8;
+                x2 = (x2 << 8) | 0xFF;
+                x = (x << 8) | (k < in_len ? in[k++] : 0xFF);
+            }
+        }
+    }
+
+    model_free(m);
+    return NULL;
+}
+
+// Run jobs in waves of CM_THREADS
+static void run_jobs(CmJob* jobs, size_t count, void* (*worker)(void*)) {
+    pthread_t threads[CM_THREADS];
+    for (size_t b = 0; b < count; b += CM_THREADS) {
+        size_t wave = count - b < CM_THREADS ? count - b : CM_THREADS;
+        if (wave == 1) {
+            worker(&jobs[b]);
+            continue;
+        }
+        for (size_t t = 0; t < wave; t++) pthread_create(&threads[t], NULL, worker, &jobs[b + t]);
+        for (size_t t = 0; t < wave; t++) pthread_join(threads[t], NULL);
+    }
+}
+
+// Section starts that fall inside [start, start + len), block-relative
+static size_t* block_sections(const size_t* sections, size_t section_count, size_t start, size_t len, size_t* count) {
+    size_t* out = malloc(sizeof(size_t) * (section_count + 1));
+    size_t n = 0;
+    out[n++] = 0;
+    for (size_t s = 0; s < section_count; s++) {
+        if (sections[s] > start && sections[s] < start + len) out[n++] = sections[s] - start;
+    }
+    *count = n;
+    return out;
+}
+
+// Layout: magic, varint length, varint section count, section starts as
+// deltas, varint block count, varint coded length per block, coded blocks
+
+uint8_t* cm_compress(const uint8_t* data, size_t len, const size_t* sections, size_t section_count,
+                     size_t* out_len) {
+    size_t block_count = (len + CM_BLOCK_SIZE - 1) / CM_BLOCK_SIZE;
+    CmJob* jobs = calloc(block_count + 1, sizeof(CmJob));
+    for (size_t b = 0; b < block_count; b++) {
+        size_t start = b * CM_BLOCK_SIZE;
+        jobs[b].data = data + start;
+        jobs[b].len = len - start < CM_BLOCK_SIZE ? len - start : CM_BLOCK_SIZE;
+        jobs[b].sections = block_sections(sections, section_count, start, jobs[b].len, &jobs[b].section_count);
+    }
+    run_jobs(jobs, block_count, cm_encode_worker);
+
+    size_t total = CM_MAGIC_LEN + 10 * (3 + section_count + block_count);
+    for (size_t b = 0; b < block_count; b++) total += jobs[b].out_len;
+    uint8_t* out = malloc(total);
+    size_t n = 0;
+    memcpy(out, CM_MAGIC, CM_MAGIC_LEN);
+    n += CM_MAGIC_LEN;
+    n += put_varint(out + n, len);
+    n += put_varint(out + n, section_count);
+    size_t prev = 0;
+    for (size_t s = 0; s < section_count; s++) {
+        n += put_varint(out + n, sections[s] - prev);
+        prev = sections[s];
+    }
+    n += put_varint(out + n, block_count);
+    for (size_t b = 0; b < block_count; b++) n += put_varint(out + n, jobs[b].out_len);
+    for (size_t b = 0; b < block_count; b++) {
+        memcpy(out + n, jobs[b].out, jobs[b].out_len);
+        n += jobs[b].out_len;
+        free(jobs[b].out);
+        free((void*)jobs[b].sections);
+    }
+    free(jobs);
+
+    *out_len = n;
+    return out;
+}
+
+uint8_t* cm_decompress(const uint8_t* data, size_t len, size_t* consumed, size_t* out_len) {
+    size_t offset = CM_MAGIC_LEN;
+    size_t total = get_varint(data, &offset);
+    size_t section_count = get_varint(data, &offset);
+    size_t* sections = malloc(sizeof(size_t) * (section_count + 1));
+    size_t prev = 0;
+    for (size_t s = 0; s < section_count; s++) {
+        prev += get_varint(data, &offset);
+        sections[s] = prev;
+    }
+    size_t block_count = get_varint(data, &offset);
+
+    uint8_t* out = malloc(total + 1);
+    CmJob* jobs = calloc(block_count + 1, sizeof(CmJob));
+    for (size_t b = 0; b < block_count; b++) jobs[b].packed_len = get_varint(data, &offset);
+    for (size_t b = 0; b < block_count; b++) {
+        size_t start = b * CM_BLOCK_SIZE;
+        jobs[b].raw = out + start;
+        jobs[b].len = total - start < CM_BLOCK_SIZE ? total - start : CM_BLOCK_SIZE;
+        jobs[b].packed = data + offset;
+        offset += jobs[b].packed_len;
+        jobs[b].sections = block_sections(sections, section_count, start, jobs[b].len, &jobs[b].section_count);
+    }
+    run_jobs(jobs, block_count, cm_decode_worker);
+
+    for (size_t b = 0; b < block_count; b++) free((void*)jobs[b].sections);
+    free(jobs);
+    free(sections);
+
+    (void)len;
+    out[total] = 0;
+    *consumed = offset;
+    *out_len = total;
+    return out;
+}
+
+int cm_is_stream(const uint8_t* data, size_t len) {
+    return len >= CM_MAGIC_LEN && memcmp(data, CM_MAGIC, CM_MAGIC_LEN) == 0;
+}
@@ -1,89 +1,226 @@
 #include "../include/ulc_compress.h"
 #include "../include/ulc_parser.h"
 #include "../include/ulc_utils.h"
+#include "../include/ulc_addr.h"
+#include "../include/ulc_json.h"
+#include "../include/ulc_frame.h"
+#include "../include/ulc_envelope.h"
+#include "../include/ulc_stream.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
 #include <lzma.h>
 
-// Simple serialization format (simplified compared to Python's pickle)
-// Format: [field_count][field1_len][field1][type1][data1_len][data1]...
+// Whether a value survives atoll and printing back unchanged
+static int is_plain_int(const char* s, size_t len) {
+    const char* p = (*s == '-') ? s + 1 : s;
+    len -= p - s;
+    if (len == 0 || len > 18 || (p[0] == '0' && (len > 1 || p != s))) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] < '0' || p[i] > '9') return 0;
+    }
+    return 1;
+}
+
+// Column type from the values: integer, address or timestamp (of one
+// shape, returned in *shape) when every present value is one and prints
+// back unchanged
+static ColumnType infer_column_type(const StringColumn* col, TimestampShape* shape) {
+    int present = 0, is_int = 1, is_ip = 1, is_ts = 1;
+    for (size_t i = 0; i < col->count && (is_int || is_ip || is_ts); i++) {
+        if (string_column_missing(col, i)) continue;
+        const char* val = string_column_value(col, i);
+        size_t len = string_column_length(col, i);
+        Address addr;
+        if (is_int && !is_plain_int(val, len)) is_int = 0;
+        if (is_ip && !addr_parse(val, len, &addr)) is_ip = 0;
+        if (is_ts) {
+            TimestampShape value_shape;
+            int64_t ticks;
+            if (!timestamp_parse(val, &value_shape, &ticks) || (present && !timestamp_shape_equal(&value_shape, shape))) {
+                is_ts = 0;
+            } else {
+                *shape = value_shape;
+            }
+        }
+        present = 1;
+    }
+    if (!present) return COL_TYPE_STRING;
+    if (is_int) return COL_TYPE_INT;
+    if (is_ip) return COL_TYPE_IP;
+    if (is_ts) return COL_TYPE_TIMESTAMP;
+    return COL_TYPE_STRING;
+}
+
+// Multi-line record: the continuation lines become two string fields, the
+// frame skeleton (recurring traces share one dictionary entry) and the
+// lines between the frames
+static void attach_trace(LogParser* parser, LogEntry* entry, char** lines, size_t count) {
+    char* frames;
+    char* messages;
+    frame_split(lines, count, &frames, &messages);
+    log_entry_add_field(parser, entry, "trace_frames", frames);
+    log_entry_add_field(parser, entry, "trace_messages", messages);
+    free(frames);
+    free(messages);
+    for (size_t i = 0; i < count; i++) free(lines[i]);
+}
 
-static ByteArray* serialize_compressed_data(LogEntry** entries, size_t entry_count, 
-                                            Dictionary** dicts, size_t dict_count) {
+// Fields of the file as string columns by schema id, in order of first
+// appearance. Each entry goes in once it is complete (its trace attached),
+// so no array of entries is kept
+typedef struct {
+    StringColumn* columns;  // By schema id
+    char* seen;             // Whether columns[id] is in use
+    size_t capacity;
+    int* order;             // Schema ids in order of first appearance
+    size_t count;
+} FieldStore;
+
+static void field_store_add(FieldStore* store, const LogParser* parser, const LogEntry* entry, size_t row) {
+    if (parser->schema.count > store->capacity) {
+        size_t capacity = store->capacity ? store->capacity : 16;
+        while (capacity < parser->schema.count) capacity *= 2;
+        store->columns = realloc(store->columns, sizeof(StringColumn) * capacity);
+        store->seen = realloc(store->seen, capacity);
+        store->order = realloc(store->order, sizeof(int) * capacity);
+        memset(store->seen + store->capacity, 0, capacity - store->capacity);
+        store->capacity = capacity;
+    }
+    for (size_t k = 0; k < entry->field_count; k++) {
+        int id = entry->ids[k];
+        if (!store->seen[id]) {
+            store->seen[id] = 1;
+            string_column_init(&store->columns[id]);
+            store->order[store->count++] = id;
+        }
+        const char* val = entry->values[k];
+        string_column_put(&store->columns[id], row, val, strlen(val));
+    }
+}
+
+static void field_store_free(FieldStore* store) {
+    for (size_t k = 0; k < store->count; k++) string_column_free(&store->columns[store->order[k]]);
+    free(store->columns);
+    free(store->seen);
+    free(store->order);
+}
+
+// Serialization format:
+// [entry_count][field_count]([name_len][name])... then per field [type][data]:
+//   STRING    [dict_count]([len][bytes])... [ids_len][varint ids]
+//   INT       [data_len][delta-coded values]
+//   TIMESTAMP [kind][digits][sep][point][suffix_len][suffix][data_len][delta-coded ticks]
+//   IP        [data_len][addr_encode stream]
+// and last [line_flags] (LINES_*), which streams from before it lack: those
+// read as LF line ends with a final newline. With LINES_NUL_BYTES it is
+// followed by [nul_count][delta-coded offsets] of the input's NUL bytes.
+// Every row has a "_layout" (see LogParser.layouts) naming the fields it
+// holds; rows without a field store "", or repeat the previous number.
+// sections (store->count entries) receives where each field's data starts
+
+#define LINES_CRLF              1   // Every line ended in CRLF
+#define LINES_NO_FINAL_NEWLINE  2   // The last line had no line end
+#define LINES_NUL_BYTES         4   // NUL bytes were parsed as NUL_STANDIN
+
+// The parser works on C strings, so a NUL byte is replaced by this before
+// parsing and put back by offset on decode
+#define NUL_STANDIN 0x7F
+
+static ByteArray* serialize_compressed_data(const LogParser* parser, FieldStore* store, size_t entry_count,
+                                            const FormatSpec* spec, size_t* sections) {
     ByteArray* output = bytearray_new(1024 * 1024);
+    const Schema* schema = &parser->schema;
+    const int* field_order = store->order;
+    size_t field_count = store->count;
     
     // Write entry count
     encode_varint(output, entry_count);
     
-    // Determine all unique fields
-    Dictionary* field_dict = dict_new(64);
-    for (size_t i = 0; i < entry_count; i++) {
-        for (size_t j = 0; j < entries[i]->field_count; j++) {
-            dict_get_or_add(field_dict, entries[i]->fields[j]);
-        }
-    }
-    
     // Write field dictionary
-    encode_varint(output, field_dict->count);
-    for (size_t i = 0; i < field_dict->count; i++) {
-        const char* field = field_dict->entries[i].key;
+    encode_varint(output, field_count);
+    for (size_t i = 0; i < field_count; i++) {
+        const char* field = schema->names[field_order[i]];
         encode_varint(output, strlen(field));
         bytearray_append(output, (uint8_t*)field, strlen(field));
     }
     
-    // For each field, collect values and encode
-    for (size_t field_idx = 0; field_idx < field_dict->count; field_idx++) {
-        const char* field_name = field_dict->entries[field_idx].key;
+    // Each field's values are a string column; rows that lack the field
+    // are flagged missing and hold ""
+    for (size_t field_idx = 0; field_idx < field_count; field_idx++) {
+        int id = field_order[field_idx];
+        const char* field_name = schema->names[id];
+        StringColumn* col = &store->columns[id];
+        string_column_pad(col, entry_count);
+        sections[field_idx] = output->length;
         
-        // Determine column type
+        // Determine column type; a declared format's fields keep their type.
+        // Numbers and timestamps only where they print back exactly
         ColumnType col_type = COL_TYPE_STRING;
-        if (strcmp(field_name, "timestamp") == 0) {
-            col_type = COL_TYPE_TIMESTAMP;
+        TimestampShape shape;
+        int declared = spec ? format_spec_type(spec, field_name) : -1;
+        if (declared >= 0) {
+            col_type = (ColumnType)declared;
         } else if (strcmp(field_name, "ip") == 0) {
             col_type = COL_TYPE_IP;
-        } else if (strcmp(field_name, "status") == 0 || strcmp(field_name, "size") == 0 ||
-                   strcmp(field_name, "pid") == 0) {
-            col_type = COL_TYPE_INT;
+        } else if (strcmp(field_name, JSON_LAYOUT_FIELD) != 0) {
+            col_type = infer_column_type(col, &shape);
         }
         
         // Write column type
         bytearray_append_byte(output, (uint8_t)col_type);
         
         // Collect values
-        if (col_type == COL_TYPE_TIMESTAMP || col_type == COL_TYPE_IP || col_type == COL_TYPE_INT) {
+        if (col_type == COL_TYPE_IP) {
+            // Address column - family tag + XOR against previous address (IPv4 and IPv6)
+            AddrCodec codec;
+            addr_codec_init(&codec);
+            ByteArray* encoded = bytearray_new(entry_count * 4);
+            uint8_t header[ADDR_MAX_ENCODED];
+            for (size_t i = 0; i < entry_count; i++) {
+                const char* val = string_column_value(col, i);
+                size_t len = string_column_length(col, i);
+                int verbatim;
+                size_t n = addr_encode(&codec, val, len, header, &verbatim);
+                bytearray_append(encoded, header, n);
+                if (verbatim) bytearray_append(encoded, (const uint8_t*)val, len);
+            }
+            encode_varint(output, encoded->length);
+            bytearray_append(output, encoded->data, encoded->length);
+            bytearray_free(encoded);
+        } else if (col_type == COL_TYPE_TIMESTAMP || col_type == COL_TYPE_INT) {
             // Numeric column - use delta encoding
-            int64_t* values = malloc(sizeof(int64_t) * entry_count);
+            if (col_type == COL_TYPE_TIMESTAMP) {
+                bytearray_append_byte(output, shape.kind);
+                bytearray_append_byte(output, shape.digits);
+                bytearray_append_byte(output, (uint8_t)shape.sep);
+                bytearray_append_byte(output, (uint8_t)shape.point);
+                encode_varint(output, strlen(shape.suffix));
+                bytearray_append(output, (const uint8_t*)shape.suffix, strlen(shape.suffix));
+            }
+            int64_t* numbers = malloc(sizeof(int64_t) * entry_count);
+            int64_t prev = 0;
             for (size_t i = 0; i < entry_count; i++) {
-                const char* val = NULL;
-                for (size_t j = 0; j < entries[i]->field_count; j++) {
-                    if (strcmp(entries[i]->fields[j], field_name) == 0) {
-                        val = entries[i]->values[j];
-                        break;
-                    }
-                }
-                
-                if (val) {
+                const char* val = string_column_value(col, i);
+                if (!string_column_missing(col, i)) {
                     if (col_type == COL_TYPE_TIMESTAMP) {
-                        values[i] = parse_timestamp(val);
-                    } else if (col_type == COL_TYPE_IP) {
-                        values[i] = parse_ip(val);
+                        TimestampShape value_shape;
+                        timestamp_parse(val, &value_shape, &prev);
                     } else {
-                        values[i] = atoll(val);
+                        prev = atoll(val);
                     }
-                } else {
-                    values[i] = 0;
                 }
+                numbers[i] = prev;
             }
             
             // Encode with delta
             ByteArray* encoded = bytearray_new(entry_count * 4);
-            encode_delta(encoded, values, entry_count);
+            encode_delta(encoded, numbers, entry_count);
             encode_varint(output, encoded->length);
             bytearray_append(output, encoded->data, encoded->length);
             
-            free(values);
+            free(numbers);
             bytearray_free(encoded);
         } else {
             // String column - use dictionary encoding
@@ -91,14 +228,7 @@ static ByteArray* serialize_compressed_data(LogEntry** entries, size_t entry_cou
             int* ids = malloc(sizeof(int) * entry_count);
             
             for (size_t i = 0; i < entry_count; i++) {
-                const char* val = "";
-                for (size_t j = 0; j < entries[i]->field_count; j++) {
-                    if (strcmp(entries[i]->fields[j], field_name) == 0) {
-                        val = entries[i]->values[j];
-                        break;
-                    }
-                }
-                ids[i] = dict_get_or_add(value_dict, val);
+                ids[i] = dict_get_or_add(value_dict, string_column_value(col, i));
             }
             
             // Write dictionary
@@ -123,52 +253,154 @@ static ByteArray* serialize_compressed_data(LogEntry** entries, size_t entry_cou
         }
     }
     
-    dict_free(field_dict);
     return output;
 }
 
 int ulc_compress_file(const char* input_path, const char* output_path,
                       size_t* orig_size, size_t* comp_size, double* duration) {
+    return ulc_compress_file_spec(input_path, output_path, NULL, orig_size, comp_size, duration);
+}
+
+int ulc_compress_file_spec(const char* input_path, const char* output_path, const FormatSpec* spec,
+                           size_t* orig_size, size_t* comp_size, double* duration) {
     clock_t start = clock();
     
-    // Read input file
-    FILE* fp = fopen(input_path, "r");
+    // Read input file whole, in binary: lines of any length, with their
+    // line ends as they are
+    FILE* fp = fopen(input_path, "rb");
     if (!fp) {
         fprintf(stderr, "Error: Cannot open input file: %s\n", input_path);
         return -1;
     }
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* text = malloc((file_size > 0 ? file_size : 0) + 1);
+    size_t total_bytes = file_size > 0 ? fread(text, 1, file_size, fp) : 0;
+    fclose(fp);
+    text[total_bytes] = '\0';
+    
+    // Line ends: CRLF is dropped from the lines only when every line has
+    // it; otherwise a CR stays in its line's text
+    uint8_t line_flags = 0;
+    size_t lf_count = 0, crlf_count = 0;
+    for (size_t i = 0; i < total_bytes; i++) {
+        if (text[i] != '\n') continue;
+        lf_count++;
+        if (i > 0 && text[i-1] == '\r') crlf_count++;
+    }
+    if (lf_count > 0 && crlf_count == lf_count) line_flags |= LINES_CRLF;
+    if (total_bytes > 0 && text[total_bytes-1] != '\n') line_flags |= LINES_NO_FINAL_NEWLINE;
+    
+    ByteArray* nul_offsets = bytearray_new(64);
+    size_t nul_count = 0, prev_nul = 0;
+    for (char* p = memchr(text, '\0', total_bytes); p; p = memchr(p + 1, '\0', text + total_bytes - p - 1)) {
+        *p = NUL_STANDIN;
+        encode_varint(nul_offsets, (size_t)(p - text) - prev_nul);
+        prev_nul = (size_t)(p - text);
+        nul_count++;
+    }
+    if (nul_count > 0) line_flags |= LINES_NUL_BYTES;
+    
+    // Split into lines, in place
+    size_t line_count = 0, line_capacity = 1024, partials = 0;
+    char** lines = malloc(sizeof(char*) * line_capacity);
+    for (char* line = text; line < text + total_bytes; ) {
+        char* end = memchr(line, '\n', text + total_bytes - line);
+        char* next = end ? end + 1 : text + total_bytes;
+        if (!end) {
+            end = text + total_bytes;
+        } else if (line_flags & LINES_CRLF) {
+            end--;
+        }
+        *end = '\0';
+        if (line_count == line_capacity) {
+            line_capacity *= 2;
+            lines = realloc(lines, sizeof(char*) * line_capacity);
+        }
+        lines[line_count++] = line;
+        partials += envelope_maybe_partial(line);
+        line = next;
+    }
     
-    // Read all lines
-    LogEntry** entries = NULL;
-    size_t entry_count = 0;
-    size_t entry_capacity = 1024;
-    entries = malloc(sizeof(LogEntry*) * entry_capacity);
+    // Container logs: a run of partial lines becomes the one line it was
+    // split from; tags[] records where to cut it again. envelope_reassemble
+    // replaces the lines it joins, so they are copied first
+    char** envelope_tags = NULL;
+    if (partials > 0) {
+        for (size_t i = 0; i < line_count; i++) lines[i] = strdup(lines[i]);
+        size_t joined_count = envelope_reassemble(lines, line_count, &envelope_tags);
+        for (size_t i = joined_count; i < line_count; i++) lines[i] = NULL;
+        line_count = joined_count;
+    }
     
-    char line[16384];
-    size_t total_bytes = 0;
+    // Each record goes into the field columns once the next header shows
+    // its trace (if any) is complete
+    FieldStore store = {0};
+    LogEntry* last = NULL;
+    size_t entry_count = 0;
     
-    while (fgets(line, sizeof(line), fp)) {
-        // Remove newline
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') line[len-1] = '\0';
-        if (len > 1 && line[len-2] == '\r') line[len-2] = '\0';
-        
-        total_bytes += strlen(line) + 1;
-        
-        LogEntry* entry = parse_log_line(line);
+    LogParser parser;
+    log_parser_init(&parser);
+    parser.layouts = 1;
+    if (spec) log_parser_set_spec(&parser, spec);
+    
+    // Continuation lines (stack traces) waiting for the next record header
+    char** pending = NULL;
+    size_t pending_count = 0, pending_capacity = 0;
+    
+    for (size_t i = 0; i < line_count; i++) {
+        const char* line = lines[i];
+        if (entry_count > 0 && frame_is_continuation(line)) {
+            if (pending_count == pending_capacity) {
+                pending_capacity = pending_capacity ? pending_capacity * 2 : 64;
+                pending = realloc(pending, sizeof(char*) * pending_capacity);
+            }
+            pending[pending_count++] = strdup(line);
+            continue;
+        }
+        if (pending_count > 0) {
+            attach_trace(&parser, last, pending, pending_count);
+            pending_count = 0;
+        }
+        if (last) field_store_add(&store, &parser, last, entry_count - 1);
         
-        if (entry_count >= entry_capacity) {
-            entry_capacity *= 2;
-            entries = realloc(entries, sizeof(LogEntry*) * entry_capacity);
+        last = log_parser_parse(&parser, line);
+        // Fragment tag of a reassembled container line replaces its "F"
+        if (envelope_tags && envelope_tags[i]) log_entry_set_envelope_tag(&parser, last, envelope_tags[i]);
+        entry_count++;
+    }
+    if (partials > 0) {
+        for (size_t i = 0; i < line_count; i++) {
+            free(lines[i]);
+            if (envelope_tags) free(envelope_tags[i]);
         }
-        entries[entry_count++] = entry;
     }
-    fclose(fp);
+    free(envelope_tags);
+    free(lines);
+    free(text);
+    if (pending_count > 0) attach_trace(&parser, last, pending, pending_count);
+    if (last) field_store_add(&store, &parser, last, entry_count - 1);
+    free(pending);
     
     *orig_size = total_bytes;
     
     // Serialize
-    ByteArray* serialized = serialize_compressed_data(entries, entry_count, NULL, 0);
+    // Declared types hold when every line matched the spec; otherwise the
+    // same field names may carry other parsers' values and get inferred
+    if (spec) printf("Format spec: %zu of %zu lines matched\n", parser.spec_hits, entry_count);
+    const FormatSpec* typed = (spec && parser.spec_hits == entry_count) ? spec : NULL;
+    size_t section_count = store.count;
+    size_t* sections = malloc(sizeof(size_t) * (section_count + 1));
+    ByteArray* serialized = serialize_compressed_data(&parser, &store, entry_count, typed, sections);
+    bytearray_append_byte(serialized, line_flags);
+    if (nul_count > 0) {
+        encode_varint(serialized, nul_count);
+        bytearray_append(serialized, nul_offsets->data, nul_offsets->length);
+    }
+    bytearray_free(nul_offsets);
+    log_parser_free(&parser);
+    field_store_free(&store);
     
     // Compress with LZMA
     size_t compressed_capacity = serialized->length + 1024;
@@ -180,6 +412,7 @@ int ulc_compress_file(const char* input_path, const char* output_path,
     if (ret != LZMA_OK) {
         fprintf(stderr, "Error: LZMA encoder init failed\n");
         free(compressed);
+        free(sections);
         bytearray_free(serialized);
         return -1;
     }
@@ -195,6 +428,7 @@ int ulc_compress_file(const char* input_path, const char* output_path,
         fprintf(stderr, "Error: LZMA compression failed\n");
         lzma_end(&strm);
         free(compressed);
+        free(sections);
         bytearray_free(serialized);
         return -1;
     }
@@ -202,6 +436,23 @@ int ulc_compress_file(const char* input_path, const char* output_path,
     size_t compressed_size = strm.total_out;
     lzma_end(&strm);
     
+    // Per-column streams (self-identifying) when they are smaller: column
+    // groups coded apart with their own backend, each fetchable alone
+    size_t codec_counts[STREAM_CODECS];
+    size_t streams_size;
+    uint8_t* streams = streams_compress(serialized->data, serialized->length, sections, section_count,
+                                        codec_counts, &streams_size);
+    free(sections);
+    if (streams_size < compressed_size) {
+        printf("Per-column streams: %zu text, %zu binary, %zu delta, %zu stored\n", codec_counts[STREAM_TEXT],
+               codec_counts[STREAM_BINARY], codec_counts[STREAM_DELTA], codec_counts[STREAM_STORE]);
+        free(compressed);
+        compressed = streams;
+        compressed_size = streams_size;
+    } else {
+        free(streams);
+    }
+    
     // Write output file
     FILE* out_fp = fopen(output_path, "wb");
     if (!out_fp) {
@@ -221,10 +472,6 @@ int ulc_compress_file(const char* input_path, const char* output_path,
     // Cleanup
     free(compressed);
     bytearray_free(serialized);
-    for (size_t i = 0; i < entry_count; i++) {
-        log_entry_free(entries[i]);
-    }
-    free(entries);
     
     clock_t end = clock();
     *duration = (double)(end - start) / CLOCKS_PER_SEC;
@@ -232,23 +479,354 @@ int ulc_compress_file(const char* input_path, const char* output_path,
     return 0;
 }
 
-int ulc_decompress_file(const char* input_path, const char* output_path, double* duration) {
-    clock_t start = clock();
+// --- Decoder ---
+
+// A field's column decoded into a typed vector, one value per row
+typedef struct {
+    ColumnType type;
+    char** dict;            // STRING: dictionary
+    size_t dict_count;
+    uint32_t* ids;          // STRING: dictionary id of each row
+    int64_t* numbers;       // INT, TIMESTAMP
+    TimestampShape shape;   // TIMESTAMP
+    char* text;             // IP: the rendered values, NUL-terminated
+    size_t* offsets;        // IP: start of each row's value in text
+} DecodedColumn;
+
+// Bounds-checked reads of the decompressed stream
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    int failed;
+} StreamReader;
+
+static uint64_t read_varint(StreamReader* in) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in->offset >= in->size) break;
+        uint8_t byte = in->data[in->offset++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    in->failed = 1;
+    return 0;
+}
+
+// Next len bytes, or NULL past the end
+static const uint8_t* read_bytes(StreamReader* in, uint64_t len) {
+    if (in->failed || len > in->size - in->offset) {
+        in->failed = 1;
+        return NULL;
+    }
+    const uint8_t* out = in->data + in->offset;
+    in->offset += len;
+    return out;
+}
+
+static char* read_string(StreamReader* in) {
+    uint64_t len = read_varint(in);
+    const uint8_t* bytes = read_bytes(in, len);
+    if (!bytes) return NULL;
+    char* str = malloc(len + 1);
+    memcpy(str, bytes, len);
+    str[len] = '\0';
+    return str;
+}
+
+static int decode_numbers(StreamReader* in, DecodedColumn* col, size_t entry_count) {
+    uint64_t len = read_varint(in);
+    const uint8_t* data = read_bytes(in, len);
+    if (!data) return 0;
+    size_t count = 0;
+    if (len > 0) decode_delta(data, len, &col->numbers, &count);
+    return count == entry_count;
+}
+
+static int decode_column(StreamReader* in, DecodedColumn* col, size_t entry_count) {
+    memset(col, 0, sizeof(DecodedColumn));
+    const uint8_t* type = read_bytes(in, 1);
+    if (!type) return 0;
+    col->type = (ColumnType)*type;
+    
+    if (col->type == COL_TYPE_STRING) {
+        col->dict_count = read_varint(in);
+        if (col->dict_count > in->size) return 0;
+        col->dict = calloc(col->dict_count + 1, sizeof(char*));
+        for (size_t k = 0; k < col->dict_count; k++) {
+            if (!(col->dict[k] = read_string(in))) return 0;
+        }
+        uint64_t len = read_varint(in);
+        const uint8_t* id_data = read_bytes(in, len);
+        if (!id_data) return 0;
+        StreamReader ids = {id_data, len, 0, 0};
+        col->ids = malloc(sizeof(uint32_t) * (entry_count + 1));
+        for (size_t i = 0; i < entry_count; i++) {
+            uint64_t id = read_varint(&ids);
+            if (ids.failed || id >= col->dict_count) return 0;
+            col->ids[i] = (uint32_t)id;
+        }
+        return 1;
+    }
+    if (col->type == COL_TYPE_INT) return entry_count == 0 || decode_numbers(in, col, entry_count);
+    if (col->type == COL_TYPE_TIMESTAMP) {
+        const uint8_t* head = read_bytes(in, 4);
+        if (!head) return 0;
+        col->shape.kind = head[0];
+        col->shape.digits = head[1];
+        col->shape.sep = (char)head[2];
+        col->shape.point = (char)head[3];
+        uint64_t suffix_len = read_varint(in);
+        const uint8_t* suffix = read_bytes(in, suffix_len);
+        if (!suffix || suffix_len >= sizeof(col->shape.suffix) || col->shape.digits > 9) return 0;
+        memcpy(col->shape.suffix, suffix, suffix_len);
+        return entry_count == 0 || decode_numbers(in, col, entry_count);
+    }
+    if (col->type == COL_TYPE_IP) {
+        uint64_t len = read_varint(in);
+        const uint8_t* data = read_bytes(in, len);
+        if (!data) return 0;
+        
+        // Rendered text is at most the larger of the address text and the verbatim bytes
+        col->text = malloc(len + entry_count * (ADDR_MAX_TEXT + 1) + 1);
+        col->offsets = malloc(sizeof(size_t) * (entry_count + 1));
+        AddrCodec codec;
+        addr_codec_init(&codec);
+        size_t offset = 0, at = 0;
+        for (size_t i = 0; i < entry_count; i++) {
+            size_t value_len;
+            if (offset >= len) return 0;
+            col->offsets[i] = at;
+            if (addr_decode(&codec, data, &offset, col->text + at, &value_len) == ADDR_FAMILY_NONE) {
+                if (value_len > len - offset) return 0;
+                memcpy(col->text + at, data + offset, value_len);
+                offset += value_len;
+            }
+            at += value_len;
+            col->text[at++] = '\0';
+        }
+        return 1;
+    }
+    return 0;
+}
+
+static void decoded_column_free(DecodedColumn* col) {
+    if (col->dict) {
+        for (size_t k = 0; k < col->dict_count; k++) free(col->dict[k]);
+    }
+    free(col->dict);
+    free(col->ids);
+    free(col->numbers);
+    free(col->text);
+    free(col->offsets);
+}
+
+// Text of a row's value; numbers are printed into scratch
+// (TIMESTAMP_MAX_TEXT bytes)
+static const char* column_text(const DecodedColumn* col, size_t row, char* scratch) {
+    switch (col->type) {
+        case COL_TYPE_STRING:
+            return col->dict[col->ids[row]];
+        case COL_TYPE_INT: {
+            // Digits backwards from the end of scratch
+            int64_t value = col->numbers[row];
+            uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+            char* p = scratch + TIMESTAMP_MAX_TEXT - 1;
+            *p = '\0';
+            do {
+                *--p = (char)('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude);
+            if (value < 0) *--p = '-';
+            return p;
+        }
+        case COL_TYPE_TIMESTAMP:
+            timestamp_format(&col->shape, col->numbers[row], scratch);
+            return scratch;
+        default:
+            return col->text + col->offsets[row];
+    }
+}
+
+// Restore plan of one _layout dictionary entry, with the column of each
+// field it names (-1 when no column has it)
+typedef struct {
+    LayoutPlan plan;
+    int* cols;
+    int envelope_cols[3];
+    int state;          // 0 not built yet, 1 ready, -1 invalid layout
+} RowPlan;
+
+static int row_plan_build(RowPlan* rp, const char* layout, const Schema* names) {
+    if (!layout_plan_init(&rp->plan, layout)) {
+        rp->state = -1;
+        return 0;
+    }
+    rp->cols = malloc(sizeof(int) * (rp->plan.count ? rp->plan.count : 1));
+    for (size_t k = 0; k < rp->plan.count; k++) rp->cols[k] = schema_find(names, rp->plan.fields[k]);
+    rp->envelope_cols[0] = schema_find(names, ENVELOPE_FIELD_TIME);
+    rp->envelope_cols[1] = schema_find(names, ENVELOPE_FIELD_STREAM);
+    rp->envelope_cols[2] = schema_find(names, ENVELOPE_FIELD_TAG);
+    rp->state = 1;
+    return 1;
+}
+
+// Output buffered in large writes
+#define DECODE_WRITE_BUFFER (1024 * 1024)
+
+// Output offsets of the input's NUL bytes (LINES_NUL_BYTES), ascending
+typedef struct {
+    size_t* offsets;
+    size_t count;
+    size_t next;
+    size_t written;     // Bytes flushed so far
+} NulBytes;
+
+static void flush_output(String* buffer, FILE* out, NulBytes* nuls) {
+    for (; nuls && nuls->next < nuls->count && nuls->offsets[nuls->next] < nuls->written + buffer->length;
+         nuls->next++) {
+        buffer->data[nuls->offsets[nuls->next] - nuls->written] = '\0';
+    }
+    if (nuls) nuls->written += buffer->length;
+    fwrite(buffer->data, 1, buffer->length, out);
+    buffer->length = 0;
+}
+
+// Text of lines joined by '\n', with CRLF line ends when crlf is set
+static void append_lines(String* buffer, const char* text, int crlf) {
+    const char* end;
+    while (crlf && (end = strchr(text, '\n'))) {
+        string_append(buffer, text, end - text);
+        string_append(buffer, "\r\n", 2);
+        text = end + 1;
+    }
+    string_append(buffer, text, strlen(text));
+}
+
+// Row assembly: one pass over the rows, each restored from its layout's
+// plan and the typed columns, then its trace, with the line ends line_flags
+// records and the NUL bytes put back
+static int assemble_rows(DecodedColumn* cols, const Schema* names, size_t entry_count, uint8_t line_flags,
+                         NulBytes* nuls, FILE* out) {
+    int layout_col = schema_find(names, JSON_LAYOUT_FIELD);
+    if (layout_col < 0 || cols[layout_col].type != COL_TYPE_STRING) return entry_count == 0;
+    const DecodedColumn* layouts = &cols[layout_col];
+    int frames_col = schema_find(names, "trace_frames");
+    int messages_col = schema_find(names, "trace_messages");
+    
+    RowPlan* plans = calloc(layouts->dict_count + 1, sizeof(RowPlan));
+    size_t scratch_slots = 4;
+    char* scratch = malloc(scratch_slots * TIMESTAMP_MAX_TEXT);
+    const char** values = malloc(sizeof(char*) * scratch_slots);
+    String* buffer = string_new(DECODE_WRITE_BUFFER + 1024);
+    int crlf = line_flags & LINES_CRLF;
+    const char* line_end = crlf ? "\r\n" : "\n";
+    size_t line_end_len = crlf ? 2 : 1;
+    int ok = 1;
+    
+    for (size_t i = 0; i < entry_count && ok; i++) {
+        // Flushed before a row, so the last line end is still held below
+        if (buffer->length >= DECODE_WRITE_BUFFER) flush_output(buffer, out, nuls);
+        uint32_t layout_id = layouts->ids[i];
+        RowPlan* rp = &plans[layout_id];
+        if (rp->state == 0) row_plan_build(rp, layouts->dict[layout_id], names);
+        if (rp->state < 0) {
+            ok = 0;
+            break;
+        }
+        
+        // Values in field order, then the envelope's
+        size_t slots = rp->plan.count + 3;
+        if (slots > scratch_slots) {
+            while (slots > scratch_slots) scratch_slots *= 2;
+            scratch = realloc(scratch, scratch_slots * TIMESTAMP_MAX_TEXT);
+            values = realloc(values, sizeof(char*) * scratch_slots);
+        }
+        for (size_t k = 0; k < slots; k++) {
+            int col = k < rp->plan.count ? rp->cols[k] : rp->envelope_cols[k - rp->plan.count];
+            values[k] = col >= 0 ? column_text(&cols[col], i, scratch + k * TIMESTAMP_MAX_TEXT) : "";
+        }
+        // A reassembled container line renders its fragments '\n'-joined
+        char* line = layout_plan_render(&rp->plan, values, values + rp->plan.count);
+        append_lines(buffer, line, crlf);
+        free(line);
+        
+        if (frames_col >= 0 && messages_col >= 0 && cols[frames_col].type == COL_TYPE_STRING &&
+            cols[messages_col].type == COL_TYPE_STRING) {
+            const char* frames = column_text(&cols[frames_col], i, scratch);
+            if (frames[0]) {
+                char* trace = frame_join(frames, column_text(&cols[messages_col], i, scratch));
+                string_append(buffer, line_end, line_end_len);
+                append_lines(buffer, trace, crlf);
+                free(trace);
+            }
+        }
+        string_append(buffer, line_end, line_end_len);
+    }
+    if (ok && entry_count > 0 && (line_flags & LINES_NO_FINAL_NEWLINE)) buffer->length -= line_end_len;
+    flush_output(buffer, out, nuls);
     
-    // Read compressed file
+    for (size_t k = 0; k < layouts->dict_count; k++) {
+        if (plans[k].state > 0) {
+            layout_plan_free(&plans[k].plan);
+            free(plans[k].cols);
+        }
+    }
+    free(plans);
+    free(scratch);
+    free(values);
+    string_free(buffer);
+    return ok;
+}
+
+// Whole LZMA stream into a growing buffer
+static uint8_t* lzma_decompress_all(const uint8_t* compressed, size_t compressed_size, size_t* out_size) {
+    lzma_stream strm = LZMA_STREAM_INIT;
+    if (lzma_stream_decoder(&strm, UINT64_MAX, 0) != LZMA_OK) return NULL;
+    
+    size_t capacity = compressed_size * 8 + 4096;
+    uint8_t* out = malloc(capacity);
+    strm.next_in = compressed;
+    strm.avail_in = compressed_size;
+    strm.next_out = out;
+    strm.avail_out = capacity;
+    
+    lzma_ret ret;
+    while ((ret = lzma_code(&strm, LZMA_FINISH)) == LZMA_OK) {
+        if (strm.avail_out == 0) {
+            capacity *= 2;
+            out = realloc(out, capacity);
+            strm.next_out = out + strm.total_out;
+            strm.avail_out = capacity - strm.total_out;
+        }
+    }
+    *out_size = strm.total_out;
+    lzma_end(&strm);
+    if (ret != LZMA_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+// Payload of a ULC file (what follows the magic), or NULL with a message
+static uint8_t* read_payload(const char* input_path, size_t* size) {
     FILE* fp = fopen(input_path, "rb");
     if (!fp) {
         fprintf(stderr, "Error: Cannot open input file: %s\n", input_path);
-        return -1;
+        return NULL;
     }
     
     // Check magic
     char magic[ULC_MAGIC_LEN];
-    if (fread(magic, 1, ULC_MAGIC_LEN, fp) != ULC_MAGIC_LEN ||
-        memcmp(magic, ULC_MAGIC, ULC_MAGIC_LEN) != 0) {
-        fprintf(stderr, "Error: Invalid ULC file (bad magic)\n");
+    if (fread(magic, 1, ULC_MAGIC_LEN, fp) != ULC_MAGIC_LEN || memcmp(magic, ULC_MAGIC, ULC_MAGIC_LEN) != 0) {
+        if (memcmp(magic, ULC_MAGIC_V1, ULC_MAGIC_LEN) == 0) {
+            fprintf(stderr, "Error: ULC1 files do not keep the original lines; compress the log again\n");
+        } else {
+            fprintf(stderr, "Error: Invalid ULC file (bad magic)\n");
+        }
         fclose(fp);
-        return -1;
+        return NULL;
     }
     
     // Read compressed data
@@ -257,60 +835,177 @@ int ulc_decompress_file(const char* input_path, const char* output_path, double*
     fseek(fp, ULC_MAGIC_LEN, SEEK_SET);
     
     size_t compressed_size = file_size - ULC_MAGIC_LEN;
-    uint8_t* compressed = malloc(compressed_size);
-    fread(compressed, 1, compressed_size, fp);
+    uint8_t* compressed = malloc(compressed_size + 1);
+    *size = fread(compressed, 1, compressed_size, fp);
     fclose(fp);
+    return compressed;
+}
+
+// Field table: the row count and the names, in column order. Returns the
+// field count
+static size_t read_field_table(StreamReader* in, size_t* entry_count, Schema* names) {
+    *entry_count = read_varint(in);
+    size_t field_count = read_varint(in);
+    if (field_count > in->size) in->failed = 1;
+    for (size_t f = 0; f < field_count && !in->failed; f++) {
+        char* name = read_string(in);
+        if (name && schema_intern(names, name) != (int)f) in->failed = 1;
+        free(name);
+    }
+    return in->failed ? 0 : field_count;
+}
+
+int ulc_decompress_file(const char* input_path, const char* output_path, double* duration) {
+    clock_t start = clock();
     
-    // Decompress with LZMA
-    size_t decompressed_capacity = compressed_size * 20; // Estimate
-    uint8_t* decompressed = malloc(decompressed_capacity);
+    size_t read_size;
+    uint8_t* compressed = read_payload(input_path, &read_size);
+    if (!compressed) return -1;
+    
+    // Decompress: per-column streams, or one LZMA stream
+    size_t decompressed_size;
+    uint8_t* decompressed;
+    if (streams_is_stream(compressed, read_size)) {
+        size_t consumed;
+        decompressed = streams_decompress(compressed, read_size, &consumed, &decompressed_size);
+    } else {
+        decompressed = lzma_decompress_all(compressed, read_size, &decompressed_size);
+    }
+    free(compressed);
+    if (!decompressed) {
+        fprintf(stderr, "Error: LZMA decompression failed\n");
+        return -1;
+    }
     
-    lzma_stream strm = LZMA_STREAM_INIT;
-    lzma_ret ret = lzma_stream_decoder(&strm, UINT64_MAX, 0);
+    StreamReader in = {decompressed, decompressed_size, 0, 0};
+    size_t entry_count;
+    Schema names;
+    schema_init(&names);
+    size_t field_count = read_field_table(&in, &entry_count, &names);
+    if (entry_count > decompressed_size) in.failed = 1;
+    
+    // Columns: each decoded whole into its typed vector
+    DecodedColumn* cols = calloc(field_count + 1, sizeof(DecodedColumn));
+    for (size_t f = 0; f < field_count && !in.failed; f++) {
+        if (!decode_column(&in, &cols[f], entry_count)) in.failed = 1;
+    }
+    const uint8_t* line_flags = in.offset < in.size ? read_bytes(&in, 1) : NULL;
+    NulBytes nuls = {0};
+    if (line_flags && (*line_flags & LINES_NUL_BYTES)) {
+        nuls.count = read_varint(&in);
+        if (nuls.count > in.size) in.failed = 1;
+        nuls.offsets = malloc(sizeof(size_t) * (in.failed ? 1 : nuls.count));
+        size_t offset = 0;
+        for (size_t k = 0; k < nuls.count && !in.failed; k++) {
+            offset += read_varint(&in);
+            nuls.offsets[k] = offset;
+        }
+    }
     
-    if (ret != LZMA_OK) {
-        fprintf(stderr, "Error: LZMA decoder init failed\n");
-        free(compressed);
-        free(decompressed);
-        return -1;
+    int ok = !in.failed;
+    if (ok) {
+        FILE* out_fp = fopen(output_path, "wb");
+        if (!out_fp) {
+            fprintf(stderr, "Error: Cannot open output file: %s\n", output_path);
+            ok = -1;
+        } else {
+            ok = assemble_rows(cols, &names, entry_count, line_flags ? *line_flags : 0, &nuls, out_fp);
+            fclose(out_fp);
+        }
     }
+    if (ok == 0) fprintf(stderr, "Error: Corrupt ULC stream\n");
     
-    strm.next_in = compressed;
-    strm.avail_in = compressed_size;
-    strm.next_out = decompressed;
-    strm.avail_out = decompressed_capacity;
+    for (size_t f = 0; f < field_count; f++) decoded_column_free(&cols[f]);
+    free(cols);
+    free(nuls.offsets);
+    schema_free(&names);
+    free(decompressed);
     
-    ret = lzma_code(&strm, LZMA_FINISH);
+    clock_t end = clock();
+    *duration = (double)(end - start) / CLOCKS_PER_SEC;
     
-    if (ret != LZMA_STREAM_END) {
+    return ok == 1 ? 0 : -1;
+}
+
+int ulc_extract_field(const char* input_path, const char* field, const char* output_path, double* duration) {
+    clock_t start = clock();
+    
+    size_t read_size;
+    uint8_t* compressed = read_payload(input_path, &read_size);
+    if (!compressed) return -1;
+    
+    // Per-column streams: the field table (part 0) and the column's part,
+    // inflating only the groups that hold them. One LZMA stream: all of it
+    int is_stream = streams_is_stream(compressed, read_size);
+    size_t head_size;
+    uint8_t* head = is_stream ? streams_extract(compressed, read_size, 0, &head_size)
+                              : lzma_decompress_all(compressed, read_size, &head_size);
+    if (!head) {
         fprintf(stderr, "Error: LZMA decompression failed\n");
-        lzma_end(&strm);
         free(compressed);
-        free(decompressed);
         return -1;
     }
     
-    size_t decompressed_size = strm.total_out;
-    lzma_end(&strm);
+    StreamReader in = {head, head_size, 0, 0};
+    size_t entry_count;
+    Schema names;
+    schema_init(&names);
+    size_t field_count = read_field_table(&in, &entry_count, &names);
+    int target = in.failed ? -1 : schema_find(&names, field);
+    
+    uint8_t* part = NULL;
+    StreamReader column_in = in;
+    if (target >= 0 && is_stream) {
+        size_t part_size;
+        part = streams_extract(compressed, read_size, target + 1, &part_size);
+        column_in = (StreamReader){part, part_size, 0, !part};
+    }
     free(compressed);
     
-    // For now, just write a placeholder message
-    // Full deserialization would reconstruct the log lines
-    FILE* out_fp = fopen(output_path, "w");
-    if (!out_fp) {
-        fprintf(stderr, "Error: Cannot open output file: %s\n", output_path);
-        free(decompressed);
-        return -1;
+    // Columns ahead of the target are decoded only to step past them
+    DecodedColumn col;
+    memset(&col, 0, sizeof(col));
+    int ok = target >= 0 && !column_in.failed && entry_count <= column_in.size;
+    for (int f = is_stream ? target : 0; ok && f <= target; f++) {
+        decoded_column_free(&col);
+        ok = decode_column(&column_in, &col, entry_count);
     }
     
-    fprintf(out_fp, "# Decompressed data (simplified implementation)\n");
-    fprintf(out_fp, "# Decompressed %zu bytes\n", decompressed_size);
-    fclose(out_fp);
+    if (target < 0 && !in.failed) {
+        fprintf(stderr, "Error: No field '%s' (fields:", field);
+        for (size_t f = 0; f < field_count; f++) fprintf(stderr, " %s", names.names[f]);
+        fprintf(stderr, ")\n");
+    } else if (!ok) {
+        fprintf(stderr, "Error: Corrupt ULC stream\n");
+    }
     
-    free(decompressed);
+    // One value per line, in row order
+    FILE* out_fp = ok ? fopen(output_path, "wb") : NULL;
+    if (ok && !out_fp) {
+        fprintf(stderr, "Error: Cannot open output file: %s\n", output_path);
+        ok = 0;
+    }
+    if (out_fp) {
+        String* buffer = string_new(DECODE_WRITE_BUFFER + 1024);
+        char scratch[TIMESTAMP_MAX_TEXT];
+        for (size_t i = 0; i < entry_count; i++) {
+            const char* value = column_text(&col, i, scratch);
+            string_append(buffer, value, strlen(value));
+            string_append(buffer, "\n", 1);
+            if (buffer->length >= DECODE_WRITE_BUFFER) flush_output(buffer, out_fp, NULL);
+        }
+        flush_output(buffer, out_fp, NULL);
+        string_free(buffer);
+        fclose(out_fp);
+    }
+    
+    decoded_column_free(&col);
+    schema_free(&names);
+    free(part);
+    free(head);
     
     clock_t end = clock();
     *duration = (double)(end - start) / CLOCKS_PER_SEC;
     
-    return 0;
+    return ok ? 0 : -1;
 }
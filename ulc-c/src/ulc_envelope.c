@@ -0,0 +1,412 @@
+#include "../include/ulc_envelope.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define DOCKER_PREFIX "{\"log\":\""
+#define DOCKER_STREAM "\",\"stream\":\""
+#define DOCKER_TIME "\",\"time\":\""
+
+static char* copy_span(const char* s, size_t len) {
+    char* out = malloc(len + 1);
+    memcpy(out, s, len);
+    out[len] = '\0';
+    return out;
+}
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// RFC 3339 up to the 'T' ("2025-11-24T"), then only the bytes a time and
+// offset use; anything else (',' in particular, the fragment tag separator)
+// leaves the line unsplit
+static size_t scan_time(const char* p) {
+    for (int i = 0; i < 10; i++) {
+        if ((i == 4 || i == 7) ? p[i] != '-' : !is_digit(p[i])) return 0;
+    }
+    if (p[10] != 'T') return 0;
+    size_t len = 11;
+    while (is_digit(p[len]) || (p[len] && strchr(":.+-Z", p[len]))) len++;
+    if (p[len] && p[len] != ' ' && p[len] != '"') return 0;
+    return len;
+}
+
+static size_t scan_stream(const char* p) {
+    return (strncmp(p, "stdout", 6) == 0 || strncmp(p, "stderr", 6) == 0) ? 6 : 0;
+}
+
+// --- Docker string escaping (Go encoding/json, as the json-file driver writes it) ---
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int read_hex4(const char* p, unsigned* value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int h = hex_value(p[i]);
+        if (h < 0) return 0;
+        *value = (*value << 4) | (unsigned)h;
+    }
+    return 1;
+}
+
+static size_t put_utf8(char* out, unsigned cp) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Contents of a JSON string (without quotes); NULL on bad escapes or NUL
+static char* json_unescape(const char* s, size_t len) {
+    char* out = malloc(len + 1);
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] != '\\') {
+            out[n++] = s[i];
+            continue;
+        }
+        if (++i == len) break;
+        char c = s[i];
+        unsigned cp;
+        switch (c) {
+            case '"': case '\\': case '/': out[n++] = c; continue;
+            case 'b': out[n++] = '\b'; continue;
+            case 'f': out[n++] = '\f'; continue;
+            case 'n': out[n++] = '\n'; continue;
+            case 'r': out[n++] = '\r'; continue;
+            case 't': out[n++] = '\t'; continue;
+            case 'u':
+                if (i + 4 >= len || !read_hex4(s + i + 1, &cp)) break;
+                i += 4;
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 6 < len && s[i + 1] == '\\' && s[i + 2] == 'u') {
+                    unsigned low;
+                    if (read_hex4(s + i + 3, &low) && low >= 0xDC00 && low < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                if (cp == 0) break;
+                n += put_utf8(out + n, cp);
+                continue;
+            default:
+                break;
+        }
+        free(out);
+        return NULL;
+    }
+    out[n] = '\0';
+    return out;
+}
+
+// Escaped length of s, and the escaped text when out is not NULL. Go escapes
+// quotes, backslashes, control bytes, <, >, & and U+2028/U+2029
+static size_t json_escape(const char* s, size_t len, char* out) {
+    static const char hex[] = "0123456789abcdef";
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        const char* short_form = NULL;
+        switch (c) {
+            case '"': short_form = "\\\""; break;
+            case '\\': short_form = "\\\\"; break;
+            case '\n': short_form = "\\n"; break;
+            case '\r': short_form = "\\r"; break;
+            case '\t': short_form = "\\t"; break;
+            default: break;
+        }
+        if (short_form) {
+            if (out) memcpy(out + n, short_form, 2);
+            n += 2;
+        } else if (c < 0x20 || c == '<' || c == '>' || c == '&') {
+            if (out) {
+                memcpy(out + n, "\\u00", 4);
+                out[n + 4] = hex[c >> 4];
+                out[n + 5] = hex[c & 0xF];
+            }
+            n += 6;
+        } else if (c == 0xE2 && i + 2 < len && (unsigned char)s[i + 1] == 0x80 &&
+                   ((unsigned char)s[i + 2] == 0xA8 || (unsigned char)s[i + 2] == 0xA9)) {
+            if (out) memcpy(out + n, (unsigned char)s[i + 2] == 0xA8 ? "\\u2028" : "\\u2029", 6);
+            n += 6;
+            i += 2;
+        } else {
+            if (out) out[n] = (char)c;
+            n++;
+        }
+    }
+    return n;
+}
+
+// --- Split and render ---
+
+static int split_cri(const char* line, Envelope* env) {
+    size_t time_len = scan_time(line);
+    if (time_len == 0 || line[time_len] != ' ') return 0;
+    const char* p = line + time_len + 1;
+    if (!scan_stream(p) || p[6] != ' ') return 0;
+    if ((p[7] != 'F' && p[7] != 'P') || p[8] != ' ') return 0;
+
+    env->kind = ENVELOPE_CRI_TAG;
+    env->time = copy_span(line, time_len);
+    env->stream = copy_span(p, 6);
+    env->tag = copy_span(p + 7, 1);
+    env->payload = strdup(p + 9);
+    return 1;
+}
+
+static int split_docker(const char* line, Envelope* env) {
+    size_t prefix = strlen(DOCKER_PREFIX);
+    if (strncmp(line, DOCKER_PREFIX, prefix) != 0) return 0;
+
+    // End of the log string: the first unescaped quote
+    const char* start = line + prefix;
+    const char* p = start;
+    while (*p && *p != '"') p += (*p == '\\' && p[1]) ? 2 : 1;
+    if (*p != '"') return 0;
+    const char* log_end = p;
+
+    if (strncmp(p, DOCKER_STREAM, strlen(DOCKER_STREAM)) != 0) return 0;
+    p += strlen(DOCKER_STREAM);
+    const char* stream = p;
+    if (!scan_stream(p)) return 0;
+    p += 6;
+    if (strncmp(p, DOCKER_TIME, strlen(DOCKER_TIME)) != 0) return 0;
+    p += strlen(DOCKER_TIME);
+    const char* time = p;
+    size_t time_len = scan_time(p);
+    if (time_len == 0 || strcmp(p + time_len, "\"}") != 0) return 0;
+
+    char* payload = json_unescape(start, (size_t)(log_end - start));
+    if (!payload) return 0;
+    size_t len = strlen(payload);
+    int full = len > 0 && payload[len - 1] == '\n';
+    if (full) payload[len - 1] = '\0';
+
+    env->kind = ENVELOPE_DOCKER_TAG;
+    env->time = copy_span(time, time_len);
+    env->stream = copy_span(stream, 6);
+    env->tag = strdup(full ? "F" : "P");
+    env->payload = payload;
+    return 1;
+}
+
+int envelope_split(const char* line, Envelope* env) {
+    int ok = (line[0] == '{') ? split_docker(line, env) : is_digit(line[0]) && split_cri(line, env);
+    if (!ok) return 0;
+
+    // Docker escaping has more than one spelling; keep only lines it restores
+    if (env->kind == ENVELOPE_DOCKER_TAG) {
+        char* rendered = envelope_render(env->kind, env->time, env->stream, env->tag, env->payload);
+        int exact = strcmp(rendered, line) == 0;
+        free(rendered);
+        if (!exact) {
+            envelope_free(env);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void envelope_free(Envelope* env) {
+    free(env->time);
+    free(env->stream);
+    free(env->tag);
+    free(env->payload);
+}
+
+// One line of the envelope, appended at out + n; returns the length
+static size_t render_line(char kind, const char* time, size_t time_len, const char* stream, char tag,
+                          const char* payload, size_t len, char* out) {
+    size_t n = 0;
+    if (kind == ENVELOPE_CRI_TAG) {
+        // time stream tag payload
+        if (out) {
+            memcpy(out, time, time_len);
+            out[time_len] = ' ';
+            memcpy(out + time_len + 1, stream, 6);
+            out[time_len + 7] = ' ';
+            out[time_len + 8] = tag;
+            out[time_len + 9] = ' ';
+            memcpy(out + time_len + 10, payload, len);
+        }
+        return time_len + 10 + len;
+    }
+
+    // {"log":"payload\n","stream":"...","time":"..."}, without the \n for partial lines
+    size_t prefix = strlen(DOCKER_PREFIX), stream_key = strlen(DOCKER_STREAM), time_key = strlen(DOCKER_TIME);
+    if (out) memcpy(out, DOCKER_PREFIX, prefix);
+    n = prefix;
+    n += json_escape(payload, len, out ? out + n : NULL);
+    if (tag == 'F') {
+        if (out) memcpy(out + n, "\\n", 2);
+        n += 2;
+    }
+    if (out) {
+        memcpy(out + n, DOCKER_STREAM, stream_key);
+        memcpy(out + n + stream_key, stream, 6);
+        memcpy(out + n + stream_key + 6, DOCKER_TIME, time_key);
+        memcpy(out + n + stream_key + 6 + time_key, time, time_len);
+        memcpy(out + n + stream_key + 6 + time_key + time_len, "\"}", 2);
+    }
+    return n + stream_key + 6 + time_key + time_len + 2;
+}
+
+// Walk the fragments of a tag, rendering into out (or measuring when NULL)
+static size_t render_fragments(char kind, const char* time, const char* stream, const char* tag,
+                               const char* payload, char* out) {
+    size_t payload_len = strlen(payload);
+    size_t n = 0, offset = 0;
+    const char* frag_time = time;
+    size_t frag_time_len = strlen(time);
+    const char* spec = (tag[0] == 'P' && tag[1] == ',') ? tag + 1 : NULL;
+
+    while (spec && *spec == ',') {
+        // ",<len>,<time>" closes the current fragment and opens the next
+        char* end;
+        size_t len = strtoul(spec + 1, &end, 10);
+        if (*end != ',' || offset + len > payload_len) break;
+        n += render_line(kind, frag_time, frag_time_len, stream, 'P', payload + offset, len, out ? out + n : NULL);
+        if (out) out[n] = '\n';
+        n++;
+        offset += len;
+        frag_time = end + 1;
+        spec = strchr(frag_time, ',');
+        frag_time_len = spec ? (size_t)(spec - frag_time) : strlen(frag_time);
+    }
+    char last = tag[1] == ',' ? 'F' : tag[0];
+    n += render_line(kind, frag_time, frag_time_len, stream, last, payload + offset, payload_len - offset,
+                     out ? out + n : NULL);
+    return n;
+}
+
+char* envelope_render(char kind, const char* time, const char* stream, const char* tag, const char* payload) {
+    size_t len = render_fragments(kind, time, stream, tag, payload, NULL);
+    char* out = malloc(len + 1);
+    render_fragments(kind, time, stream, tag, payload, out);
+    out[len] = '\0';
+    return out;
+}
+
+int envelope_maybe_partial(const char* line) {
+    if (is_digit(line[0])) {
+        size_t time_len = scan_time(line);
+        if (time_len == 0 || line[time_len] != ' ') return 0;
+        const char* p = line + time_len + 1;
+        return scan_stream(p) && p[6] == ' ' && p[7] == 'P' && p[8] == ' ';
+    }
+    if (strncmp(line, DOCKER_PREFIX, strlen(DOCKER_PREFIX)) != 0) return 0;
+    const char* stream = strstr(line, DOCKER_STREAM);
+    return stream && !(stream - line >= 2 && stream[-2] == '\\' && stream[-1] == 'n');
+}
+
+size_t envelope_reassemble(char** lines, size_t count, char*** tags) {
+    *tags = NULL;
+    size_t out = 0;
+    for (size_t i = 0; i < count; ) {
+        Envelope first;
+        int partial = envelope_split(lines[i], &first);
+        if (partial && first.tag[0] != 'P') {
+            envelope_free(&first);
+            partial = 0;
+        }
+        if (!partial) {
+            lines[out++] = lines[i++];
+            continue;
+        }
+
+        // A run of P lines on the stream, closed by an F line
+        Envelope* run = malloc(sizeof(Envelope) * (count - i));
+        size_t n = 0;
+        int closed = 0;
+        run[n++] = first;
+        for (size_t j = i + 1; j < count; j++) {
+            Envelope next;
+            if (!envelope_split(lines[j], &next)) break;
+            if (next.kind != first.kind || strcmp(next.stream, first.stream) != 0) {
+                envelope_free(&next);
+                break;
+            }
+            run[n++] = next;
+            if (next.tag[0] == 'F') {
+                closed = 1;
+                break;
+            }
+        }
+
+        if (!closed) {
+            for (size_t k = 0; k < n; k++) envelope_free(&run[k]);
+            free(run);
+            lines[out++] = lines[i++];
+            continue;
+        }
+
+        // Joined payload, and the fragment tag: ",<len>,<next time>" per cut
+        size_t payload_len = 0, tag_len = 1;
+        for (size_t k = 0; k < n; k++) {
+            payload_len += strlen(run[k].payload);
+            if (k > 0) tag_len += strlen(run[k].time) + 24;
+        }
+        char* payload = malloc(payload_len + 1);
+        char* tag = malloc(tag_len + 1);
+        size_t p = 0, t = 0;
+        tag[t++] = 'P';
+        for (size_t k = 0; k < n; k++) {
+            size_t len = strlen(run[k].payload);
+            memcpy(payload + p, run[k].payload, len);
+            p += len;
+            if (k + 1 < n) t += (size_t)sprintf(tag + t, ",%zu,%s", len, run[k + 1].time);
+        }
+        payload[p] = '\0';
+
+        // Keep the run only if its tag renders the original lines back
+        char* joined = envelope_render(first.kind, first.time, first.stream, tag, payload);
+        int exact = 1;
+        size_t at = 0;
+        for (size_t k = 0; k < n && exact; k++) {
+            size_t len = strlen(lines[i + k]);
+            exact = strncmp(joined + at, lines[i + k], len) == 0 && joined[at + len] == (k + 1 < n ? '\n' : '\0');
+            at += len + 1;
+        }
+        free(joined);
+        if (!exact) {
+            free(payload);
+            free(tag);
+            for (size_t k = 0; k < n; k++) envelope_free(&run[k]);
+            free(run);
+            lines[out++] = lines[i++];
+            continue;
+        }
+
+        if (!*tags) *tags = calloc(count, sizeof(char*));
+        (*tags)[out] = tag;
+        for (size_t k = 0; k < n; k++) free(lines[i + k]);
+        lines[out++] = envelope_render(first.kind, first.time, first.stream, "F", payload);
+        free(payload);
+        for (size_t k = 0; k < n; k++) envelope_free(&run[k]);
+        free(run);
+        i += n;
+    }
+    return out;
+}
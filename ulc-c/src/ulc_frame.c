@@ -0,0 +1,100 @@
+#include "../include/ulc_frame.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int is_ident_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$';
+}
+
+static int ends_with(const char* s, size_t len, const char* suffix) {
+    size_t n = strlen(suffix);
+    return len >= n && memcmp(s + len - n, suffix, n) == 0;
+}
+
+// "java.lang.IllegalStateException: msg": a qualified class name ending in
+// Exception/Error/Throwable, then ':' or the end of the line
+static int is_exception_header(const char* line) {
+    const char* p = line;
+    int dots = 0;
+    if (!is_ident_char(*p) || (*p >= '0' && *p <= '9')) return 0;
+    while (is_ident_char(*p) || (*p == '.' && is_ident_char(p[1]))) dots += (*p++ == '.');
+    if (dots == 0 || (*p != ':' && *p != '\0')) return 0;
+    size_t len = (size_t)(p - line);
+    return ends_with(line, len, "Exception") || ends_with(line, len, "Error") || ends_with(line, len, "Throwable");
+}
+
+int frame_is_continuation(const char* line) {
+    if (*line == ' ' || *line == '\t') {
+        // Indented JSON is a record of its own
+        const char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        return *p != '{';
+    }
+    return strncmp(line, "Caused by: ", 11) == 0 || is_exception_header(line);
+}
+
+// "\tat pkg.Class.method(File.java:42)" and "\t... 12 more"
+static int is_frame(const char* line) {
+    const char* p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    return p != line && (strncmp(p, "at ", 3) == 0 || strncmp(p, "... ", 4) == 0);
+}
+
+void frame_split(char* const* lines, size_t count, char** skeleton, char** messages) {
+    size_t skeleton_len = 0, messages_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (is_frame(lines[i])) skeleton_len += strlen(lines[i]) + 1;
+        else {
+            skeleton_len += 2;
+            messages_len += strlen(lines[i]) + 1;
+        }
+    }
+
+    char* s = malloc(skeleton_len + 1);
+    char* m = malloc(messages_len + 1);
+    size_t sn = 0, mn = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t len = strlen(lines[i]);
+        if (sn > 0) s[sn++] = '\n';
+        if (is_frame(lines[i])) {
+            memcpy(s + sn, lines[i], len);
+            sn += len;
+        } else {
+            s[sn++] = FRAME_MESSAGE_SLOT;
+            if (mn > 0) m[mn++] = '\n';
+            memcpy(m + mn, lines[i], len);
+            mn += len;
+        }
+    }
+    s[sn] = '\0';
+    m[mn] = '\0';
+    *skeleton = s;
+    *messages = m;
+}
+
+char* frame_join(const char* skeleton, const char* messages) {
+    // Every slot takes one message line, so the output is at most their sum
+    char* out = malloc(strlen(skeleton) + strlen(messages) + 1);
+    size_t n = 0;
+    const char* s = skeleton;
+    const char* m = messages;
+    for (;;) {
+        const char* end = strchr(s, '\n');
+        size_t len = end ? (size_t)(end - s) : strlen(s);
+        if (len == 1 && *s == FRAME_MESSAGE_SLOT) {
+            const char* mend = strchr(m, '\n');
+            size_t mlen = mend ? (size_t)(mend - m) : strlen(m);
+            memcpy(out + n, m, mlen);
+            n += mlen;
+            m += mlen + (mend ? 1 : 0);
+        } else {
+            memcpy(out + n, s, len);
+            n += len;
+        }
+        if (!end) break;
+        out[n++] = '\n';
+        s = end + 1;
+    }
+    out[n] = '\0';
+    return out;
+}
@@ -0,0 +1,427 @@
+#include "../include/ulc_json.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// --- Structural index ---
+
+// Quote, backslash and operator ({}[]:,) bitmasks of a 64-byte block
+static void classify_block(const uint8_t* in, uint64_t* quote, uint64_t* backslash, uint64_t* op) {
+    uint64_t q = 0, b = 0, o = 0;
+#if defined(__SSE2__)
+    for (int k = 0; k < 4; k++) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + 16 * k));
+        // '[' and ']' become '{' and '}' with bit 5 set
+        __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i ops = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        q |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << (16 * k);
+        b |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << (16 * k);
+        o |= (uint64_t)(uint16_t)_mm_movemask_epi8(ops) << (16 * k);
+    }
+#else
+    for (int i = 0; i < 64; i++) {
+        uint8_t c = in[i];
+        uint8_t folded = c | 0x20;
+        q |= (uint64_t)(c == '"') << i;
+        b |= (uint64_t)(c == '\\') << i;
+        o |= (uint64_t)(folded == '{' || folded == '}' || c == ':' || c == ',') << i;
+    }
+#endif
+    *quote = q;
+    *backslash = b;
+    *op = o;
+}
+
+// Characters escaped by an odd-length backslash run; *prev_escaped carries
+// a run that crosses the block boundary
+static uint64_t find_escaped(uint64_t backslash, uint64_t* prev_escaped) {
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    backslash &= ~*prev_escaped;
+    uint64_t follows_escape = (backslash << 1) | *prev_escaped;
+    uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t even_starts = odd_starts + backslash;
+    *prev_escaped = even_starts < backslash;
+    uint64_t invert_mask = even_starts << 1;
+    return (even_bits ^ invert_mask) & follows_escape;
+}
+
+// Running XOR: bit i set when an odd number of quotes are at or before i
+static uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+int json_index_build(const char* data, size_t len, JsonIndex* index) {
+    index->positions = malloc(sizeof(uint32_t) * (len + 1));
+    index->count = 0;
+
+    uint64_t prev_escaped = 0;
+    uint64_t prev_in_string = 0;
+    uint8_t tail[64];
+
+    for (size_t base = 0; base < len; base += 64) {
+        const uint8_t* block = (const uint8_t*)data + base;
+        if (len - base < 64) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, len - base);
+            block = tail;
+        }
+
+        uint64_t quote, backslash, op;
+        classify_block(block, &quote, &backslash, &op);
+        quote &= ~find_escaped(backslash, &prev_escaped);
+        uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+        uint64_t structural = (op & ~in_string) | quote;
+        while (structural) {
+            index->positions[index->count++] = (uint32_t)(base + __builtin_ctzll(structural));
+            structural &= structural - 1;
+        }
+    }
+    return prev_in_string == 0;
+}
+
+void json_index_free(JsonIndex* index) {
+    free(index->positions);
+    index->positions = NULL;
+    index->count = 0;
+}
+
+// --- Flattening ---
+
+typedef struct {
+    const char* line;
+    const uint32_t* pos;
+    size_t count;
+    size_t k;              // Next index entry
+    size_t copied;         // Line bytes already in the layout
+    size_t depth;
+
+    char* layout;
+    size_t layout_len;
+
+    char* path;
+    size_t path_len;
+    size_t path_capacity;
+
+    JsonRow* row;
+    size_t row_capacity;
+} Flattener;
+
+// Nesting deeper than this is kept raw
+#define JSON_MAX_DEPTH 64
+
+static inline int is_ws(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int only_ws(const char* s, size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        if (!is_ws(s[i])) return 0;
+    }
+    return 1;
+}
+
+// Next index entry is c with only whitespace since from
+static int expect(Flattener* f, char c, size_t from) {
+    return f->k < f->count && f->line[f->pos[f->k]] == c && only_ws(f->line, from, f->pos[f->k]);
+}
+
+static char* copy_span(const char* s, size_t len) {
+    char* out = malloc(len + 1);
+    memcpy(out, s, len);
+    out[len] = '\0';
+    return out;
+}
+
+static void path_push(Flattener* f, const char* key, size_t len) {
+    size_t need = f->path_len + len + 2;
+    if (need > f->path_capacity) {
+        while (need > f->path_capacity) f->path_capacity *= 2;
+        f->path = realloc(f->path, f->path_capacity);
+    }
+    if (f->path_len > 0) f->path[f->path_len++] = '.';
+    memcpy(f->path + f->path_len, key, len);
+    f->path_len += len;
+    f->path[f->path_len] = '\0';
+}
+
+// Replace line[start, end) with a marker; the value is line[vstart, vend)
+static void emit_value(Flattener* f, size_t start, size_t end, char mark, size_t vstart, size_t vend) {
+    memcpy(f->layout + f->layout_len, f->line + f->copied, start - f->copied);
+    f->layout_len += start - f->copied;
+    f->layout[f->layout_len++] = mark;
+    f->copied = end;
+
+    JsonRow* row = f->row;
+    if (row->count == f->row_capacity) {
+        f->row_capacity *= 2;
+        row->paths = realloc(row->paths, sizeof(char*) * f->row_capacity);
+        row->values = realloc(row->values, sizeof(char*) * f->row_capacity);
+    }
+    row->paths[row->count] = copy_span(f->path, f->path_len);
+    row->values[row->count] = copy_span(f->line + vstart, vend - vstart);
+    row->count++;
+}
+
+// Object starting at index entry k ('{'); leaves k after its '}'
+static int flatten_object(Flattener* f) {
+    if (++f->depth > JSON_MAX_DEPTH) return 0;
+    size_t after = f->pos[f->k++] + 1;
+
+    if (expect(f, '}', after)) {
+        f->k++;
+        f->depth--;
+        return 1;
+    }
+
+    for (;;) {
+        // Key
+        if (!expect(f, '"', after) || f->k + 1 >= f->count) return 0;
+        size_t key_start = f->pos[f->k] + 1;
+        size_t key_end = f->pos[f->k + 1];
+        f->k += 2;
+        for (size_t i = key_start; i < key_end; i++) {
+            // Keys stay in the layout, so they must not hold marker bytes
+            if (f->line[i] == JSON_MARK_STRING || f->line[i] == JSON_MARK_RAW) return 0;
+        }
+        if (!expect(f, ':', key_end + 1)) return 0;
+        size_t value = f->pos[f->k++] + 1;
+        while (is_ws(f->line[value])) value++;
+
+        size_t saved_len = f->path_len;
+        path_push(f, f->line + key_start, key_end - key_start);
+
+        // Value
+        char c = f->line[value];
+        if (c == '"') {
+            if (f->k + 1 >= f->count || f->pos[f->k] != value) return 0;
+            size_t close = f->pos[f->k + 1];
+            f->k += 2;
+            emit_value(f, value, close + 1, JSON_MARK_STRING, value + 1, close);
+            after = close + 1;
+        } else if (c == '{') {
+            if (f->k >= f->count || f->pos[f->k] != value || !flatten_object(f)) return 0;
+            after = f->pos[f->k - 1] + 1;
+        } else if (c == '[') {
+            // Arrays stay whole: skip to the matching bracket
+            if (f->k >= f->count || f->pos[f->k] != value) return 0;
+            int depth = 0;
+            size_t end = 0;
+            while (f->k < f->count) {
+                char s = f->line[f->pos[f->k]];
+                if (s == '[' || s == '{') depth++;
+                else if (s == ']' || s == '}') depth--;
+                if (depth == 0) {
+                    end = f->pos[f->k++] + 1;
+                    break;
+                }
+                f->k++;
+            }
+            if (depth != 0) return 0;
+            emit_value(f, value, end, JSON_MARK_RAW, value, end);
+            after = end;
+        } else {
+            // Number or literal, up to the next structural character
+            if (f->k >= f->count) return 0;
+            size_t end = f->pos[f->k];
+            while (end > value && is_ws(f->line[end - 1])) end--;
+            if (end == value) return 0;
+            for (size_t i = value; i < end; i++) {
+                if (is_ws(f->line[i]) || f->line[i] == '\\') return 0;
+            }
+            emit_value(f, value, end, JSON_MARK_RAW, value, end);
+            after = end;
+        }
+        f->path_len = saved_len;
+        f->path[f->path_len] = '\0';
+
+        if (expect(f, ',', after)) {
+            after = f->pos[f->k++] + 1;
+        } else if (expect(f, '}', after)) {
+            f->k++;
+            f->depth--;
+            return 1;
+        } else {
+            return 0;
+        }
+    }
+}
+
+// Whether any key path occurs twice or collides with the layout field
+// (the row could not map to columns)
+static int has_duplicate_paths(const JsonRow* row) {
+    size_t size = 16;
+    while (size < row->count * 2) size *= 2;
+    const char** table = calloc(size, sizeof(char*));
+    int duplicate = 0;
+    for (size_t i = 0; i < row->count && !duplicate; i++) {
+        if (strcmp(row->paths[i], JSON_LAYOUT_FIELD) == 0) {
+            duplicate = 1;
+            break;
+        }
+        uint32_t h = 2166136261u;
+        for (const char* p = row->paths[i]; *p; p++) h = (h ^ (uint8_t)*p) * 16777619u;
+        size_t slot = h & (size - 1);
+        while (table[slot]) {
+            if (strcmp(table[slot], row->paths[i]) == 0) {
+                duplicate = 1;
+                break;
+            }
+            slot = (slot + 1) & (size - 1);
+        }
+        table[slot] = row->paths[i];
+    }
+    free(table);
+    return duplicate;
+}
+
+int json_flatten(const char* line, size_t len, JsonRow* row) {
+    row->layout = NULL;
+    row->paths = NULL;
+    row->values = NULL;
+    row->count = 0;
+
+    JsonIndex index;
+    if (!json_index_build(line, len, &index) || index.count == 0) {
+        json_index_free(&index);
+        return 0;
+    }
+
+    Flattener f;
+    memset(&f, 0, sizeof(f));
+    f.line = line;
+    f.pos = index.positions;
+    f.count = index.count;
+    f.layout = malloc(len + 1);
+    f.path_capacity = 64;
+    f.path = malloc(f.path_capacity);
+    f.path[0] = '\0';
+    f.row = row;
+    f.row_capacity = 16;
+    row->paths = malloc(sizeof(char*) * f.row_capacity);
+    row->values = malloc(sizeof(char*) * f.row_capacity);
+
+    // A single object, surrounded by whitespace only
+    int ok = line[index.positions[0]] == '{' && only_ws(line, 0, index.positions[0]) &&
+             flatten_object(&f) && f.k == f.count && only_ws(line, f.pos[f.k - 1] + 1, len) &&
+             !has_duplicate_paths(row);
+
+    json_index_free(&index);
+    free(f.path);
+    if (!ok) {
+        free(f.layout);
+        json_row_free(row);
+        return 0;
+    }
+
+    memcpy(f.layout + f.layout_len, line + f.copied, len - f.copied);
+    f.layout_len += len - f.copied;
+    f.layout[f.layout_len] = '\0';
+    row->layout = f.layout;
+    return 1;
+}
+
+void json_row_free(JsonRow* row) {
+    for (size_t i = 0; i < row->count; i++) {
+        free(row->paths[i]);
+        free(row->values[i]);
+    }
+    free(row->paths);
+    free(row->values);
+    free(row->layout);
+    row->paths = NULL;
+    row->values = NULL;
+    row->layout = NULL;
+    row->count = 0;
+}
+
+// --- Restore ---
+
+size_t json_layout_paths(const char* layout, char*** paths) {
+    size_t count = 0, capacity = 16;
+    *paths = malloc(sizeof(char*) * capacity);
+
+    size_t path_capacity = 64, path_len = 0;
+    char* path = malloc(path_capacity);
+    size_t stack[JSON_MAX_DEPTH + 1];
+    size_t depth = 0;
+    const char* key = NULL;
+    size_t key_len = 0;
+
+    for (const char* p = layout; *p; p++) {
+        char c = *p;
+        if (c == '"') {
+            // Keys are the only strings left in a layout
+            key = ++p;
+            while (*p != '"') p += (*p == '\\') ? 2 : 1;
+            key_len = (size_t)(p - key);
+        } else if (c == '{') {
+            stack[depth++] = path_len;
+            if (key) {
+                if (path_len + key_len + 2 > path_capacity) {
+                    path_capacity = (path_len + key_len + 2) * 2;
+                    path = realloc(path, path_capacity);
+                }
+                if (path_len > 0) path[path_len++] = '.';
+                memcpy(path + path_len, key, key_len);
+                path_len += key_len;
+                key = NULL;
+            }
+        } else if (c == '}') {
+            path_len = stack[--depth];
+        } else if (c == JSON_MARK_STRING || c == JSON_MARK_RAW) {
+            if (count == capacity) {
+                capacity *= 2;
+                *paths = realloc(*paths, sizeof(char*) * capacity);
+            }
+            char* full = malloc(path_len + key_len + 2);
+            memcpy(full, path, path_len);
+            size_t n = path_len;
+            if (path_len > 0) full[n++] = '.';
+            memcpy(full + n, key, key_len);
+            full[n + key_len] = '\0';
+            (*paths)[count++] = full;
+            key = NULL;
+        }
+    }
+    free(path);
+    return count;
+}
+
+void json_paths_free(char** paths, size_t count) {
+    for (size_t i = 0; i < count; i++) free(paths[i]);
+    free(paths);
+}
+
+char* json_restore(const char* layout, const char* const* values, size_t count) {
+    size_t total = strlen(layout) + 1;
+    for (size_t i = 0; i < count; i++) total += strlen(values[i]) + 2;
+
+    char* out = malloc(total);
+    size_t n = 0, v = 0;
+    for (const char* p = layout; *p; p++) {
+        if ((*p == JSON_MARK_STRING || *p == JSON_MARK_RAW) && v < count) {
+            size_t len = strlen(values[v]);
+            if (*p == JSON_MARK_STRING) out[n++] = '"';
+            memcpy(out + n, values[v], len);
+            n += len;
+            if (*p == JSON_MARK_STRING) out[n++] = '"';
+            v++;
+        } else {
+            out[n++] = *p;
+        }
+    }
+    out[n] = '\0';
+    return out;
+}
@@ -0,0 +1,142 @@
+#include "../include/ulc_logfmt.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int is_sep(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Key bytes: anything visible except '=' and '"'
+static int is_key_char(char c) {
+    return (unsigned char)c > ' ' && c != '=' && c != '"';
+}
+
+static char* copy_span(const char* s, size_t len) {
+    char* out = malloc(len + 1);
+    memcpy(out, s, len);
+    out[len] = '\0';
+    return out;
+}
+
+// Keys become column names next to the layout field, so they must be unique
+static int has_key(const JsonRow* row, const char* key, size_t len) {
+    if (len == strlen(JSON_LAYOUT_FIELD) && memcmp(key, JSON_LAYOUT_FIELD, len) == 0) return 1;
+    for (size_t i = 0; i < row->count; i++) {
+        if (strncmp(row->paths[i], key, len) == 0 && row->paths[i][len] == '\0') return 1;
+    }
+    return 0;
+}
+
+int logfmt_split(const char* line, size_t len, JsonRow* row) {
+    size_t capacity = 16;
+    row->paths = malloc(sizeof(char*) * capacity);
+    row->values = malloc(sizeof(char*) * capacity);
+    row->count = 0;
+    // A pair with an empty value ("k=") takes a marker byte more than its
+    // text, and every pair is at least two bytes
+    row->layout = malloc(len + len / 2 + 2);
+
+    // Single pass: separators and keys are copied to the layout, values
+    // are cut out and replaced by a marker
+    char* layout = row->layout;
+    size_t n = 0;
+    layout[n++] = LOGFMT_LAYOUT_TAG;
+    size_t i = 0;
+    int ok = 1;
+    for (;;) {
+        size_t sep = i;
+        while (i < len && is_sep(line[i])) i++;
+        memcpy(layout + n, line + sep, i - sep);
+        n += i - sep;
+        if (i == len) break;
+        if (i == sep && row->count > 0) {
+            // Pairs must be separated (a="x"b=1)
+            ok = 0;
+            break;
+        }
+
+        // Key, followed by '=' or, as a bare key (a flag), by a separator
+        size_t key = i;
+        while (i < len && is_key_char(line[i])) i++;
+        if (i == key || (i < len && line[i] != '=' && !is_sep(line[i]))) {
+            ok = 0;
+            break;
+        }
+        if (i == len || line[i] != '=') {
+            // Kept in the layout as it is; it has no value column
+            memcpy(layout + n, line + key, i - key);
+            n += i - key;
+            continue;
+        }
+        if (has_key(row, line + key, i - key)) {
+            ok = 0;
+            break;
+        }
+        size_t key_len = i - key;
+        memcpy(layout + n, line + key, key_len + 1);
+        n += key_len + 1;
+        i++;
+
+        // Value: quoted (escapes kept verbatim) or bare up to the next separator
+        size_t vstart, vend;
+        char mark;
+        if (i < len && line[i] == '"') {
+            vstart = ++i;
+            while (i < len && line[i] != '"') i += (line[i] == '\\') ? 2 : 1;
+            if (i >= len) {
+                ok = 0;
+                break;
+            }
+            vend = i++;
+            mark = JSON_MARK_STRING;
+        } else {
+            vstart = i;
+            while (i < len && (unsigned char)line[i] > ' ' && line[i] != '"') i++;
+            vend = i;
+            mark = JSON_MARK_RAW;
+        }
+        layout[n++] = mark;
+
+        if (row->count == capacity) {
+            capacity *= 2;
+            row->paths = realloc(row->paths, sizeof(char*) * capacity);
+            row->values = realloc(row->values, sizeof(char*) * capacity);
+        }
+        row->paths[row->count] = copy_span(line + key, key_len);
+        row->values[row->count] = copy_span(line + vstart, vend - vstart);
+        row->count++;
+    }
+    layout[n] = '\0';
+
+    if (!ok || row->count < LOGFMT_MIN_PAIRS) {
+        json_row_free(row);
+        return 0;
+    }
+    return 1;
+}
+
+size_t logfmt_layout_keys(const char* layout, char*** keys) {
+    size_t count = 0, capacity = 16;
+    *keys = malloc(sizeof(char*) * capacity);
+
+    // Skip the tag; each key runs up to '=', which is followed by its
+    // marker. Bare keys run up to a separator and are skipped
+    const char* p = layout + 1;
+    while (*p) {
+        if (is_sep(*p)) {
+            p++;
+            continue;
+        }
+        const char* key = p;
+        while (*p && *p != '=' && !is_sep(*p)) p++;
+        if (*p != '=') continue;
+        if (!p[1]) break;
+        if (count == capacity) {
+            capacity *= 2;
+            *keys = realloc(*keys, sizeof(char*) * capacity);
+        }
+        (*keys)[count++] = copy_span(key, (size_t)(p - key));
+        p += 2;
+    }
+    return count;
+}
@@ -1,17 +1,57 @@
 #include "../include/ulc_parser.h"
+#include "../include/ulc_utils.h"
+#include "../include/ulc_json.h"
+#include "../include/ulc_logfmt.h"
+#include "../include/ulc_envelope.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
 
+// Field names by format, in field order
+static const char* const apache_fields[] = {
+    "ip", "timestamp", "method", "path", "status", "size", "referer", "useragent"
+};
+static const char* const generic_fields[] = {"timestamp", "service", "level", "message"};
+static const char* const syslog_pid_fields[] = {"timestamp", "host", "service", "pid", "message"};
+static const char* const syslog_fields[] = {"timestamp", "host", "service", "message"};
+static const char* const java_fields[] = {"timestamp", "level", "thread", "logger", "message"};
+static const char* const security_fields[] = {"timestamp", "service", "pid", "message"};
+static const char* const raw_fields[] = {"raw_message"};
+
 // Helper to check if line is JSON
 static int is_json(const char* line) {
     while (isspace(*line)) line++;
     return *line == '{';
 }
 
+// --- Entries ---
+
+// Entry with room for count fields, allocated from the parser's arena
+static LogEntry* entry_new(LogParser* parser, LogFormat format, size_t count) {
+    LogEntry* entry = arena_alloc(&parser->arena, sizeof(LogEntry));
+    entry->format = format;
+    entry->span = 0;
+    entry->field_count = count;
+    entry->ids = arena_alloc(&parser->arena, sizeof(int) * (count ? count : 1));
+    entry->values = arena_alloc(&parser->arena, sizeof(char*) * (count ? count : 1));
+    return entry;
+}
+
+static void entry_set(LogParser* parser, LogEntry* entry, size_t k, const char* name, const char* value, size_t len) {
+    entry->ids[k] = schema_intern(&parser->schema, name);
+    entry->values[k] = arena_strndup(&parser->arena, value, len);
+}
+
+static LogEntry* entry_from_values(LogParser* parser, LogFormat format, const char* const* names,
+                                   const char* const* values, size_t count) {
+    LogEntry* entry = entry_new(parser, format, count);
+    for (size_t k = 0; k < count; k++) entry_set(parser, entry, k, names[k], values[k], strlen(values[k]));
+    return entry;
+}
+
 // Simple regex-like matching for common patterns
-static int parse_apache(const char* line, LogEntry* entry) {
+static LogEntry* parse_apache(LogParser* parser, const char* line) {
     // Format: IP - - [timestamp] "METHOD path HTTP/1.1" status size "referer" "useragent"
     char ip[64], timestamp[128], method[16], path[512], status[16], size[32];
     char referer[512], useragent[512];
@@ -20,36 +60,25 @@ static int parse_apache(const char* line, LogEntry* entry) {
                    ip, timestamp, method, path, status, size, referer, useragent);
     
     if (n >= 6) {
-        entry->format = LOG_FORMAT_APACHE;
-        log_entry_add_field(entry, "ip", ip);
-        log_entry_add_field(entry, "timestamp", timestamp);
-        log_entry_add_field(entry, "method", method);
-        log_entry_add_field(entry, "path", path);
-        log_entry_add_field(entry, "status", status);
-        log_entry_add_field(entry, "size", size);
-        if (n >= 7) log_entry_add_field(entry, "referer", referer);
-        if (n >= 8) log_entry_add_field(entry, "useragent", useragent);
-        return 1;
+        // Referer and user agent only when present
+        const char* values[] = {ip, timestamp, method, path, status, size, referer, useragent};
+        return entry_from_values(parser, LOG_FORMAT_APACHE, apache_fields, values, (size_t)n);
     }
-    return 0;
+    return NULL;
 }
 
-static int parse_generic(const char* line, LogEntry* entry) {
+static LogEntry* parse_generic(LogParser* parser, const char* line) {
     // Format: [timestamp] service level: message
     char timestamp[128], service[64], level[32], message[1024];
     
     if (sscanf(line, "[%127[^]]] %63s %31[^:]: %1023[^\n]", timestamp, service, level, message) == 4) {
-        entry->format = LOG_FORMAT_GENERIC;
-        log_entry_add_field(entry, "timestamp", timestamp);
-        log_entry_add_field(entry, "service", service);
-        log_entry_add_field(entry, "level", level);
-        log_entry_add_field(entry, "message", message);
-        return 1;
+        const char* values[] = {timestamp, service, level, message};
+        return entry_from_values(parser, LOG_FORMAT_GENERIC, generic_fields, values, 4);
     }
-    return 0;
+    return NULL;
 }
 
-static int parse_syslog(const char* line, LogEntry* entry) {
+static LogEntry* parse_syslog(LogParser* parser, const char* line) {
     // Format: Nov 24 18:55:22 hostname service[pid]: message
     char month[16], day[8], time[16], host[128], service[64], message[1024];
     int pid;
@@ -61,13 +90,8 @@ static int parse_syslog(const char* line, LogEntry* entry) {
         snprintf(timestamp, sizeof(timestamp), "%s %s %s", month, day, time);
         snprintf(pid_str, sizeof(pid_str), "%d", pid);
         
-        entry->format = LOG_FORMAT_SYSLOG;
-        log_entry_add_field(entry, "timestamp", timestamp);
-        log_entry_add_field(entry, "host", host);
-        log_entry_add_field(entry, "service", service);
-        log_entry_add_field(entry, "pid", pid_str);
-        log_entry_add_field(entry, "message", message);
-        return 1;
+        const char* values[] = {timestamp, host, service, pid_str, message};
+        return entry_from_values(parser, LOG_FORMAT_SYSLOG, syslog_pid_fields, values, 5);
     }
     
     // Try without PID
@@ -76,21 +100,43 @@ static int parse_syslog(const char* line, LogEntry* entry) {
         char timestamp[64];
         snprintf(timestamp, sizeof(timestamp), "%s %s %s", month, day, time);
         
-        entry->format = LOG_FORMAT_SYSLOG;
-        log_entry_add_field(entry, "timestamp", timestamp);
-        log_entry_add_field(entry, "host", host);
-        log_entry_add_field(entry, "service", service);
-        log_entry_add_field(entry, "message", message);
-        return 1;
+        const char* values[] = {timestamp, host, service, message};
+        return entry_from_values(parser, LOG_FORMAT_SYSLOG, syslog_fields, values, 4);
+    }
+    return NULL;
+}
+
+static int is_java_level(const char* level) {
+    static const char* const levels[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        if (strcmp(level, levels[i]) == 0) return 1;
     }
     return 0;
 }
 
-static int parse_security(const char* line, LogEntry* entry) {
+static LogEntry* parse_java(LogParser* parser, const char* line) {
+    // Format: 2025-11-24 18:55:22.123 ERROR [main] com.example.Service - message (logback/log4j)
+    char date[16], time[32], level[16], thread[128], logger[256], message[1024];
+    
+    if (sscanf(line, "%15s %31s %15s [%127[^]]] %255s - %1023[^\n]",
+               date, time, level, thread, logger, message) == 6 &&
+        date[0] >= '0' && date[0] <= '9' && is_java_level(level)) {
+        char timestamp[64];
+        snprintf(timestamp, sizeof(timestamp), "%s %s", date, time);
+        
+        const char* values[] = {timestamp, level, thread, logger, message};
+        return entry_from_values(parser, LOG_FORMAT_JAVA, java_fields, values, 5);
+    }
+    return NULL;
+}
+
+static LogEntry* parse_security(LogParser* parser, const char* line) {
     // Format: 2025-11-24 18:55:22 service[pid]: message
     char timestamp[64], service[64], message[1024];
     int pid;
     
+    // Only three conversions are required, so the message may stay unset
+    message[0] = '\0';
     if (sscanf(line, "%63s %*s %63[^[][%d]: %1023[^\n]", timestamp, service, &pid, message) == 3) {
         char pid_str[16];
         snprintf(pid_str, sizeof(pid_str), "%d", pid);
@@ -99,63 +145,608 @@ static int parse_security(const char* line, LogEntry* entry) {
         char full_timestamp[128];
         sscanf(line, "%127s", full_timestamp);
         
-        entry->format = LOG_FORMAT_SEC;
-        log_entry_add_field(entry, "timestamp", full_timestamp);
-        log_entry_add_field(entry, "service", service);
-        log_entry_add_field(entry, "pid", pid_str);
-        log_entry_add_field(entry, "message", message);
-        return 1;
+        const char* values[] = {full_timestamp, service, pid_str, message};
+        return entry_from_values(parser, LOG_FORMAT_SEC, security_fields, values, 4);
+    }
+    return NULL;
+}
+
+// --- Format-locked scanners ---
+// Each scanner mirrors its sscanf pattern for the usual shape of the format
+// (fields within the sscanf buffer sizes, whitespace between fields), so a
+// line it accepts parses exactly as it would through the sscanf chain.
+// Anything else returns 0.
+
+// isspace() in the C locale, without the locale lookup
+static inline int is_space(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline void set_span(FieldSpan* span, const char* start, size_t length) {
+    span->start = start;
+    span->length = length;
+    span->joined = 0;
+}
+
+// %Ns: run of 1..max non-space characters
+static const char* scan_token(const char* p, size_t max, FieldSpan* span) {
+    const char* start = p;
+    while (*p && !is_space(*p)) p++;
+    size_t length = (size_t)(p - start);
+    if (length == 0 || length > max) return NULL;
+    set_span(span, start, length);
+    return p;
+}
+
+// %N[^stop]: run of 1..max characters, stop must follow
+static const char* scan_until(const char* p, char stop, size_t max, FieldSpan* span) {
+    const char* end = strchr(p, stop);
+    if (!end || end == p || (size_t)(end - p) > max) return NULL;
+    set_span(span, p, (size_t)(end - p));
+    return end;
+}
+
+// Format whitespace after a token: a whitespace run, then the next field
+static const char* scan_sep(const char* p) {
+    if (!p || !is_space(*p)) return NULL;
+    while (is_space(*p)) p++;
+    return *p ? p : NULL;
+}
+
+// One space, then %Ns
+static const char* scan_next_token(const char* p, size_t max, FieldSpan* span) {
+    p = scan_sep(p);
+    return p ? scan_token(p, max, span) : NULL;
+}
+
+// Rest of the line after ": " as %1023[^\n]
+static int scan_message(const char* p, FieldSpan* span) {
+    while (is_space(*p)) p++;
+    size_t length = strlen(p);
+    if (length == 0 || length > 1023) return 0;
+    set_span(span, p, length);
+    return 1;
+}
+
+// Whether the sscanf Apache pattern could match the start of the line
+// ("%63s - - ["); other scanners leave such lines to the generic chain
+static int apache_prefix(const char* p) {
+    while (is_space(*p)) p++;
+    const char* start = p;
+    while (*p && !is_space(*p)) p++;
+    if (p == start) return 0;
+    if (p - start > 63) return 1;
+    for (int i = 0; i < 2; i++) {
+        while (is_space(*p)) p++;
+        if (*p++ != '-') return 0;
+    }
+    while (is_space(*p)) p++;
+    return *p == '[';
+}
+
+static size_t scan_apache(const char* line, FieldSpan* f) {
+    const char* p = scan_token(line, 63, &f[0]);
+    if (!p || strncmp(p, " - - [", 6) != 0) return 0;
+    p = scan_until(p + 6, ']', 127, &f[1]);
+    if (!p || strncmp(p, "] \"", 3) != 0) return 0;
+    p = scan_token(p + 3, 15, &f[2]);
+    p = scan_next_token(p, 511, &f[3]);
+    p = scan_sep(p);
+    if (!p || strncmp(p, "HTTP/", 5) != 0) return 0;
+    
+    // Protocol version is skipped, like %*[^"]
+    const char* quote = strchr(p + 5, '"');
+    if (!quote || quote == p + 5) return 0;
+    p = scan_next_token(quote + 1, 15, &f[4]);
+    p = scan_next_token(p, 31, &f[5]);
+    if (!p) return 0;
+    
+    // Quoted tail: sscanf stops counting at the first part that is missing
+    for (size_t k = 6; k < 8; k++) {
+        while (is_space(*p)) p++;
+        if (*p != '"' || p[1] == '"' || p[1] == '\0') return k;
+        const char* start = ++p;
+        while (*p && *p != '"') p++;
+        if (p - start > 511) return 0;
+        set_span(&f[k], start, (size_t)(p - start));
+        if (*p == '\0') return k + 1;
+        p++;
+    }
+    return 8;
+}
+
+static size_t scan_generic(const char* line, FieldSpan* f) {
+    if (line[0] != '[' || apache_prefix(line)) return 0;
+    const char* p = scan_until(line + 1, ']', 127, &f[0]);
+    p = p ? scan_next_token(p + 1, 63, &f[1]) : NULL;
+    p = scan_sep(p);
+    p = p ? scan_until(p, ':', 31, &f[2]) : NULL;
+    if (!p || !scan_message(p + 1, &f[3])) return 0;
+    return 4;
+}
+
+static size_t scan_syslog(const char* line, FieldSpan* f) {
+    if (line[0] == '[' || apache_prefix(line)) return 0;
+    FieldSpan month = {0}, day = {0}, time = {0};
+    const char* p = scan_token(line, 15, &month);
+    p = scan_next_token(p, 7, &day);
+    p = scan_next_token(p, 15, &time);
+    if (!p) return 0;
+    
+    // "%s %s %s" of month, day and time; padded days ("Nov  5") are joined
+    set_span(&f[0], line, (size_t)(p - line));
+    f[0].joined = day.start != month.start + month.length + 1 || time.start != day.start + day.length + 1 ||
+                  day.start[-1] != ' ' || time.start[-1] != ' ';
+    p = scan_next_token(p, 127, &f[1]);
+    p = scan_sep(p);
+    if (!p) return 0;
+    
+    // With PID: "%63[^[][%d]: " succeeds whenever the loose shape below
+    // holds, only the canonical form of it is taken here
+    const char* bracket = strchr(p, '[');
+    if (bracket && bracket > p) {
+        const char* digits = bracket + 1;
+        const char* d = digits;
+        while (is_space(*d)) d++;
+        if (*d == '+' || *d == '-') d++;
+        const char* first_digit = d;
+        while (*d >= '0' && *d <= '9') d++;
+        
+        if (d > first_digit && d[0] == ']' && d[1] == ':') {
+            size_t count = (size_t)(d - digits);
+            if (bracket - p > 63 || digits != first_digit || count > 9 || (count > 1 && *digits == '0')) return 0;
+            if (!scan_message(d + 2, &f[4])) {
+                // Empty message: the sscanf chain tries other patterns
+                return 0;
+            }
+            set_span(&f[2], p, (size_t)(bracket - p));
+            set_span(&f[3], digits, count);
+            return 5;
+        }
+    }
+    
+    // Without PID: "%63[^:]: "
+    const char* colon = strchr(p, ':');
+    if (!colon || colon == p || colon - p > 63 || !scan_message(colon + 1, &f[3])) return 0;
+    set_span(&f[2], p, (size_t)(colon - p));
+    return 4;
+}
+
+static size_t scan_java(const char* line, FieldSpan* f) {
+    if (line[0] < '0' || line[0] > '9' || apache_prefix(line)) return 0;
+    FieldSpan date = {0}, time = {0};
+    const char* p = scan_token(line, 15, &date);
+    p = scan_next_token(p, 31, &time);
+    if (!p) return 0;
+    
+    // "%s %s" of date and time, joined like the syslog timestamp
+    set_span(&f[0], line, (size_t)(p - line));
+    f[0].joined = time.start != date.start + date.length + 1 || time.start[-1] != ' ';
+    p = scan_next_token(p, 15, &f[1]);
+    if (!p) return 0;
+    char level[16];
+    memcpy(level, f[1].start, f[1].length);
+    level[f[1].length] = '\0';
+    if (!is_java_level(level)) return 0;
+    
+    p = scan_sep(p);
+    if (!p || *p != '[') return 0;
+    p = scan_until(p + 1, ']', 127, &f[2]);
+    p = p ? scan_next_token(p + 1, 255, &f[3]) : NULL;
+    if (!p) return 0;
+    while (is_space(*p)) p++;
+    if (*p != '-' || !scan_message(p + 1, &f[4])) return 0;
+    return 5;
+}
+
+size_t scan_log_line(LogFormat format, const char* line, FieldSpan* spans, const char* const** names) {
+    // Leading whitespace and JSON go through the generic chain
+    if (line[0] == '{' || is_space(line[0])) return 0;
+    
+    size_t count = 0;
+    switch (format) {
+        case LOG_FORMAT_APACHE:
+            count = scan_apache(line, spans);
+            *names = apache_fields;
+            break;
+        case LOG_FORMAT_GENERIC:
+            count = scan_generic(line, spans);
+            *names = generic_fields;
+            break;
+        case LOG_FORMAT_SYSLOG:
+            count = scan_syslog(line, spans);
+            *names = count == 5 ? syslog_pid_fields : syslog_fields;
+            break;
+        case LOG_FORMAT_JAVA:
+            count = scan_java(line, spans);
+            *names = java_fields;
+            break;
+        default:
+            break;
+    }
+    return count;
+}
+
+// Build an entry from spans, values copied straight into the arena
+static LogEntry* entry_from_spans(LogParser* parser, LogFormat format, const FieldSpan* spans,
+                                  const char* const* names, size_t count) {
+    LogEntry* entry = entry_new(parser, format, count);
+    for (size_t i = 0; i < count; i++) {
+        entry->ids[i] = schema_intern(&parser->schema, names[i]);
+        char* value = arena_alloc(&parser->arena, spans[i].length + 1);
+        size_t length = 0;
+        if (spans[i].joined) {
+            // Collapse whitespace runs to single spaces
+            for (size_t k = 0; k < spans[i].length; k++) {
+                char c = spans[i].start[k];
+                if (!is_space(c)) value[length++] = c;
+                else if (!is_space(spans[i].start[k - 1])) value[length++] = ' ';
+            }
+        } else {
+            memcpy(value, spans[i].start, spans[i].length);
+            length = spans[i].length;
+        }
+        value[length] = '\0';
+        entry->values[i] = value;
+    }
+    return entry;
+}
+
+void log_parser_init(LogParser* parser) {
+    memset(parser, 0, sizeof(LogParser));
+    parser->format = LOG_FORMAT_RAW;
+    schema_init(&parser->schema);
+    arena_init(&parser->arena);
+}
+
+void log_parser_free(LogParser* parser) {
+    schema_free(&parser->schema);
+    arena_free(&parser->arena);
+}
+
+void log_parser_set_spec(LogParser* parser, const FormatSpec* spec) {
+    parser->spec = spec;
+    parser->format = LOG_FORMAT_CUSTOM;
+    parser->locked = 1;
+}
+
+// Layout (the spec tag and text), then the spec's fields in order
+static LogEntry* entry_from_spec(LogParser* parser, const char* line, const size_t* starts, const size_t* lengths) {
+    const FormatSpec* spec = parser->spec;
+    LogEntry* entry = entry_new(parser, LOG_FORMAT_CUSTOM, spec->count + 1);
+    entry->ids[0] = schema_intern(&parser->schema, JSON_LAYOUT_FIELD);
+    entry->values[0] = arena_alloc(&parser->arena, strlen(spec->text) + 2);
+    entry->values[0][0] = SPEC_LAYOUT_TAG;
+    strcpy(entry->values[0] + 1, spec->text);
+    for (size_t i = 0; i < spec->count; i++) {
+        entry_set(parser, entry, i + 1, spec->fields[i].name, line + starts[i], lengths[i]);
+    }
+    return entry;
+}
+
+// --- Container envelopes ---
+
+// Span field names by format; the count picks the syslog variant
+static const char* const* format_fields(LogFormat format, size_t count) {
+    switch (format) {
+        case LOG_FORMAT_APACHE: return apache_fields;
+        case LOG_FORMAT_GENERIC: return generic_fields;
+        case LOG_FORMAT_SYSLOG: return count == 5 ? syslog_pid_fields : syslog_fields;
+        case LOG_FORMAT_JAVA: return java_fields;
+        default: return raw_fields;
+    }
+}
+
+// Marker and tag bytes in the text between fields would be misread
+static int span_plain(const char* payload) {
+    for (const char* p = payload; *p; p++) {
+        if (*p >= JSON_MARK_STRING && *p <= PARSER_SPAN_TAG) return 0;
+    }
+    return 1;
+}
+
+// Joined tokens lose the whitespace between them
+static int spans_joined(const FieldSpan* spans, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (spans[i].joined) return 1;
     }
     return 0;
 }
 
-LogEntry* parse_log_line(const char* line) {
-    LogEntry* entry = malloc(sizeof(LogEntry));
-    entry->fields = NULL;
-    entry->values = NULL;
-    entry->field_count = 0;
-    entry->format = LOG_FORMAT_RAW;
+// Span layout of a payload into out (strlen(payload) + count + 3 bytes)
+static void span_layout_write(char* out, LogFormat format, const char* payload, const FieldSpan* spans, size_t count) {
+    size_t n = 0;
+    out[n++] = PARSER_SPAN_TAG;
+    out[n++] = (char)('0' + format);
+    const char* p = payload;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(out + n, p, (size_t)(spans[i].start - p));
+        n += (size_t)(spans[i].start - p);
+        out[n++] = JSON_MARK_RAW;
+        p = spans[i].start + spans[i].length;
+    }
+    strcpy(out + n, p);
+}
+
+// Payload of a positional format as a span layout. Scanners run in the
+// order of the sscanf chain; the whole payload is the one field when none
+// takes it exactly. Values are the spans' text as it stands, so joined
+// spans are exact too, but container payloads keep rejecting them for the
+// layouts already written
+static void span_row(const char* payload, int keep_joined, JsonRow* row) {
+    static const LogFormat chain[] = {LOG_FORMAT_APACHE, LOG_FORMAT_GENERIC, LOG_FORMAT_JAVA, LOG_FORMAT_SYSLOG};
+    FieldSpan spans[PARSER_MAX_SPANS];
+    const char* const* names = raw_fields;
+    LogFormat format = LOG_FORMAT_RAW;
+    size_t count = 0;
+    
+    int plain = span_plain(payload);
+    for (size_t k = 0; plain && count == 0 && k < sizeof(chain) / sizeof(chain[0]); k++) {
+        count = scan_log_line(chain[k], payload, spans, &names);
+        if (!keep_joined && spans_joined(spans, count)) count = 0;
+        format = chain[k];
+    }
+    if (count == 0) {
+        format = LOG_FORMAT_RAW;
+        names = raw_fields;
+        set_span(&spans[0], payload, strlen(payload));
+        count = 1;
+    }
+    
+    row->count = count;
+    row->paths = malloc(sizeof(char*) * count);
+    row->values = malloc(sizeof(char*) * count);
+    row->layout = malloc(strlen(payload) + count + 3);
+    span_layout_write(row->layout, format, payload, spans, count);
+    for (size_t i = 0; i < count; i++) {
+        row->paths[i] = strdup(names[i]);
+        row->values[i] = malloc(spans[i].length + 1);
+        memcpy(row->values[i], spans[i].start, spans[i].length);
+        row->values[i][spans[i].length] = '\0';
+    }
+}
+
+// Scanned line as a keyed entry: its span layout, then the spans' values
+static LogEntry* entry_from_span_layout(LogParser* parser, LogFormat format, const char* line,
+                                        const FieldSpan* spans, const char* const* names, size_t count) {
+    LogEntry* entry = entry_new(parser, format, count + 1);
+    entry->span = 1;
+    entry->ids[0] = schema_intern(&parser->schema, JSON_LAYOUT_FIELD);
+    entry->values[0] = arena_alloc(&parser->arena, strlen(line) + count + 3);
+    span_layout_write(entry->values[0], format, line, spans, count);
+    for (size_t i = 0; i < count; i++) {
+        entry_set(parser, entry, i + 1, names[i], spans[i].start, spans[i].length);
+    }
+    return entry;
+}
+
+size_t span_layout_fields(const char* layout, char*** fields) {
+    size_t count = 0;
+    for (const char* p = layout + 2; *p; p++) count += (*p == JSON_MARK_RAW);
+    const char* const* names = format_fields((LogFormat)(layout[1] - '0'), count);
+    *fields = malloc(sizeof(char*) * (count ? count : 1));
+    for (size_t i = 0; i < count; i++) (*fields)[i] = strdup(names[i]);
+    return count;
+}
+
+// Payload keys may not shadow the envelope's own columns
+static int has_envelope_field(const JsonRow* row) {
+    for (size_t i = 0; i < row->count; i++) {
+        if (strcmp(row->paths[i], ENVELOPE_FIELD_TIME) == 0 || strcmp(row->paths[i], ENVELOPE_FIELD_STREAM) == 0 ||
+            strcmp(row->paths[i], ENVELOPE_FIELD_TAG) == 0) return 1;
+    }
+    return 0;
+}
+
+// Layout (the envelope tag, then the payload's layout), time, stream and
+// tag, then the payload's fields; the envelope is freed
+static LogEntry* entry_take_envelope(LogParser* parser, Envelope* env) {
+    JsonRow row;
+    const char* payload = env->payload;
+    size_t len = strlen(payload);
+    int keyed = is_json(payload) ? json_flatten(payload, len, &row) : logfmt_split(payload, len, &row);
+    if (keyed && has_envelope_field(&row)) {
+        json_row_free(&row);
+        keyed = 0;
+    }
+    if (!keyed) span_row(payload, 0, &row);
+    
+    LogEntry* entry = entry_new(parser, LOG_FORMAT_CONTAINER, row.count + 4);
+    entry->ids[0] = schema_intern(&parser->schema, JSON_LAYOUT_FIELD);
+    entry->values[0] = arena_alloc(&parser->arena, strlen(row.layout) + 2);
+    entry->values[0][0] = env->kind;
+    strcpy(entry->values[0] + 1, row.layout);
+    entry_set(parser, entry, 1, ENVELOPE_FIELD_TIME, env->time, strlen(env->time));
+    entry_set(parser, entry, 2, ENVELOPE_FIELD_STREAM, env->stream, strlen(env->stream));
+    entry_set(parser, entry, 3, ENVELOPE_FIELD_TAG, env->tag, strlen(env->tag));
+    for (size_t k = 0; k < row.count; k++) {
+        entry_set(parser, entry, k + 4, row.paths[k], row.values[k], strlen(row.values[k]));
+    }
+    json_row_free(&row);
+    envelope_free(env);
+    return entry;
+}
+
+// Layout first, then one field per key; the row is freed
+static LogEntry* entry_take_row(LogParser* parser, LogFormat format, JsonRow* row) {
+    LogEntry* entry = entry_new(parser, format, row->count + 1);
+    entry_set(parser, entry, 0, JSON_LAYOUT_FIELD, row->layout, strlen(row->layout));
+    for (size_t k = 0; k < row->count; k++) {
+        entry_set(parser, entry, k + 1, row->paths[k], row->values[k], strlen(row->values[k]));
+    }
+    json_row_free(row);
+    return entry;
+}
+
+LogEntry* log_parser_parse(LogParser* parser, const char* line) {
+    if (!parser->locked) {
+        LogEntry* entry = parse_log_line(parser, line);
+        parser->votes[entry->format]++;
+        
+        // Lock in the most common format of the sample
+        if (++parser->sampled >= PARSER_SAMPLE_LINES) {
+            for (int f = 0; f <= LOG_FORMAT_RAW; f++) {
+                if (parser->votes[f] > parser->votes[parser->format]) parser->format = f;
+            }
+            parser->locked = 1;
+        }
+        return entry;
+    }
     
+    if (parser->spec) {
+        size_t starts[SPEC_MAX_FIELDS], lengths[SPEC_MAX_FIELDS];
+        if (format_spec_match(parser->spec, line, starts, lengths)) {
+            parser->fast_hits++;
+            parser->spec_hits++;
+            return entry_from_spec(parser, line, starts, lengths);
+        }
+    }
+    
+    // Envelopes first: the JSON splitter would take Docker lines whole
+    Envelope env;
+    if (envelope_split(line, &env)) {
+        parser->fast_hits++;
+        return entry_take_envelope(parser, &env);
+    }
+    
+    // JSON and logfmt have no span scanner; their splitters are the fast path
+    JsonRow row;
+    if ((parser->format == LOG_FORMAT_JSON && is_json(line) && json_flatten(line, strlen(line), &row)) ||
+        (parser->format == LOG_FORMAT_LOGFMT && !is_json(line) && logfmt_split(line, strlen(line), &row))) {
+        parser->fast_hits++;
+        return entry_take_row(parser, parser->format, &row);
+    }
+    
+    FieldSpan spans[PARSER_MAX_SPANS];
+    const char* const* names;
+    size_t count = scan_log_line(parser->format, line, spans, &names);
+    if (count > 0 && (parser->layouts || (parser->span_formats >> parser->format & 1))) {
+        if (span_plain(line)) {
+            parser->fast_hits++;
+            return entry_from_span_layout(parser, parser->format, line, spans, names, count);
+        }
+    } else if (count > 0) {
+        parser->fast_hits++;
+        return entry_from_spans(parser, parser->format, spans, names, count);
+    }
+    
+    parser->fallbacks++;
+    return parse_log_line(parser, line);
+}
+
+// Span layout of a line that a scanner of parser->span_formats takes,
+// NULL when none does
+static LogEntry* parse_span_formats(LogParser* parser, const char* line) {
+    if (!parser->span_formats || !span_plain(line)) return NULL;
+    FieldSpan spans[PARSER_MAX_SPANS];
+    const char* const* names;
+    for (int f = 0; f < LOG_FORMAT_RAW; f++) {
+        if (!(parser->span_formats >> f & 1)) continue;
+        size_t count = scan_log_line((LogFormat)f, line, spans, &names);
+        if (count > 0) return entry_from_span_layout(parser, (LogFormat)f, line, spans, names, count);
+    }
+    return NULL;
+}
+
+LogEntry* parse_log_line(LogParser* parser, const char* line) {
     // Try different parsers
-    if (is_json(line)) {
-        // For simplicity, treat JSON as raw for now
-        // A full implementation would use a JSON parser
-        entry->format = LOG_FORMAT_RAW;
-        log_entry_add_field(entry, "raw_message", line);
-    } else if (parse_apache(line, entry)) {
+    LogEntry* entry = NULL;
+    Envelope env;
+    JsonRow row;
+    if (envelope_split(line, &env)) {
+        // Before JSON and the sscanf chain, which would take the envelope as the line
+        entry = entry_take_envelope(parser, &env);
+    } else if (is_json(line) && json_flatten(line, strlen(line), &row)) {
+        entry = entry_take_row(parser, LOG_FORMAT_JSON, &row);
+    } else if (is_json(line)) {
+        // Not a single flat object: stays raw
+    } else if (logfmt_split(line, strlen(line), &row)) {
+        // Before the sscanf chain: syslog's "%s %s %s %s %[^:]:" accepts most logfmt lines
+        entry = entry_take_row(parser, LOG_FORMAT_LOGFMT, &row);
+    } else if (parser->layouts) {
+        // Positional formats become span layouts below
+    } else if ((entry = parse_span_formats(parser, line))) {
+        // A format the caller restores from span layouts
+    } else if ((entry = parse_apache(parser, line))) {
         // Parsed as Apache
-    } else if (parse_generic(line, entry)) {
+    } else if ((entry = parse_generic(parser, line))) {
         // Parsed as Generic
-    } else if (parse_syslog(line, entry)) {
+    } else if (!(parser->span_formats >> LOG_FORMAT_JAVA & 1) && (entry = parse_java(parser, line))) {
+        // Parsed as Java (logback/log4j); stack traces are framed by the engines
+    } else if ((entry = parse_syslog(parser, line))) {
         // Parsed as Syslog
-    } else if (parse_security(line, entry)) {
+    } else if ((entry = parse_security(parser, line))) {
         // Parsed as Security
-    } else {
-        // Fallback to raw
-        entry->format = LOG_FORMAT_RAW;
-        log_entry_add_field(entry, "raw_message", line);
     }
     
+    if (!entry && parser->layouts) {
+        // The text between the fields is kept, so the row restores exactly
+        span_row(line, 1, &row);
+        entry = entry_take_row(parser, (LogFormat)(row.layout[1] - '0'), &row);
+    }
+    
+    // Fallback to raw
+    if (!entry) entry = entry_from_values(parser, LOG_FORMAT_RAW, raw_fields, &line, 1);
     return entry;
 }
 
-void log_entry_add_field(LogEntry* entry, const char* field, const char* value) {
-    entry->field_count++;
-    entry->fields = realloc(entry->fields, sizeof(char*) * entry->field_count);
-    entry->values = realloc(entry->values, sizeof(char*) * entry->field_count);
-    
-    entry->fields[entry->field_count - 1] = strdup(field);
-    entry->values[entry->field_count - 1] = strdup(value);
+void log_entry_add_field(LogParser* parser, LogEntry* entry, const char* field, const char* value) {
+    // Arena arrays do not grow: copy them with room for one more
+    int* ids = arena_alloc(&parser->arena, sizeof(int) * (entry->field_count + 1));
+    char** values = arena_alloc(&parser->arena, sizeof(char*) * (entry->field_count + 1));
+    memcpy(ids, entry->ids, sizeof(int) * entry->field_count);
+    memcpy(values, entry->values, sizeof(char*) * entry->field_count);
+    entry->ids = ids;
+    entry->values = values;
+    entry_set(parser, entry, entry->field_count++, field, value, strlen(value));
 }
 
-void log_entry_free(LogEntry* entry) {
-    if (entry) {
-        for (size_t i = 0; i < entry->field_count; i++) {
-            free(entry->fields[i]);
-            free(entry->values[i]);
+void log_entry_set_envelope_tag(LogParser* parser, LogEntry* entry, const char* tag) {
+    int tag_id = schema_find(&parser->schema, ENVELOPE_FIELD_TAG);
+    for (size_t k = 0; k < entry->field_count; k++) {
+        if (entry->ids[k] == tag_id) {
+            entry_set(parser, entry, k, ENVELOPE_FIELD_TAG, tag, strlen(tag));
+            break;
         }
-        free(entry->fields);
-        free(entry->values);
-        free(entry);
     }
 }
+
+// --- Keyed row restore ---
+
+int layout_plan_init(LayoutPlan* plan, const char* layout) {
+    memset(plan, 0, sizeof(LayoutPlan));
+    if (layout[0] == ENVELOPE_CRI_TAG || layout[0] == ENVELOPE_DOCKER_TAG) plan->envelope = *layout++;
+    if (layout[0] == SPEC_LAYOUT_TAG) {
+        plan->spec = format_spec_compile(layout + 1, NULL);
+        if (!plan->spec) return 0;
+        plan->count = plan->spec->count;
+        plan->fields = malloc(sizeof(char*) * (plan->count ? plan->count : 1));
+        for (size_t k = 0; k < plan->count; k++) plan->fields[k] = strdup(plan->spec->fields[k].name);
+    } else if (layout[0] == LOGFMT_LAYOUT_TAG) {
+        plan->count = logfmt_layout_keys(layout, &plan->fields);
+        plan->body = layout + 1;
+    } else if (layout[0] == PARSER_SPAN_TAG) {
+        plan->count = span_layout_fields(layout, &plan->fields);
+        plan->body = layout + 2;
+    } else {
+        plan->count = json_layout_paths(layout, &plan->fields);
+        plan->body = layout;
+    }
+    return 1;
+}
+
+char* layout_plan_render(const LayoutPlan* plan, const char* const* values, const char* const* envelope) {
+    char* line = plan->spec ? format_spec_render(plan->spec, values) : json_restore(plan->body, values, plan->count);
+    if (plan->envelope) {
+        char* payload = line;
+        line = envelope_render(plan->envelope, envelope[0], envelope[1], envelope[2], payload);
+        free(payload);
+    }
+    return line;
+}
+
+void layout_plan_free(LayoutPlan* plan) {
+    if (plan->fields) json_paths_free(plan->fields, plan->count);
+    format_spec_free(plan->spec);
+    memset(plan, 0, sizeof(LayoutPlan));
+}
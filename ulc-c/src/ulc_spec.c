@@ -0,0 +1,358 @@
+#include "../include/ulc_spec.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+
+// Fields typed without a hint
+static const char* const spec_int_names[] = {
+    "status", "body_bytes_sent", "bytes_sent", "request_length", "connection",
+    "connection_requests", "pid", "server_port", "remote_port", NULL
+};
+static const char* const spec_ip_names[] = {
+    "remote_addr", "server_addr", "realip_remote_addr", "remote_host", NULL
+};
+
+static int in_list(const char* const* list, const char* name) {
+    for (size_t i = 0; list[i]; i++) {
+        if (strcmp(list[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+static ColumnType default_type(const char* name) {
+    if (in_list(spec_int_names, name)) return COL_TYPE_INT;
+    if (in_list(spec_ip_names, name)) return COL_TYPE_IP;
+    return COL_TYPE_STRING;
+}
+
+static char* copy_span(const char* s, size_t len) {
+    char* out = malloc(len + 1);
+    memcpy(out, s, len);
+    out[len] = '\0';
+    return out;
+}
+
+static char* spec_error(const char* message, const char* detail) {
+    char* out = malloc(strlen(message) + strlen(detail) + 4);
+    if (detail[0]) sprintf(out, "%s: %s", message, detail);
+    else strcpy(out, message);
+    return out;
+}
+
+// Canonical decimal that survives strtoll + "%lld"
+static int is_canonical_int(const char* s, size_t len) {
+    const char* p = s;
+    if (len > 0 && *p == '-') { p++; len--; }
+    if (len == 0 || len > 18 || (p[0] == '0' && (len > 1 || p != s))) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] < '0' || p[i] > '9') return 0;
+    }
+    return 1;
+}
+
+// Builder state: literal text collects until the next field closes it
+typedef struct {
+    FormatSpec* spec;
+    size_t capacity;
+    char* literal;
+    size_t literal_len;
+    size_t literal_cap;
+} SpecBuilder;
+
+static void builder_char(SpecBuilder* b, char c) {
+    if (b->literal_len + 1 >= b->literal_cap) {
+        b->literal_cap = b->literal_cap ? b->literal_cap * 2 : 32;
+        b->literal = realloc(b->literal, b->literal_cap);
+    }
+    b->literal[b->literal_len++] = c;
+}
+
+static char* builder_take_literal(SpecBuilder* b, size_t* len) {
+    *len = b->literal_len;
+    char* out = copy_span(b->literal ? b->literal : "", b->literal_len);
+    b->literal_len = 0;
+    return out;
+}
+
+static const char* builder_field(SpecBuilder* b, char* name, ColumnType type) {
+    FormatSpec* spec = b->spec;
+    for (size_t i = 0; i < spec->count; i++) {
+        if (strcmp(spec->fields[i].name, name) == 0) {
+            free(name);
+            return "duplicate field";
+        }
+    }
+    if (spec->count >= SPEC_MAX_FIELDS) {
+        free(name);
+        return "too many fields";
+    }
+    if (spec->count > 0) {
+        if (b->literal_len == 0) {
+            free(name);
+            return "fields without text between them";
+        }
+        SpecField* prev = &spec->fields[spec->count - 1];
+        prev->literal = builder_take_literal(b, &prev->literal_len);
+    } else {
+        spec->prefix = builder_take_literal(b, &spec->prefix_len);
+    }
+    if (spec->count >= b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 16;
+        spec->fields = realloc(spec->fields, b->capacity * sizeof(SpecField));
+    }
+    SpecField* field = &spec->fields[spec->count++];
+    field->name = name;
+    field->type = type;
+    field->literal = NULL;
+    field->literal_len = 0;
+    return NULL;
+}
+
+static int is_name_char(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static int parse_hint(const char* hint, size_t len, ColumnType* type) {
+    if (len == 3 && strncmp(hint, "int", 3) == 0) *type = COL_TYPE_INT;
+    else if (len == 2 && strncmp(hint, "ip", 2) == 0) *type = COL_TYPE_IP;
+    else if ((len == 3 && strncmp(hint, "str", 3) == 0) ||
+             (len == 6 && strncmp(hint, "string", 6) == 0)) *type = COL_TYPE_STRING;
+    else return 0;
+    return 1;
+}
+
+// nginx: $name, ${name} or ${name:type}
+static const char* compile_nginx(SpecBuilder* b, const char* text, char* detail) {
+    const char* p = text;
+    while (*p) {
+        if (*p != '$') {
+            builder_char(b, *p++);
+            continue;
+        }
+        p++;
+        const char* name = p;
+        size_t name_len = 0;
+        if (*p == '{') {
+            name = ++p;
+            while (is_name_char(*p)) p++;
+            name_len = p - name;
+            const char* hint = NULL;
+            if (*p == ':') {
+                hint = ++p;
+                while (*p && *p != '}') p++;
+            }
+            if (*p != '}') return "unterminated ${";
+            if (name_len == 0) return "empty field name";
+            char* owned = copy_span(name, name_len);
+            ColumnType type = default_type(owned);
+            if (hint && !parse_hint(hint, p - hint, &type)) {
+                snprintf(detail, 64, "%.*s", (int)(p - hint), hint);
+                free(owned);
+                return "unknown type";
+            }
+            p++;
+            const char* err = builder_field(b, owned, type);
+            if (err) return err;
+        } else {
+            while (is_name_char(*p)) p++;
+            name_len = p - name;
+            if (name_len == 0) {
+                builder_char(b, '$');
+                continue;
+            }
+            char* owned = copy_span(name, name_len);
+            const char* err = builder_field(b, owned, default_type(owned));
+            if (err) return err;
+        }
+    }
+    return NULL;
+}
+
+// Apache LogFormat directives and the field each becomes
+static const struct {
+    const char* directive;
+    const char* name;
+    ColumnType type;
+} apache_directives[] = {
+    {"h", "remote_host", COL_TYPE_IP},
+    {"a", "remote_addr", COL_TYPE_IP},
+    {"A", "local_addr", COL_TYPE_IP},
+    {"l", "ident", COL_TYPE_STRING},
+    {"u", "remote_user", COL_TYPE_STRING},
+    {"t", "time", COL_TYPE_STRING},
+    {"r", "request", COL_TYPE_STRING},
+    {"s", "status", COL_TYPE_INT},
+    {">s", "status", COL_TYPE_INT},
+    {"b", "bytes", COL_TYPE_STRING},        // "-" for an empty body
+    {"B", "bytes", COL_TYPE_INT},
+    {"D", "duration_us", COL_TYPE_INT},
+    {"T", "duration", COL_TYPE_INT},
+    {"p", "server_port", COL_TYPE_INT},
+    {"P", "pid", COL_TYPE_INT},
+    {"m", "method", COL_TYPE_STRING},
+    {"U", "path", COL_TYPE_STRING},
+    {"q", "query", COL_TYPE_STRING},
+    {"H", "protocol", COL_TYPE_STRING},
+    {"v", "server_name", COL_TYPE_STRING},
+    {"V", "server_name", COL_TYPE_STRING},
+    {NULL, NULL, COL_TYPE_STRING}
+};
+
+// Apache: %h, %>s, %{Header}i, %{Header}o, %{Cookie}C, %%
+static const char* compile_apache(SpecBuilder* b, const char* text, char* detail) {
+    const char* p = text;
+    while (*p) {
+        if (*p == '\\' && p[1] == '"') p++;     // \" as written in httpd.conf
+        if (*p != '%') {
+            builder_char(b, *p++);
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            builder_char(b, *p++);
+            continue;
+        }
+        if (*p == '{') {
+            const char* arg = ++p;
+            while (*p && *p != '}') p++;
+            if (*p != '}' || p == arg) return "unterminated %{";
+            size_t arg_len = p - arg;
+            p++;
+            const char* prefix;
+            if (*p == 'i') prefix = "http_";
+            else if (*p == 'o') prefix = "sent_http_";
+            else if (*p == 'C') prefix = "cookie_";
+            else {
+                snprintf(detail, 64, "%%{%.*s}%c", (int)arg_len, arg, *p ? *p : ' ');
+                return "unknown directive";
+            }
+            p++;
+            size_t prefix_len = strlen(prefix);
+            char* owned = malloc(prefix_len + arg_len + 1);
+            memcpy(owned, prefix, prefix_len);
+            for (size_t i = 0; i < arg_len; i++) {
+                char c = (char)tolower((unsigned char)arg[i]);
+                owned[prefix_len + i] = is_name_char(c) ? c : '_';
+            }
+            owned[prefix_len + arg_len] = '\0';
+            const char* err = builder_field(b, owned, COL_TYPE_STRING);
+            if (err) return err;
+            continue;
+        }
+        size_t len = (*p == '>' || *p == '<') ? 2 : 1;
+        size_t i = 0;
+        while (apache_directives[i].directive &&
+               (strlen(apache_directives[i].directive) != len ||
+                strncmp(apache_directives[i].directive, p, len) != 0)) i++;
+        if (!apache_directives[i].directive) {
+            snprintf(detail, 64, "%%%.*s", (int)len, *p ? p : " ");
+            return "unknown directive";
+        }
+        p += len;
+        const char* err = builder_field(b, strdup(apache_directives[i].name), apache_directives[i].type);
+        if (err) return err;
+    }
+    return NULL;
+}
+
+FormatSpec* format_spec_compile(const char* text, char** error) {
+    SpecBuilder b = {0};
+    b.spec = calloc(1, sizeof(FormatSpec));
+    b.spec->text = strdup(text);
+    char detail[64] = "";
+    const char* err = strchr(text, '$') ? compile_nginx(&b, text, detail) : compile_apache(&b, text, detail);
+    if (!err && b.spec->count == 0) err = text[0] ? "no fields" : "empty spec";
+    if (!err) {
+        SpecField* last = &b.spec->fields[b.spec->count - 1];
+        last->literal = builder_take_literal(&b, &last->literal_len);
+    }
+    free(b.literal);
+    if (err) {
+        format_spec_free(b.spec);
+        if (error) *error = spec_error(err, detail[0] ? detail : text);
+        return NULL;
+    }
+    return b.spec;
+}
+
+FormatSpec* format_spec_load(const char* path, char** error) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        if (error) *error = spec_error("cannot open format spec", path);
+        return NULL;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+        fclose(f);
+        return format_spec_compile(line, error);
+    }
+    fclose(f);
+    if (error) *error = spec_error("empty format spec", path);
+    return NULL;
+}
+
+void format_spec_free(FormatSpec* spec) {
+    if (!spec) return;
+    for (size_t i = 0; i < spec->count; i++) {
+        free(spec->fields[i].name);
+        free(spec->fields[i].literal);
+    }
+    free(spec->fields);
+    free(spec->prefix);
+    free(spec->text);
+    free(spec);
+}
+
+int format_spec_match(const FormatSpec* spec, const char* line, size_t* starts, size_t* lengths) {
+    size_t line_len = strlen(line);
+    if (line_len < spec->prefix_len || memcmp(line, spec->prefix, spec->prefix_len) != 0) return 0;
+    size_t pos = spec->prefix_len;
+    for (size_t i = 0; i < spec->count; i++) {
+        const SpecField* field = &spec->fields[i];
+        size_t end;
+        if (i + 1 == spec->count) {
+            // The trailing text closes the line
+            if (line_len - pos < field->literal_len) return 0;
+            end = line_len - field->literal_len;
+            if (memcmp(line + end, field->literal, field->literal_len) != 0) return 0;
+        } else {
+            const char* hit = strstr(line + pos, field->literal);
+            if (!hit) return 0;
+            end = hit - line;
+        }
+        if (field->type == COL_TYPE_INT && !is_canonical_int(line + pos, end - pos)) return 0;
+        starts[i] = pos;
+        lengths[i] = end - pos;
+        pos = end + field->literal_len;
+    }
+    return 1;
+}
+
+char* format_spec_render(const FormatSpec* spec, const char* const* values) {
+    size_t len = spec->prefix_len;
+    for (size_t i = 0; i < spec->count; i++) {
+        len += strlen(values[i]) + spec->fields[i].literal_len;
+    }
+    char* out = malloc(len + 1);
+    memcpy(out, spec->prefix, spec->prefix_len);
+    size_t pos = spec->prefix_len;
+    for (size_t i = 0; i < spec->count; i++) {
+        size_t value_len = strlen(values[i]);
+        memcpy(out + pos, values[i], value_len);
+        pos += value_len;
+        memcpy(out + pos, spec->fields[i].literal, spec->fields[i].literal_len);
+        pos += spec->fields[i].literal_len;
+    }
+    out[pos] = '\0';
+    return out;
+}
+
+int format_spec_type(const FormatSpec* spec, const char* name) {
+    for (size_t i = 0; i < spec->count; i++) {
+        if (strcmp(spec->fields[i].name, name) == 0) return spec->fields[i].type;
+    }
+    return -1;
+}
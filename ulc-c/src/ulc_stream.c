@@ -0,0 +1,308 @@
+#include "../include/ulc_stream.h"
+#include "../include/ulc_varint.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <lzma.h>
+
+// Delta distances tried for STREAM_DELTA: bytes, 32-bit and 64-bit values
+static const uint8_t delta_distances[] = {1, 4, 8};
+#define DELTA_CHOICES (sizeof(delta_distances) / sizeof(delta_distances[0]))
+
+// Window sized to the group (encoder memory follows it); the decoder
+// derives the same size from the directory
+static uint32_t stream_dict_size(size_t len) {
+    uint32_t size = LZMA_DICT_SIZE_MIN;
+    while (size < len && size < (64u << 20)) size <<= 1;
+    return size;
+}
+
+// Filter chain of a backend: [delta] + LZMA2
+static void stream_filters(uint8_t codec, uint8_t distance, uint32_t preset, size_t len,
+                           lzma_options_lzma* opt, lzma_options_delta* delta, lzma_filter* filters) {
+    lzma_lzma_preset(opt, preset);
+    opt->dict_size = stream_dict_size(len);
+    opt->lc = codec == STREAM_TEXT ? 4 : 0;
+    opt->lp = 0;
+    opt->pb = 0;
+    size_t f = 0;
+    if (codec == STREAM_DELTA) {
+        memset(delta, 0, sizeof(*delta));
+        delta->type = LZMA_DELTA_TYPE_BYTE;
+        delta->dist = distance;
+        filters[f].id = LZMA_FILTER_DELTA;
+        filters[f++].options = delta;
+    }
+    filters[f].id = LZMA_FILTER_LZMA2;
+    filters[f++].options = opt;
+    filters[f].id = LZMA_VLI_UNKNOWN;
+    filters[f].options = NULL;
+}
+
+// Raw LZMA2 (no container: the directory carries what the decoder needs);
+// returns 0 when the output would not fit in capacity
+static size_t stream_encode(uint8_t codec, uint8_t distance, uint32_t preset, const uint8_t* data, size_t len,
+                            uint8_t* out, size_t capacity) {
+    lzma_options_lzma opt;
+    lzma_options_delta delta;
+    lzma_filter filters[3];
+    stream_filters(codec, distance, preset, len, &opt, &delta, filters);
+    size_t out_pos = 0;
+    if (lzma_raw_buffer_encode(filters, NULL, data, len, out, &out_pos, capacity) != LZMA_OK) return 0;
+    return out_pos;
+}
+
+typedef struct {
+    const uint8_t* data;      // Group bytes (encoder input / decoder output)
+    uint8_t* raw;             // Decoder output
+    size_t len;
+    uint8_t* out;             // Coded group (encoder output)
+    size_t out_len;
+    const uint8_t* packed;    // Coded group (decoder input)
+    size_t packed_len;
+    uint8_t codec;
+    uint8_t distance;
+    int failed;
+} StreamJob;
+
+// Try each backend on the head of the group at a fast preset, then code
+// the whole group with the winner; store when nothing beats the raw bytes
+static void* stream_encode_worker(void* arg) {
+    StreamJob* job = arg;
+    size_t probe = job->len < STREAM_PROBE ? job->len : STREAM_PROBE;
+    size_t probe_capacity = probe + probe / 2 + 1024;
+    uint8_t* scratch = malloc(probe_capacity);
+
+    job->codec = STREAM_STORE;
+    job->distance = 0;
+    size_t best = probe;
+    for (uint8_t codec = STREAM_TEXT; codec < STREAM_CODECS; codec++) {
+        size_t choices = codec == STREAM_DELTA ? DELTA_CHOICES : 1;
+        for (size_t d = 0; d < choices; d++) {
+            uint8_t distance = codec == STREAM_DELTA ? delta_distances[d] : 0;
+            size_t size = stream_encode(codec, distance, 1, job->data, probe, scratch, probe_capacity);
+            if (size > 0 && size < best) {
+                best = size;
+                job->codec = codec;
+                job->distance = distance;
+            }
+        }
+    }
+    free(scratch);
+
+    size_t capacity = job->len + job->len / 2 + 1024;
+    job->out = malloc(capacity);
+    job->out_len = 0;
+    if (job->codec != STREAM_STORE) {
+        job->out_len = stream_encode(job->codec, job->distance, 9 | LZMA_PRESET_EXTREME,
+                                     job->data, job->len, job->out, capacity);
+    }
+    if (job->out_len == 0 || job->out_len >= job->len) {
+        job->codec = STREAM_STORE;
+        job->distance = 0;
+        memcpy(job->out, job->data, job->len);
+        job->out_len = job->len;
+    }
+    return NULL;
+}
+
+static void* stream_decode_worker(void* arg) {
+    StreamJob* job = arg;
+    if (job->codec == STREAM_STORE) {
+        job->failed = job->packed_len != job->len;
+        if (!job->failed) memcpy(job->raw, job->packed, job->len);
+        return NULL;
+    }
+    lzma_options_lzma opt;
+    lzma_options_delta delta;
+    lzma_filter filters[3];
+    stream_filters(job->codec, job->distance, 0, job->len, &opt, &delta, filters);
+    size_t in_pos = 0, out_pos = 0;
+    lzma_ret ret = lzma_raw_buffer_decode(filters, NULL, job->packed, &in_pos, job->packed_len,
+                                          job->raw, &out_pos, job->len);
+    job->failed = ret != LZMA_OK || out_pos != job->len;
+    return NULL;
+}
+
+// Run jobs in waves of STREAM_THREADS
+static void run_jobs(StreamJob* jobs, size_t count, void* (*worker)(void*)) {
+    pthread_t threads[STREAM_THREADS];
+    for (size_t b = 0; b < count; b += STREAM_THREADS) {
+        size_t wave = count - b < STREAM_THREADS ? count - b : STREAM_THREADS;
+        if (wave == 1) {
+            worker(&jobs[b]);
+            continue;
+        }
+        for (size_t t = 0; t < wave; t++) pthread_create(&threads[t], NULL, worker, &jobs[b + t]);
+        for (size_t t = 0; t < wave; t++) pthread_join(threads[t], NULL);
+    }
+}
+
+// Layout: magic, varint part count, varint length per part, varint group
+// count, then per group varint part count, codec byte, delta distance byte
+// (STREAM_DELTA only) and varint coded length; coded groups follow
+
+uint8_t* streams_compress(const uint8_t* data, size_t len, const size_t* sections, size_t section_count,
+                          size_t* codec_counts, size_t* out_len) {
+    size_t part_count = section_count + 1;
+    size_t* parts = malloc(sizeof(size_t) * part_count);
+    size_t prev = 0;
+    for (size_t p = 0; p < part_count; p++) {
+        size_t end = p < section_count ? sections[p] : len;
+        parts[p] = end - prev;
+        prev = end;
+    }
+
+    // Groups: parts in order, closed once they reach STREAM_GROUP_MIN
+    StreamJob* jobs = calloc(part_count, sizeof(StreamJob));
+    size_t* group_parts = calloc(part_count, sizeof(size_t));
+    size_t group_count = 0, start = 0;
+    for (size_t p = 0; p < part_count; p++) {
+        if (group_parts[group_count] == 0) {
+            jobs[group_count].data = data + start;
+            jobs[group_count].len = 0;
+        }
+        jobs[group_count].len += parts[p];
+        group_parts[group_count]++;
+        start += parts[p];
+        if (jobs[group_count].len >= STREAM_GROUP_MIN || p + 1 == part_count) group_count++;
+    }
+    run_jobs(jobs, group_count, stream_encode_worker);
+
+    size_t total = STREAM_MAGIC_LEN + 10 * (2 + part_count + 3 * group_count);
+    for (size_t g = 0; g < group_count; g++) total += jobs[g].out_len;
+    uint8_t* out = malloc(total);
+    size_t n = 0;
+    memcpy(out, STREAM_MAGIC, STREAM_MAGIC_LEN);
+    n += STREAM_MAGIC_LEN;
+    n += put_varint(out + n, part_count);
+    for (size_t p = 0; p < part_count; p++) n += put_varint(out + n, parts[p]);
+    n += put_varint(out + n, group_count);
+    if (codec_counts) memset(codec_counts, 0, sizeof(size_t) * STREAM_CODECS);
+    for (size_t g = 0; g < group_count; g++) {
+        n += put_varint(out + n, group_parts[g]);
+        out[n++] = jobs[g].codec;
+        if (jobs[g].codec == STREAM_DELTA) out[n++] = jobs[g].distance;
+        n += put_varint(out + n, jobs[g].out_len);
+        if (codec_counts) codec_counts[jobs[g].codec]++;
+    }
+    for (size_t g = 0; g < group_count; g++) {
+        memcpy(out + n, jobs[g].out, jobs[g].out_len);
+        n += jobs[g].out_len;
+        free(jobs[g].out);
+    }
+    free(jobs);
+    free(group_parts);
+    free(parts);
+
+    *out_len = n;
+    return out;
+}
+
+// Directory of a stream: part lengths, and per group its parts, raw offset
+// and coded bytes. Returns the group count
+typedef struct {
+    size_t part_count;
+    size_t* parts;
+    size_t total;
+    size_t group_count;
+    size_t* group_parts;
+    StreamJob* jobs;          // Per group: len, codec, distance, packed
+    size_t end;               // Offset just past the last coded group
+} StreamDirectory;
+
+static void directory_read(const uint8_t* data, StreamDirectory* dir) {
+    size_t offset = STREAM_MAGIC_LEN;
+    dir->part_count = get_varint(data, &offset);
+    dir->parts = malloc(sizeof(size_t) * (dir->part_count + 1));
+    dir->total = 0;
+    for (size_t p = 0; p < dir->part_count; p++) {
+        dir->parts[p] = get_varint(data, &offset);
+        dir->total += dir->parts[p];
+    }
+    dir->group_count = get_varint(data, &offset);
+    dir->group_parts = malloc(sizeof(size_t) * (dir->group_count + 1));
+    dir->jobs = calloc(dir->group_count + 1, sizeof(StreamJob));
+    size_t part = 0;
+    for (size_t g = 0; g < dir->group_count; g++) {
+        dir->group_parts[g] = get_varint(data, &offset);
+        dir->jobs[g].codec = data[offset++];
+        if (dir->jobs[g].codec == STREAM_DELTA) dir->jobs[g].distance = data[offset++];
+        dir->jobs[g].packed_len = get_varint(data, &offset);
+        for (size_t k = 0; k < dir->group_parts[g] && part < dir->part_count; k++) {
+            dir->jobs[g].len += dir->parts[part++];
+        }
+    }
+    for (size_t g = 0; g < dir->group_count; g++) {
+        dir->jobs[g].packed = data + offset;
+        offset += dir->jobs[g].packed_len;
+    }
+    dir->end = offset;
+}
+
+static void directory_free(StreamDirectory* dir) {
+    free(dir->parts);
+    free(dir->group_parts);
+    free(dir->jobs);
+}
+
+uint8_t* streams_decompress(const uint8_t* data, size_t len, size_t* consumed, size_t* out_len) {
+    StreamDirectory dir;
+    directory_read(data, &dir);
+    if (dir.end > len) {
+        directory_free(&dir);
+        return NULL;
+    }
+
+    uint8_t* out = malloc(dir.total + 1);
+    size_t start = 0;
+    for (size_t g = 0; g < dir.group_count; g++) {
+        dir.jobs[g].raw = out + start;
+        start += dir.jobs[g].len;
+    }
+    run_jobs(dir.jobs, dir.group_count, stream_decode_worker);
+
+    int failed = 0;
+    for (size_t g = 0; g < dir.group_count; g++) failed |= dir.jobs[g].failed;
+    out[dir.total] = 0;
+    *consumed = dir.end;
+    *out_len = dir.total;
+    directory_free(&dir);
+    if (failed) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+uint8_t* streams_extract(const uint8_t* data, size_t len, size_t part, size_t* out_len) {
+    StreamDirectory dir;
+    directory_read(data, &dir);
+    if (dir.end > len || part >= dir.part_count) {
+        directory_free(&dir);
+        return NULL;
+    }
+
+    // Group holding the part, and where the part sits in it
+    size_t g = 0, first = 0, skip = 0;
+    while (g < dir.group_count && first + dir.group_parts[g] <= part) first += dir.group_parts[g++];
+    for (size_t p = first; p < part; p++) skip += dir.parts[p];
+
+    uint8_t* group = malloc(dir.jobs[g].len + 1);
+    dir.jobs[g].raw = group;
+    stream_decode_worker(&dir.jobs[g]);
+    uint8_t* out = NULL;
+    if (!dir.jobs[g].failed) {
+        out = malloc(dir.parts[part] + 1);
+        memcpy(out, group + skip, dir.parts[part]);
+        out[dir.parts[part]] = 0;
+        *out_len = dir.parts[part];
+    }
+    free(group);
+    directory_free(&dir);
+    return out;
+}
+
+int streams_is_stream(const uint8_t* data, size_t len) {
+    return len >= STREAM_MAGIC_LEN && memcmp(data, STREAM_MAGIC, STREAM_MAGIC_LEN) == 0;
+}
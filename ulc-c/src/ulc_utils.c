@@ -1,8 +1,8 @@
 #include "../include/ulc_utils.h"
+#include "../include/ulc_addr.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <time.h>
 
 // String implementation
 String* string_new(size_t initial_capacity) {
@@ -105,6 +105,68 @@ void dict_free(Dictionary* dict) {
     }
 }
 
+// Schema implementation
+static uint32_t schema_hash(const char* name) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) h = (h ^ *p) * 16777619u;
+    return h;
+}
+
+void schema_init(Schema* schema) {
+    schema->capacity = 64;
+    schema->names = malloc(sizeof(char*) * schema->capacity);
+    schema->count = 0;
+    schema->slot_count = 128;
+    schema->slots = malloc(sizeof(int) * schema->slot_count);
+    memset(schema->slots, -1, sizeof(int) * schema->slot_count);
+}
+
+// Slot of name, or of the empty slot where it belongs
+static size_t schema_slot(const Schema* schema, const char* name) {
+    size_t mask = schema->slot_count - 1;
+    size_t slot = schema_hash(name) & mask;
+    while (schema->slots[slot] >= 0 && strcmp(schema->names[schema->slots[slot]], name) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+int schema_intern(Schema* schema, const char* name) {
+    size_t slot = schema_slot(schema, name);
+    if (schema->slots[slot] >= 0) return schema->slots[slot];
+    
+    if (schema->count == schema->capacity) {
+        schema->capacity *= 2;
+        schema->names = realloc(schema->names, sizeof(char*) * schema->capacity);
+    }
+    int id = (int)schema->count++;
+    schema->names[id] = strdup(name);
+    schema->slots[slot] = id;
+    
+    // Keep the table at most half full
+    if (schema->count * 2 > schema->slot_count) {
+        free(schema->slots);
+        schema->slot_count *= 2;
+        schema->slots = malloc(sizeof(int) * schema->slot_count);
+        memset(schema->slots, -1, sizeof(int) * schema->slot_count);
+        for (size_t i = 0; i < schema->count; i++) {
+            schema->slots[schema_slot(schema, schema->names[i])] = (int)i;
+        }
+    }
+    return id;
+}
+
+int schema_find(const Schema* schema, const char* name) {
+    return schema->slots[schema_slot(schema, name)];
+}
+
+void schema_free(Schema* schema) {
+    for (size_t i = 0; i < schema->count; i++) free(schema->names[i]);
+    free(schema->names);
+    free(schema->slots);
+}
+
 // Varint encoding
 void encode_varint(ByteArray* out, uint64_t value) {
     while (value >= 0x80) {
@@ -177,54 +239,200 @@ void decode_delta(const uint8_t* data, size_t data_len, int64_t** out_values, si
     }
 }
 
-// Timestamp parsing (simplified - handles common formats)
-int64_t parse_timestamp(const char* ts_str) {
-    // Try ISO format: 2025-02-01T10:00:00.070Z
-    struct tm tm_info = {0};
-    int year, month, day, hour, min, sec, usec = 0;
+// Timestamp parsing
+static const char* const month_names[12] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static const int64_t fraction_scale[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// Days since 1970-01-01 of a proleptic Gregorian date, and back
+static int64_t days_from_civil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yoe = year - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(int64_t days, int64_t* year, int* month, int* day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = yoe + era * 400 + (*month <= 2);
+}
+
+// Value of n decimal digits, or -1
+static int read_digits(const char* p, int n) {
+    int value = 0;
+    for (int i = 0; i < n; i++) {
+        if (p[i] < '0' || p[i] > '9') return -1;
+        value = value * 10 + (p[i] - '0');
+    }
+    return value;
+}
+
+static int read_month(const char* p) {
+    for (int i = 0; i < 12; i++) {
+        if (strncmp(p, month_names[i], 3) == 0) return i + 1;
+    }
+    return -1;
+}
+
+int timestamp_parse(const char* text, TimestampShape* shape, int64_t* ticks) {
+    memset(shape, 0, sizeof(TimestampShape));
+    size_t len = strlen(text);
+    if (len >= TIMESTAMP_MAX_TEXT) return 0;
     
-    if (sscanf(ts_str, "%d-%d-%dT%d:%d:%d.%dZ", &year, &month, &day, &hour, &min, &sec, &usec) >= 6) {
-        tm_info.tm_year = year - 1900;
-        tm_info.tm_mon = month - 1;
-        tm_info.tm_mday = day;
-        tm_info.tm_hour = hour;
-        tm_info.tm_min = min;
-        tm_info.tm_sec = sec;
-        time_t t = mktime(&tm_info);
-        return (int64_t)t * 1000000LL + usec;
+    const char* p = text;
+    int year, month, day;
+    if (len >= 19 && p[4] == '-' && p[7] == '-' && (p[10] == 'T' || p[10] == ' ')) {
+        shape->kind = TS_SHAPE_ISO;
+        shape->sep = p[10];
+        year = read_digits(p, 4);
+        month = read_digits(p + 5, 2);
+        day = read_digits(p + 8, 2);
+        p += 11;
+    } else if (len >= 20 && p[2] == '/' && p[6] == '/' && p[11] == ':') {
+        shape->kind = TS_SHAPE_CLF;
+        day = read_digits(p, 2);
+        month = read_month(p + 3);
+        year = read_digits(p + 7, 4);
+        p += 12;
+    } else if (len >= 14 && p[3] == ' ' && (month = read_month(p)) > 0) {
+        // No year: 2000 is a leap year, so Feb 29 stays a date. Days pad
+        // to two characters with a space ("Nov  5") unless a one-digit day
+        // says otherwise
+        shape->kind = TS_SHAPE_SYSLOG;
+        int unpadded = p[4] != ' ' && p[5] == ' ';
+        shape->sep = unpadded ? 0 : ' ';
+        year = 2000;
+        day = unpadded ? read_digits(p + 4, 1) : read_digits(p + 4 + (p[4] == ' '), 2 - (p[4] == ' '));
+        p += unpadded ? 6 : 7;
+        if (p[-1] != ' ') return 0;
+    } else {
+        return 0;
     }
     
-    // Try simple date-time: 2025-11-24 18:55:22
-    if (sscanf(ts_str, "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &min, &sec) == 6) {
-        tm_info.tm_year = year - 1900;
-        tm_info.tm_mon = month - 1;
-        tm_info.tm_mday = day;
-        tm_info.tm_hour = hour;
-        tm_info.tm_min = min;
-        tm_info.tm_sec = sec;
-        time_t t = mktime(&tm_info);
-        return (int64_t)t * 1000000LL;
+    if (strlen(p) < 8 || p[2] != ':' || p[5] != ':') return 0;
+    int hour = read_digits(p, 2), min = read_digits(p + 3, 2), sec = read_digits(p + 6, 2);
+    p += 8;
+    if (year < 0 || month < 1 || day < 1 || hour < 0 || min < 0 || sec < 0) return 0;
+    
+    int fraction = 0;
+    if (shape->kind == TS_SHAPE_ISO && (*p == '.' || *p == ',')) {
+        shape->point = *p++;
+        while (shape->digits < 9 && p[shape->digits] >= '0' && p[shape->digits] <= '9') shape->digits++;
+        if (shape->digits == 0) return 0;
+        fraction = read_digits(p, shape->digits);
+        p += shape->digits;
     }
     
-    // Try time only: 08:00:01
-    if (sscanf(ts_str, "%d:%d:%d", &hour, &min, &sec) == 3) {
-        time_t now = time(NULL);
-        struct tm* now_tm = localtime(&now);
-        now_tm->tm_hour = hour;
-        now_tm->tm_min = min;
-        now_tm->tm_sec = sec;
-        time_t t = mktime(now_tm);
-        return (int64_t)t * 1000000LL;
+    // Zone text, constant within a column
+    size_t suffix_len = strlen(p);
+    if (suffix_len >= sizeof(shape->suffix) || (shape->kind == TS_SHAPE_SYSLOG && suffix_len > 0)) return 0;
+    for (size_t i = 0; i < suffix_len; i++) {
+        if (!strchr("Z+-: 0123456789", p[i])) return 0;
     }
+    memcpy(shape->suffix, p, suffix_len + 1);
     
-    return 0;
+    int64_t seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + min * 60 + sec;
+    if (seconds > INT64_MAX / fraction_scale[shape->digits] - 1 || seconds < INT64_MIN / fraction_scale[shape->digits] + 1) {
+        return 0;
+    }
+    *ticks = seconds * fraction_scale[shape->digits] + fraction;
+    
+    // Out-of-range fields (Feb 30, 25:00) normalize and no longer match
+    char check[TIMESTAMP_MAX_TEXT];
+    return timestamp_format(shape, *ticks, check) == len && memcmp(check, text, len) == 0;
+}
+
+// Zero-padded decimal of value into out, width digits
+static char* put_digits(char* out, int64_t value, int width) {
+    for (int i = width - 1; i >= 0; i--) {
+        out[i] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    return out + width;
+}
+
+size_t timestamp_format(const TimestampShape* shape, int64_t ticks, char* out) {
+    int digits = shape->digits < 10 ? shape->digits : 0;
+    int64_t scale = fraction_scale[digits];
+    int64_t seconds = ticks / scale, fraction = ticks % scale;
+    if (fraction < 0) {
+        fraction += scale;
+        seconds--;
+    }
+    int64_t days = seconds / 86400, rem = seconds % 86400;
+    if (rem < 0) {
+        rem += 86400;
+        days--;
+    }
+    int64_t year;
+    int month, day;
+    civil_from_days(days, &year, &month, &day);
+    
+    // Years outside 0000-9999 never parse; they come only from corrupt input
+    if (year < 0 || year > 9999) year = 0;
+    char* p = out;
+    if (shape->kind == TS_SHAPE_ISO) {
+        p = put_digits(p, year, 4);
+        *p++ = '-';
+        p = put_digits(p, month, 2);
+        *p++ = '-';
+        p = put_digits(p, day, 2);
+        *p++ = shape->sep;
+    } else if (shape->kind == TS_SHAPE_CLF) {
+        p = put_digits(p, day, 2);
+        *p++ = '/';
+        memcpy(p, month_names[month - 1], 3);
+        p += 3;
+        *p++ = '/';
+        p = put_digits(p, year, 4);
+        *p++ = ':';
+    } else {
+        memcpy(p, month_names[month - 1], 3);
+        p += 3;
+        *p++ = ' ';
+        if (day < 10 && shape->sep) *p++ = ' ';
+        p = put_digits(p, day, day < 10 ? 1 : 2);
+        *p++ = ' ';
+    }
+    p = put_digits(p, rem / 3600, 2);
+    *p++ = ':';
+    p = put_digits(p, rem / 60 % 60, 2);
+    *p++ = ':';
+    p = put_digits(p, rem % 60, 2);
+    if (shape->kind == TS_SHAPE_ISO && digits > 0) {
+        *p++ = shape->point;
+        p = put_digits(p, fraction, digits);
+    }
+    size_t suffix_len = strlen(shape->suffix);
+    memcpy(p, shape->suffix, suffix_len);
+    p += suffix_len;
+    *p = '\0';
+    return (size_t)(p - out);
+}
+
+int timestamp_shape_equal(const TimestampShape* a, const TimestampShape* b) {
+    return a->kind == b->kind && a->digits == b->digits && a->sep == b->sep && a->point == b->point &&
+           strcmp(a->suffix, b->suffix) == 0;
 }
 
-// IP parsing
+// IP parsing (IPv4 only, see ulc_addr.h for mixed-family columns)
 uint32_t parse_ip(const char* ip_str) {
-    unsigned int a, b, c, d;
-    if (sscanf(ip_str, "%u.%u.%u.%u", &a, &b, &c, &d) == 4) {
-        return (a << 24) | (b << 16) | (c << 8) | d;
+    Address addr;
+    if (addr_parse(ip_str, strlen(ip_str), &addr) && addr.family == ADDR_FAMILY_V4) {
+        return (uint32_t)addr.lo;
     }
     return 0;
 }
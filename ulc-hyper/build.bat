@@ -1,5 +1,5 @@
 @echo off
-gcc -O3 -I./include src/ulc_hyper_compress.c src/ulc_hyper_cli.c -o ulc-hyper.exe -llzma
+gcc -O3 -I./include -I../ulc-c/include src/ulc_hyper_compress.c src/ulc_hyper_binary.c src/ulc_hyper_cli.c ../ulc-c/src/ulc_addr.c ../ulc-c/src/ulc_arena.c ../ulc-c/src/ulc_cm.c ../ulc-c/src/ulc_frame.c ../ulc-c/src/ulc_stream.c -o ulc-hyper.exe -llzma -lpthread -lm
 if %errorlevel% neq 0 (
     echo Build failed!
     exit /b %errorlevel%
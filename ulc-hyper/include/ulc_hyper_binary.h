@@ -0,0 +1,38 @@
+#ifndef ULC_HYPER_BINARY_H
+#define ULC_HYPER_BINARY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary token formats (low nibble of the format descriptor)
+typedef enum {
+    BIN_FORMAT_NONE = 0,
+    BIN_FORMAT_HEX,      // Even-length hex string (hashes, trace ids)
+    BIN_FORMAT_UUID,     // 8-4-4-4-12 hex
+    BIN_FORMAT_BASE64    // Base64 blob (session tokens)
+} BinFormat;
+
+// Variant flags (high nibble of the format descriptor)
+#define BIN_FLAG_UPPER   0x10  // Upper-case hex digits
+#define BIN_FLAG_URLSAFE 0x20  // Base64 with '-' and '_'
+#define BIN_FLAG_PADDED  0x40  // Base64 with '=' padding
+
+// Format descriptor that reproduces this token exactly, 0 if none
+uint8_t bintoken_detect(const char* str, size_t len);
+
+// Pack a token with the given descriptor (out needs len bytes); returns the
+// packed length or -1 when the token would not render back byte for byte
+int bintoken_pack(uint8_t format, const char* str, size_t len, uint8_t* out);
+
+// Render packed bytes back to text (out needs 2 * len + 5 bytes), returns length
+size_t bintoken_render(uint8_t format, const uint8_t* data, size_t len, char* out);
+
+// Same format with its variant flipped (hex case, base64 padding), so a
+// column can mix both spellings with one bit per row
+uint8_t bintoken_alternate(uint8_t format);
+
+// Pick one descriptor for a column sample; 0 when under 90% of the values
+// pack with it or its alternate
+uint8_t bintoken_choose_format(const char** values, size_t count);
+
+#endif // ULC_HYPER_BINARY_H
@@ -7,6 +7,14 @@
 int hyper_compress_file(const char* input_path, const char* output_path, 
                        size_t* orig_size, size_t* comp_size, double* duration);
 
+// Compression flags
+#define HYPER_MAX 1      // Context-mixing backend when it is smaller
+#define HYPER_EXPLAIN 2  // Print each column's encoding and candidate costs
+
+// Compression with HYPER_* flags
+int hyper_compress_file_ex(const char* input_path, const char* output_path, int flags,
+                           size_t* orig_size, size_t* comp_size, double* duration);
+
 // Main decompression function
 int hyper_decompress_file(const char* input_path, const char* output_path, 
                          double* duration);
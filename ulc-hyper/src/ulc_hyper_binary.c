@@ -0,0 +1,218 @@
+#include "../include/ulc_hyper_binary.h"
+#include <string.h>
+
+#define BIN_MIN_HEX_LEN 16
+#define BIN_MIN_BASE64_LEN 12
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+static const char b64_std[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char b64_url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Hex digit value honoring the column case, -1 on mismatch
+static int hex_value(char c, int upper) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (!upper && c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (upper && c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int b64_value(char c, int url_safe) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == (url_safe ? '-' : '+')) return 62;
+    if (c == (url_safe ? '_' : '/')) return 63;
+    return -1;
+}
+
+static int pack_hex(const char* str, size_t len, int upper, uint8_t* out) {
+    if (len % 2) return -1;
+    for (size_t i = 0; i < len; i += 2) {
+        int hi = hex_value(str[i], upper);
+        int lo = hex_value(str[i + 1], upper);
+        if (hi < 0 || lo < 0) return -1;
+        out[i / 2] = (uint8_t)((hi << 4) | lo);
+    }
+    return (int)(len / 2);
+}
+
+static int pack_uuid(const char* str, size_t len, int upper, uint8_t* out) {
+    if (len != 36 || str[8] != '-' || str[13] != '-' || str[18] != '-' || str[23] != '-') return -1;
+    int n = 0;
+    for (size_t i = 0; i < 36; ) {
+        if (str[i] == '-') { i++; continue; }
+        int hi = hex_value(str[i], upper);
+        int lo = hex_value(str[i + 1], upper);
+        if (hi < 0 || lo < 0) return -1;
+        out[n++] = (uint8_t)((hi << 4) | lo);
+        i += 2;
+    }
+    return n;
+}
+
+static int pack_base64(const char* str, size_t len, int url_safe, int padded, uint8_t* out) {
+    size_t data_len = len;
+    if (padded) {
+        if (len % 4) return -1;
+        while (data_len > 0 && len - data_len < 2 && str[data_len - 1] == '=') data_len--;
+    }
+    if (data_len % 4 == 1) return -1;
+
+    int n = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < data_len; i++) {
+        int v = b64_value(str[i], url_safe);
+        if (v < 0) return -1;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    // Non-zero leftover bits would not survive re-encoding
+    if (acc & ((1u << bits) - 1)) return -1;
+    return n;
+}
+
+int bintoken_pack(uint8_t format, const char* str, size_t len, uint8_t* out) {
+    int upper = (format & BIN_FLAG_UPPER) != 0;
+    switch (format & 0x0F) {
+        case BIN_FORMAT_HEX:
+            return pack_hex(str, len, upper, out);
+        case BIN_FORMAT_UUID:
+            return pack_uuid(str, len, upper, out);
+        case BIN_FORMAT_BASE64:
+            return pack_base64(str, len, (format & BIN_FLAG_URLSAFE) != 0,
+                               (format & BIN_FLAG_PADDED) != 0, out);
+        default:
+            return -1;
+    }
+}
+
+size_t bintoken_render(uint8_t format, const uint8_t* data, size_t len, char* out) {
+    const char* digits = (format & BIN_FLAG_UPPER) ? hex_upper : hex_lower;
+    size_t n = 0;
+
+    switch (format & 0x0F) {
+        case BIN_FORMAT_HEX:
+            for (size_t i = 0; i < len; i++) {
+                out[n++] = digits[data[i] >> 4];
+                out[n++] = digits[data[i] & 0x0F];
+            }
+            break;
+        case BIN_FORMAT_UUID:
+            for (size_t i = 0; i < len; i++) {
+                if (i == 4 || i == 6 || i == 8 || i == 10) out[n++] = '-';
+                out[n++] = digits[data[i] >> 4];
+                out[n++] = digits[data[i] & 0x0F];
+            }
+            break;
+        case BIN_FORMAT_BASE64: {
+            const char* alphabet = (format & BIN_FLAG_URLSAFE) ? b64_url : b64_std;
+            size_t i = 0;
+            for (; i + 3 <= len; i += 3) {
+                uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+                out[n++] = alphabet[(v >> 18) & 63];
+                out[n++] = alphabet[(v >> 12) & 63];
+                out[n++] = alphabet[(v >> 6) & 63];
+                out[n++] = alphabet[v & 63];
+            }
+            if (i < len) {
+                uint32_t v = (uint32_t)data[i] << 16;
+                if (i + 1 < len) v |= (uint32_t)data[i + 1] << 8;
+                out[n++] = alphabet[(v >> 18) & 63];
+                out[n++] = alphabet[(v >> 12) & 63];
+                if (i + 1 < len) out[n++] = alphabet[(v >> 6) & 63];
+                else if (format & BIN_FLAG_PADDED) out[n++] = '=';
+                if (format & BIN_FLAG_PADDED) out[n++] = '=';
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+uint8_t bintoken_detect(const char* str, size_t len) {
+    int has_lower = 0, has_upper = 0, has_digit = 0, has_other = 0;
+    int has_std = 0, has_url = 0, has_pad = 0, all_hex = 1;
+    for (size_t i = 0; i < len; i++) {
+        char c = str[i];
+        if (c >= '0' && c <= '9') has_digit = 1;
+        else if (c >= 'a' && c <= 'z') { has_lower = 1; if (c > 'f') all_hex = 0; }
+        else if (c >= 'A' && c <= 'Z') { has_upper = 1; if (c > 'F') all_hex = 0; }
+        else if (c == '+' || c == '/') { has_std = 1; all_hex = 0; }
+        else if (c == '_') { has_url = 1; all_hex = 0; }
+        else if (c == '-') { has_url = 1; if (len != 36) all_hex = 0; }
+        else if (c == '=') { has_pad = 1; all_hex = 0; }
+        else { has_other = 1; all_hex = 0; }
+    }
+    if (has_other) return 0;
+
+    uint8_t hex_case = (has_upper && !has_lower) ? BIN_FLAG_UPPER : 0;
+    uint8_t scratch[64];
+    if (all_hex && !(has_lower && has_upper) && len <= 2 * sizeof(scratch)) {
+        uint8_t format = BIN_FORMAT_UUID | hex_case;
+        if (len == 36 && bintoken_pack(format, str, len, scratch) == 16) return format;
+        format = BIN_FORMAT_HEX | hex_case;
+        if (len >= BIN_MIN_HEX_LEN && bintoken_pack(format, str, len, scratch) >= 0) return format;
+    }
+
+    if (len < BIN_MIN_BASE64_LEN || (has_std && has_url)) return 0;
+    // Plain words are not tokens: require digits or mixed case
+    if (!has_digit && !(has_lower && has_upper)) return 0;
+    uint8_t format = BIN_FORMAT_BASE64 | (has_url ? BIN_FLAG_URLSAFE : 0) | (has_pad ? BIN_FLAG_PADDED : 0);
+    uint8_t buf[512];
+    if (len > sizeof(buf) || bintoken_pack(format, str, len, buf) < 0) return 0;
+    return format;
+}
+
+uint8_t bintoken_alternate(uint8_t format) {
+    if ((format & 0x0F) == BIN_FORMAT_BASE64) return format ^ BIN_FLAG_PADDED;
+    return format ^ BIN_FLAG_UPPER;
+}
+
+uint8_t bintoken_choose_format(const char** values, size_t count) {
+    uint8_t candidates[8];
+    size_t candidate_count = 0;
+    size_t non_empty = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t len = strlen(values[i]);
+        if (len == 0) continue;
+        non_empty++;
+        uint8_t format = bintoken_detect(values[i], len);
+        if (!format) continue;
+        int known = 0;
+        for (size_t k = 0; k < candidate_count; k++) {
+            if (candidates[k] == format) known = 1;
+        }
+        if (!known && candidate_count < 8) candidates[candidate_count++] = format;
+    }
+    if (non_empty == 0) return 0;
+
+    // A descriptor may also cover values that detected differently
+    // (digit-only hex, the other case, unpadded base64 of full quanta)
+    uint8_t best = 0;
+    size_t best_hits = 0;
+    uint8_t buf[1024];
+    for (size_t k = 0; k < candidate_count; k++) {
+        size_t hits = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t len = strlen(values[i]);
+            if (len == 0 || len > sizeof(buf)) continue;
+            if (bintoken_pack(candidates[k], values[i], len, buf) >= 0 ||
+                bintoken_pack(bintoken_alternate(candidates[k]), values[i], len, buf) >= 0) hits++;
+        }
+        if (hits > best_hits) {
+            best = candidates[k];
+            best_hits = hits;
+        }
+    }
+    return (best_hits * 10 >= non_empty * 9) ? best : 0;
+}
@@ -5,7 +5,7 @@
 
 int main(int argc, char** argv) {
     if (argc < 4) {
-        printf("Usage: ulc-hyper <compress|decompress> <input> -o <output>\n");
+        printf("Usage: ulc-hyper <compress|decompress> <input> -o <output> [--max] [--explain]\n");
         return 1;
     }
     
@@ -16,7 +16,12 @@ int main(int argc, char** argv) {
     if (strcmp(mode, "compress") == 0) {
         size_t orig, comp;
         double duration;
-        if (hyper_compress_file(input, output, &orig, &comp, &duration) == 0) {
+        int flags = 0;
+        for (int i = 5; i < argc; i++) {
+            if (strcmp(argv[i], "--max") == 0) flags |= HYPER_MAX;
+            else if (strcmp(argv[i], "--explain") == 0) flags |= HYPER_EXPLAIN;
+        }
+        if (hyper_compress_file_ex(input, output, flags, &orig, &comp, &duration) == 0) {
             printf("Compressed: %zu -> %zu bytes (%.2fx) in %.3fs\n", 
                    orig, comp, (double)orig/comp, duration);
         } else {
@@ -1,15 +1,25 @@
 #include "../include/ulc_hyper_compress.h"
 #include "../include/ulc_hyper_types.h"
+#include "../include/ulc_hyper_binary.h"
+#include "../../ulc-c/include/ulc_addr.h"
+#include "../../ulc-c/include/ulc_arena.h"
+#include "../../ulc-c/include/ulc_cm.h"
+#include "../../ulc-c/include/ulc_frame.h"
+#include "../../ulc-c/include/ulc_stream.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <math.h>
 #include <lzma.h>
 
 #define HYPER_MAGIC "ULCH"
 #define HYPER_MAGIC_LEN 4
 
+// In place of the column count: rows are clustered by shape
+#define HYPER_CLUSTERED UINT64_MAX
+
 // --- Utilities ---
 
 typedef struct {
@@ -61,6 +71,18 @@ uint64_t decode_varint(const uint8_t* data, size_t* offset) {
     return value;
 }
 
+static uint64_t hash_bytes(const char* s, size_t len) {
+    // FNV-1a, then a 64-bit finalizer so every bit is mixed
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)s[i]) * 1099511628211ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
 // --- Dictionary ---
 
 typedef struct {
@@ -68,80 +90,300 @@ typedef struct {
     int id;
 } DictEntry;
 
+// Keys live in the arena the dictionary was made with. slots index the
+// entries by key hash (open addressing, kept at most half full), so
+// dictionaries of 100K+ entries build in linear time
 typedef struct {
     DictEntry* entries;
     size_t count;
     size_t capacity;
+    int* slots;
+    size_t slot_count;
+    Arena* arena;
 } Dictionary;
 
-Dictionary* dict_new(size_t cap) {
+Dictionary* dict_new(size_t cap, Arena* arena) {
     Dictionary* d = malloc(sizeof(Dictionary));
     d->capacity = cap > 0 ? cap : 128;
     d->entries = malloc(sizeof(DictEntry) * d->capacity);
     d->count = 0;
+    d->slot_count = 64;
+    while (d->slot_count < 2 * d->capacity) d->slot_count *= 2;
+    d->slots = malloc(sizeof(int) * d->slot_count);
+    memset(d->slots, -1, sizeof(int) * d->slot_count);
+    d->arena = arena;
     return d;
 }
 
+// Slot of key, or of the empty slot where it belongs
+static size_t dict_slot(const Dictionary* d, const char* key, size_t len) {
+    size_t mask = d->slot_count - 1;
+    size_t slot = hash_bytes(key, len) & mask;
+    while (d->slots[slot] >= 0 && strcmp(d->entries[d->slots[slot]].key, key) != 0) slot = (slot + 1) & mask;
+    return slot;
+}
+
 int dict_get_or_add(Dictionary* d, const char* key) {
-    for (size_t i = 0; i < d->count; i++) {
-        if (strcmp(d->entries[i].key, key) == 0) return d->entries[i].id;
-    }
+    size_t len = strlen(key);
+    size_t slot = dict_slot(d, key, len);
+    if (d->slots[slot] >= 0) return d->entries[d->slots[slot]].id;
     if (d->count >= d->capacity) {
         d->capacity *= 2;
         d->entries = realloc(d->entries, sizeof(DictEntry) * d->capacity);
     }
-    d->entries[d->count].key = strdup(key);
+    d->entries[d->count].key = arena_strndup(d->arena, key, len);
     d->entries[d->count].id = d->count;
-    return d->count++;
+    d->slots[slot] = (int)d->count;
+    
+    if (++d->count * 2 > d->slot_count) {
+        free(d->slots);
+        d->slot_count *= 2;
+        d->slots = malloc(sizeof(int) * d->slot_count);
+        memset(d->slots, -1, sizeof(int) * d->slot_count);
+        for (size_t i = 0; i < d->count; i++) {
+            const char* k = d->entries[i].key;
+            d->slots[dict_slot(d, k, strlen(k))] = (int)i;
+        }
+    }
+    return d->entries[d->count - 1].id;
 }
 
 void dict_free(Dictionary* d) {
     if (d) {
-        for(size_t i=0; i<d->count; i++) free(d->entries[i].key);
         free(d->entries);
+        free(d->slots);
         free(d);
     }
 }
 
+// Large dictionaries may be written sorted and front coded: each entry is
+// the length of the prefix it shares with the entry before, then the rest
+// of its bytes. Ids then refer to sorted positions, which also keeps the
+// entries binary-searchable. Front-coded dictionaries have encoding types
+// of their own (columns 9 and 10, sub-columns 8 and 9), so streams written
+// before them still read as they were
+#define FRONT_CODE_MIN_ENTRIES 256
+
+static int dict_entry_compare(const void* a, const void* b) {
+    return strcmp(((const DictEntry*)a)->key, ((const DictEntry*)b)->key);
+}
+
+// Entries of a dictionary: the count, then each entry. remap[id] is set to
+// the id the entry is written under
+static void encode_dict_entries(ByteArray* out, const Dictionary* d, int front_coded, uint32_t* remap) {
+    encode_varint(out, d->count);
+    if (!front_coded) {
+        for (size_t k = 0; k < d->count; k++) {
+            size_t len = strlen(d->entries[k].key);
+            encode_varint(out, len);
+            bytearray_append(out, d->entries[k].key, len);
+            remap[k] = (uint32_t)k;
+        }
+        return;
+    }
+    DictEntry* sorted = malloc(sizeof(DictEntry) * (d->count ? d->count : 1));
+    memcpy(sorted, d->entries, sizeof(DictEntry) * d->count);
+    qsort(sorted, d->count, sizeof(DictEntry), dict_entry_compare);
+    const char* prev = "";
+    for (size_t k = 0; k < d->count; k++) {
+        const char* key = sorted[k].key;
+        size_t shared = 0;
+        while (prev[shared] && prev[shared] == key[shared]) shared++;
+        size_t rest = strlen(key + shared);
+        encode_varint(out, shared);
+        encode_varint(out, rest);
+        bytearray_append(out, key + shared, rest);
+        remap[sorted[k].id] = (uint32_t)k;
+        prev = key;
+    }
+    free(sorted);
+}
+
+// Entries written by encode_dict_entries, rebuilt back to back in one
+// arena buffer: a first pass over the lengths sizes it, a second fills it
+static char** decode_dict_entries(const uint8_t* data, size_t* offset, Arena* arena, int front_coded,
+                                  uint64_t* count) {
+    *count = decode_varint(data, offset);
+    char** dict = malloc(sizeof(char*) * (*count ? *count : 1));
+
+    size_t pos = *offset, total = 0;
+    for (uint64_t k = 0; k < *count; k++) {
+        uint64_t shared = front_coded ? decode_varint(data, &pos) : 0;
+        uint64_t rest = decode_varint(data, &pos);
+        total += shared + rest + 1;
+        pos += rest;
+    }
+    char* buffer = arena_alloc(arena, total ? total : 1);
+
+    const char* prev = buffer;
+    for (uint64_t k = 0; k < *count; k++) {
+        uint64_t shared = front_coded ? decode_varint(data, offset) : 0;
+        uint64_t rest = decode_varint(data, offset);
+        memcpy(buffer, prev, shared);
+        memcpy(buffer + shared, data + *offset, rest);
+        buffer[shared + rest] = '\0';
+        *offset += rest;
+        dict[k] = buffer;
+        prev = buffer;
+        buffer += shared + rest + 1;
+    }
+    return dict;
+}
+
+static size_t varint_size(uint64_t value) {
+    size_t n = 1;
+    while (value >= 0x80) { value >>= 7; n++; }
+    return n;
+}
+
+// Frame-of-reference bit packing: [min][width][packed bits, LSB first]
+static void encode_bitpacked(ByteArray* out, const uint64_t* values, size_t count) {
+    uint64_t min = UINT64_MAX, max = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+    if (count == 0) min = 0;
+    uint8_t width = 0;
+    while (width < 64 && ((max - min) >> width) != 0) width++;
+    
+    encode_varint(out, min);
+    bytearray_append(out, &width, 1);
+    
+    uint64_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t v = values[i] - min;
+        for (int b = 0; b < width; ) {
+            int take = width - b;
+            if (take > 64 - bits) take = 64 - bits;
+            uint64_t part = (take == 64) ? v : ((v >> b) & ((1ULL << take) - 1));
+            acc |= part << bits;
+            bits += take;
+            b += take;
+            if (bits == 64) {
+                bytearray_append(out, &acc, 8);
+                acc = 0;
+                bits = 0;
+            }
+        }
+    }
+    while (bits > 0) {
+        uint8_t byte = (uint8_t)acc;
+        bytearray_append(out, &byte, 1);
+        acc >>= 8;
+        bits -= 8;
+    }
+}
+
+static void decode_bitpacked(const uint8_t* data, size_t* offset, uint64_t* values, size_t count) {
+    uint64_t min = decode_varint(data, offset);
+    uint8_t width = data[(*offset)++];
+    size_t bit_pos = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t v = 0;
+        for (int b = 0; b < width; b++, bit_pos++) {
+            v |= (uint64_t)((data[*offset + bit_pos / 8] >> (bit_pos % 8)) & 1) << b;
+        }
+        values[i] = v + min;
+    }
+    *offset += (bit_pos + 7) / 8;
+}
+
+// Binary token rows: varint(n << 2 | alt << 1) + packed bytes, or
+// varint(len << 2 | 1) + text. alt selects the alternate case/padding.
+static void encode_binary_token(ByteArray* out, uint8_t format, const char* val) {
+    size_t len = strlen(val);
+    uint8_t stack_buf[256];
+    uint8_t* packed = len <= sizeof(stack_buf) ? stack_buf : malloc(len);
+    uint64_t alt = 0;
+    int n = bintoken_pack(format, val, len, packed);
+    if (n < 0) {
+        n = bintoken_pack(bintoken_alternate(format), val, len, packed);
+        alt = 1;
+    }
+    if (n >= 0) {
+        encode_varint(out, ((uint64_t)n << 2) | (alt << 1));
+        bytearray_append(out, packed, n);
+    } else {
+        encode_varint(out, ((uint64_t)len << 2) | 1);
+        bytearray_append(out, val, len);
+    }
+    if (packed != stack_buf) free(packed);
+}
+
+static char* decode_binary_token(Arena* arena, uint8_t format, const uint8_t* data, size_t* offset) {
+    uint64_t header = decode_varint(data, offset);
+    size_t len = header >> 2;
+    char* val;
+    if (header & 1) {
+        val = arena_strndup(arena, (const char*)data + *offset, len);
+    } else {
+        val = arena_alloc(arena, 2 * len + 5);
+        bintoken_render((header & 2) ? bintoken_alternate(format) : format, data + *offset, len, val);
+    }
+    *offset += len;
+    return val;
+}
+
+// Sample up to 100 values for binary token detection
+#define BINARY_SAMPLE 100
+
 // --- Tokenization ---
 
-TokenStream* tokenize_field(const char* field) {
-    TokenStream* ts = malloc(sizeof(TokenStream));
-    ts->capacity = 8;
-    ts->tokens = malloc(sizeof(Token) * ts->capacity);
+// Canonical decimal (no sign, no leading zeros) that fits an int64 and round-trips via %llu
+static int is_numeric_token(const char* s, size_t len) {
+    if (len == 0 || len > 18) return 0;
+    if (s[0] == '0' && len > 1) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') return 0;
+    }
+    return 1;
+}
+
+static TokenType classify_token(const char* s, size_t len) {
+    if (is_numeric_token(s, len)) return TOKEN_TYPE_NUMERIC;
+    Address addr;
+    if (memchr(s, '.', len) && addr_parse(s, len, &addr)) return TOKEN_TYPE_IP;
+    return TOKEN_TYPE_LITERAL;
+}
+
+static int is_token_delim(char c) {
+    return c == '/' || c == ' ' || c == '?' || c == '&' || c == '=' || c == ':' || c == '[' || c == ']' ||
+           c == '"' || c == '\0';
+}
+
+// Delimiter tokens point into this table: one "c\0" pair per byte value
+static char delim_text[512];
+
+// Tokens and their values are allocated from the arena: a field of n
+// delimiters has at most 2n + 1 tokens, so the array is sized up front
+TokenStream* tokenize_field(Arena* arena, const char* field, size_t len) {
+    size_t delims = 0;
+    for (size_t i = 0; i < len; i++) delims += is_token_delim(field[i]);
+    
+    TokenStream* ts = arena_alloc(arena, sizeof(TokenStream));
+    ts->capacity = 2 * delims + 1;
+    ts->tokens = arena_alloc(arena, sizeof(Token) * ts->capacity);
     ts->count = 0;
     
-    size_t len = strlen(field);
     size_t start = 0;
-    
     for (size_t i = 0; i <= len; i++) {
         char c = field[i];
-        int is_delim = (c == '/' || c == ' ' || c == '?' || c == '&' || c == '=' || c == ':' || c == '[' || c == ']' || c == '"' || c == '\0');
-        
-        if (is_delim) {
+        if (is_token_delim(c)) {
             // Add preceding token if exists
             if (i > start) {
-                if (ts->count >= ts->capacity) {
-                    ts->capacity *= 2;
-                    ts->tokens = realloc(ts->tokens, sizeof(Token) * ts->capacity);
-                }
                 size_t tok_len = i - start;
-                ts->tokens[ts->count].value = malloc(tok_len + 1);
-                memcpy(ts->tokens[ts->count].value, field + start, tok_len);
-                ts->tokens[ts->count].value[tok_len] = '\0';
-                ts->tokens[ts->count].type = TOKEN_TYPE_LITERAL; // Refine later
+                ts->tokens[ts->count].value = arena_strndup(arena, field + start, tok_len);
+                ts->tokens[ts->count].type = classify_token(field + start, tok_len);
                 ts->count++;
             }
             
             // Add delimiter as token (unless it's null terminator)
             if (c != '\0') {
-                if (ts->count >= ts->capacity) {
-                    ts->capacity *= 2;
-                    ts->tokens = realloc(ts->tokens, sizeof(Token) * ts->capacity);
-                }
-                ts->tokens[ts->count].value = malloc(2);
-                ts->tokens[ts->count].value[0] = c;
-                ts->tokens[ts->count].value[1] = '\0';
+                char* text = delim_text + 2 * (unsigned char)c;
+                text[0] = c;
+                ts->tokens[ts->count].value = text;
                 ts->tokens[ts->count].type = TOKEN_TYPE_DELIMITER;
                 ts->count++;
             }
@@ -151,173 +393,767 @@ TokenStream* tokenize_field(const char* field) {
     return ts;
 }
 
-void tokenstream_free(TokenStream* ts) {
-    if (ts) {
-        for(size_t i=0; i<ts->count; i++) free(ts->tokens[i].value);
-        free(ts->tokens);
-        free(ts);
+// --- Column Analysis ---
+
+// HyperLogLog: distinct-value estimates in 4 KB per column, ~1.6% error
+#define HLL_BITS 12
+#define HLL_REGISTERS (1 << HLL_BITS)
+
+typedef struct {
+    uint8_t registers[HLL_REGISTERS];
+} HyperLogLog;
+
+static void hll_add(HyperLogLog* hll, uint64_t hash) {
+    size_t reg = hash >> (64 - HLL_BITS);
+    uint64_t rest = hash << HLL_BITS;
+    uint8_t rank = 1;
+    while (rank <= 64 - HLL_BITS && !(rest & (1ULL << 63))) {
+        rest <<= 1;
+        rank++;
     }
+    if (rank > hll->registers[reg]) hll->registers[reg] = rank;
 }
 
-// --- Compression Engine ---
+static double hll_estimate(const HyperLogLog* hll) {
+    double m = HLL_REGISTERS;
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (size_t r = 0; r < HLL_REGISTERS; r++) {
+        sum += ldexp(1.0, -hll->registers[r]);
+        if (hll->registers[r] == 0) zeros++;
+    }
+    double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+    // Small range: linear counting is near exact
+    if (estimate <= 2.5 * m && zeros > 0) estimate = m * log(m / zeros);
+    return estimate;
+}
 
-int hyper_compress_file(const char* input_path, const char* output_path, 
-                       size_t* orig_size, size_t* comp_size, double* duration) {
-    clock_t start = clock();
-    
-    FILE* fp = fopen(input_path, "r");
-    if (!fp) return -1;
-    
-    // Read lines
-    char** lines = NULL;
-    size_t line_count = 0;
-    size_t line_cap = 1024;
-    lines = malloc(sizeof(char*) * line_cap);
-    char buf[16384];
-    size_t total_bytes = 0;
+// What one pass over a major column tells the encoder
+typedef struct {
+    size_t non_empty;
+    size_t integers;        // Values that delta-code back exactly
+    size_t addresses;       // Values the address codec takes
+    double distinct;        // Estimated distinct non-empty values
+    int constant;           // Every row holds the same bytes
+} ColumnStats;
+
+// Whether a value prints back unchanged through strtoll and %lld
+static int is_canonical_int(const char* s, size_t len) {
+    const char* p = (len > 0 && *s == '-') ? s + 1 : s;
+    size_t digits = len - (p - s);
+    if (digits == 0 || digits > 18 || (p[0] == '0' && (digits > 1 || p != s))) return 0;
+    for (size_t i = 0; i < digits; i++) {
+        if (p[i] < '0' || p[i] > '9') return 0;
+    }
+    return 1;
+}
+
+// Exact dictionary of a column's non-empty values
+static Dictionary* column_dict(const StringColumn* col, Arena* arena) {
+    Dictionary* dict = dict_new(256, arena);
+    for (size_t i = 0; i < col->count; i++) {
+        if (string_column_length(col, i) > 0) dict_get_or_add(dict, string_column_value(col, i));
+    }
+    return dict;
+}
+
+static void analyze_column(const StringColumn* col, ColumnStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    HyperLogLog* values = calloc(1, sizeof(HyperLogLog));
+    stats->constant = col->count > 0;
+    const char* first = col->count ? string_column_value(col, 0) : NULL;
+    size_t first_len = col->count ? string_column_length(col, 0) : 0;
     
-    while (fgets(buf, sizeof(buf), fp)) {
-        size_t len = strlen(buf);
-        if (len > 0 && buf[len-1] == '\n') buf[len-1] = '\0';
-        if (len > 1 && buf[len-2] == '\r') buf[len-2] = '\0';
-        total_bytes += strlen(buf) + 1;
+    for (size_t i = 0; i < col->count; i++) {
+        const char* val = string_column_value(col, i);
+        size_t len = string_column_length(col, i);
+        if (stats->constant && (len != first_len || memcmp(val, first, len) != 0)) stats->constant = 0;
+        if (string_column_missing(col, i) || len == 0) continue;
+        stats->non_empty++;
+        hll_add(values, hash_bytes(val, len));
         
-        if (line_count >= line_cap) {
-            line_cap *= 2;
-            lines = realloc(lines, sizeof(char*) * line_cap);
-        }
-        lines[line_count++] = strdup(buf);
+        Address addr;
+        if (is_canonical_int(val, len)) stats->integers++;
+        if (addr_parse(val, len, &addr)) stats->addresses++;
     }
-    fclose(fp);
-    *orig_size = total_bytes;
     
-    printf("ULC-Hyper: Semantic Decomposition\n");
-    printf("Parsing %zu lines...\n", line_count);
+    stats->distinct = stats->non_empty ? hll_estimate(values) : 0.0;
+    free(values);
+}
+
+// Exact dictionary of sub-column sc of the token streams
+static Dictionary* token_dict(TokenStream** streams, size_t count, size_t sc, Arena* arena) {
+    Dictionary* dict = dict_new(256, arena);
+    for (size_t i = 0; i < count; i++) {
+        if (sc < streams[i]->count) dict_get_or_add(dict, streams[i]->tokens[sc].value);
+    }
+    return dict;
+}
+
+// --- Cost Model ---
+
+// Every encoding that applies to a column is costed on a sample of its
+// values: the sample is encoded, sized by coded_size (a greedy LZ parse
+// with order-0 literals, standing in for the LZMA stage) and scaled to the
+// whole column. The cheapest
+// candidate is the one written. The sample is runs of consecutive values
+// spread over the column, so deltas stay local
+#define COST_RUNS 8
+#define COST_RUN_ROWS 512
+
+typedef enum {
+    CAND_RAW,
+    CAND_DICT,
+    CAND_DELTA,
+    CAND_PACKED,
+    CAND_ADDRESS,
+    CAND_BINARY,
+    CAND_DECOMPOSED,
+    CAND_CONSTANT,
+    CAND_RUNS,
+    CAND_COUNT
+} Candidate;
+
+static const char* candidate_names[CAND_COUNT] = {
+    "raw", "dict", "delta", "packed", "address", "binary", "decomposed", "constant", "runs"
+};
+
+// Encoding ids the candidates are written as (-1: not offered)
+static const int major_encodings[CAND_COUNT] = {4, 1, 2, -1, 5, 6, 0, 7, 8};
+static const int sub_encodings[CAND_COUNT] = {0, 1, 2, 3, 4, 5, -1, 6, 7};
+
+// Values in the order an encoder writes them
+typedef struct {
+    const char** values;
+    size_t* lengths;
+    size_t count;
+} ValueList;
+
+// Estimated bytes per candidate (< 0 when it does not apply) and the pick
+typedef struct {
+    double cost[CAND_COUNT];
+    Candidate best;
+} CostReport;
+
+static void value_list_init(ValueList* list, size_t capacity) {
+    list->values = malloc(sizeof(char*) * (capacity ? capacity : 1));
+    list->lengths = malloc(sizeof(size_t) * (capacity ? capacity : 1));
+    list->count = 0;
+}
+
+static void value_list_free(ValueList* list) {
+    free(list->values);
+    free(list->lengths);
+}
+
+// The sample of a list: all of it when short, else COST_RUNS runs
+static void value_list_sample(const ValueList* list, ValueList* sample) {
+    if (list->count <= COST_RUNS * COST_RUN_ROWS) {
+        value_list_init(sample, list->count);
+        memcpy(sample->values, list->values, sizeof(char*) * list->count);
+        memcpy(sample->lengths, list->lengths, sizeof(size_t) * list->count);
+        sample->count = list->count;
+        return;
+    }
+    value_list_init(sample, COST_RUNS * COST_RUN_ROWS);
+    for (size_t r = 0; r < COST_RUNS; r++) {
+        size_t start = r * (list->count - COST_RUN_ROWS) / (COST_RUNS - 1);
+        memcpy(sample->values + sample->count, list->values + start, sizeof(char*) * COST_RUN_ROWS);
+        memcpy(sample->lengths + sample->count, list->lengths + start, sizeof(size_t) * COST_RUN_ROWS);
+        sample->count += COST_RUN_ROWS;
+    }
+}
+
+// Size of a buffer after an LZ + entropy coder, estimated: a greedy parse
+// finds repeats through a hash of the next LZ_MIN_MATCH bytes, each repeat
+// costs LZ_MATCH_COST bytes and the literals their order-0 entropy
+#define LZ_MIN_MATCH 4
+#define LZ_MATCH_COST 2.0
+
+static double coded_size(const uint8_t* data, size_t len) {
+    int bits = 10;
+    while (bits < 16 && ((size_t)1 << bits) < len) bits++;
+    uint32_t* table = calloc((size_t)1 << bits, sizeof(uint32_t)); // Position + 1
+    size_t counts[256] = {0};
+    size_t literals = 0, matches = 0;
+    for (size_t i = 0; i < len; ) {
+        size_t match = 0;
+        if (i + LZ_MIN_MATCH <= len) {
+            uint32_t key;
+            memcpy(&key, data + i, sizeof(key));
+            uint32_t h = (key * 2654435761u) >> (32 - bits);
+            size_t prev = table[h];
+            table[h] = (uint32_t)(i + 1);
+            if (prev && memcmp(data + prev - 1, data + i, LZ_MIN_MATCH) == 0) {
+                match = LZ_MIN_MATCH;
+                while (i + match < len && data[prev - 1 + match] == data[i + match]) match++;
+            }
+        }
+        if (match) {
+            matches++;
+            // Positions inside the repeat stay findable
+            for (size_t k = i + 1; k < i + match && k + LZ_MIN_MATCH <= len; k++) {
+                uint32_t key;
+                memcpy(&key, data + k, sizeof(key));
+                table[(key * 2654435761u) >> (32 - bits)] = (uint32_t)(k + 1);
+            }
+            i += match;
+        } else {
+            counts[data[i++]]++;
+            literals++;
+        }
+    }
+    free(table);
+    double literal_bits = 0.0;
+    for (int s = 0; s < 256; s++) {
+        if (counts[s]) literal_bits -= counts[s] * log2((double)counts[s] / literals);
+    }
+    return literal_bits / 8.0 + matches * LZ_MATCH_COST;
+}
+
+static double cost_raw(const ValueList* sample, double scale) {
+    ByteArray* out = bytearray_new(4096);
+    for (size_t i = 0; i < sample->count; i++) {
+        encode_varint(out, sample->lengths[i]);
+        bytearray_append(out, sample->values[i], sample->lengths[i]);
+    }
+    double cost = coded_size(out->data, out->length) * scale;
+    bytearray_free(out);
+    return cost;
+}
+
+typedef struct {
+    const char* value;
+    size_t len;
+} Slice;
+
+static int slice_compare(const void* a, const void* b) {
+    const Slice* x = a;
+    const Slice* y = b;
+    int c = memcmp(x->value, y->value, x->len < y->len ? x->len : y->len);
+    if (c) return c;
+    return (x->len > y->len) - (x->len < y->len);
+}
+
+// Entries once each plus ids at the value distribution's entropy, one per
+// row or `ids` of them when given (> 0). The sample's dictionary grows to
+// the column's distinct count: the estimate when there is one
+// (distinct >= 0), else Good-Turing, where each value past the sample is
+// new at the rate the sample saw values only once
+static double cost_dict(const ValueList* sample, double scale, double distinct, double ids) {
+    size_t n = sample->count;
+    if (n == 0) return 1.0;
+    Slice* slices = malloc(sizeof(Slice) * n);
+    for (size_t i = 0; i < n; i++) {
+        slices[i].value = sample->values[i];
+        slices[i].len = sample->lengths[i];
+    }
+    qsort(slices, n, sizeof(Slice), slice_compare);
     
-    // 1. Initial Parse (Space separated for now, ULC-C style)
-    // We will treat each space-separated part as a "Major Column"
-    // Then decompose each Major Column into "Minor Columns" (Tokens)
+    ByteArray* entries = bytearray_new(4096);
+    double id_bits = 0.0;
+    size_t kinds = 0, singles = 0;
+    for (size_t i = 0; i < n; ) {
+        size_t j = i + 1;
+        while (j < n && slice_compare(&slices[i], &slices[j]) == 0) j++;
+        id_bits -= (j - i) * log2((double)(j - i) / n);
+        kinds++;
+        if (j - i == 1) singles++;
+        encode_varint(entries, slices[i].len);
+        bytearray_append(entries, slices[i].value, slices[i].len);
+        i = j;
+    }
     
-    size_t max_cols = 0;
-    char*** grid = malloc(sizeof(char**) * line_count);
-    size_t* col_counts = malloc(sizeof(size_t) * line_count);
+    double rows = n * scale;
+    if (distinct < 0) distinct = kinds + (rows - n) * singles / n;
+    if (distinct < kinds) distinct = kinds;
+    if (ids <= 0) ids = rows;
+    double growth = distinct / kinds;
+    double cost = coded_size(entries->data, entries->length) * growth + varint_size((uint64_t)distinct) +
+                  ids * (id_bits / n + log2(growth)) / 8.0;
+    bytearray_free(entries);
+    free(slices);
+    return cost;
+}
+
+// Empty values write a zero delta and leave the previous value in place
+static double cost_delta(const ValueList* sample, double scale) {
+    ByteArray* out = bytearray_new(4096);
+    long long prev = 0;
+    for (size_t i = 0; i < sample->count; i++) {
+        if (sample->lengths[i] == 0) {
+            encode_varint(out, 0);
+            continue;
+        }
+        long long val = strtoll(sample->values[i], NULL, 10);
+        long long delta = val - prev;
+        encode_varint(out, (delta << 1) ^ (delta >> 63));
+        prev = val;
+    }
+    double cost = coded_size(out->data, out->length) * scale;
+    bytearray_free(out);
+    return cost;
+}
+
+// Packed bits do not compress further: their plain size
+static double cost_packed(const ValueList* sample, double scale) {
+    uint64_t min = UINT64_MAX, max = 0;
+    for (size_t i = 0; i < sample->count; i++) {
+        uint64_t v = strtoull(sample->values[i], NULL, 10);
+        if (v < min) min = v;
+        if (v > max) max = v;
+    }
+    if (sample->count == 0) min = max = 0;
+    int width = 0;
+    while (width < 64 && ((max - min) >> width) != 0) width++;
+    return varint_size(min) + 1 + (double)sample->count * width / 8.0 * scale;
+}
+
+static double cost_address(const ValueList* sample, double scale) {
+    ByteArray* out = bytearray_new(4096);
+    AddrCodec codec;
+    addr_codec_init(&codec);
+    uint8_t header[ADDR_MAX_ENCODED];
+    for (size_t i = 0; i < sample->count; i++) {
+        int verbatim;
+        size_t n = addr_encode(&codec, sample->values[i], sample->lengths[i], header, &verbatim);
+        bytearray_append(out, header, n);
+        if (verbatim) bytearray_append(out, sample->values[i], sample->lengths[i]);
+    }
+    double cost = coded_size(out->data, out->length) * scale;
+    bytearray_free(out);
+    return cost;
+}
+
+static double cost_binary(const ValueList* sample, uint8_t format, double scale) {
+    ByteArray* out = bytearray_new(4096);
+    for (size_t i = 0; i < sample->count; i++) encode_binary_token(out, format, sample->values[i]);
+    double cost = 1.0 + coded_size(out->data, out->length) * scale;
+    bytearray_free(out);
+    return cost;
+}
+
+// Whether every value of a list is the same
+static int value_list_constant(const ValueList* list) {
+    for (size_t i = 1; i < list->count; i++) {
+        if (list->lengths[i] != list->lengths[0] || memcmp(list->values[i], list->values[0], list->lengths[0]) != 0) {
+            return 0;
+        }
+    }
+    return list->count > 0;
+}
+
+// Runs of equal ids: the run count, then each run's id and length
+static void encode_id_runs(ByteArray* out, const uint32_t* ids, size_t count) {
+    size_t runs = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || ids[i] != ids[i - 1]) runs++;
+    }
+    encode_varint(out, runs);
+    for (size_t i = 0; i < count; ) {
+        size_t j = i + 1;
+        while (j < count && ids[j] == ids[i]) j++;
+        encode_varint(out, ids[i]);
+        encode_varint(out, j - i);
+        i = j;
+    }
+}
+
+// A dictionary whose ids are written as runs: its entries, an id per run
+// and the run lengths. Offered only when runs average two rows or more
+static double cost_runs(const ValueList* sample, double scale, double distinct) {
+    ByteArray* lengths = bytearray_new(4096);
+    size_t runs = 0;
+    for (size_t i = 0; i < sample->count; ) {
+        size_t j = i + 1;
+        while (j < sample->count && sample->lengths[j] == sample->lengths[i] &&
+               memcmp(sample->values[j], sample->values[i], sample->lengths[i]) == 0) j++;
+        encode_varint(lengths, j - i);
+        runs++;
+        i = j;
+    }
+    double cost = -1.0;
+    if (runs && runs * 2 <= sample->count) {
+        cost = cost_dict(sample, scale, distinct, runs * scale) + coded_size(lengths->data, lengths->length) * scale;
+    }
+    bytearray_free(lengths);
+    return cost;
+}
+
+// Ids through a dictionary's remap, ids past its entries unchanged
+static void dict_ids_write(ByteArray* out, const Dictionary* d, const uint32_t* remap, const uint32_t* ids,
+                           uint32_t* mapped, size_t count, int runs) {
+    for (size_t i = 0; i < count; i++) mapped[i] = ids[i] < d->count ? remap[ids[i]] : ids[i];
+    if (runs) {
+        encode_id_runs(out, mapped, count);
+    } else {
+        for (size_t i = 0; i < count; i++) encode_varint(out, mapped[i]);
+    }
+}
+
+// A dictionary, then its ids one per value or as runs. Dictionaries of
+// FRONT_CODE_MIN_ENTRIES or more are written in both layouts, ids
+// included, and front coded when that is at least 2% smaller by
+// coded_size: sorting shortens the entries but reorders the ids. Returns
+// whether it was front coded
+static int encode_dict_ids(ByteArray* out, const Dictionary* d, const uint32_t* ids, size_t count, int runs) {
+    uint32_t* remap = malloc(sizeof(uint32_t) * (d->count ? d->count : 1));
+    uint32_t* mapped = malloc(sizeof(uint32_t) * (count ? count : 1));
+    int front_coded = 0;
+    if (d->count >= FRONT_CODE_MIN_ENTRIES) {
+        double size[2];
+        for (int layout = 0; layout < 2; layout++) {
+            ByteArray* trial = bytearray_new(4096);
+            encode_dict_entries(trial, d, layout, remap);
+            dict_ids_write(trial, d, remap, ids, mapped, count, runs);
+            size[layout] = coded_size(trial->data, trial->length);
+            bytearray_free(trial);
+        }
+        front_coded = size[1] < size[0] * 0.98;
+    }
+    encode_dict_entries(out, d, front_coded, remap);
+    dict_ids_write(out, d, remap, ids, mapped, count, runs);
+    free(mapped);
+    free(remap);
+    return front_coded;
+}
+
+// Flat encodings of a sample: numeric ones when every value is a number,
+// address when every value is an address, binary with a format, constant
+// when every value of the whole column is the same
+static void cost_flat(const ValueList* sample, double scale, double distinct,
+                      int numeric, int addresses, uint8_t bin_format, int constant, CostReport* report) {
+    for (int c = 0; c < CAND_COUNT; c++) report->cost[c] = -1.0;
+    if (constant) report->cost[CAND_CONSTANT] = 1.0 + sample->lengths[0];
+    report->cost[CAND_RAW] = cost_raw(sample, scale);
+    report->cost[CAND_DICT] = cost_dict(sample, scale, distinct, 0);
+    report->cost[CAND_RUNS] = cost_runs(sample, scale, distinct);
+    if (numeric) {
+        report->cost[CAND_DELTA] = cost_delta(sample, scale);
+        report->cost[CAND_PACKED] = cost_packed(sample, scale);
+    }
+    if (addresses) report->cost[CAND_ADDRESS] = cost_address(sample, scale);
+    if (bin_format) report->cost[CAND_BINARY] = cost_binary(sample, bin_format, scale);
+}
+
+// A constant column is written as one: nothing is smaller, and its decode
+// is a fill
+static void cost_pick(CostReport* report) {
+    if (report->cost[CAND_CONSTANT] >= 0) {
+        report->best = CAND_CONSTANT;
+        return;
+    }
+    report->best = CAND_RAW;
+    for (int c = 0; c < CAND_COUNT; c++) {
+        if (report->cost[c] >= 0 && report->cost[c] < report->cost[report->best]) report->best = c;
+    }
+}
+
+// Binary format of the first BINARY_SAMPLE values, 0 when none fits
+static uint8_t value_list_bin_format(const ValueList* list) {
+    size_t n = list->count < BINARY_SAMPLE ? list->count : BINARY_SAMPLE;
+    return bintoken_choose_format(list->values, n);
+}
+
+// Tokens of sub-column sc, in row order
+static void sub_column_values(TokenStream** streams, size_t count, size_t sc, ValueList* list,
+                              int* numeric, int* addresses) {
+    value_list_init(list, count);
+    *numeric = *addresses = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (sc >= streams[i]->count) continue;
+        const Token* token = &streams[i]->tokens[sc];
+        list->values[list->count] = token->value;
+        list->lengths[list->count++] = strlen(token->value);
+        if (token->type != TOKEN_TYPE_NUMERIC) *numeric = 0;
+        if (token->type != TOKEN_TYPE_IP) *addresses = 0;
+    }
+    if (list->count == 0) *numeric = *addresses = 0;
+}
+
+// Decomposition of a sample: the token counts plus each sub-column at its
+// cheapest flat encoding, with dictionaries grown by Good-Turing
+static double cost_decomposed(const ValueList* sample, double scale, Arena* arena) {
+    TokenStream** streams = malloc(sizeof(TokenStream*) * (sample->count ? sample->count : 1));
+    size_t max_tokens = 0;
+    int constant_count = 1;
+    ByteArray* counts = bytearray_new(4096);
+    for (size_t i = 0; i < sample->count; i++) {
+        streams[i] = tokenize_field(arena, sample->values[i], sample->lengths[i]);
+        if (streams[i]->count > max_tokens) max_tokens = streams[i]->count;
+        if (streams[i]->count != streams[0]->count) constant_count = 0;
+        encode_varint(counts, streams[i]->count);
+    }
+    double cost = 2.0 + (constant_count ? 1.0 : coded_size(counts->data, counts->length) * scale);
+    bytearray_free(counts);
     
-    for (size_t i = 0; i < line_count; i++) {
-        // Simple split by space (respecting quotes would be better, but keeping it simple for now)
-        // Actually, let's use a smarter split that respects quotes/brackets like ULC-C
-        // For this demo, we'll just use the tokenizer we wrote but only split on spaces
-        // Wait, let's reuse the tokenizer but flatten it? No, let's just use the tokenizer on the WHOLE LINE first?
-        // Better: Split by space to get fields. Then tokenize fields.
-        
-        // Simplified field parsing
-        size_t cap = 16;
-        grid[i] = malloc(sizeof(char*) * cap);
-        size_t cols = 0;
-        char* ptr = lines[i];
-        while (*ptr) {
-            while (*ptr == ' ') ptr++;
-            if (!*ptr) break;
-            char* start = ptr;
-            if (*ptr == '[') {
-                while (*ptr && *ptr != ']') ptr++;
-                if (*ptr) ptr++;
-            } else if (*ptr == '"') {
-                ptr++;
-                while (*ptr && *ptr != '"') ptr++;
-                if (*ptr) ptr++;
-            } else {
-                while (*ptr && *ptr != ' ') ptr++;
-            }
-            
-            size_t len = ptr - start;
-            if (cols >= cap) {
-                cap *= 2;
-                grid[i] = realloc(grid[i], sizeof(char*) * cap);
+    for (size_t sc = 0; sc < max_tokens; sc++) {
+        ValueList list;
+        int numeric, addresses;
+        sub_column_values(streams, sample->count, sc, &list, &numeric, &addresses);
+        CostReport report;
+        cost_flat(&list, scale, -1.0, numeric, addresses, value_list_bin_format(&list), value_list_constant(&list),
+                  &report);
+        cost_pick(&report);
+        cost += 1.0 + report.cost[report.best];
+        value_list_free(&list);
+    }
+    free(streams);
+    return cost;
+}
+
+static void explain_costs(const CostReport* report) {
+    for (int c = 0; c < CAND_COUNT; c++) {
+        if (report->cost[c] >= 0) printf(" %s=%.0f", candidate_names[c], report->cost[c]);
+    }
+    printf("\n");
+}
+
+// --- Row Clustering ---
+// Major columns are aligned by position, so rows of another shape shift
+// every later column. Rows are grouped by shape (field count and the class
+// of the leading fields) and each group gets its own column set; a partition
+// id per row restores the order.
+
+#define CLUSTER_SHAPE_FIELDS 4
+#define CLUSTER_MAX 16          // Partitions, the last one shared by rare shapes
+#define CLUSTER_MIN_ROWS 64     // and 1% of the rows, to get a partition
+
+// Next field of a line: space separated, [...] and "..." kept whole.
+// NULL at the end of the line
+static const char* next_field(const char** cursor, size_t* len) {
+    const char* ptr = *cursor;
+    while (*ptr == ' ') ptr++;
+    if (!*ptr) {
+        *cursor = ptr;
+        return NULL;
+    }
+    const char* start = ptr;
+    if (*ptr == '[') {
+        while (*ptr && *ptr != ']') ptr++;
+        if (*ptr) ptr++;
+    } else if (*ptr == '"') {
+        ptr++;
+        while (*ptr && *ptr != '"') ptr++;
+        if (*ptr) ptr++;
+    } else {
+        while (*ptr && *ptr != ' ') ptr++;
+    }
+    *len = ptr - start;
+    *cursor = ptr;
+    return start;
+}
+
+// Major columns of a run of rows
+typedef struct {
+    StringColumn* columns;
+    size_t count;       // Columns of the widest row
+    size_t cap;
+    size_t rows;
+} ColumnSet;
+
+static void column_set_init(ColumnSet* set) {
+    set->cap = 16;
+    set->columns = malloc(sizeof(StringColumn) * set->cap);
+    set->count = 0;
+    set->rows = 0;
+}
+
+// Fields go straight into their major column as they are split
+static void column_set_add_row(ColumnSet* set, const char* line) {
+    size_t cols = 0;
+    size_t len;
+    const char* field;
+    while ((field = next_field(&line, &len))) {
+        if (cols >= set->count) {
+            if (set->count >= set->cap) {
+                set->cap *= 2;
+                set->columns = realloc(set->columns, sizeof(StringColumn) * set->cap);
             }
-            grid[i][cols] = malloc(len + 1);
-            memcpy(grid[i][cols], start, len);
-            grid[i][cols][len] = '\0';
-            cols++;
+            string_column_init(&set->columns[set->count++]);
         }
-        col_counts[i] = cols;
-        if (cols > max_cols) max_cols = cols;
+        string_column_pad(&set->columns[cols], set->rows);
+        string_column_push(&set->columns[cols], field, len);
+        cols++;
+    }
+    set->rows++;
+}
+
+// Missing cells up to the last row
+static void column_set_finish(ColumnSet* set) {
+    for (size_t c = 0; c < set->count; c++) string_column_pad(&set->columns[c], set->rows);
+}
+
+static void column_set_free(ColumnSet* set) {
+    for (size_t c = 0; c < set->count; c++) string_column_free(&set->columns[c]);
+    free(set->columns);
+}
+
+// Field count and coarse class (digit, letter or the opening byte) of the
+// leading fields
+static uint64_t line_shape(const char* line) {
+    char classes[CLUSTER_SHAPE_FIELDS];
+    size_t fields = 0;
+    size_t len;
+    const char* field;
+    while ((field = next_field(&line, &len))) {
+        if (fields < CLUSTER_SHAPE_FIELDS) {
+            // A lone '-' (the access-log placeholder) counts as a word
+            unsigned char c = (unsigned char)field[0];
+            if (len == 1 && c == '-') c = 'a';
+            classes[fields] = isdigit(c) ? '0' : isalpha(c) ? 'a' : (char)c;
+        }
+        fields++;
+    }
+    size_t used = fields < CLUSTER_SHAPE_FIELDS ? fields : CLUSTER_SHAPE_FIELDS;
+    return hash_bytes(classes, used) ^ (fields * 0x9E3779B97F4A7C15ULL);
+}
+
+typedef struct {
+    uint64_t shape;
+    size_t rows;
+} ShapeCount;
+
+static int u64_compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static int shape_count_compare(const void* a, const void* b) {
+    const ShapeCount* x = a;
+    const ShapeCount* y = b;
+    if (x->rows != y->rows) return x->rows < y->rows ? 1 : -1;
+    return (x->shape > y->shape) - (x->shape < y->shape);
+}
+
+// Partition of every row: shapes with enough rows get their own, largest
+// first, the rest share one more. Returns the partition count (1 when the
+// rows have a single common shape)
+static size_t cluster_rows(char** lines, size_t count, uint8_t* partition) {
+    if (count == 0) return 1;
+    uint64_t* shapes = malloc(sizeof(uint64_t) * count);
+    uint64_t* sorted = malloc(sizeof(uint64_t) * count);
+    for (size_t i = 0; i < count; i++) shapes[i] = sorted[i] = line_shape(lines[i]);
+    qsort(sorted, count, sizeof(uint64_t), u64_compare);
+    
+    ShapeCount* counts = malloc(sizeof(ShapeCount) * count);
+    size_t distinct = 0;
+    for (size_t i = 0; i < count; ) {
+        size_t j = i;
+        while (j < count && sorted[j] == sorted[i]) j++;
+        counts[distinct].shape = sorted[i];
+        counts[distinct++].rows = j - i;
+        i = j;
     }
+    qsort(counts, distinct, sizeof(ShapeCount), shape_count_compare);
     
-    printf("Detected %zu max columns. Decomposing...\n", max_cols);
+    size_t min_rows = count / 100 > CLUSTER_MIN_ROWS ? count / 100 : CLUSTER_MIN_ROWS;
+    size_t kept = 0;
+    while (kept < distinct && kept < CLUSTER_MAX - 1 && counts[kept].rows >= min_rows) kept++;
+    size_t partitions = kept + (kept < distinct);
     
-    // 2. Semantic Decomposition & Serialization
-    ByteArray* serialized = bytearray_new(total_bytes);
-    encode_varint(serialized, line_count);
-    encode_varint(serialized, max_cols);
+    for (size_t i = 0; i < count; i++) {
+        size_t p = 0;
+        while (p < kept && counts[p].shape != shapes[i]) p++;
+        partition[i] = (uint8_t)p;
+    }
+    free(shapes);
+    free(sorted);
+    free(counts);
+    return partitions;
+}
+
+// --- Compression Engine ---
+
+// Semantic decomposition of one column set: per major column its encoding
+// byte and payload; sections[c] receives where column c starts
+static void serialize_columns(ByteArray* serialized, const ColumnSet* set, size_t* sections, int explain,
+                              Arena* col_arena) {
+    const StringColumn* columns = set->columns;
+    size_t max_cols = set->count;
+    size_t line_count = set->rows;
     
-    // We process column by column (Major Columns)
     for (size_t c = 0; c < max_cols; c++) {
-        // Analyze Column First
-        Dictionary* col_dict = dict_new(256);
-        int is_numeric = 1;
-        int is_ip = 1;
-        size_t non_empty_count = 0;
+        sections[c] = serialized->length;
+        const StringColumn* col = &columns[c];
+        
+        // Analyze Column First: one pass, no dictionary until one is chosen
+        ColumnStats stats;
+        analyze_column(col, &stats);
+        
+        // Types hold only when every value votes for them (delta coding
+        // cannot carry a non-integer)
+        int is_numeric = stats.integers == stats.non_empty && stats.non_empty > 10;
+        int is_ip = stats.addresses == stats.non_empty && stats.non_empty > 10;
         
+        ValueList values, sample;
+        value_list_init(&values, line_count);
         for (size_t i = 0; i < line_count; i++) {
-            if (c < col_counts[i]) {
-                const char* val = grid[i][c];
-                if (strlen(val) > 0) {
-                    non_empty_count++;
-                    dict_get_or_add(col_dict, val);
-                    
-                    // Check type (heuristic on first 100 non-empty)
-                    if (non_empty_count < 100) {
-                        char* endptr;
-                        strtoll(val, &endptr, 10);
-                        if (*endptr != '\0') is_numeric = 0;
-                        
-                        int dots = 0, digits = 0;
-                        for(size_t k=0; k<strlen(val); k++) {
-                            if(val[k] == '.') dots++;
-                            else if(isdigit(val[k])) digits++;
-                            else { is_ip = 0; break; }
-                        }
-                        if(dots < 3 || digits < 4) is_ip = 0;
-                    }
-                }
-            }
+            values.values[i] = string_column_value(col, i);
+            values.lengths[i] = string_column_length(col, i);
         }
+        values.count = line_count;
+        value_list_sample(&values, &sample);
+        double scale = sample.count ? (double)line_count / sample.count : 1.0;
         
-        double unique_ratio = (double)col_dict->count / line_count;
+        // Binary format from the first present values
+        const char* bin_sample[BINARY_SAMPLE];
+        size_t bin_count = 0;
+        for (size_t i = 0; i < line_count && bin_count < BINARY_SAMPLE; i++) {
+            if (!string_column_missing(col, i)) bin_sample[bin_count++] = string_column_value(col, i);
+        }
+        uint8_t bin_format = bintoken_choose_format(bin_sample, bin_count);
+        
+        // Decision Logic: cheapest estimate
+        // 0=Raw (Hyper Decomp), 1=Dict, 2=Delta, 3=IP_XOR (legacy), 4=Raw, 5=Address, 6=Binary tokens,
+        // 7=Constant, 8=Dict with id runs
+        CostReport report;
+        cost_flat(&sample, scale, stats.distinct, is_numeric, is_ip, bin_format, stats.constant, &report);
+        report.cost[CAND_PACKED] = -1.0;
+        report.cost[CAND_DECOMPOSED] = cost_decomposed(&sample, scale, col_arena);
+        cost_pick(&report);
+        int encoding_type = major_encodings[report.best];
+        value_list_free(&sample);
+        arena_reset(col_arena);
         
-        // Decision Logic
-        // 0=Raw (Hyper Decomp), 1=Dict, 2=Delta, 3=IP_XOR
-        int encoding_type = 0;
+        if (explain) {
+            printf("  column %zu: %s (%zu rows, ~%.0f distinct)\n   ", c, candidate_names[report.best],
+                   stats.non_empty, stats.distinct);
+            explain_costs(&report);
+        }
         
-        if (is_numeric && non_empty_count > 10) encoding_type = 2;
-        else if (is_ip && non_empty_count > 10) encoding_type = 3;
-        else if (unique_ratio < 0.5 || col_dict->count < 256) encoding_type = 1;
-        else encoding_type = 0; // High cardinality string -> Hyper Decomp
+        Dictionary* col_dict = encoding_type == 1 || encoding_type == 8 ? column_dict(col, col_arena) : NULL;
         
-        // Write Encoding Type
+        // Write Encoding Type (dictionaries switch to their front-coded
+        // type once the layout is chosen)
+        size_t type_at = serialized->length;
         bytearray_append(serialized, (uint8_t*)&encoding_type, 1);
         
-        if (encoding_type == 1) {
-            // DICTIONARY (v3 style)
-            encode_varint(serialized, col_dict->count);
-            for (size_t k = 0; k < col_dict->count; k++) {
-                encode_varint(serialized, strlen(col_dict->entries[k].key));
-                bytearray_append(serialized, col_dict->entries[k].key, strlen(col_dict->entries[k].key));
-            }
+        if (encoding_type == 1 || encoding_type == 8) {
+            // DICTIONARY (v3 style), ids one per row or as runs. Empty
+            // cells take an id past the entries, which reads back as empty
+            size_t entries = col_dict->count;
+            uint32_t* ids = malloc(sizeof(uint32_t) * (line_count ? line_count : 1));
             for (size_t i = 0; i < line_count; i++) {
-                if (c < col_counts[i]) {
-                    int id = dict_get_or_add(col_dict, grid[i][c]);
-                    encode_varint(serialized, id);
+                if (encoding_type == 1 && string_column_missing(col, i)) {
+                    ids[i] = 0; // Should be handled better, but sticking to v3 logic
                 } else {
-                    encode_varint(serialized, 0); // Should be handled better, but sticking to v3 logic
+                    ids[i] = (uint32_t)dict_get_or_add(col_dict, string_column_value(col, i));
                 }
             }
+            col_dict->count = entries;   // The empty value added above is not written
+            if (encode_dict_ids(serialized, col_dict, ids, line_count, encoding_type == 8)) {
+                serialized->data[type_at] = encoding_type == 8 ? 10 : 9;
+                if (explain) printf("   dictionary front coded (%zu entries)\n", entries);
+            }
+            free(ids);
+            dict_free(col_dict);
         } else if (encoding_type == 2) {
             // DELTA (v3 style)
             long long prev = 0;
             for (size_t i = 0; i < line_count; i++) {
-                if (c < col_counts[i] && strlen(grid[i][c]) > 0) {
-                    long long val = strtoll(grid[i][c], NULL, 10);
+                if (string_column_length(col, i) > 0) {
+                    long long val = strtoll(string_column_value(col, i), NULL, 10);
                     long long delta = val - prev;
                     uint64_t zigzag = (delta << 1) ^ (delta >> 63);
                     encode_varint(serialized, zigzag);
@@ -326,71 +1162,49 @@ int hyper_compress_file(const char* input_path, const char* output_path,
                     encode_varint(serialized, 0);
                 }
             }
-        } else if (encoding_type == 3) {
-            // IP XOR (v3 style)
-            uint32_t prev_ip = 0;
+        } else if (encoding_type == 5) {
+            // ADDRESS (family tag + XOR against previous IPv4/IPv6)
+            AddrCodec codec;
+            addr_codec_init(&codec);
+            uint8_t header[ADDR_MAX_ENCODED];
             for (size_t i = 0; i < line_count; i++) {
-                unsigned int a, b, c, d;
-                if (c < col_counts[i] && sscanf(grid[i][c], "%u.%u.%u.%u", &a, &b, &c, &d) == 4) {
-                    uint32_t ip = (a << 24) | (b << 16) | (c << 8) | d;
-                    uint32_t xor_val = ip ^ prev_ip;
-                    encode_varint(serialized, xor_val);
-                    prev_ip = ip;
-                } else {
-                    encode_varint(serialized, 0);
-                }
+                const char* val = string_column_value(col, i);
+                size_t len = string_column_length(col, i);
+                int verbatim;
+                size_t n = addr_encode(&codec, val, len, header, &verbatim);
+                bytearray_append(serialized, header, n);
+                if (verbatim) bytearray_append(serialized, val, len);
+            }
+        } else if (encoding_type == 6) {
+            // BINARY TOKENS
+            bytearray_append(serialized, &bin_format, 1);
+            for (size_t i = 0; i < line_count; i++) {
+                encode_binary_token(serialized, bin_format, string_column_value(col, i));
+            }
+        } else if (encoding_type == 7) {
+            // CONSTANT: the value once
+            encode_varint(serialized, values.lengths[0]);
+            bytearray_append(serialized, values.values[0], values.lengths[0]);
+        } else if (encoding_type == 4) {
+            // RAW (v3 style)
+            for (size_t i = 0; i < line_count; i++) {
+                size_t len = string_column_length(col, i);
+                encode_varint(serialized, len);
+                bytearray_append(serialized, string_column_value(col, i), len);
             }
         } else {
-            // HYPER DECOMPOSITION vs RAW
-            // Analyze if decomposition is actually beneficial
+            // HYPER DECOMPOSITION
             TokenStream** streams = malloc(sizeof(TokenStream*) * line_count);
             size_t max_tokens = 0;
-            size_t total_token_count = 0;
-            
-            // Tokenize first
             for (size_t i = 0; i < line_count; i++) {
-                if (c < col_counts[i]) {
-                    streams[i] = tokenize_field(grid[i][c]);
+                if (!string_column_missing(col, i)) {
+                    streams[i] = tokenize_field(col_arena, string_column_value(col, i), string_column_length(col, i));
                     if (streams[i]->count > max_tokens) max_tokens = streams[i]->count;
-                    total_token_count += streams[i]->count;
                 } else {
-                    streams[i] = tokenize_field("");
+                    streams[i] = tokenize_field(col_arena, "", 0);
                 }
             }
             
-            // Check Token Redundancy AND Length
-            Dictionary* token_dict = dict_new(1024);
-            size_t total_len = 0;
-            for (size_t i = 0; i < line_count; i++) {
-                if (c < col_counts[i]) total_len += strlen(grid[i][c]);
-                for (size_t k = 0; k < streams[i]->count; k++) {
-                    dict_get_or_add(token_dict, streams[i]->tokens[k].value);
-                }
-            }
-            
-            double token_unique_ratio = (total_token_count > 0) ? (double)token_dict->count / total_token_count : 1.0;
-            double avg_len = (double)total_len / line_count;
-            dict_free(token_dict);
-            
-            // Heuristic:
-            // 1. If tokens are mostly unique (> 50%), use Raw.
-            // 2. If string is short (< 15 chars), decomposition overhead outweighs benefits. Use Raw.
-            if (token_unique_ratio > 0.5 || avg_len < 15.0) {
-                // FALLBACK TO RAW (v3 style)
-                serialized->length--; 
-                uint8_t raw_type = 4;
-                bytearray_append(serialized, &raw_type, 1);
-                
-                for (size_t i = 0; i < line_count; i++) {
-                    if (c < col_counts[i]) {
-                        const char* val = grid[i][c];
-                        encode_varint(serialized, strlen(val));
-                        bytearray_append(serialized, val, strlen(val));
-                    } else {
-                        encode_varint(serialized, 0);
-                    }
-                }
-            } else {
             // Check if token count is constant
             int is_constant_count = 1;
             if (line_count > 0) {
@@ -422,50 +1236,208 @@ int hyper_compress_file(const char* input_path, const char* output_path,
             }
             
             for (size_t sc = 0; sc < max_tokens; sc++) {
-                    Dictionary* sub_dict = dict_new(256);
+                // Sub-column tokens, their cardinality, then the cheapest estimate
+                // 0=Raw, 1=Dict, 2=Delta, 3=Bit-packed, 4=Address, 5=Binary tokens, 6=Constant,
+                // 7=Dict with id runs, 8 and 9=1 and 7 front coded
+                ValueList list, sample;
+                int all_numeric, all_addr;
+                sub_column_values(streams, line_count, sc, &list, &all_numeric, &all_addr);
+                size_t present = list.count;
+                HyperLogLog* hll = calloc(1, sizeof(HyperLogLog));
+                for (size_t k = 0; k < present; k++) hll_add(hll, hash_bytes(list.values[k], list.lengths[k]));
+                double distinct = present ? hll_estimate(hll) : 0.0;
+                free(hll);
+                
+                uint8_t bin_format = value_list_bin_format(&list);
+                value_list_sample(&list, &sample);
+                CostReport sub_report;
+                cost_flat(&sample, sample.count ? (double)present / sample.count : 1.0, distinct,
+                          all_numeric, all_addr, bin_format, value_list_constant(&list), &sub_report);
+                cost_pick(&sub_report);
+                uint8_t sub_encoding = sub_encodings[sub_report.best];
+                value_list_free(&sample);
+                
+                if (explain) {
+                    printf("    token %zu: %s (%zu rows, ~%.0f distinct)\n     ", sc,
+                           candidate_names[sub_report.best], present, distinct);
+                    explain_costs(&sub_report);
+                }
+                
+                uint64_t* numbers = NULL;
+                if (sub_encoding == 2 || sub_encoding == 3) {
+                    numbers = malloc(sizeof(uint64_t) * present);
+                    for (size_t k = 0; k < present; k++) numbers[k] = strtoull(list.values[k], NULL, 10);
+                }
+                Dictionary* sub_dict = sub_encoding == 1 || sub_encoding == 7 ?
+                                       token_dict(streams, line_count, sc, col_arena) : NULL;
+                
+                size_t sub_type_at = serialized->length;
+                bytearray_append(serialized, &sub_encoding, 1);
+                
+                if (sub_encoding == 6) {
+                    encode_varint(serialized, list.lengths[0]);
+                    bytearray_append(serialized, list.values[0], list.lengths[0]);
+                } else if (sub_encoding == 2) {
+                    long long prev = 0;
+                    for (size_t k = 0; k < present; k++) {
+                        long long delta = (long long)numbers[k] - prev;
+                        encode_varint(serialized, (delta << 1) ^ (delta >> 63));
+                        prev = (long long)numbers[k];
+                    }
+                } else if (sub_encoding == 3) {
+                    encode_bitpacked(serialized, numbers, present);
+                } else if (sub_encoding == 4) {
+                    AddrCodec codec;
+                    addr_codec_init(&codec);
+                    uint8_t header[ADDR_MAX_ENCODED];
                     for (size_t i = 0; i < line_count; i++) {
-                        if (sc < streams[i]->count) dict_get_or_add(sub_dict, streams[i]->tokens[sc].value);
+                        if (sc >= streams[i]->count) continue;
+                        const char* val = streams[i]->tokens[sc].value;
+                        int verbatim;
+                        size_t n = addr_encode(&codec, val, strlen(val), header, &verbatim);
+                        bytearray_append(serialized, header, n);
+                        if (verbatim) bytearray_append(serialized, val, strlen(val));
                     }
-                    
-                    double ratio = (double)sub_dict->count / line_count;
-                    int use_dict = (ratio < 0.5 || sub_dict->count < 256);
-                    
-                    bytearray_append(serialized, (uint8_t*)&use_dict, 1);
-                    
-                    if (use_dict) {
-                        encode_varint(serialized, sub_dict->count);
-                        for (size_t k = 0; k < sub_dict->count; k++) {
-                            encode_varint(serialized, strlen(sub_dict->entries[k].key));
-                            bytearray_append(serialized, sub_dict->entries[k].key, strlen(sub_dict->entries[k].key));
+                } else if (sub_encoding == 5) {
+                    bytearray_append(serialized, &bin_format, 1);
+                    for (size_t i = 0; i < line_count; i++) {
+                        if (sc < streams[i]->count) {
+                            encode_binary_token(serialized, bin_format, streams[i]->tokens[sc].value);
                         }
-                        for (size_t i = 0; i < line_count; i++) {
-                            if (sc < streams[i]->count) {
-                                int id = dict_get_or_add(sub_dict, streams[i]->tokens[sc].value);
-                                encode_varint(serialized, id);
-                            }
+                    }
+                } else if (sub_encoding == 1 || sub_encoding == 7) {
+                    uint32_t* ids = malloc(sizeof(uint32_t) * (present ? present : 1));
+                    size_t k = 0;
+                    for (size_t i = 0; i < line_count; i++) {
+                        if (sc < streams[i]->count) {
+                            ids[k++] = (uint32_t)dict_get_or_add(sub_dict, streams[i]->tokens[sc].value);
                         }
-                    } else {
-                        for (size_t i = 0; i < line_count; i++) {
-                            if (sc < streams[i]->count) {
-                                const char* val = streams[i]->tokens[sc].value;
-                                encode_varint(serialized, strlen(val));
-                                bytearray_append(serialized, val, strlen(val));
-                            }
+                    }
+                    if (encode_dict_ids(serialized, sub_dict, ids, present, sub_encoding == 7)) {
+                        serialized->data[sub_type_at] = sub_encoding == 7 ? 9 : 8;
+                        if (explain) printf("     dictionary front coded (%zu entries)\n", sub_dict->count);
+                    }
+                    free(ids);
+                } else {
+                    for (size_t i = 0; i < line_count; i++) {
+                        if (sc < streams[i]->count) {
+                            const char* val = streams[i]->tokens[sc].value;
+                            encode_varint(serialized, strlen(val));
+                            bytearray_append(serialized, val, strlen(val));
                         }
                     }
-                    dict_free(sub_dict);
                 }
+                free(numbers);
+                value_list_free(&list);
+                if (sub_dict) dict_free(sub_dict);
             }
             
-            for(size_t i=0; i<line_count; i++) tokenstream_free(streams[i]);
             free(streams);
         }
-        dict_free(col_dict);
+        value_list_free(&values);
+        arena_reset(col_arena);
+    }
+}
+
+// A serialized file and where its sections start
+typedef struct {
+    ByteArray* data;
+    size_t* sections;
+    size_t section_count;
+    size_t max_cols;
+    size_t partitions;      // Row shapes, 1 when not clustered
+    size_t missing;         // Cells of rows shorter than their column set, which decode empty
+} Serialized;
+
+// Header, the column sets (one per row shape when clustering) and the
+// trace section
+static void serialize_records(Serialized* out, char** lines, size_t line_count, char** frames, char** messages,
+                              size_t total_bytes, int cluster, int explain, Arena* col_arena) {
+    // Fields of each row go to the column set of its shape
+    uint8_t* partition = malloc(line_count ? line_count : 1);
+    size_t partitions = 1;
+    if (cluster) partitions = cluster_rows(lines, line_count, partition);
+    else memset(partition, 0, line_count);
+    ColumnSet* sets = malloc(sizeof(ColumnSet) * partitions);
+    for (size_t p = 0; p < partitions; p++) column_set_init(&sets[p]);
+    for (size_t i = 0; i < line_count; i++) column_set_add_row(&sets[partition[i]], lines[i]);
+    size_t max_cols = 0;
+    size_t total_cols = 0;
+    for (size_t p = 0; p < partitions; p++) {
+        column_set_finish(&sets[p]);
+        if (sets[p].count > max_cols) max_cols = sets[p].count;
+        total_cols += sets[p].count;
     }
     
-    printf("Serialized size: %zu bytes\n", serialized->length);
+    ByteArray* serialized = bytearray_new(total_bytes);
+    encode_varint(serialized, line_count);
     
-    // 3. LZMA Compression
+    // Column section starts, context for the CM backend
+    size_t* sections = malloc(sizeof(size_t) * (total_cols + 2));
+    size_t section_count = 0;
+    
+    if (partitions == 1) {
+        encode_varint(serialized, max_cols);
+    } else {
+        // The marker in place of the column count, the partition of every
+        // row, then per partition its column count and columns
+        encode_varint(serialized, HYPER_CLUSTERED);
+        encode_varint(serialized, partitions);
+        sections[section_count++] = serialized->length;
+        bytearray_append(serialized, partition, line_count);
+    }
+    
+    // We process column by column (Major Columns)
+    size_t missing = 0;
+    for (size_t p = 0; p < partitions; p++) {
+        for (size_t c = 0; c < sets[p].count; c++) {
+            for (size_t i = 0; i < sets[p].rows; i++) missing += string_column_missing(&sets[p].columns[c], i);
+        }
+        if (partitions > 1) {
+            encode_varint(serialized, sets[p].count);
+            if (explain) printf("  shape %zu: %zu rows\n", p, sets[p].rows);
+        }
+        serialize_columns(serialized, &sets[p], sections + section_count, explain, col_arena);
+        section_count += sets[p].count;
+        column_set_free(&sets[p]);
+    }
+    free(sets);
+    free(partition);
+    
+    // Trace section after the columns (absent when nothing was framed):
+    // frame skeletons by dictionary, so recurring traces are one id each,
+    // then the lines between the frames
+    if (frames) {
+        sections[section_count++] = serialized->length;
+        Dictionary* frame_dict = dict_new(256, col_arena);
+        size_t* ids = malloc(sizeof(size_t) * line_count);
+        for (size_t i = 0; i < line_count; i++) ids[i] = dict_get_or_add(frame_dict, frames[i] ? frames[i] : "");
+        encode_varint(serialized, frame_dict->count);
+        for (size_t k = 0; k < frame_dict->count; k++) {
+            size_t len = strlen(frame_dict->entries[k].key);
+            encode_varint(serialized, len);
+            bytearray_append(serialized, (uint8_t*)frame_dict->entries[k].key, len);
+        }
+        for (size_t i = 0; i < line_count; i++) encode_varint(serialized, ids[i]);
+        for (size_t i = 0; i < line_count; i++) {
+            const char* msg = messages[i] ? messages[i] : "";
+            encode_varint(serialized, strlen(msg));
+            bytearray_append(serialized, (uint8_t*)msg, strlen(msg));
+        }
+        free(ids);
+        dict_free(frame_dict);
+    }
+    
+    out->data = serialized;
+    out->sections = sections;
+    out->section_count = section_count;
+    out->max_cols = max_cols;
+    out->partitions = partitions;
+    out->missing = missing;
+}
+
+// Single LZMA2 stream (xz container) of the serialized records
+static uint8_t* lzma_compress_records(const ByteArray* records, size_t* out_len) {
     lzma_options_lzma opt;
     lzma_lzma_preset(&opt, 9 | LZMA_PRESET_EXTREME);
     opt.dict_size = 128 * 1024 * 1024;
@@ -475,17 +1447,163 @@ int hyper_compress_file(const char* input_path, const char* output_path,
     
     lzma_filter filters[] = { { .id = LZMA_FILTER_LZMA2, .options = &opt }, { .id = LZMA_VLI_UNKNOWN, .options = NULL } };
     
-    size_t comp_cap = serialized->length + 1024;
+    size_t comp_cap = records->length + 1024;
     uint8_t* compressed = malloc(comp_cap);
     lzma_stream strm = LZMA_STREAM_INIT;
     lzma_stream_encoder(&strm, filters, LZMA_CHECK_CRC64);
-    strm.next_in = serialized->data;
-    strm.avail_in = serialized->length;
+    strm.next_in = records->data;
+    strm.avail_in = records->length;
     strm.next_out = compressed;
     strm.avail_out = comp_cap;
     lzma_code(&strm, LZMA_FINISH);
-    size_t comp_len = strm.total_out;
+    *out_len = strm.total_out;
     lzma_end(&strm);
+    return compressed;
+}
+
+int hyper_compress_file(const char* input_path, const char* output_path, 
+                       size_t* orig_size, size_t* comp_size, double* duration) {
+    return hyper_compress_file_ex(input_path, output_path, 0, orig_size, comp_size, duration);
+}
+
+int hyper_compress_file_ex(const char* input_path, const char* output_path, int flags,
+                           size_t* orig_size, size_t* comp_size, double* duration) {
+    clock_t start = clock();
+    int explain = flags & HYPER_EXPLAIN;
+    
+    FILE* fp = fopen(input_path, "r");
+    if (!fp) return -1;
+    
+    // Lines of the whole file live in one arena; each column's tokens and
+    // dictionaries in another, reset per column
+    Arena file_arena, col_arena;
+    arena_init(&file_arena);
+    arena_init(&col_arena);
+    
+    // Read lines
+    char** lines = NULL;
+    size_t line_count = 0;
+    size_t line_cap = 1024;
+    lines = malloc(sizeof(char*) * line_cap);
+    char buf[16384];
+    size_t total_bytes = 0;
+    
+    while (fgets(buf, sizeof(buf), fp)) {
+        size_t len = strlen(buf);
+        if (len > 0 && buf[len-1] == '\n') buf[len-1] = '\0';
+        if (len > 1 && buf[len-2] == '\r') buf[len-2] = '\0';
+        total_bytes += strlen(buf) + 1;
+        
+        if (line_count >= line_cap) {
+            line_cap *= 2;
+            lines = realloc(lines, sizeof(char*) * line_cap);
+        }
+        lines[line_count++] = arena_strndup(&file_arena, buf, strlen(buf));
+    }
+    fclose(fp);
+    *orig_size = total_bytes;
+    
+    // Multi-line records: continuation lines (stack traces) join the line
+    // above them instead of widening the grid; lines[] keeps the headers
+    char** frames = NULL;
+    char** messages = NULL;
+    size_t record_count = 0;
+    for (size_t i = 0; i < line_count; ) {
+        size_t end = i + 1;
+        while (end < line_count && frame_is_continuation(lines[end])) end++;
+        if (end > i + 1) {
+            if (!frames) {
+                frames = calloc(line_count, sizeof(char*));
+                messages = calloc(line_count, sizeof(char*));
+            }
+            frame_split(lines + i + 1, end - i - 1, &frames[record_count], &messages[record_count]);
+        }
+        lines[record_count++] = lines[i];
+        i = end;
+    }
+    line_count = record_count;
+    
+    printf("ULC-Hyper: Semantic Decomposition\n");
+    printf("Parsing %zu lines...\n", line_count);
+    
+    // 1. Initial Parse and 2. Semantic Decomposition & Serialization
+    Serialized records;
+    serialize_records(&records, lines, line_count, frames, messages, total_bytes, 1, explain, &col_arena);
+    ByteArray* serialized = records.data;
+    size_t* sections = records.sections;
+    size_t section_count = records.section_count;
+    
+    printf("Detected %zu max columns\n", records.max_cols);
+    if (records.partitions > 1) printf("Clustered rows into %zu shapes\n", records.partitions);
+    printf("Serialized size: %zu bytes\n", serialized->length);
+    printf("Arena blocks: %zu for lines, %zu for tokens\n", file_arena.blocks, col_arena.blocks);
+    
+    // 3. LZMA Compression
+    size_t comp_len;
+    uint8_t* compressed = lzma_compress_records(serialized, &comp_len);
+    
+    // Max mode: the rows unclustered too, kept when they compress smaller
+    // and leave no more cells missing
+    if ((flags & HYPER_MAX) && records.partitions > 1) {
+        Serialized flat;
+        serialize_records(&flat, lines, line_count, frames, messages, total_bytes, 0, 0, &col_arena);
+        size_t flat_len;
+        uint8_t* flat_compressed = lzma_compress_records(flat.data, &flat_len);
+        if (flat_len < comp_len && flat.missing <= records.missing) {
+            printf("Row clustering: dropped (%zu vs %zu bytes)\n", flat_len, comp_len);
+            free(compressed);
+            bytearray_free(serialized);
+            free(sections);
+            compressed = flat_compressed;
+            comp_len = flat_len;
+            serialized = flat.data;
+            sections = flat.sections;
+            section_count = flat.section_count;
+        } else {
+            free(flat_compressed);
+            bytearray_free(flat.data);
+            free(flat.sections);
+        }
+    }
+    
+    if (frames) {
+        for (size_t i = 0; i < line_count; i++) {
+            free(frames[i]);
+            free(messages[i]);
+        }
+        free(frames);
+        free(messages);
+    }
+    
+    // Per-column streams (self-identifying) when they are smaller: column
+    // groups coded apart with their own backend, each fetchable alone
+    size_t codec_counts[STREAM_CODECS];
+    size_t streams_len;
+    uint8_t* streams = streams_compress(serialized->data, serialized->length, sections, section_count,
+                                        codec_counts, &streams_len);
+    if (streams_len < comp_len) {
+        printf("Streams: %zu text, %zu binary, %zu delta, %zu stored\n", codec_counts[STREAM_TEXT],
+               codec_counts[STREAM_BINARY], codec_counts[STREAM_DELTA], codec_counts[STREAM_STORE]);
+        free(compressed);
+        compressed = streams;
+        comp_len = streams_len;
+    } else {
+        free(streams);
+    }
+    
+    // Max mode: context-mixed stream (self-identifying) when it is smaller
+    if (flags & HYPER_MAX) {
+        size_t cm_len;
+        uint8_t* cm = cm_compress(serialized->data, serialized->length, sections, section_count, &cm_len);
+        if (cm_len < comp_len) {
+            free(compressed);
+            compressed = cm;
+            comp_len = cm_len;
+        } else {
+            free(cm);
+        }
+    }
+    free(sections);
     
     // Write output
     FILE* out_fp = fopen(output_path, "wb");
@@ -498,81 +1616,30 @@ int hyper_compress_file(const char* input_path, const char* output_path,
     // Cleanup
     free(compressed);
     bytearray_free(serialized);
-    for(size_t i=0; i<line_count; i++) {
-        for(size_t j=0; j<col_counts[i]; j++) free(grid[i][j]);
-        free(grid[i]);
-        free(lines[i]);
-    }
-    free(grid);
-    free(col_counts);
     free(lines);
+    arena_free(&file_arena);
+    arena_free(&col_arena);
     
     clock_t end = clock();
     *duration = (double)(end - start) / CLOCKS_PER_SEC;
     return 0;
 }
 
-int hyper_decompress_file(const char* input_path, const char* output_path, double* duration) {
-    clock_t start = clock();
-    
-    FILE* fp = fopen(input_path, "rb");
-    if (!fp) return -1;
-    
-    char magic[HYPER_MAGIC_LEN];
-    fread(magic, 1, HYPER_MAGIC_LEN, fp);
-    if (memcmp(magic, HYPER_MAGIC, HYPER_MAGIC_LEN) != 0) { fclose(fp); return -1; }
-    
-    fseek(fp, 0, SEEK_END);
-    long fsize = ftell(fp);
-    fseek(fp, HYPER_MAGIC_LEN, SEEK_SET);
-    size_t comp_len = fsize - HYPER_MAGIC_LEN;
-    uint8_t* compressed = malloc(comp_len);
-    fread(compressed, 1, comp_len, fp);
-    fclose(fp);
-    
-    // Decompress
-    size_t decomp_cap = comp_len * 30;
-    uint8_t* decompressed = malloc(decomp_cap);
-    lzma_stream strm = LZMA_STREAM_INIT;
-    lzma_stream_decoder(&strm, UINT64_MAX, 0);
-    strm.next_in = compressed;
-    strm.avail_in = comp_len;
-    strm.next_out = decompressed;
-    strm.avail_out = decomp_cap;
-    lzma_code(&strm, LZMA_FINISH);
-    lzma_end(&strm);
-    free(compressed);
-    
-    // Parse
-    size_t offset = 0;
-    uint64_t line_count = decode_varint(decompressed, &offset);
-    uint64_t max_cols = decode_varint(decompressed, &offset);
-    
-    // Reconstruct grid
-    // grid[row][col] -> string (we'll build this from tokens)
-    char*** grid = malloc(sizeof(char**) * line_count);
-    for(size_t i=0; i<line_count; i++) grid[i] = calloc(max_cols, sizeof(char*));
-    
+// Inverse of serialize_columns: fills grid[i][c] for the set's rows
+static void decode_columns(const uint8_t* decompressed, size_t* offset_ptr, char*** grid, size_t line_count,
+                           size_t max_cols, Arena* file_arena, Arena* col_arena) {
+    size_t offset = *offset_ptr;
     for (size_t c = 0; c < max_cols; c++) {
         uint8_t encoding_type = decompressed[offset++];
         
-        if (encoding_type == 1) {
-            // DICTIONARY
-            uint64_t dict_count = decode_varint(decompressed, &offset);
-            char** dict = malloc(sizeof(char*) * dict_count);
-            for(size_t k=0; k<dict_count; k++) {
-                uint64_t len = decode_varint(decompressed, &offset);
-                dict[k] = malloc(len+1);
-                memcpy(dict[k], decompressed+offset, len);
-                dict[k][len] = '\0';
-                offset += len;
-            }
+        if (encoding_type == 1 || encoding_type == 9) {
+            // DICTIONARY, front coded as 9
+            uint64_t dict_count;
+            char** dict = decode_dict_entries(decompressed, &offset, file_arena, encoding_type == 9, &dict_count);
             for(size_t i=0; i<line_count; i++) {
                 uint64_t id = decode_varint(decompressed, &offset);
-                if (id < dict_count) grid[i][c] = strdup(dict[id]);
-                else grid[i][c] = strdup("");
+                grid[i][c] = id < dict_count ? dict[id] : (char*)"";
             }
-            for(size_t k=0; k<dict_count; k++) free(dict[k]);
             free(dict);
         } else if (encoding_type == 2) {
             // DELTA
@@ -583,7 +1650,7 @@ int hyper_decompress_file(const char* input_path, const char* output_path, doubl
                 long long val = prev + delta;
                 char buf[64];
                 snprintf(buf, sizeof(buf), "%lld", val);
-                grid[i][c] = strdup(buf);
+                grid[i][c] = arena_strndup(file_arena, buf, strlen(buf));
                 prev = val;
             }
         } else if (encoding_type == 3) {
@@ -595,9 +1662,56 @@ int hyper_decompress_file(const char* input_path, const char* output_path, doubl
                 char buf[64];
                 snprintf(buf, sizeof(buf), "%u.%u.%u.%u", 
                         (ip >> 24) & 0xFF, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
-                grid[i][c] = strdup(buf);
+                grid[i][c] = arena_strndup(file_arena, buf, strlen(buf));
                 prev_ip = ip;
             }
+        } else if (encoding_type == 4) {
+            // RAW
+            for(size_t i=0; i<line_count; i++) {
+                uint64_t len = decode_varint(decompressed, &offset);
+                grid[i][c] = arena_strndup(file_arena, (const char*)decompressed + offset, len);
+                offset += len;
+            }
+        } else if (encoding_type == 7) {
+            // CONSTANT: every row shares one copy
+            uint64_t len = decode_varint(decompressed, &offset);
+            char* value = arena_strndup(file_arena, (const char*)decompressed + offset, len);
+            offset += len;
+            for(size_t i=0; i<line_count; i++) grid[i][c] = value;
+        } else if (encoding_type == 8 || encoding_type == 10) {
+            // DICTIONARY, ids as runs, front coded as 10
+            uint64_t dict_count;
+            char** dict = decode_dict_entries(decompressed, &offset, file_arena, encoding_type == 10, &dict_count);
+            uint64_t runs = decode_varint(decompressed, &offset);
+            size_t i = 0;
+            for(uint64_t r=0; r<runs; r++) {
+                uint64_t id = decode_varint(decompressed, &offset);
+                uint64_t run = decode_varint(decompressed, &offset);
+                char* value = id < dict_count ? dict[id] : (char*)"";
+                for(uint64_t k=0; k<run && i<line_count; k++) grid[i++][c] = value;
+            }
+            while (i < line_count) grid[i++][c] = (char*)"";
+            free(dict);
+        } else if (encoding_type == 6) {
+            // BINARY TOKENS (hex / UUID / base64)
+            uint8_t bin_format = decompressed[offset++];
+            for(size_t i=0; i<line_count; i++) {
+                grid[i][c] = decode_binary_token(file_arena, bin_format, decompressed, &offset);
+            }
+        } else if (encoding_type == 5) {
+            // ADDRESS
+            AddrCodec codec;
+            addr_codec_init(&codec);
+            char text[ADDR_MAX_TEXT];
+            for(size_t i=0; i<line_count; i++) {
+                size_t len;
+                if (addr_decode(&codec, decompressed, &offset, text, &len) == ADDR_FAMILY_NONE) {
+                    grid[i][c] = arena_strndup(file_arena, (const char*)decompressed + offset, len);
+                    offset += len;
+                } else {
+                    grid[i][c] = arena_strndup(file_arena, text, len);
+                }
+            }
         } else {
             // HYPER DECOMPOSITION
             uint64_t max_tokens = decode_varint(decompressed, &offset);
@@ -617,36 +1731,96 @@ int hyper_decompress_file(const char* input_path, const char* output_path, doubl
             
             for (size_t sc = 0; sc < max_tokens; sc++) {
                 sub_cols[sc] = malloc(sizeof(char*) * line_count);
-                uint8_t use_dict = decompressed[offset++];
+                uint8_t sub_encoding = decompressed[offset++];
                 
-                if (use_dict) {
-                    uint64_t dict_count = decode_varint(decompressed, &offset);
-                    char** dict = malloc(sizeof(char*) * dict_count);
-                    for(size_t k=0; k<dict_count; k++) {
-                        uint64_t len = decode_varint(decompressed, &offset);
-                        dict[k] = malloc(len+1);
-                        memcpy(dict[k], decompressed+offset, len);
-                        dict[k][len] = '\0';
-                        offset += len;
+                if (sub_encoding == 2 || sub_encoding == 3) {
+                    // Numeric sub-column (delta or bit-packed)
+                    size_t present = 0;
+                    for(size_t i=0; i<line_count; i++) if (sc < token_counts[i]) present++;
+                    uint64_t* numbers = malloc(sizeof(uint64_t) * (present ? present : 1));
+                    if (sub_encoding == 3) {
+                        decode_bitpacked(decompressed, &offset, numbers, present);
+                    } else {
+                        long long prev = 0;
+                        for(size_t k=0; k<present; k++) {
+                            uint64_t zigzag = decode_varint(decompressed, &offset);
+                            prev += (long long)((zigzag >> 1) ^ -(zigzag & 1));
+                            numbers[k] = (uint64_t)prev;
+                        }
                     }
+                    size_t k = 0;
                     for(size_t i=0; i<line_count; i++) {
                         if (sc < token_counts[i]) {
-                            uint64_t id = decode_varint(decompressed, &offset);
-                            if (id < dict_count) sub_cols[sc][i] = strdup(dict[id]);
-                            else sub_cols[sc][i] = strdup("");
+                            char buf[32];
+                            snprintf(buf, sizeof(buf), "%llu", (unsigned long long)numbers[k++]);
+                            sub_cols[sc][i] = arena_strndup(col_arena, buf, strlen(buf));
                         } else {
                             sub_cols[sc][i] = NULL;
                         }
                     }
-                    for(size_t k=0; k<dict_count; k++) free(dict[k]);
+                    free(numbers);
+                } else if (sub_encoding == 6) {
+                    // Constant: one copy for every row holding the token
+                    uint64_t len = decode_varint(decompressed, &offset);
+                    char* value = arena_strndup(col_arena, (const char*)decompressed + offset, len);
+                    offset += len;
+                    for(size_t i=0; i<line_count; i++) sub_cols[sc][i] = sc < token_counts[i] ? value : NULL;
+                } else if (sub_encoding == 5) {
+                    // Binary token sub-column
+                    uint8_t bin_format = decompressed[offset++];
+                    for(size_t i=0; i<line_count; i++) {
+                        if (sc < token_counts[i]) sub_cols[sc][i] = decode_binary_token(col_arena, bin_format, decompressed, &offset);
+                        else sub_cols[sc][i] = NULL;
+                    }
+                } else if (sub_encoding == 4) {
+                    // Address sub-column
+                    AddrCodec codec;
+                    addr_codec_init(&codec);
+                    char text[ADDR_MAX_TEXT];
+                    for(size_t i=0; i<line_count; i++) {
+                        if (sc < token_counts[i]) {
+                            size_t len;
+                            if (addr_decode(&codec, decompressed, &offset, text, &len) == ADDR_FAMILY_NONE) {
+                                sub_cols[sc][i] = arena_strndup(col_arena, (const char*)decompressed + offset, len);
+                                offset += len;
+                            } else {
+                                sub_cols[sc][i] = arena_strndup(col_arena, text, len);
+                            }
+                        } else {
+                            sub_cols[sc][i] = NULL;
+                        }
+                    }
+                } else if (sub_encoding == 1 || sub_encoding == 7 || sub_encoding == 8 || sub_encoding == 9) {
+                    // Dictionary, front coded as 8 and 9; 7 and 9 have id runs
+                    int with_runs = sub_encoding == 7 || sub_encoding == 9;
+                    uint64_t dict_count;
+                    char** dict = decode_dict_entries(decompressed, &offset, col_arena, sub_encoding >= 8, &dict_count);
+                    // Runs: the id is read at the start of each run
+                    uint64_t runs = with_runs ? decode_varint(decompressed, &offset) : 0;
+                    uint64_t id = 0, left = 0;
+                    for(size_t i=0; i<line_count; i++) {
+                        if (sc >= token_counts[i]) {
+                            sub_cols[sc][i] = NULL;
+                            continue;
+                        }
+                        if (!with_runs) {
+                            id = decode_varint(decompressed, &offset);
+                        } else if (left == 0 && runs > 0) {
+                            id = decode_varint(decompressed, &offset);
+                            left = decode_varint(decompressed, &offset);
+                            runs--;
+                        } else if (left == 0) {
+                            id = dict_count;
+                        }
+                        if (left) left--;
+                        sub_cols[sc][i] = id < dict_count ? dict[id] : (char*)"";
+                    }
                     free(dict);
                 } else {
                     for(size_t i=0; i<line_count; i++) {
                         if (sc < token_counts[i]) {
                             uint64_t len = decode_varint(decompressed, &offset);
-                            sub_cols[sc][i] = malloc(len+1);
-                            memcpy(sub_cols[sc][i], decompressed+offset, len);
-                            sub_cols[sc][i][len] = '\0';
+                            sub_cols[sc][i] = arena_strndup(col_arena, (const char*)decompressed + offset, len);
                             offset += len;
                         } else {
                             sub_cols[sc][i] = NULL;
@@ -660,20 +1834,140 @@ int hyper_decompress_file(const char* input_path, const char* output_path, doubl
                 for (size_t sc = 0; sc < token_counts[i]; sc++) {
                     if (sub_cols[sc][i]) total_len += strlen(sub_cols[sc][i]);
                 }
-                grid[i][c] = malloc(total_len + 1);
-                grid[i][c][0] = '\0';
+                char* cell = arena_alloc(file_arena, total_len + 1);
+                size_t pos = 0;
                 for (size_t sc = 0; sc < token_counts[i]; sc++) {
-                    if (sub_cols[sc][i]) strcat(grid[i][c], sub_cols[sc][i]);
+                    if (!sub_cols[sc][i]) continue;
+                    size_t len = strlen(sub_cols[sc][i]);
+                    memcpy(cell + pos, sub_cols[sc][i], len);
+                    pos += len;
                 }
+                cell[pos] = '\0';
+                grid[i][c] = cell;
             }
             
-            for(size_t sc=0; sc<max_tokens; sc++) {
-                for(size_t i=0; i<line_count; i++) free(sub_cols[sc][i]);
-                free(sub_cols[sc]);
-            }
+            for(size_t sc=0; sc<max_tokens; sc++) free(sub_cols[sc]);
             free(sub_cols);
             free(token_counts);
+            arena_reset(col_arena);
+        }
+    }
+    *offset_ptr = offset;
+}
+
+int hyper_decompress_file(const char* input_path, const char* output_path, double* duration) {
+    clock_t start = clock();
+    
+    FILE* fp = fopen(input_path, "rb");
+    if (!fp) return -1;
+    
+    char magic[HYPER_MAGIC_LEN];
+    fread(magic, 1, HYPER_MAGIC_LEN, fp);
+    if (memcmp(magic, HYPER_MAGIC, HYPER_MAGIC_LEN) != 0) { fclose(fp); return -1; }
+    
+    fseek(fp, 0, SEEK_END);
+    long fsize = ftell(fp);
+    fseek(fp, HYPER_MAGIC_LEN, SEEK_SET);
+    size_t comp_len = fsize - HYPER_MAGIC_LEN;
+    uint8_t* compressed = malloc(comp_len);
+    fread(compressed, 1, comp_len, fp);
+    fclose(fp);
+    
+    // Decompress
+    uint8_t* decompressed;
+    size_t decomp_len;
+    if (streams_is_stream(compressed, comp_len)) {
+        size_t consumed;
+        decompressed = streams_decompress(compressed, comp_len, &consumed, &decomp_len);
+        if (!decompressed) {
+            free(compressed);
+            return -1;
+        }
+    } else if (cm_is_stream(compressed, comp_len)) {
+        size_t consumed;
+        decompressed = cm_decompress(compressed, comp_len, &consumed, &decomp_len);
+    } else {
+        // Grown until the stream ends, repetitive logs beat any fixed ratio
+        size_t decomp_cap = comp_len * 30 + 4096;
+        decompressed = malloc(decomp_cap);
+        lzma_stream strm = LZMA_STREAM_INIT;
+        lzma_stream_decoder(&strm, UINT64_MAX, 0);
+        strm.next_in = compressed;
+        strm.avail_in = comp_len;
+        strm.next_out = decompressed;
+        strm.avail_out = decomp_cap;
+        while (lzma_code(&strm, LZMA_FINISH) == LZMA_OK) {
+            if (strm.avail_out == 0) {
+                decomp_cap *= 2;
+                decompressed = realloc(decompressed, decomp_cap);
+                strm.next_out = decompressed + strm.total_out;
+                strm.avail_out = decomp_cap - strm.total_out;
+            }
+        }
+        decomp_len = strm.total_out;
+        lzma_end(&strm);
+    }
+    free(compressed);
+    
+    // Parse
+    size_t offset = 0;
+    uint64_t line_count = decode_varint(decompressed, &offset);
+    uint64_t max_cols = decode_varint(decompressed, &offset);
+    
+    // Clustered rows: the partition of every row, the partitions follow
+    uint64_t partitions = 1;
+    const uint8_t* partition = NULL;
+    if (max_cols == HYPER_CLUSTERED) {
+        partitions = decode_varint(decompressed, &offset);
+        partition = decompressed + offset;
+        offset += line_count;
+    }
+    
+    // Reconstruct grid
+    // grid[row][col] -> string (we'll build this from tokens). Cells live in
+    // the file arena and dictionary cells share their entry; sub-column
+    // pieces live in the column arena until they are joined
+    Arena file_arena, col_arena;
+    arena_init(&file_arena);
+    arena_init(&col_arena);
+    char*** grid = malloc(sizeof(char**) * (line_count ? line_count : 1));
+    size_t* row_cols = malloc(sizeof(size_t) * (line_count ? line_count : 1));
+    char*** rows = malloc(sizeof(char**) * (line_count ? line_count : 1));
+    for (size_t p = 0; p < partitions; p++) {
+        size_t cols = partition ? decode_varint(decompressed, &offset) : max_cols;
+        size_t count = 0;
+        for(size_t i=0; i<line_count; i++) {
+            if (partition && partition[i] != p) continue;
+            grid[i] = arena_alloc(&file_arena, sizeof(char*) * (cols ? cols : 1));
+            memset(grid[i], 0, sizeof(char*) * cols);
+            row_cols[i] = cols;
+            rows[count++] = grid[i];
+        }
+        decode_columns(decompressed, &offset, rows, count, cols, &file_arena, &col_arena);
+    }
+    free(rows);
+    
+    // Trace section (streams written before it have none)
+    char** traces = NULL;
+    if (offset < decomp_len) {
+        traces = calloc(line_count, sizeof(char*));
+        uint64_t dict_count = decode_varint(decompressed, &offset);
+        char** dict = malloc(sizeof(char*) * dict_count);
+        for(size_t k=0; k<dict_count; k++) {
+            uint64_t len = decode_varint(decompressed, &offset);
+            dict[k] = arena_strndup(&col_arena, (const char*)decompressed + offset, len);
+            offset += len;
+        }
+        uint64_t* ids = malloc(sizeof(uint64_t) * line_count);
+        for(size_t i=0; i<line_count; i++) ids[i] = decode_varint(decompressed, &offset);
+        for(size_t i=0; i<line_count; i++) {
+            uint64_t len = decode_varint(decompressed, &offset);
+            char* msg = arena_strndup(&col_arena, (const char*)decompressed + offset, len);
+            offset += len;
+            if (ids[i] < dict_count && dict[ids[i]][0]) traces[i] = frame_join(dict[ids[i]], msg);
         }
+        free(dict);
+        free(ids);
     }
     
     free(decompressed);
@@ -681,22 +1975,26 @@ int hyper_decompress_file(const char* input_path, const char* output_path, doubl
     // Write output
     FILE* out_fp = fopen(output_path, "w");
     for (size_t i = 0; i < line_count; i++) {
-        for (size_t c = 0; c < max_cols; c++) {
+        for (size_t c = 0; c < row_cols[i]; c++) {
             if (grid[i][c]) {
                 fprintf(out_fp, "%s", grid[i][c]);
-                if (c < max_cols - 1 && grid[i][c+1]) fprintf(out_fp, " "); // Assuming space separator
+                if (c < row_cols[i] - 1 && grid[i][c+1]) fprintf(out_fp, " "); // Assuming space separator
             }
         }
+        if (traces && traces[i]) fprintf(out_fp, "\n%s", traces[i]);
         fprintf(out_fp, "\n");
     }
     fclose(out_fp);
     
     // Cleanup
-    for(size_t i=0; i<line_count; i++) {
-        for(size_t c=0; c<max_cols; c++) free(grid[i][c]);
-        free(grid[i]);
+    if (traces) {
+        for(size_t i=0; i<line_count; i++) free(traces[i]);
     }
     free(grid);
+    free(row_cols);
+    free(traces);
+    arena_free(&file_arena);
+    arena_free(&col_arena);
     
     clock_t end = clock();
     *duration = (double)(end - start) / CLOCKS_PER_SEC;
@@ -12,9 +12,36 @@ echo Compiling shared utilities...
 gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_utils.c -o build/ulc_utils.o
 if errorlevel 1 goto error
 
+gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_arena.c -o build/ulc_arena.o
+if errorlevel 1 goto error
+
 gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_parser.c -o build/ulc_parser.o
 if errorlevel 1 goto error
 
+gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_addr.c -o build/ulc_addr.o
+if errorlevel 1 goto error
+
+gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_cm.c -o build/ulc_cm.o
+if errorlevel 1 goto error
+
+gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_stream.c -o build/ulc_stream.o
+if errorlevel 1 goto error
+
+gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_json.c -o build/ulc_json.o
+if errorlevel 1 goto error
+
+gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_logfmt.c -o build/ulc_logfmt.o
+if errorlevel 1 goto error
+
+gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_frame.c -o build/ulc_frame.o
+if errorlevel 1 goto error
+
+gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_envelope.c -o build/ulc_envelope.o
+if errorlevel 1 goto error
+
+gcc -Wall -Wextra -O3 -I../ulc-c/include -c ../ulc-c/src/ulc_spec.c -o build/ulc_spec.o
+if errorlevel 1 goto error
+
 REM Compile ULC-Ultra components
 echo Compiling pattern mining...
 gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_ultra_pattern.c -o build/ulc_ultra_pattern.o
@@ -24,6 +51,18 @@ echo Compiling Huffman coding...
 gcc -Wall -Wextra -O3 -Iinclude -c src/ulc_ultra_huffman.c -o build/ulc_ultra_huffman.o
 if errorlevel 1 goto error
 
+echo Compiling rANS coding...
+gcc -Wall -Wextra -O3 -Iinclude -I../ulc-c/include -c src/ulc_ultra_rans.c -o build/ulc_ultra_rans.o
+if errorlevel 1 goto error
+
+echo Compiling conditional id coding...
+gcc -Wall -Wextra -O3 -Iinclude -I../ulc-c/include -c src/ulc_ultra_context.c -o build/ulc_ultra_context.o
+if errorlevel 1 goto error
+
+echo Compiling BWT stage...
+gcc -Wall -Wextra -O3 -Iinclude -I../ulc-c/include -c src/ulc_ultra_bwt.c -o build/ulc_ultra_bwt.o
+if errorlevel 1 goto error
+
 echo Compiling compression engine...
 gcc -Wall -Wextra -O3 -Iinclude -I../ulc-c/include -c src/ulc_ultra_compress.c -o build/ulc_ultra_compress.o
 if errorlevel 1 goto error
@@ -34,7 +73,7 @@ if errorlevel 1 goto error
 
 REM Link executable
 echo Linking ulc-ultra.exe...
-gcc build/ulc_utils.o build/ulc_parser.o build/ulc_ultra_pattern.o build/ulc_ultra_huffman.o build/ulc_ultra_compress.o build/ulc_ultra_cli.o -llzma -o ulc-ultra.exe
+gcc build/ulc_utils.o build/ulc_arena.o build/ulc_parser.o build/ulc_addr.o build/ulc_cm.o build/ulc_stream.o build/ulc_json.o build/ulc_logfmt.o build/ulc_frame.o build/ulc_envelope.o build/ulc_spec.o build/ulc_ultra_pattern.o build/ulc_ultra_huffman.o build/ulc_ultra_rans.o build/ulc_ultra_context.o build/ulc_ultra_bwt.o build/ulc_ultra_compress.o build/ulc_ultra_cli.o -llzma -lpthread -lm -o ulc-ultra.exe
 if errorlevel 1 goto error
 
 echo.
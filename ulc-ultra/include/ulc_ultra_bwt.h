@@ -0,0 +1,28 @@
+#ifndef ULC_ULTRA_BWT_H
+#define ULC_ULTRA_BWT_H
+
+#include "../../ulc-c/include/ulc_types.h"
+
+// Default BWT block size (bzip2 uses 900k)
+#define BWT_BLOCK_SIZE (1024 * 1024)
+
+// Threads used by the inverse transform
+#define BWT_DECODE_THREADS 4
+
+// Suffix array of data via SA-IS (linear time); sa needs len + 1 entries,
+// sa[0] is the empty suffix
+void sais_build(const uint8_t* data, size_t len, int32_t* sa);
+
+// Burrows-Wheeler transform of one block, returns the primary index
+size_t bwt_forward(const uint8_t* data, size_t len, uint8_t* out);
+
+// Inverse transform of one block
+void bwt_inverse(const uint8_t* bwt, size_t len, size_t primary, uint8_t* out);
+
+// Block-wise BWT -> MTF -> zero-run RLE of a column stream
+ByteArray* bwt_encode_stream(const uint8_t* data, size_t len, size_t block_size);
+
+// Inverse of bwt_encode_stream, blocks are inverted in parallel
+uint8_t* bwt_decode_stream(const uint8_t* data, size_t len, size_t* out_len);
+
+#endif // ULC_ULTRA_BWT_H
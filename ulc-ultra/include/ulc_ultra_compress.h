@@ -2,6 +2,7 @@
 #define ULC_ULTRA_COMPRESS_H
 
 #include "ulc_ultra_types.h"
+#include "../../ulc-c/include/ulc_spec.h"
 
 // Create ultra compressor with compression level (1-10)
 UltraCompressor* ultra_compressor_new(int compression_level);
@@ -10,6 +11,15 @@ UltraCompressor* ultra_compressor_new(int compression_level);
 int ultra_compress_file(const char* input_path, const char* output_path,
                         size_t* orig_size, size_t* comp_size, double* duration);
 
+// Compress at an explicit level (ULTRA_LEVEL_MAX selects context mixing)
+int ultra_compress_file_level(const char* input_path, const char* output_path, int level,
+                              size_t* orig_size, size_t* comp_size, double* duration);
+
+// Compress lines of a declared format (NULL detects it as usual): matching
+// lines split on the spec and keep its field types
+int ultra_compress_file_spec(const char* input_path, const char* output_path, int level, const FormatSpec* spec,
+                             size_t* orig_size, size_t* comp_size, double* duration);
+
 // Decompress ultra-compressed file
 int ultra_decompress_file(const char* input_path, const char* output_path, double* duration);
 
@@ -0,0 +1,39 @@
+#ifndef ULC_ULTRA_CONTEXT_H
+#define ULC_ULTRA_CONTEXT_H
+
+#include "ulc_ultra_types.h"
+#include "../../ulc-c/include/ulc_types.h"
+
+// Conditional coding of dictionary ids. A column's ids are predicted from a
+// context: the same column's id in the previous row, or an earlier column's
+// id in the same row. Each context value has its own small dictionary of
+// the ids seen under it, most frequent first; a row is then a "same as
+// predicted" bit or the rank of its id in that dictionary.
+
+#define CONTEXT_NONE (-2)
+#define CONTEXT_PREVIOUS_ROW (-1)
+
+#define CONTEXT_SAMPLE_ROWS 65536
+#define CONTEXT_MIN_ROWS 1024
+#define CONTEXT_MAX_CONTEXTS 65536   // Predictor alphabets beyond this are not tried
+
+// Model over field_count columns of rows rows
+ContextModel* context_model_new(size_t field_count, size_t rows);
+void context_model_free(ContextModel* model);
+
+// Record a dictionary column's ids (the model takes ownership)
+void context_model_set(ContextModel* model, size_t column, uint32_t* ids, size_t alphabet);
+
+// Best predictor of a recorded column by conditional entropy on a sample,
+// CONTEXT_NONE when nothing saves at least a quarter of its bits
+int context_model_fit(ContextModel* model, size_t column);
+
+// Predictor code, per-context dictionaries, hit bits and residual ranks of
+// the column's first rows ids
+void context_encode(ByteArray* out, const ContextModel* model, size_t column, int predictor, size_t rows);
+
+// Ids of a column written by context_encode over all rows (malloc'd);
+// its predictor must already be recorded
+uint32_t* context_decode(const uint8_t* data, size_t* offset, const ContextModel* model, size_t alphabet);
+
+#endif // ULC_ULTRA_CONTEXT_H
@@ -2,23 +2,37 @@
 #define ULC_ULTRA_HUFFMAN_H
 
 #include "ulc_ultra_types.h"
+#include "../../ulc-c/include/ulc_types.h"
 
-// Create Huffman encoder from frequency table
+// Create canonical, length-limited (package-merge) codes from a frequency
+// table; symbol_count must not exceed HUFF_MAX_SYMBOLS
 HuffmanEncoder* huffman_create(int* frequencies, size_t symbol_count);
 
-// Encode data with Huffman codes
-BitStream* huffman_encode(HuffmanEncoder* encoder, uint8_t* data, size_t data_len);
+// Rebuild an encoder from stored code lengths
+HuffmanEncoder* huffman_from_lengths(const uint8_t* lengths, size_t symbol_count);
 
-// Decode Huffman-encoded data
-uint8_t* huffman_decode(HuffmanEncoder* encoder, BitStream* stream, size_t* out_len);
+// Encode symbols with Huffman codes
+BitStream* huffman_encode(HuffmanEncoder* encoder, const uint16_t* data, size_t data_len);
+
+// Decode count symbols (table driven, several symbols per probe)
+void huffman_decode(HuffmanEncoder* encoder, BitStream* stream, uint16_t* out, size_t count);
 
 // Free Huffman encoder
 void huffman_free(HuffmanEncoder* encoder);
 
+// Self-describing block: code lengths plus HUFF_STREAMS interleaved streams
+void huffman_encode_block(ByteArray* out, const uint16_t* symbols, size_t count, size_t alphabet);
+void huffman_decode_block(const uint8_t* data, size_t* offset, uint16_t* out, size_t count);
+
+// Exact size of huffman_encode_block output
+size_t huffman_block_size(const uint16_t* symbols, size_t count, size_t alphabet);
+
 // Bit stream operations
 BitStream* bitstream_new(size_t initial_capacity);
+BitStream* bitstream_wrap(const uint8_t* data, size_t len);
 void bitstream_write_bit(BitStream* stream, int bit);
 void bitstream_write_bits(BitStream* stream, uint32_t value, int num_bits);
+void bitstream_flush(BitStream* stream);
 int bitstream_read_bit(BitStream* stream);
 uint32_t bitstream_read_bits(BitStream* stream, int num_bits);
 void bitstream_free(BitStream* stream);
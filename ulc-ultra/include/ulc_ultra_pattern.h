@@ -18,7 +18,23 @@ int add_pattern(PatternDict* dict, const char* pattern, int frequency);
 // Free pattern dictionary
 void pattern_dict_free(PatternDict* dict);
 
-// Replace patterns in text with IDs
+// Match text against mined templates: returns the template text ("<*>" for
+// parameters) and the token indices of the parameters, or a copy of the text
 char* replace_patterns(const char* text, PatternDict* dict, int** pattern_positions, int* position_count);
 
+// Create Drain-style template miner (depth >= 3, similarity in 0..1)
+TemplateMiner* template_miner_new(int depth, double similarity);
+
+// Assign a message (split on single spaces) to a template, returns its id
+int template_miner_add(TemplateMiner* miner, const char* message);
+
+// Split a message the way the miner does; tokens point into a copy owned by *buffer
+size_t template_tokenize(const char* message, char** buffer, char*** tokens);
+
+// Render a template with "<*>" in parameter slots
+char* template_to_string(const LogTemplate* tmpl);
+
+// Free template miner
+void template_miner_free(TemplateMiner* miner);
+
 #endif // ULC_ULTRA_PATTERN_H
@@ -0,0 +1,22 @@
+#ifndef ULC_ULTRA_RANS_H
+#define ULC_ULTRA_RANS_H
+
+#include "../../ulc-c/include/ulc_types.h"
+
+// Interleaved states; symbol stream is split into this many segments
+#define RANS_STATES 8
+
+// Frequencies are normalized to 1 << RANS_PROB_BITS
+#define RANS_PROB_BITS 12
+
+// Estimated rans_encode_block size for order 0 or 1 (exact model cost,
+// payload from the entropy of the normalized frequencies)
+size_t rans_estimate(const uint8_t* data, size_t len, int order);
+
+// Self-describing block: order, length, frequency tables, 16-bit word payload
+void rans_encode_block(ByteArray* out, const uint8_t* data, size_t len, int order);
+
+// Decode a block at data + *offset, returns a malloc'd buffer of *out_len bytes
+uint8_t* rans_decode_block(const uint8_t* data, size_t* offset, size_t* out_len);
+
+#endif // ULC_ULTRA_RANS_H
@@ -8,6 +8,18 @@
 #define ULCU_MAGIC "ULCU"
 #define ULCU_MAGIC_LEN 4
 
+// Header flags (int after the magic)
+#define ULCU_FLAG_SIDE_STREAMS 1   // Entropy-coded side streams follow the LZMA stream
+#define ULCU_FLAG_CM 2             // Column stream is context-mixed instead of LZMA
+#define ULCU_FLAG_KEYED 4          // Columns are JSON/logfmt/container keys, named in the stream
+#define ULCU_FLAG_TRACES 8         // Last two columns hold multi-line traces (frames, messages)
+#define ULCU_FLAG_STREAMS 16       // Column stream is per-column streams instead of one LZMA stream
+#define ULCU_FLAG_CRLF 32          // Every line ended in CRLF (otherwise a CR stays in its line)
+
+// Compression levels; the max level swaps LZMA for context mixing
+#define ULTRA_LEVEL_DEFAULT 9
+#define ULTRA_LEVEL_MAX 10
+
 // Pattern structure for frequent pattern mining
 typedef struct {
     char* pattern;
@@ -22,40 +34,85 @@ typedef struct {
     size_t capacity;
 } PatternDict;
 
-// Huffman tree node
-typedef struct HuffmanNode {
-    int symbol;
+// Log template mined from free-text messages (Drain-style)
+typedef struct {
+    char** tokens;         // Constant tokens, NULL marks a parameter slot
+    size_t token_count;
+    size_t param_count;
     int frequency;
-    struct HuffmanNode* left;
-    struct HuffmanNode* right;
-} HuffmanNode;
+    int id;
+} LogTemplate;
+
+// Fixed-depth parse tree node (token count, then leading tokens, then clusters)
+typedef struct TemplateNode {
+    char* key;
+    struct TemplateNode** children;
+    size_t child_count;
+    size_t child_capacity;
+    int* template_ids;     // Clusters stored at the leaf
+    size_t template_count;
+    size_t template_capacity;
+} TemplateNode;
 
-// Huffman code
+// Online template miner
+typedef struct {
+    TemplateNode* root;
+    LogTemplate* templates;
+    size_t template_count;
+    size_t template_capacity;
+    int depth;             // Tree depth including the length level and leaves
+    double similarity;     // Minimum share of matching tokens to join a cluster
+    size_t max_children;
+} TemplateMiner;
+
+// Huffman limits: codes are length-limited so one table probe always
+// resolves at least one symbol
+#define HUFF_MAX_SYMBOLS 1024
+#define HUFF_MAX_BITS 12
+#define HUFF_TABLE_SIZE (1 << HUFF_MAX_BITS)
+#define HUFF_MULTI 3          // Symbols resolved per table probe (at most)
+#define HUFF_STREAMS 4        // Interleaved streams per block
+
+// Canonical Huffman code (stored bit-reversed for the LSB-first writer)
 typedef struct {
     uint32_t code;
     int length;
 } HuffmanCode;
 
-// Huffman encoder
+// Decode table entry: up to HUFF_MULTI symbols packed in the next
+// HUFF_MAX_BITS bits of input
+typedef struct {
+    uint16_t symbols[HUFF_MULTI];
+    uint8_t count;
+    uint8_t bits;
+} HuffmanTableEntry;
+
+// Huffman encoder/decoder
 typedef struct {
     HuffmanCode* codes;
     size_t code_count;
-    HuffmanNode* root;
+    HuffmanTableEntry* table;
 } HuffmanEncoder;
 
-// Context model for field prediction
+// Context model for field prediction: dictionary ids of the columns seen
+// so far, and how well each predictor (the previous row, then each column)
+// explains a column's ids
 typedef struct {
-    int** correlation_matrix;  // Field correlation scores
-    int* field_counts;
+    int** correlation_matrix;  // [column][predictor]: milli-bits per row saved, 0 if untried
+    int* field_counts;         // Dictionary size per column, 0 when not dictionary-coded
     size_t field_count;
+    uint32_t** ids;            // Dictionary ids per column (NULL when not dictionary-coded)
+    size_t rows;
 } ContextModel;
 
-// Bit stream for Huffman encoding
+// Bit stream for Huffman encoding (64-bit buffer, LSB-first)
 typedef struct {
     uint8_t* data;
     size_t byte_pos;
-    int bit_pos;
     size_t capacity;
+    size_t length;          // Bytes available when reading
+    uint64_t bit_buffer;
+    int bit_count;
 } BitStream;
 
 // Ultra compressor state
@@ -0,0 +1,344 @@
+#include "../include/ulc_ultra_bwt.h"
+#include "../../ulc-c/include/ulc_utils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// --- SA-IS (Nong, Zhang, Chan 2009) ---
+// Works on an int string whose last symbol is a unique sentinel 0.
+
+#define TYPE_S(i) ((types[(i) >> 3] >> ((i) & 7)) & 1)
+#define IS_LMS(i) ((i) > 0 && TYPE_S(i) && !TYPE_S((i) - 1))
+
+static void get_buckets(const int32_t* s, size_t n, int32_t k, int32_t* bkt, int end) {
+    memset(bkt, 0, sizeof(int32_t) * (k + 1));
+    for (size_t i = 0; i < n; i++) bkt[s[i]]++;
+    int32_t sum = 0;
+    for (int32_t c = 0; c <= k; c++) {
+        sum += bkt[c];
+        bkt[c] = end ? sum : sum - bkt[c];
+    }
+}
+
+static void induce_l(const uint8_t* types, int32_t* sa, const int32_t* s, int32_t* bkt, size_t n, int32_t k) {
+    get_buckets(s, n, k, bkt, 0);
+    for (size_t i = 0; i < n; i++) {
+        int32_t j = sa[i] - 1;
+        if (j >= 0 && !TYPE_S(j)) sa[bkt[s[j]]++] = j;
+    }
+}
+
+static void induce_s(const uint8_t* types, int32_t* sa, const int32_t* s, int32_t* bkt, size_t n, int32_t k) {
+    get_buckets(s, n, k, bkt, 1);
+    for (size_t i = n; i-- > 0; ) {
+        int32_t j = sa[i] - 1;
+        if (j >= 0 && TYPE_S(j)) sa[--bkt[s[j]]] = j;
+    }
+}
+
+static void sais_core(const int32_t* s, int32_t* sa, size_t n, int32_t k) {
+    uint8_t* types = calloc(n / 8 + 1, 1);
+    int32_t* bkt = malloc(sizeof(int32_t) * (k + 1));
+
+    // Classify suffixes (the sentinel is S-type)
+    types[(n - 1) >> 3] |= 1 << ((n - 1) & 7);
+    for (size_t i = n - 1; i-- > 0; ) {
+        if (s[i] < s[i + 1] || (s[i] == s[i + 1] && TYPE_S(i + 1))) {
+            types[i >> 3] |= 1 << (i & 7);
+        }
+    }
+
+    // Stage 1: sort LMS substrings by induction
+    get_buckets(s, n, k, bkt, 1);
+    for (size_t i = 0; i < n; i++) sa[i] = -1;
+    for (size_t i = 1; i < n; i++) {
+        if (IS_LMS(i)) sa[--bkt[s[i]]] = (int32_t)i;
+    }
+    induce_l(types, sa, s, bkt, n, k);
+    induce_s(types, sa, s, bkt, n, k);
+
+    // Compact sorted LMS substrings into sa[0..n1)
+    size_t n1 = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (IS_LMS(sa[i])) sa[n1++] = sa[i];
+    }
+
+    // Name the substrings; equal substrings share a name
+    for (size_t i = n1; i < n; i++) sa[i] = -1;
+    int32_t name = 0;
+    int32_t prev = -1;
+    for (size_t i = 0; i < n1; i++) {
+        int32_t pos = sa[i];
+        int diff = 0;
+        for (size_t d = 0; d < n; d++) {
+            if (prev == -1 || s[pos + d] != s[prev + d] || TYPE_S(pos + d) != TYPE_S(prev + d)) {
+                diff = 1;
+                break;
+            }
+            if (d > 0 && (IS_LMS(pos + d) || IS_LMS(prev + d))) break;
+        }
+        if (diff) {
+            name++;
+            prev = pos;
+        }
+        sa[n1 + pos / 2] = name - 1;
+    }
+    for (size_t i = n, j = n; i-- > n1; ) {
+        if (sa[i] >= 0) sa[--j] = sa[i];
+    }
+
+    // Stage 2: sort the reduced string (recurse while names repeat)
+    int32_t* sa1 = sa;
+    int32_t* s1 = sa + n - n1;
+    if ((size_t)name < n1) {
+        sais_core(s1, sa1, n1, name - 1);
+    } else {
+        for (size_t i = 0; i < n1; i++) sa1[s1[i]] = (int32_t)i;
+    }
+
+    // Stage 3: place sorted LMS suffixes and induce the rest
+    for (size_t i = 1, j = 0; i < n; i++) {
+        if (IS_LMS(i)) s1[j++] = (int32_t)i;
+    }
+    for (size_t i = 0; i < n1; i++) sa1[i] = s1[sa1[i]];
+    for (size_t i = n1; i < n; i++) sa[i] = -1;
+    get_buckets(s, n, k, bkt, 1);
+    for (size_t i = n1; i-- > 0; ) {
+        int32_t j = sa[i];
+        sa[i] = -1;
+        sa[--bkt[s[j]]] = j;
+    }
+    induce_l(types, sa, s, bkt, n, k);
+    induce_s(types, sa, s, bkt, n, k);
+
+    free(bkt);
+    free(types);
+}
+
+void sais_build(const uint8_t* data, size_t len, int32_t* sa) {
+    // Shift bytes up by one so 0 is free for the sentinel
+    int32_t* s = malloc(sizeof(int32_t) * (len + 1));
+    for (size_t i = 0; i < len; i++) s[i] = (int32_t)data[i] + 1;
+    s[len] = 0;
+    sais_core(s, sa, len + 1, 256);
+    free(s);
+}
+
+// --- BWT ---
+
+size_t bwt_forward(const uint8_t* data, size_t len, uint8_t* out) {
+    int32_t* sa = malloc(sizeof(int32_t) * (len + 1));
+    sais_build(data, len, sa);
+
+    // Row whose rotation starts at 0 holds the sentinel; it is dropped and its
+    // position kept as the primary index
+    size_t primary = 0;
+    size_t n = 0;
+    for (size_t i = 0; i <= len; i++) {
+        if (sa[i] == 0) {
+            primary = i;
+            continue;
+        }
+        out[n++] = data[sa[i] - 1];
+    }
+    free(sa);
+    return primary;
+}
+
+void bwt_inverse(const uint8_t* bwt, size_t len, size_t primary, uint8_t* out) {
+    // LF mapping over the len + 1 rows, the sentinel sorts first
+    size_t base[256];
+    size_t count[256] = {0};
+    for (size_t i = 0; i < len; i++) count[bwt[i]]++;
+    size_t sum = 1;
+    for (int c = 0; c < 256; c++) {
+        base[c] = sum;
+        sum += count[c];
+    }
+
+    uint32_t* lf = malloc(sizeof(uint32_t) * (len + 1));
+    uint8_t* last = malloc(len + 1);
+    for (size_t i = 0, k = 0; i <= len; i++) {
+        if (i == primary) {
+            lf[i] = 0;
+            last[i] = 0;
+            continue;
+        }
+        uint8_t c = bwt[k++];
+        last[i] = c;
+        lf[i] = (uint32_t)base[c]++;
+    }
+
+    // Row 0 is the sentinel suffix, its last column is the final byte
+    size_t row = 0;
+    for (size_t k = len; k-- > 0; ) {
+        out[k] = last[row];
+        row = lf[row];
+    }
+
+    free(lf);
+    free(last);
+}
+
+// --- MTF + zero-run RLE ---
+// Symbols: 0/1 = RUNA/RUNB (bijective base-2 run of zeros, as in bzip2),
+// 2..254 = MTF rank 1..253, 255 + byte = rank 254..255
+
+#define RLE_RUNA 0
+#define RLE_RUNB 1
+#define RLE_ESCAPE 255
+
+static void rle_flush_run(ByteArray* out, size_t run) {
+    while (run > 0) {
+        if (run & 1) {
+            bytearray_append_byte(out, RLE_RUNA);
+            run = (run - 1) >> 1;
+        } else {
+            bytearray_append_byte(out, RLE_RUNB);
+            run = (run - 2) >> 1;
+        }
+    }
+}
+
+static void mtf_rle_encode(ByteArray* out, const uint8_t* data, size_t len) {
+    uint8_t order[256];
+    for (int c = 0; c < 256; c++) order[c] = (uint8_t)c;
+
+    size_t run = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+        int rank = 0;
+        while (order[rank] != c) rank++;
+        if (rank == 0) {
+            run++;
+            continue;
+        }
+        memmove(order + 1, order, rank);
+        order[0] = c;
+
+        rle_flush_run(out, run);
+        run = 0;
+        if (rank < 254) {
+            bytearray_append_byte(out, (uint8_t)(rank + 1));
+        } else {
+            bytearray_append_byte(out, RLE_ESCAPE);
+            bytearray_append_byte(out, (uint8_t)(rank - 254));
+        }
+    }
+    rle_flush_run(out, run);
+}
+
+static void mtf_rle_decode(const uint8_t* data, size_t len, uint8_t* out, size_t out_len) {
+    uint8_t order[256];
+    for (int c = 0; c < 256; c++) order[c] = (uint8_t)c;
+
+    size_t i = 0, n = 0;
+    while (i < len && n < out_len) {
+        uint8_t sym = data[i++];
+        if (sym <= RLE_RUNB) {
+            size_t run = 0;
+            size_t weight = 1;
+            i--;
+            while (i < len && data[i] <= RLE_RUNB) {
+                run += (data[i] == RLE_RUNA ? 1 : 2) * weight;
+                weight <<= 1;
+                i++;
+            }
+            memset(out + n, order[0], run);
+            n += run;
+            continue;
+        }
+
+        int rank = sym == RLE_ESCAPE ? 254 + data[i++] : sym - 1;
+        uint8_t c = order[rank];
+        memmove(order + 1, order, rank);
+        order[0] = c;
+        out[n++] = c;
+    }
+}
+
+// --- Block streams ---
+// Layout: varint total length, varint block count, then per block
+// varint length, varint primary, varint encoded length, MTF/RLE symbols
+
+ByteArray* bwt_encode_stream(const uint8_t* data, size_t len, size_t block_size) {
+    ByteArray* out = bytearray_new(len / 2 + 64);
+    size_t block_count = (len + block_size - 1) / block_size;
+    encode_varint(out, len);
+    encode_varint(out, block_count);
+
+    uint8_t* bwt = malloc(block_size);
+    ByteArray* symbols = bytearray_new(block_size);
+    for (size_t b = 0; b < block_count; b++) {
+        size_t start = b * block_size;
+        size_t n = len - start < block_size ? len - start : block_size;
+        size_t primary = bwt_forward(data + start, n, bwt);
+
+        symbols->length = 0;
+        mtf_rle_encode(symbols, bwt, n);
+
+        encode_varint(out, n);
+        encode_varint(out, primary);
+        encode_varint(out, symbols->length);
+        bytearray_append(out, symbols->data, symbols->length);
+    }
+
+    bytearray_free(symbols);
+    free(bwt);
+    return out;
+}
+
+typedef struct {
+    const uint8_t* symbols;
+    size_t symbol_len;
+    size_t len;
+    size_t primary;
+    uint8_t* out;
+} BwtBlockJob;
+
+static void* bwt_decode_worker(void* arg) {
+    BwtBlockJob* job = arg;
+    uint8_t* bwt = malloc(job->len + 1);
+    mtf_rle_decode(job->symbols, job->symbol_len, bwt, job->len);
+    bwt_inverse(bwt, job->len, job->primary, job->out);
+    free(bwt);
+    return NULL;
+}
+
+uint8_t* bwt_decode_stream(const uint8_t* data, size_t len, size_t* out_len) {
+    size_t offset = 0;
+    uint64_t total = decode_varint(data, &offset);
+    uint64_t block_count = decode_varint(data, &offset);
+    uint8_t* out = malloc(total + 1);
+
+    BwtBlockJob* jobs = malloc(sizeof(BwtBlockJob) * (block_count + 1));
+    size_t pos = 0;
+    for (size_t b = 0; b < block_count && offset < len; b++) {
+        jobs[b].len = decode_varint(data, &offset);
+        jobs[b].primary = decode_varint(data, &offset);
+        jobs[b].symbol_len = decode_varint(data, &offset);
+        jobs[b].symbols = data + offset;
+        jobs[b].out = out + pos;
+        offset += jobs[b].symbol_len;
+        pos += jobs[b].len;
+    }
+
+    // Blocks are independent: invert them in waves of BWT_DECODE_THREADS
+    pthread_t threads[BWT_DECODE_THREADS];
+    for (size_t b = 0; b < block_count; b += BWT_DECODE_THREADS) {
+        size_t wave = block_count - b < BWT_DECODE_THREADS ? block_count - b : BWT_DECODE_THREADS;
+        if (wave == 1) {
+            bwt_decode_worker(&jobs[b]);
+            continue;
+        }
+        for (size_t t = 0; t < wave; t++) {
+            pthread_create(&threads[t], NULL, bwt_decode_worker, &jobs[b + t]);
+        }
+        for (size_t t = 0; t < wave; t++) pthread_join(threads[t], NULL);
+    }
+
+    free(jobs);
+    out[total] = '\0';
+    *out_len = total;
+    return out;
+}
@@ -6,10 +6,17 @@
 static void print_usage(const char* prog_name) {
     printf("ULC-Ultra: Maximum Compression for Structured Logs\n\n");
     printf("Usage:\n");
-    printf("  %s compress <input> [-o <output>]\n", prog_name);
+    printf("  %s compress <input> [-o <output>] [--max] [--format-spec <spec> | --format-spec-file <file>]\n", prog_name);
     printf("  %s decompress <input> [-o <output>]\n\n", prog_name);
     printf("WARNING: ULC-Ultra is optimized for maximum compression ratio.\n");
     printf("         It is SLOWER and uses MORE MEMORY than standard ULC.\n\n");
+    printf("Options:\n");
+    printf("  --max                     Context-mixing backend for cold storage (~1 MB/s per thread)\n");
+    printf("  --format-spec <spec>      Declared line format instead of detection, nginx\n");
+    printf("                            log_format ('$remote_addr [$time_local] \"$request\" $status')\n");
+    printf("                            or Apache LogFormat ('%%h %%l %%u %%t \"%%r\" %%>s %%b');\n");
+    printf("                            ${name:int|ip|str} sets a field's type\n");
+    printf("  --format-spec-file <file> First non-comment line of <file> as the spec\n\n");
     printf("Supported formats:\n");
     printf("  ✓ Apache/Nginx logs\n");
     printf("  ✓ Syslog\n");
@@ -35,7 +42,7 @@ static const char* format_size(size_t bytes, char* buffer, size_t buffer_size) {
     return buffer;
 }
 
-static int cmd_compress(const char* input, const char* output) {
+static int cmd_compress(const char* input, const char* output, int level, const FormatSpec* spec) {
     char output_path[512];
     if (!output) {
         snprintf(output_path, sizeof(output_path), "%s.ulcu", input);
@@ -50,7 +57,7 @@ static int cmd_compress(const char* input, const char* output) {
     size_t orig_size, comp_size;
     double duration;
     
-    int result = ultra_compress_file(input, output, &orig_size, &comp_size, &duration);
+    int result = ultra_compress_file_spec(input, output, level, spec, &orig_size, &comp_size, &duration);
     
     if (result != 0) {
         fprintf(stderr, "\nCompression failed!\n");
@@ -117,12 +124,32 @@ int main(int argc, char* argv[]) {
         
         const char* input = argv[2];
         const char* output = NULL;
+        int level = ULTRA_LEVEL_DEFAULT;
+        FormatSpec* spec = NULL;
+        char* error = NULL;
         
-        if (argc >= 5 && strcmp(argv[3], "-o") == 0) {
-            output = argv[4];
+        for (int i = 3; i < argc && !error; i++) {
+            if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                output = argv[++i];
+            } else if (strcmp(argv[i], "--max") == 0) {
+                level = ULTRA_LEVEL_MAX;
+            } else if (strcmp(argv[i], "--format-spec") == 0 && i + 1 < argc) {
+                format_spec_free(spec);
+                spec = format_spec_compile(argv[++i], &error);
+            } else if (strcmp(argv[i], "--format-spec-file") == 0 && i + 1 < argc) {
+                format_spec_free(spec);
+                spec = format_spec_load(argv[++i], &error);
+            }
+        }
+        if (error) {
+            fprintf(stderr, "Error: Invalid format spec (%s)\n", error);
+            free(error);
+            return 1;
         }
         
-        return cmd_compress(input, output);
+        int result = cmd_compress(input, output, level, spec);
+        format_spec_free(spec);
+        return result;
     } else if (strcmp(command, "decompress") == 0) {
         if (argc < 3) {
             fprintf(stderr, "Error: Missing input file\n");
@@ -1,22 +1,452 @@
 #include "../include/ulc_ultra_compress.h"
+#include "../include/ulc_ultra_pattern.h"
+#include "../include/ulc_ultra_bwt.h"
+#include "../include/ulc_ultra_huffman.h"
+#include "../include/ulc_ultra_rans.h"
+#include "../include/ulc_ultra_context.h"
 #include "../../ulc-c/include/ulc_parser.h"
 #include "../../ulc-c/include/ulc_utils.h"
+#include "../../ulc-c/include/ulc_addr.h"
+#include "../../ulc-c/include/ulc_cm.h"
+#include "../../ulc-c/include/ulc_stream.h"
+#include "../../ulc-c/include/ulc_json.h"
+#include "../../ulc-c/include/ulc_logfmt.h"
+#include "../../ulc-c/include/ulc_frame.h"
+#include "../../ulc-c/include/ulc_envelope.h"
+#include "../../ulc-c/include/ulc_spec.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
 #include <lzma.h>
 
-// BWT implementation (simplified - production would use libbz2)
-static void apply_bwt(uint8_t* data, size_t len, int* primary_index) {
-    // Simplified BWT - for production, use BZ2_blockSort from libbz2
-    // This is a placeholder that just returns the data as-is
-    *primary_index = 0;
+// --- BWT (raw text columns) ---
+
+// Columns below this size stay raw, the trial is not worth it
+#define BWT_MIN_COLUMN (64 * 1024)
+#define BWT_SAMPLE_SIZE (256 * 1024)
+
+// Size of a quick LZMA pass, used to compare candidate column layouts
+static size_t lzma_probe_size(const uint8_t* data, size_t len) {
+    size_t out_size = lzma_stream_buffer_bound(len);
+    uint8_t* out = malloc(out_size);
+    size_t out_pos = 0;
+    if (lzma_easy_buffer_encode(6, LZMA_CHECK_NONE, NULL, data, len, out, &out_pos, out_size) != LZMA_OK) {
+        out_pos = len;
+    }
+    free(out);
+    return out_pos;
+}
+
+// Raw column values joined by '\n' (lines never contain one): the
+// column's blob with each terminator but the last turned into a newline
+static ByteArray* join_column(const StringColumn* col) {
+    ByteArray* text = bytearray_new(col->length + 1);
+    if (col->length > 0) {
+        bytearray_append(text, (const uint8_t*)col->data, col->length - 1);
+        for (size_t i = 1; i < col->count; i++) text->data[col->offsets[i] - 1] = '\n';
+    }
+    return text;
+}
+
+// Trial on a sample: keep BWT only when it beats plain LZMA by at least 2%
+static int bwt_column_pays_off(const ByteArray* text) {
+    if (text->length < BWT_MIN_COLUMN) return 0;
+    size_t sample = text->length < BWT_SAMPLE_SIZE ? text->length : BWT_SAMPLE_SIZE;
+    ByteArray* transformed = bwt_encode_stream(text->data, sample, BWT_BLOCK_SIZE);
+    size_t plain = lzma_probe_size(text->data, sample);
+    size_t bwt = lzma_probe_size(transformed->data, transformed->length);
+    bytearray_free(transformed);
+    return bwt * 100 < plain * 98;
+}
+
+// --- Entropy-coded side streams ---
+// Dictionary ids of small-alphabet columns and delta streams can skip LZMA:
+// they are coded into side streams stored after the LZMA stream. Each side
+// block starts with its coder tag.
+
+#define ENTROPY_MIN_ROWS 1024
+#define ENTROPY_SAMPLE_ROWS 65536
+
+#define ENTROPY_HUFFMAN 1
+#define ENTROPY_RANS0 2     // Order-0 rANS
+#define ENTROPY_RANS1 3     // Order-1 rANS (previous byte as context)
+
+// Cheapest rANS order for a byte stream, compared against best_size
+static int choose_rans(const uint8_t* data, size_t len, size_t* best_size) {
+    int coder = 0;
+    for (int order = 0; order <= 1; order++) {
+        size_t size = rans_estimate(data, len, order);
+        if (size <= *best_size) {
+            *best_size = size;
+            coder = order ? ENTROPY_RANS1 : ENTROPY_RANS0;
+        }
+    }
+    return coder;
+}
+
+// Quick LZMA size of a sample's id varints
+static size_t id_varints_size(const uint32_t* ids, size_t sample) {
+    ByteArray* varints = bytearray_new(sample * 2);
+    for (size_t i = 0; i < sample; i++) encode_varint(varints, ids[i]);
+    size_t size = lzma_probe_size(varints->data, varints->length);
+    bytearray_free(varints);
+    return size;
+}
+
+// Coder for an id column by estimated size on a sample, 0 when LZMA wins;
+// *best_size gets the winner's size on the sample
+static int choose_id_coder(const uint32_t* column_ids, const uint16_t* ids, size_t count, size_t alphabet,
+                           size_t* best_size) {
+    size_t sample = count < ENTROPY_SAMPLE_ROWS ? count : ENTROPY_SAMPLE_ROWS;
+    size_t best = id_varints_size(column_ids, sample);
+    *best_size = best;
+    if (count < ENTROPY_MIN_ROWS || alphabet > HUFF_MAX_SYMBOLS) return 0;
+
+    int coder = 0;
+    size_t huffman_size = huffman_block_size(ids, sample, alphabet);
+    if (huffman_size <= best) {
+        best = huffman_size;
+        coder = ENTROPY_HUFFMAN;
+    }
+
+    // Byte-alphabet columns can also go through rANS
+    if (alphabet <= 256) {
+        uint8_t* bytes = malloc(sample);
+        for (size_t i = 0; i < sample; i++) bytes[i] = (uint8_t)ids[i];
+        int rans = choose_rans(bytes, sample, &best);
+        if (rans) coder = rans;
+        free(bytes);
+    }
+    *best_size = best;
+    return coder;
+}
+
+// Coder for a delta (zigzag varint) stream, 0 when LZMA wins
+static int choose_byte_coder(const uint8_t* data, size_t len, size_t rows) {
+    if (rows < ENTROPY_MIN_ROWS) return 0;
+    size_t sample = len < 2 * ENTROPY_SAMPLE_ROWS ? len : 2 * ENTROPY_SAMPLE_ROWS;
+    size_t best = lzma_probe_size(data, sample);
+    return choose_rans(data, sample, &best);
+}
+
+static void encode_id_stream(ByteArray* side, int coder, const uint16_t* ids, size_t count, size_t alphabet) {
+    bytearray_append_byte(side, (uint8_t)coder);
+    if (coder == ENTROPY_HUFFMAN) {
+        huffman_encode_block(side, ids, count, alphabet);
+        return;
+    }
+    uint8_t* bytes = malloc(count + 1);
+    for (size_t i = 0; i < count; i++) bytes[i] = (uint8_t)ids[i];
+    rans_encode_block(side, bytes, count, coder == ENTROPY_RANS1);
+    free(bytes);
+}
+
+static uint16_t* decode_id_stream(const uint8_t* side, size_t* offset, size_t count) {
+    uint16_t* ids = malloc(sizeof(uint16_t) * (count + HUFF_MULTI));
+    int coder = side[(*offset)++];
+    if (coder == ENTROPY_HUFFMAN) {
+        huffman_decode_block(side, offset, ids, count);
+        return ids;
+    }
+    size_t len;
+    uint8_t* bytes = rans_decode_block(side, offset, &len);
+    for (size_t i = 0; i < count; i++) ids[i] = bytes[i];
+    free(bytes);
+    return ids;
+}
+
+// --- Conditional ids ---
+
+// Keep conditional ids when a quick LZMA pass over a sample puts them at
+// least 2% under the best plain coding (plain_size, same sample)
+static int conditional_pays_off(const ContextModel* model, size_t column, int predictor, size_t plain_size) {
+    size_t sample = model->rows < ENTROPY_SAMPLE_ROWS ? model->rows : ENTROPY_SAMPLE_ROWS;
+    ByteArray* conditional = bytearray_new(sample);
+    context_encode(conditional, model, column, predictor, sample);
+    size_t conditional_size = lzma_probe_size(conditional->data, conditional->length);
+    bytearray_free(conditional);
+    return conditional_size * 100 < plain_size * 98;
+}
+
+// The column stream with every conditional column put back to plain
+// dictionary ids (type 1). id_starts[j] is where column j's conditional
+// ids begin, 0 for the other columns; plain_sections gets the new starts
+static ByteArray* plain_id_layout(const ByteArray* serialized, const size_t* sections, const size_t* id_starts,
+                                  const ContextModel* model, size_t fields, size_t* plain_sections) {
+    ByteArray* plain = bytearray_new(serialized->length + model->rows * 2);
+    bytearray_append(plain, serialized->data, fields ? sections[0] : serialized->length);
+    for (size_t j = 0; j < fields; j++) {
+        size_t end = j + 1 < fields ? sections[j + 1] : serialized->length;
+        plain_sections[j] = plain->length;
+        if (!id_starts[j]) {
+            bytearray_append(plain, serialized->data + sections[j], end - sections[j]);
+            continue;
+        }
+        bytearray_append(plain, serialized->data + sections[j], id_starts[j] - sections[j]);
+        plain->data[plain_sections[j]] = 1;
+        for (size_t i = 0; i < model->rows; i++) encode_varint(plain, model->ids[j][i]);
+    }
+    return plain;
+}
+
+// --- Template (message) columns ---
+
+// Canonical decimal that survives strtoll + "%lld"
+static int is_canonical_int(const char* s) {
+    const char* p = s;
+    if (*p == '-') p++;
+    size_t len = strlen(p);
+    if (len == 0 || len > 18 || (p[0] == '0' && (len > 1 || p != s))) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] < '0' || p[i] > '9') return 0;
+    }
+    return 1;
 }
 
-static void reverse_bwt(uint8_t* data, size_t len, int primary_index) {
-    // Simplified reverse BWT
-    // Production would use proper inverse BWT
+// Parameter column: 0=Raw, 1=Dict, 2=Delta
+static void encode_param_column(ByteArray* out, char** values, size_t count) {
+    int numeric = 1;
+    for (size_t i = 0; i < count && numeric; i++) {
+        if (!is_canonical_int(values[i])) numeric = 0;
+    }
+    if (numeric) {
+        bytearray_append_byte(out, 2);
+        long long prev = 0;
+        for (size_t i = 0; i < count; i++) {
+            long long val = strtoll(values[i], NULL, 10);
+            long long delta = val - prev;
+            encode_varint(out, (delta << 1) ^ (delta >> 63));
+            prev = val;
+        }
+        return;
+    }
+    
+    Dictionary* dict = dict_new(64);
+    int* ids = malloc(sizeof(int) * (count ? count : 1));
+    for (size_t i = 0; i < count; i++) ids[i] = dict_get_or_add(dict, values[i]);
+    
+    if (dict->count < 256 || dict->count * 2 < count) {
+        bytearray_append_byte(out, 1);
+        encode_varint(out, dict->count);
+        for (size_t k = 0; k < dict->count; k++) {
+            const char* val = dict->entries[k].key;
+            encode_varint(out, strlen(val));
+            bytearray_append(out, (const uint8_t*)val, strlen(val));
+        }
+        for (size_t i = 0; i < count; i++) encode_varint(out, ids[i]);
+    } else {
+        bytearray_append_byte(out, 0);
+        for (size_t i = 0; i < count; i++) {
+            encode_varint(out, strlen(values[i]));
+            bytearray_append(out, (const uint8_t*)values[i], strlen(values[i]));
+        }
+    }
+    free(ids);
+    dict_free(dict);
+}
+
+static char** decode_param_column(const uint8_t* data, size_t* offset, size_t count) {
+    char** values = malloc(sizeof(char*) * (count ? count : 1));
+    uint8_t type = data[(*offset)++];
+    
+    if (type == 2) {
+        long long prev = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t zigzag = decode_varint(data, offset);
+            prev += (long long)((zigzag >> 1) ^ -(zigzag & 1));
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%lld", prev);
+            values[i] = strdup(buf);
+        }
+    } else if (type == 1) {
+        uint64_t dict_count = decode_varint(data, offset);
+        char** dict = malloc(sizeof(char*) * (dict_count ? dict_count : 1));
+        for (size_t k = 0; k < dict_count; k++) {
+            uint64_t len = decode_varint(data, offset);
+            dict[k] = malloc(len + 1);
+            memcpy(dict[k], data + *offset, len);
+            dict[k][len] = '\0';
+            *offset += len;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint64_t id = decode_varint(data, offset);
+            values[i] = strdup(id < dict_count ? dict[id] : "");
+        }
+        for (size_t k = 0; k < dict_count; k++) free(dict[k]);
+        free(dict);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            uint64_t len = decode_varint(data, offset);
+            values[i] = malloc(len + 1);
+            memcpy(values[i], data + *offset, len);
+            values[i][len] = '\0';
+            *offset += len;
+        }
+    }
+    return values;
+}
+
+// Layout: templates, per-row template ids, then each template's parameter
+// slots as columns over that template's rows
+static void encode_template_column(ByteArray* out, TemplateMiner* miner, const StringColumn* col,
+                                   const int* ids, size_t count) {
+    encode_varint(out, miner->template_count);
+    for (size_t t = 0; t < miner->template_count; t++) {
+        LogTemplate* tmpl = &miner->templates[t];
+        encode_varint(out, tmpl->token_count);
+        for (size_t k = 0; k < tmpl->token_count; k++) {
+            if (!tmpl->tokens[k]) {
+                encode_varint(out, 1);
+                continue;
+            }
+            size_t len = strlen(tmpl->tokens[k]);
+            encode_varint(out, (uint64_t)len << 1);
+            bytearray_append(out, (const uint8_t*)tmpl->tokens[k], len);
+        }
+    }
+    for (size_t i = 0; i < count; i++) encode_varint(out, ids[i]);
+    
+    // Tokenize once, then gather parameters template by template
+    char** buffers = malloc(sizeof(char*) * (count ? count : 1));
+    char*** tokens = malloc(sizeof(char**) * (count ? count : 1));
+    for (size_t i = 0; i < count; i++) template_tokenize(string_column_value(col, i), &buffers[i], &tokens[i]);
+    
+    char** params = malloc(sizeof(char*) * (count ? count : 1));
+    for (size_t t = 0; t < miner->template_count; t++) {
+        LogTemplate* tmpl = &miner->templates[t];
+        for (size_t k = 0; k < tmpl->token_count; k++) {
+            if (tmpl->tokens[k]) continue;
+            size_t n = 0;
+            for (size_t i = 0; i < count; i++) {
+                if (ids[i] == (int)t) params[n++] = tokens[i][k];
+            }
+            encode_param_column(out, params, n);
+        }
+    }
+    free(params);
+    
+    for (size_t i = 0; i < count; i++) {
+        free(tokens[i]);
+        free(buffers[i]);
+    }
+    free(tokens);
+    free(buffers);
+}
+
+static void decode_template_column(const uint8_t* data, size_t* offset, char** column, size_t count) {
+    uint64_t template_count = decode_varint(data, offset);
+    char*** constants = malloc(sizeof(char**) * (template_count ? template_count : 1));
+    size_t* token_counts = malloc(sizeof(size_t) * (template_count ? template_count : 1));
+    for (size_t t = 0; t < template_count; t++) {
+        token_counts[t] = decode_varint(data, offset);
+        constants[t] = malloc(sizeof(char*) * (token_counts[t] ? token_counts[t] : 1));
+        for (size_t k = 0; k < token_counts[t]; k++) {
+            uint64_t header = decode_varint(data, offset);
+            if (header & 1) {
+                constants[t][k] = NULL;
+                continue;
+            }
+            size_t len = header >> 1;
+            constants[t][k] = malloc(len + 1);
+            memcpy(constants[t][k], data + *offset, len);
+            constants[t][k][len] = '\0';
+            *offset += len;
+        }
+    }
+    
+    uint64_t* ids = malloc(sizeof(uint64_t) * (count ? count : 1));
+    size_t* rows_per_template = calloc(template_count ? template_count : 1, sizeof(size_t));
+    for (size_t i = 0; i < count; i++) {
+        ids[i] = decode_varint(data, offset);
+        rows_per_template[ids[i]]++;
+    }
+    
+    // params[t][k] is the column of slot k over the rows of template t
+    char**** params = malloc(sizeof(char***) * (template_count ? template_count : 1));
+    for (size_t t = 0; t < template_count; t++) {
+        params[t] = calloc(token_counts[t] ? token_counts[t] : 1, sizeof(char**));
+        for (size_t k = 0; k < token_counts[t]; k++) {
+            if (!constants[t][k]) params[t][k] = decode_param_column(data, offset, rows_per_template[t]);
+        }
+    }
+    
+    size_t* cursor = calloc(template_count ? template_count : 1, sizeof(size_t));
+    for (size_t i = 0; i < count; i++) {
+        size_t t = ids[i];
+        size_t r = cursor[t]++;
+        size_t len = 0;
+        for (size_t k = 0; k < token_counts[t]; k++) {
+            len += strlen(constants[t][k] ? constants[t][k] : params[t][k][r]) + 1;
+        }
+        column[i] = malloc(len + 1);
+        size_t pos = 0;
+        for (size_t k = 0; k < token_counts[t]; k++) {
+            const char* token = constants[t][k] ? constants[t][k] : params[t][k][r];
+            size_t n = strlen(token);
+            memcpy(column[i] + pos, token, n);
+            pos += n;
+            if (k + 1 < token_counts[t]) column[i][pos++] = ' ';
+        }
+        column[i][pos] = '\0';
+    }
+    
+    for (size_t t = 0; t < template_count; t++) {
+        for (size_t k = 0; k < token_counts[t]; k++) {
+            if (params[t][k]) {
+                for (size_t r = 0; r < rows_per_template[t]; r++) free(params[t][k][r]);
+                free(params[t][k]);
+            }
+            free(constants[t][k]);
+        }
+        free(params[t]);
+        free(constants[t]);
+    }
+    free(params);
+    free(constants);
+    free(token_counts);
+    free(rows_per_template);
+    free(cursor);
+    free(ids);
+}
+
+// Whole-stream LZMA with the 128MB dictionary, NULL on failure
+static uint8_t* lzma_compress_stream(const ByteArray* serialized, size_t* out_len) {
+    lzma_options_lzma opt;
+    lzma_lzma_preset(&opt, 9 | LZMA_PRESET_EXTREME);
+    opt.dict_size = 128 * 1024 * 1024;
+    opt.lc = 4; opt.lp = 0; opt.pb = 2;
+    opt.mf = LZMA_MF_BT4;
+    opt.depth = 512;
+    
+    lzma_filter filters[] = {
+        { .id = LZMA_FILTER_LZMA2, .options = &opt },
+        { .id = LZMA_VLI_UNKNOWN, .options = NULL }
+    };
+    
+    size_t compressed_capacity = serialized->length + 1024;
+    uint8_t* compressed = malloc(compressed_capacity);
+    
+    lzma_stream strm = LZMA_STREAM_INIT;
+    if (lzma_stream_encoder(&strm, filters, LZMA_CHECK_CRC64) != LZMA_OK) {
+        free(compressed);
+        return NULL;
+    }
+    
+    strm.next_in = serialized->data;
+    strm.avail_in = serialized->length;
+    strm.next_out = compressed;
+    strm.avail_out = compressed_capacity;
+    
+    if (lzma_code(&strm, LZMA_FINISH) != LZMA_STREAM_END) {
+        lzma_end(&strm);
+        free(compressed);
+        return NULL;
+    }
+    
+    *out_len = strm.total_out;
+    lzma_end(&strm);
+    return compressed;
 }
 
 UltraCompressor* ultra_compressor_new(int compression_level) {
@@ -35,6 +465,21 @@ void ultra_compressor_free(UltraCompressor* compressor) {
 }
 
 // Validate format consistency
+// Entries split into a layout plus one field per key (JSON, logfmt, a
+// container envelope, a declared format or a span layout)
+static int is_keyed(const LogEntry* entry) {
+    return entry->format == LOG_FORMAT_JSON || entry->format == LOG_FORMAT_LOGFMT ||
+           entry->format == LOG_FORMAT_CONTAINER || entry->format == LOG_FORMAT_CUSTOM || entry->span;
+}
+
+// Whether every field of a keyed entry has a key column
+static int has_columns(const LogEntry* entry, const int* column_of) {
+    for (size_t k = 0; k < entry->field_count; k++) {
+        if (column_of[entry->ids[k]] < 0) return 0;
+    }
+    return 1;
+}
+
 int validate_log_format(char** lines, size_t line_count, char** error_message) {
     if (line_count < 100) {
         *error_message = strdup("Error: Minimum 100 lines required for ultra compression");
@@ -44,13 +489,15 @@ int validate_log_format(char** lines, size_t line_count, char** error_message) {
     // Parse first 100 lines to detect format
     LogFormat dominant_format = LOG_FORMAT_RAW;
     int format_counts[10] = {0};
+    LogParser parser;
+    log_parser_init(&parser);
     
     for (size_t i = 0; i < (line_count < 100 ? line_count : 100); i++) {
-        LogEntry* entry = parse_log_line(lines[i]);
+        LogEntry* entry = parse_log_line(&parser, lines[i]);
         format_counts[entry->format]++;
         if (i == 0) dominant_format = entry->format;
-        log_entry_free(entry);
     }
+    log_parser_free(&parser);
     
     // Check consistency (80% threshold)
     int max_count = 0;
@@ -74,16 +521,59 @@ int validate_log_format(char** lines, size_t line_count, char** error_message) {
     return 1;
 }
 
+// A declared format replaces detection: the same 100-line sample must match
+// the spec itself at the 80% threshold
+static int validate_spec_format(const FormatSpec* spec, char** lines, size_t line_count, char** error_message) {
+    if (line_count < 100) {
+        *error_message = strdup("Error: Minimum 100 lines required for ultra compression");
+        return 0;
+    }
+    size_t starts[SPEC_MAX_FIELDS], lengths[SPEC_MAX_FIELDS];
+    int matched = 0;
+    for (size_t i = 0; i < 100; i++) matched += format_spec_match(spec, lines[i], starts, lengths);
+    if (matched < 80) {
+        *error_message = strdup("Error: Fewer than 80% of the lines match the format spec.");
+        return 0;
+    }
+    return 1;
+}
+
 int ultra_compress_file(const char* input_path, const char* output_path,
                        size_t* orig_size, size_t* comp_size, double* duration) {
+    return ultra_compress_file_level(input_path, output_path, ULTRA_LEVEL_DEFAULT, orig_size, comp_size, duration);
+}
+
+int ultra_compress_file_level(const char* input_path, const char* output_path, int level,
+                              size_t* orig_size, size_t* comp_size, double* duration) {
+    return ultra_compress_file_spec(input_path, output_path, level, NULL, orig_size, comp_size, duration);
+}
+
+int ultra_compress_file_spec(const char* input_path, const char* output_path, int level, const FormatSpec* spec,
+                             size_t* orig_size, size_t* comp_size, double* duration) {
     clock_t start = clock();
     
-    // Read input file
-    FILE* fp = fopen(input_path, "r");
+    // Read input file whole, in binary
+    FILE* fp = fopen(input_path, "rb");
     if (!fp) {
         fprintf(stderr, "Error: Cannot open input file: %s\n", input_path);
         return -1;
     }
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* text = malloc((file_size > 0 ? file_size : 0) + 1);
+    size_t total_bytes = file_size > 0 ? fread(text, 1, file_size, fp) : 0;
+    fclose(fp);
+    
+    // CRLF is dropped from the lines only when every line has it; otherwise
+    // a CR stays in its line's text (continuation lines included)
+    size_t lf_count = 0, crlf_count = 0;
+    for (size_t i = 0; i < total_bytes; i++) {
+        if (text[i] != '\n') continue;
+        lf_count++;
+        if (i > 0 && text[i-1] == '\r') crlf_count++;
+    }
+    int crlf = lf_count > 0 && crlf_count == lf_count;
     
     // Read all lines
     char** lines = NULL;
@@ -91,33 +581,81 @@ int ultra_compress_file(const char* input_path, const char* output_path,
     size_t line_capacity = 1024;
     lines = malloc(sizeof(char*) * line_capacity);
     
-    char line_buffer[16384];
-    size_t total_bytes = 0;
-    
-    while (fgets(line_buffer, sizeof(line_buffer), fp)) {
-        size_t len = strlen(line_buffer);
-        if (len > 0 && line_buffer[len-1] == '\n') line_buffer[len-1] = '\0';
-        if (len > 1 && line_buffer[len-2] == '\r') line_buffer[len-2] = '\0';
-        
-        total_bytes += strlen(line_buffer) + 1;
+    for (char* line = text; line < text + total_bytes; ) {
+        char* end = memchr(line, '\n', text + total_bytes - line);
+        char* next = end ? end + 1 : text + total_bytes;
+        if (!end) {
+            end = text + total_bytes;
+        } else if (crlf) {
+            end--;
+        }
+        *end = '\0';
         
         if (line_count >= line_capacity) {
             line_capacity *= 2;
             lines = realloc(lines, sizeof(char*) * line_capacity);
         }
-        lines[line_count++] = strdup(line_buffer);
+        lines[line_count++] = strdup(line);
+        line = next;
     }
-    fclose(fp);
+    free(text);
     
     *orig_size = total_bytes;
     
+    // Container logs: a run of partial lines becomes the one line it was
+    // split from; tags[] records where to cut it again
+    char** envelope_tags;
+    size_t joined_count = envelope_reassemble(lines, line_count, &envelope_tags);
+    if (joined_count < line_count) {
+        printf("Reassembled %zu partial lines into %zu\n", line_count, joined_count);
+    }
+    line_count = joined_count;
+    
+    // Multi-line records: continuation lines (stack traces) join the line
+    // above them and leave the row grid; lines[] keeps the record headers
+    char** frames = NULL;
+    char** messages = NULL;
+    size_t record_count = 0, traced = 0;
+    for (size_t i = 0; i < line_count; ) {
+        size_t end = i + 1;
+        while (end < line_count && frame_is_continuation(lines[end])) end++;
+        if (end > i + 1) {
+            if (!frames) {
+                frames = calloc(line_count, sizeof(char*));
+                messages = calloc(line_count, sizeof(char*));
+            }
+            frame_split(lines + i + 1, end - i - 1, &frames[record_count], &messages[record_count]);
+            for (size_t k = i + 1; k < end; k++) free(lines[k]);
+            traced++;
+        }
+        if (envelope_tags) envelope_tags[record_count] = envelope_tags[i];
+        lines[record_count++] = lines[i];
+        i = end;
+    }
+    if (traced > 0) {
+        printf("Framed %zu lines into %zu records (%zu with traces)\n", line_count, record_count, traced);
+    }
+    line_count = record_count;
+    
     // Validate format
     char* error_msg = NULL;
-    if (!validate_log_format(lines, line_count, &error_msg)) {
+    int valid = spec ? validate_spec_format(spec, lines, line_count, &error_msg)
+                     : validate_log_format(lines, line_count, &error_msg);
+    if (!valid) {
         fprintf(stderr, "%s\n", error_msg);
         free(error_msg);
-        for (size_t i = 0; i < line_count; i++) free(lines[i]);
+        for (size_t i = 0; i < line_count; i++) {
+            free(lines[i]);
+            if (frames) {
+                free(frames[i]);
+                free(messages[i]);
+            }
+            if (envelope_tags) free(envelope_tags[i]);
+        }
         free(lines);
+        free(frames);
+        free(messages);
+        free(envelope_tags);
         return -1;
     }
     if (error_msg) {
@@ -131,186 +669,400 @@ int ultra_compress_file(const char* input_path, const char* output_path,
     printf("Parsing logs...\n");
     LogEntry** entries = malloc(sizeof(LogEntry*) * line_count);
     size_t max_fields = 0;
+    LogParser parser;
+    log_parser_init(&parser);
+    // The positional decoder joins fields with spaces, which would lose a
+    // Java header's brackets and " - ": those lines keep their span layout
+    parser.span_formats = 1u << LOG_FORMAT_JAVA;
+    if (spec) log_parser_set_spec(&parser, spec);
     for (size_t i = 0; i < line_count; i++) {
-        entries[i] = parse_log_line(lines[i]);
+        entries[i] = log_parser_parse(&parser, lines[i]);
+        // Fragment tag of a reassembled container line replaces its "F"
+        if (envelope_tags && envelope_tags[i]) {
+            log_entry_set_envelope_tag(&parser, entries[i], envelope_tags[i]);
+            free(envelope_tags[i]);
+        }
         if (entries[i]->field_count > max_fields) max_fields = entries[i]->field_count;
     }
+    printf("Parsed %zu lines (%zu fast path, %zu fallback)\n", line_count, parser.fast_hits, parser.fallbacks);
+    
+    // JSON and logfmt logs: columns by key rather than position, since keys
+    // vary in order and presence; the layout column restores each line exactly
+    size_t keyed_rows = 0;
+    for (size_t i = 0; i < line_count; i++) keyed_rows += is_keyed(entries[i]);
+    int keyed_mode = keyed_rows * 2 > line_count;
+    Dictionary* names = NULL;
+    int* column_of = NULL;  // Schema id -> key column
+    if (keyed_mode) {
+        names = dict_new(64);
+        column_of = malloc(sizeof(int) * (parser.schema.count + 1));
+        for (size_t id = 0; id < parser.schema.count; id++) column_of[id] = -1;
+        column_of[schema_intern(&parser.schema, JSON_LAYOUT_FIELD)] = dict_get_or_add(names, JSON_LAYOUT_FIELD);
+        for (size_t i = 0; i < line_count; i++) {
+            if (!is_keyed(entries[i])) continue;
+            for (size_t k = 1; k < entries[i]->field_count; k++) {
+                int id = entries[i]->ids[k];
+                if (column_of[id] < 0) column_of[id] = dict_get_or_add(names, parser.schema.names[id]);
+            }
+        }
+        max_fields = names->count;
+    }
     
     // PHASE 2: Transpose to Columns
+    // One row-major pass over the entries; each column's values end up back
+    // to back in its own blob, "" where a row lacks the field
     printf("Transposing to %zu columns...\n", max_fields);
-    // columns[col_idx][row_idx]
-    char*** columns = malloc(sizeof(char**) * max_fields);
-    for (size_t j = 0; j < max_fields; j++) {
-        columns[j] = malloc(sizeof(char*) * line_count);
-        for (size_t i = 0; i < line_count; i++) {
-            if (j < entries[i]->field_count) {
-                columns[j][i] = entries[i]->values[j]; // Reference only
-            } else {
-                columns[j][i] = ""; // Empty string for missing fields
+    StringColumn* columns = malloc(sizeof(StringColumn) * (max_fields + 2));
+    for (size_t j = 0; j < max_fields; j++) string_column_init(&columns[j]);
+    if (keyed_mode) printf("Keyed mode: %zu JSON/logfmt/container/spec/span rows, %zu key columns\n", keyed_rows, max_fields - 1);
+    for (size_t i = 0; i < line_count; i++) {
+        const LogEntry* entry = entries[i];
+        if (!keyed_mode) {
+            for (size_t k = 0; k < entry->field_count; k++) {
+                string_column_put(&columns[k], i, entry->values[k], strlen(entry->values[k]));
+            }
+        } else if (is_keyed(entry) && has_columns(entry, column_of)) {
+            // Backwards: a row's first put wins, and the last of repeated keys should
+            for (size_t k = entry->field_count; k-- > 0; ) {
+                string_column_put(&columns[column_of[entry->ids[k]]], i, entry->values[k], strlen(entry->values[k]));
             }
+        } else {
+            // Neither an object nor logfmt: tagged raw line in the layout column
+            size_t len = strlen(lines[i]);
+            char* raw = malloc(len + 1);
+            raw[0] = JSON_MARK_RAW;
+            memcpy(raw + 1, lines[i], len);
+            string_column_put(&columns[0], i, raw, len + 1);
+            free(raw);
         }
     }
+    for (size_t j = 0; j < max_fields; j++) string_column_pad(&columns[j], line_count);
+    
+    // Trace columns go last: frame skeletons (recurring traces repeat
+    // exactly, so the dictionary turns them into references) and the
+    // exception/message lines between the frames
+    if (frames) {
+        string_column_init(&columns[max_fields]);
+        string_column_init(&columns[max_fields + 1]);
+        for (size_t i = 0; i < line_count; i++) {
+            const char* frame = frames[i] ? frames[i] : "";
+            const char* message = messages[i] ? messages[i] : "";
+            string_column_push(&columns[max_fields], frame, strlen(frame));
+            string_column_push(&columns[max_fields + 1], message, strlen(message));
+        }
+        max_fields += 2;
+    }
     
     // PHASE 3: Analyze and Serialize Columns
     printf("Analyzing columns and serializing...\n");
     ByteArray* serialized = bytearray_new(total_bytes);
+    ByteArray* side = bytearray_new(1024);
     
     // Write metadata
     encode_varint(serialized, line_count);
     encode_varint(serialized, max_fields);
+    if (keyed_mode) {
+        for (size_t j = 0; j < names->count; j++) {
+            const char* name = names->entries[j].key;
+            encode_varint(serialized, strlen(name));
+            bytearray_append(serialized, (const uint8_t*)name, strlen(name));
+        }
+    }
+    
+    // Column section starts, context for the CM backend
+    size_t* sections = malloc(sizeof(size_t) * (max_fields + 1));
+    
+    // Dictionary ids of the columns written so far, predictors for the next
+    ContextModel* context = context_model_new(max_fields, line_count);
+    size_t* id_starts = calloc(max_fields ? max_fields : 1, sizeof(size_t));
+    size_t conditional_columns = 0;
     
     for (size_t j = 0; j < max_fields; j++) {
+        sections[j] = serialized->length;
+        const StringColumn* col = &columns[j];
+        
         // Analyze column type and cardinality
         Dictionary* col_dict = dict_new(256);
         int is_numeric = 1;
         int is_ip = 1;
         
+        // Fields of a declared format keep their declared type, no probing
+        int declared = -1;
+        if (spec && keyed_mode && j < names->count) declared = format_spec_type(spec, names->entries[j].key);
+        
         for (size_t i = 0; i < line_count; i++) {
-            const char* val = columns[j][i];
+            const char* val = string_column_value(col, i);
+            size_t len = string_column_length(col, i);
             dict_get_or_add(col_dict, val);
             
+            // Keyed columns must restore exactly: delta only for canonical integers
+            if (keyed_mode && !is_canonical_int(val)) is_numeric = 0;
+            
             // Check type (heuristic on first 100 non-empty values)
-            if (i < 100 && strlen(val) > 0) {
+            if (declared < 0 && i < 100 && len > 0) {
                 // Check numeric
                 char* endptr;
                 strtoll(val, &endptr, 10);
                 if (*endptr != '\0') is_numeric = 0;
                 
-                // Check IP (simplified: contains dots and digits)
-                int dots = 0;
-                int digits = 0;
-                for(size_t k=0; k<strlen(val); k++) {
-                    if(val[k] == '.') dots++;
-                    else if(val[k] >= '0' && val[k] <= '9') digits++;
-                    else { is_ip = 0; break; }
-                }
-                if(dots < 3 || digits < 4) is_ip = 0;
+                // Check IP (IPv4 or IPv6 that round-trips exactly)
+                Address addr;
+                if (!addr_parse(val, len, &addr)) is_ip = 0;
             }
         }
         
+        if (declared >= 0) {
+            is_numeric = is_numeric && declared == COL_TYPE_INT;
+            is_ip = declared == COL_TYPE_IP;
+        }
+        
         double unique_ratio = (double)col_dict->count / line_count;
-        int encoding_type = 0; // 0=Raw, 1=Dict, 2=Delta, 3=IP_XOR
+        int encoding_type = 0; // 0=Raw, 1=Dict, 2=Delta, 3=IP_XOR (legacy), 4=Template, 5=Address, 6=BWT, 7=Dict+entropy ids, 8=Delta+entropy, 9=Dict+conditional ids
         
         if (is_numeric && line_count > 10) encoding_type = 2; // Delta
-        else if (is_ip && line_count > 10) encoding_type = 3; // IP XOR
+        else if (is_ip && line_count > 10) encoding_type = 5; // Address XOR
         else if (unique_ratio < 0.5 || col_dict->count < 256) encoding_type = 1; // Dict (Aggressive)
         else encoding_type = 0; // Raw
         
-        // Write column encoding type
-        bytearray_append(serialized, (uint8_t*)&encoding_type, 1);
+        // Free-text columns (syslog/generic messages): try template mining
+        TemplateMiner* miner = NULL;
+        int* template_ids = NULL;
+        if ((encoding_type == 0 || encoding_type == 1) && col_dict->count >= 64) {
+            size_t spaces = 0;
+            for (size_t k = 0; k < col->length; k++) spaces += (col->data[k] == ' ');
+            if (spaces >= 2 * line_count) {
+                miner = template_miner_new(4, 0.5);
+                template_ids = malloc(sizeof(int) * line_count);
+                for (size_t i = 0; i < line_count; i++) {
+                    template_ids[i] = template_miner_add(miner, string_column_value(col, i));
+                }
+                if (miner->template_count * 4 <= col_dict->count) {
+                    encoding_type = 4; // Template
+                } else {
+                    template_miner_free(miner);
+                    free(template_ids);
+                    miner = NULL;
+                    template_ids = NULL;
+                }
+            }
+        }
         
+        // Dictionary ids: entropy-code them outside LZMA when that is no
+        // worse, or code them conditionally on the previous row or an
+        // earlier column when one predicts them better still
+        uint16_t* ids = NULL;
+        int id_coder = 0;
+        int predictor = CONTEXT_NONE;
         if (encoding_type == 1) {
-            // DICTIONARY ENCODING
-            encode_varint(serialized, col_dict->count);
-            for (size_t k = 0; k < col_dict->count; k++) {
-                const char* val = col_dict->entries[k].key;
-                encode_varint(serialized, strlen(val));
-                bytearray_append(serialized, (uint8_t*)val, strlen(val));
-            }
+            uint32_t* column_ids = malloc(sizeof(uint32_t) * (line_count ? line_count : 1));
             for (size_t i = 0; i < line_count; i++) {
-                int id = dict_get_or_add(col_dict, columns[j][i]);
-                encode_varint(serialized, id);
+                column_ids[i] = (uint32_t)dict_get_or_add(col_dict, string_column_value(col, i));
             }
-        } else if (encoding_type == 2) {
-            // DELTA ENCODING (Numeric)
+            context_model_set(context, j, column_ids, col_dict->count);
+            
+            size_t id_size = 0;
+            predictor = context_model_fit(context, j);
+            if (col_dict->count <= HUFF_MAX_SYMBOLS) {
+                ids = malloc(sizeof(uint16_t) * line_count);
+                for (size_t i = 0; i < line_count; i++) ids[i] = (uint16_t)column_ids[i];
+            }
+            if (line_count >= ENTROPY_MIN_ROWS && (ids || predictor != CONTEXT_NONE)) {
+                id_coder = choose_id_coder(column_ids, ids, line_count, col_dict->count, &id_size);
+            }
+            if (predictor != CONTEXT_NONE && conditional_pays_off(context, j, predictor, id_size)) {
+                encoding_type = 9;
+                conditional_columns++;
+            } else if (id_coder) {
+                encoding_type = 7;
+            }
+        }
+        
+        // Delta streams: same idea, rANS over the zigzag varint bytes
+        ByteArray* deltas = NULL;
+        int delta_coder = 0;
+        if (encoding_type == 2) {
+            deltas = bytearray_new(line_count * 2);
             long long prev = 0;
             for (size_t i = 0; i < line_count; i++) {
-                if (strlen(columns[j][i]) == 0) {
-                    encode_varint(serialized, 0); // Handle empty as 0 delta? Or flag? Simplified: 0
+                if (string_column_length(col, i) == 0) {
+                    encode_varint(deltas, 0); // Handle empty as 0 delta? Or flag? Simplified: 0
                     continue;
                 }
-                long long val = strtoll(columns[j][i], NULL, 10);
+                long long val = strtoll(string_column_value(col, i), NULL, 10);
                 long long delta = val - prev;
                 // ZigZag encode delta to handle negatives efficiently
                 uint64_t zigzag = (delta << 1) ^ (delta >> 63);
-                encode_varint(serialized, zigzag);
+                encode_varint(deltas, zigzag);
                 prev = val;
             }
-        } else if (encoding_type == 3) {
-            // IP XOR ENCODING
-            // Convert IP to 32-bit int, XOR with prev
-            uint32_t prev_ip = 0;
+            delta_coder = choose_byte_coder(deltas->data, deltas->length, line_count);
+            if (delta_coder) encoding_type = 8;
+        }
+        
+        // Large free-text columns: BWT + MTF/RLE when the sample says so
+        // (values are joined with '\n', which trace values contain)
+        ByteArray* column_text = NULL;
+        int is_trace = frames && j + 2 >= max_fields;
+        if (encoding_type == 0 && !is_trace) {
+            column_text = join_column(col);
+            if (bwt_column_pays_off(column_text)) {
+                encoding_type = 6; // BWT
+            } else {
+                bytearray_free(column_text);
+                column_text = NULL;
+            }
+        }
+        
+        // Write column encoding type
+        bytearray_append(serialized, (uint8_t*)&encoding_type, 1);
+        
+        if (encoding_type == 1 || encoding_type == 7 || encoding_type == 9) {
+            // DICTIONARY ENCODING
+            encode_varint(serialized, col_dict->count);
+            for (size_t k = 0; k < col_dict->count; k++) {
+                const char* val = col_dict->entries[k].key;
+                encode_varint(serialized, strlen(val));
+                bytearray_append(serialized, (uint8_t*)val, strlen(val));
+            }
+            if (encoding_type == 7) {
+                // Ids go to the side stream
+                encode_id_stream(side, id_coder, ids, line_count, col_dict->count);
+            } else if (encoding_type == 9) {
+                // Hit bits and residual ranks against the predictor
+                id_starts[j] = serialized->length;
+                context_encode(serialized, context, j, predictor, line_count);
+            } else {
+                for (size_t i = 0; i < line_count; i++) encode_varint(serialized, context->ids[j][i]);
+            }
+        } else if (encoding_type == 2) {
+            // DELTA ENCODING (Numeric)
+            bytearray_append(serialized, deltas->data, deltas->length);
+        } else if (encoding_type == 8) {
+            // DELTA ENCODING, stream in the side section
+            bytearray_append_byte(side, (uint8_t)delta_coder);
+            rans_encode_block(side, deltas->data, deltas->length, delta_coder == ENTROPY_RANS1);
+        } else if (encoding_type == 5) {
+            // ADDRESS ENCODING
+            // Family tag + XOR with previous address of the same family
+            AddrCodec codec;
+            addr_codec_init(&codec);
+            uint8_t header[ADDR_MAX_ENCODED];
             for (size_t i = 0; i < line_count; i++) {
-                unsigned int a, b, c, d;
-                if (sscanf(columns[j][i], "%u.%u.%u.%u", &a, &b, &c, &d) == 4) {
-                    uint32_t ip = (a << 24) | (b << 16) | (c << 8) | d;
-                    uint32_t xor_val = ip ^ prev_ip;
-                    encode_varint(serialized, xor_val);
-                    prev_ip = ip;
-                } else {
-                    encode_varint(serialized, 0); // Failover
-                }
+                const char* val = string_column_value(col, i);
+                size_t len = string_column_length(col, i);
+                int verbatim;
+                size_t n = addr_encode(&codec, val, len, header, &verbatim);
+                bytearray_append(serialized, header, n);
+                if (verbatim) bytearray_append(serialized, (const uint8_t*)val, len);
             }
+        } else if (encoding_type == 4) {
+            // TEMPLATE ENCODING (mined message templates + parameter columns)
+            encode_template_column(serialized, miner, col, template_ids, line_count);
+            template_miner_free(miner);
+            free(template_ids);
+        } else if (encoding_type == 6) {
+            // BWT ENCODING (joined values, block-sorted)
+            ByteArray* stream = bwt_encode_stream(column_text->data, column_text->length, BWT_BLOCK_SIZE);
+            encode_varint(serialized, stream->length);
+            bytearray_append(serialized, stream->data, stream->length);
+            bytearray_free(stream);
+            bytearray_free(column_text);
         } else {
             // RAW ENCODING
             for (size_t i = 0; i < line_count; i++) {
-                const char* val = columns[j][i];
-                encode_varint(serialized, strlen(val));
-                bytearray_append(serialized, (uint8_t*)val, strlen(val));
+                size_t len = string_column_length(col, i);
+                encode_varint(serialized, len);
+                bytearray_append(serialized, (const uint8_t*)string_column_value(col, i), len);
             }
         }
         
+        free(ids);
+        if (deltas) bytearray_free(deltas);
         dict_free(col_dict);
     }
     
-    printf("Serialized size: %zu bytes\n", serialized->length);
+    if (conditional_columns) printf("Conditional ids: %zu of %zu columns\n", conditional_columns, max_fields);
+    printf("Serialized size: %zu bytes (+%zu bytes of side streams)\n", serialized->length, side->length);
     
-    // PHASE 4: Apply BWT (Disabled for testing - might be overhead on small files)
-    // printf("Applying BWT preprocessing...\n");
-    int bwt_primary = 0;
-    // apply_bwt(serialized->data, serialized->length, &bwt_primary);
+    // Header flags (this word held the whole-stream BWT index, always 0)
+    int flags = side->length > 0 ? ULCU_FLAG_SIDE_STREAMS : 0;
+    if (keyed_mode) flags |= ULCU_FLAG_KEYED;
+    if (frames) flags |= ULCU_FLAG_TRACES;
+    if (crlf) flags |= ULCU_FLAG_CRLF;
     
-    // PHASE 5: LZMA Compression
+    // PHASE 4: LZMA, and at the max level context mixing when it is smaller
     printf("Applying LZMA (128MB dict)...\n");
+    size_t compressed_size = 0;
+    uint8_t* compressed = lzma_compress_stream(serialized, &compressed_size);
     
-    lzma_options_lzma opt;
-    lzma_lzma_preset(&opt, 9 | LZMA_PRESET_EXTREME);
-    opt.dict_size = 128 * 1024 * 1024;
-    opt.lc = 4; opt.lp = 0; opt.pb = 2;
-    opt.mf = LZMA_MF_BT4;
-    opt.depth = 512;
-    
-    lzma_filter filters[] = {
-        { .id = LZMA_FILTER_LZMA2, .options = &opt },
-        { .id = LZMA_VLI_UNKNOWN, .options = NULL }
-    };
-    
-    size_t compressed_capacity = serialized->length + 1024;
-    uint8_t* compressed = malloc(compressed_capacity);
-    
-    lzma_stream strm = LZMA_STREAM_INIT;
-    lzma_ret ret = lzma_stream_encoder(&strm, filters, LZMA_CHECK_CRC64);
-    
-    if (ret != LZMA_OK) {
-        fprintf(stderr, "Error: LZMA encoder init failed\n");
-        free(compressed);
-        bytearray_free(serialized);
-        // Cleanup columns
-        for(size_t j=0; j<max_fields; j++) free(columns[j]);
-        free(columns);
-        return -1;
+    // Conditional ids were chosen column by column; LZMA can also match a
+    // plain column against an earlier one (a duplicated timestamp), which
+    // no per-column probe sees. Keep the whole stream that is smaller
+    if (compressed && conditional_columns) {
+        size_t* plain_sections = malloc(sizeof(size_t) * (max_fields + 1));
+        ByteArray* plain = plain_id_layout(serialized, sections, id_starts, context, max_fields, plain_sections);
+        size_t plain_size;
+        uint8_t* plain_compressed = lzma_compress_stream(plain, &plain_size);
+        if (plain_compressed && plain_size <= compressed_size) {
+            printf("Conditional ids: dropped, plain ids are smaller\n");
+            free(compressed);
+            compressed = plain_compressed;
+            compressed_size = plain_size;
+            bytearray_free(serialized);
+            serialized = plain;
+            free(sections);
+            sections = plain_sections;
+        } else {
+            free(plain_compressed);
+            bytearray_free(plain);
+            free(plain_sections);
+        }
     }
+    context_model_free(context);
+    free(id_starts);
     
-    strm.next_in = serialized->data;
-    strm.avail_in = serialized->length;
-    strm.next_out = compressed;
-    strm.avail_out = compressed_capacity;
-    
-    ret = lzma_code(&strm, LZMA_FINISH);
+    // Per-column streams when they are smaller: column groups coded apart
+    // with their own backend, each fetchable alone
+    if (compressed) {
+        size_t codec_counts[STREAM_CODECS];
+        size_t streams_size;
+        uint8_t* streams = streams_compress(serialized->data, serialized->length, sections, max_fields,
+                                            codec_counts, &streams_size);
+        if (streams_size < compressed_size) {
+            printf("Per-column streams: %zu text, %zu binary, %zu delta, %zu stored\n", codec_counts[STREAM_TEXT],
+                   codec_counts[STREAM_BINARY], codec_counts[STREAM_DELTA], codec_counts[STREAM_STORE]);
+            free(compressed);
+            compressed = streams;
+            compressed_size = streams_size;
+            flags |= ULCU_FLAG_STREAMS;
+        } else {
+            free(streams);
+        }
+    }
+    if (compressed && level >= ULTRA_LEVEL_MAX) {
+        printf("Applying context mixing (%d threads)...\n", CM_THREADS);
+        size_t cm_size;
+        uint8_t* cm = cm_compress(serialized->data, serialized->length, sections, max_fields, &cm_size);
+        if (cm_size < compressed_size) {
+            free(compressed);
+            compressed = cm;
+            compressed_size = cm_size;
+            flags = (flags & ~ULCU_FLAG_STREAMS) | ULCU_FLAG_CM;
+        } else {
+            free(cm);
+        }
+    }
+    free(sections);
     
-    if (ret != LZMA_STREAM_END) {
-        fprintf(stderr, "Error: LZMA compression failed\n");
-        lzma_end(&strm);
-        free(compressed);
+    if (!compressed) {
+        fprintf(stderr, "Error: Compression failed\n");
         bytearray_free(serialized);
-        for(size_t j=0; j<max_fields; j++) free(columns[j]);
+        bytearray_free(side);
+        for(size_t j=0; j<max_fields; j++) string_column_free(&columns[j]);
         free(columns);
         return -1;
     }
     
-    size_t compressed_size = strm.total_out;
-    lzma_end(&strm);
-    
     printf("Final compressed size: %zu bytes\n", compressed_size);
     
     // Write output
@@ -319,29 +1071,39 @@ int ultra_compress_file(const char* input_path, const char* output_path,
         fprintf(stderr, "Error: Cannot open output file\n");
         free(compressed);
         bytearray_free(serialized);
-        for(size_t j=0; j<max_fields; j++) free(columns[j]);
+        bytearray_free(side);
+        for(size_t j=0; j<max_fields; j++) string_column_free(&columns[j]);
         free(columns);
         return -1;
     }
     
     fwrite(ULCU_MAGIC, 1, ULCU_MAGIC_LEN, out_fp);
-    fwrite(&bwt_primary, sizeof(int), 1, out_fp);
+    fwrite(&flags, sizeof(int), 1, out_fp);
     fwrite(compressed, 1, compressed_size, out_fp);
+    fwrite(side->data, 1, side->length, out_fp);
     fclose(out_fp);
     
-    *comp_size = compressed_size + ULCU_MAGIC_LEN + sizeof(int);
+    *comp_size = compressed_size + side->length + ULCU_MAGIC_LEN + sizeof(int);
     
     // Cleanup
     free(compressed);
     bytearray_free(serialized);
-    for(size_t j=0; j<max_fields; j++) free(columns[j]);
+    bytearray_free(side);
+    for(size_t j=0; j<max_fields; j++) string_column_free(&columns[j]);
     free(columns);
-    for (size_t i = 0; i < line_count; i++) {
-        free(lines[i]);
-        log_entry_free(entries[i]);
-    }
+    for (size_t i = 0; i < line_count; i++) free(lines[i]);
     free(lines);
     free(entries);
+    free(column_of);
+    log_parser_free(&parser);
+    for (size_t i = 0; frames && i < line_count; i++) {
+        free(frames[i]);
+        free(messages[i]);
+    }
+    free(frames);
+    free(messages);
+    free(envelope_tags);
+    if (names) dict_free(names);
     ultra_compressor_free(NULL); // Helper free
     
     clock_t end = clock();
@@ -350,6 +1112,80 @@ int ultra_compress_file(const char* input_path, const char* output_path,
     return 0;
 }
 
+// '\n'-joined lines, written with the stream's line end between them
+static void write_lines(FILE* out, const char* text, const char* line_end) {
+    const char* end;
+    while (line_end[0] != '\n' && (end = strchr(text, '\n'))) {
+        fwrite(text, 1, (size_t)(end - text), out);
+        fputs(line_end, out);
+        text = end + 1;
+    }
+    fputs(text, out);
+}
+
+// Continuation lines of a multi-line record, after its header line
+static void write_trace(FILE* out, const char* frames, const char* messages, const char* line_end) {
+    if (!frames[0]) return;
+    char* trace = frame_join(frames, messages);
+    fputs(line_end, out);
+    write_lines(out, trace, line_end);
+    free(trace);
+}
+
+// Cell of a keyed row by column name ("" when no row has the key)
+static const char* keyed_value(char*** columns, Dictionary* names, size_t column_count, const char* name, size_t row) {
+    size_t col = (size_t)dict_get_or_add(names, name);
+    return col < column_count ? columns[col][row] : "";
+}
+
+// A keyed row rebuilt from its layout's plan and the column of each key it
+// names; envelopes render around their restored payload
+static char* restore_keyed_row(const LayoutPlan* plan, char*** columns, Dictionary* names, size_t column_count, size_t row) {
+    const char** values = malloc(sizeof(char*) * (plan->count ? plan->count : 1));
+    for (size_t k = 0; k < plan->count; k++) values[k] = keyed_value(columns, names, column_count, plan->fields[k], row);
+    const char* envelope[3] = {NULL, NULL, NULL};
+    if (plan->envelope) {
+        envelope[0] = keyed_value(columns, names, column_count, ENVELOPE_FIELD_TIME, row);
+        envelope[1] = keyed_value(columns, names, column_count, ENVELOPE_FIELD_STREAM, row);
+        envelope[2] = keyed_value(columns, names, column_count, ENVELOPE_FIELD_TAG, row);
+    }
+    char* line = layout_plan_render(plan, values, envelope);
+    free(values);
+    return line;
+}
+
+// Keyed mode output: tagged raw lines pass through, the other rows are
+// restored from their layout. The plan (and a spec row's compiled spec) is
+// rebuilt only when the layout changes
+static void write_keyed_rows(FILE* out, char*** columns, Dictionary* names,
+                             char** frames, char** messages, size_t line_count, const char* line_end) {
+    size_t column_count = names->count;
+    LayoutPlan plan;
+    const char* plan_layout = NULL;
+    int planned = 0;
+    for (size_t i = 0; i < line_count; i++) {
+        const char* layout = columns[0][i];
+        if (layout[0] == JSON_MARK_RAW) {
+            fprintf(out, "%s", layout + 1);
+        } else {
+            if (!plan_layout || strcmp(plan_layout, layout) != 0) {
+                if (plan_layout) layout_plan_free(&plan);
+                planned = layout_plan_init(&plan, layout);
+                plan_layout = layout;
+            }
+            if (planned) {
+                // A reassembled container line renders its fragments '\n'-joined
+                char* line = restore_keyed_row(&plan, columns, names, column_count, i);
+                write_lines(out, line, line_end);
+                free(line);
+            }
+        }
+        if (frames) write_trace(out, frames[i], messages[i], line_end);
+        fprintf(out, "%s", line_end);
+    }
+    if (plan_layout) layout_plan_free(&plan);
+}
+
 int ultra_decompress_file(const char* input_path, const char* output_path, double* duration) {
     clock_t start = clock();
     
@@ -361,8 +1197,8 @@ int ultra_decompress_file(const char* input_path, const char* output_path, doubl
         fclose(fp); return -1;
     }
     
-    int bwt_primary;
-    fread(&bwt_primary, sizeof(int), 1, fp);
+    int flags;
+    fread(&flags, sizeof(int), 1, fp);
     
     fseek(fp, 0, SEEK_END);
     long file_size = ftell(fp);
@@ -373,36 +1209,81 @@ int ultra_decompress_file(const char* input_path, const char* output_path, doubl
     fread(compressed, 1, compressed_size, fp);
     fclose(fp);
     
-    // Decompress LZMA
-    size_t decompressed_capacity = compressed_size * 30; // Safety margin
-    uint8_t* decompressed = malloc(decompressed_capacity);
-    
-    lzma_stream strm = LZMA_STREAM_INIT;
-    lzma_stream_decoder(&strm, UINT64_MAX, 0);
-    strm.next_in = compressed;
-    strm.avail_in = compressed_size;
-    strm.next_out = decompressed;
-    strm.avail_out = decompressed_capacity;
-    lzma_code(&strm, LZMA_FINISH);
-    size_t decompressed_size = strm.total_out;
-    lzma_end(&strm);
-    free(compressed);
+    // Decompress the column stream (LZMA, per-column streams, or CM at the max level)
+    uint8_t* decompressed;
+    size_t stream_size;
+    if (flags & ULCU_FLAG_CM) {
+        size_t decompressed_size;
+        decompressed = cm_decompress(compressed, compressed_size, &stream_size, &decompressed_size);
+    } else if (flags & ULCU_FLAG_STREAMS) {
+        size_t decompressed_size;
+        decompressed = streams_decompress(compressed, compressed_size, &stream_size, &decompressed_size);
+        if (!decompressed) {
+            free(compressed);
+            return -1;
+        }
+    } else {
+        // Grow the output until the stream ends: highly repetitive logs
+        // expand past any fixed ratio, and a short buffer would also cut
+        // stream_size short of the side streams
+        size_t decompressed_capacity = compressed_size * 30 + 4096;
+        decompressed = malloc(decompressed_capacity);
+        
+        lzma_stream strm = LZMA_STREAM_INIT;
+        lzma_stream_decoder(&strm, UINT64_MAX, 0);
+        strm.next_in = compressed;
+        strm.avail_in = compressed_size;
+        strm.next_out = decompressed;
+        strm.avail_out = decompressed_capacity;
+        while (lzma_code(&strm, LZMA_FINISH) == LZMA_OK) {
+            if (strm.avail_out == 0) {
+                decompressed_capacity *= 2;
+                decompressed = realloc(decompressed, decompressed_capacity);
+                strm.next_out = decompressed + strm.total_out;
+                strm.avail_out = decompressed_capacity - strm.total_out;
+            }
+        }
+        stream_size = strm.total_in;
+        lzma_end(&strm);
+    }
     
-    // Reverse BWT
-    reverse_bwt(decompressed, decompressed_size, bwt_primary);
+    // Side streams follow the main stream
+    const uint8_t* side = (flags & ULCU_FLAG_SIDE_STREAMS) ? compressed + stream_size : NULL;
+    size_t side_offset = 0;
     
     // Parse Columns
     size_t offset = 0;
     uint64_t line_count = decode_varint(decompressed, &offset);
     uint64_t max_fields = decode_varint(decompressed, &offset);
     
+    // Trace columns come after the data columns
+    size_t data_fields = (flags & ULCU_FLAG_TRACES) ? max_fields - 2 : max_fields;
+    
+    // Keyed mode: column names, in column order
+    Dictionary* names = NULL;
+    if (flags & ULCU_FLAG_KEYED) {
+        names = dict_new(data_fields ? data_fields : 1);
+        for (size_t j = 0; j < data_fields; j++) {
+            uint64_t len = decode_varint(decompressed, &offset);
+            char* name = malloc(len + 1);
+            memcpy(name, decompressed + offset, len);
+            name[len] = '\0';
+            offset += len;
+            dict_get_or_add(names, name);
+            free(name);
+        }
+    }
+    
     char*** columns = malloc(sizeof(char**) * max_fields);
     
+    // Dictionary ids of the columns read so far, for conditional columns
+    ContextModel* context = context_model_new(max_fields, line_count);
+    
     for (size_t j = 0; j < max_fields; j++) {
         columns[j] = malloc(sizeof(char*) * line_count);
         uint8_t encoding_type = decompressed[offset++];
         
-        if (encoding_type == 1) {
+        if (encoding_type == 1 || encoding_type == 7 || encoding_type == 9) {
             // DICTIONARY
             uint64_t dict_count = decode_varint(decompressed, &offset);
             char** dict = malloc(sizeof(char*) * dict_count);
@@ -414,19 +1295,46 @@ int ultra_decompress_file(const char* input_path, const char* output_path, doubl
                 offset += len;
             }
             
+            uint32_t* ids;
+            if (encoding_type == 9) {
+                // Conditional ids: per-context dictionary lookups
+                ids = context_decode(decompressed, &offset, context, dict_count);
+            } else if (encoding_type == 7) {
+                // Entropy-coded ids from the side stream
+                uint16_t* coded = decode_id_stream(side, &side_offset, line_count);
+                ids = malloc(sizeof(uint32_t) * (line_count ? line_count : 1));
+                for (size_t i = 0; i < line_count; i++) ids[i] = coded[i];
+                free(coded);
+            } else {
+                ids = malloc(sizeof(uint32_t) * (line_count ? line_count : 1));
+                for (size_t i = 0; i < line_count; i++) {
+                    uint64_t id = decode_varint(decompressed, &offset);
+                    ids[i] = id < dict_count ? (uint32_t)id : UINT32_MAX;
+                }
+            }
             for (size_t i = 0; i < line_count; i++) {
-                uint64_t id = decode_varint(decompressed, &offset);
-                if (id < dict_count) columns[j][i] = strdup(dict[id]);
-                else columns[j][i] = strdup("");
+                columns[j][i] = strdup(ids[i] < dict_count ? dict[ids[i]] : "");
             }
+            context_model_set(context, j, ids, dict_count);
             
             for(size_t k=0; k<dict_count; k++) free(dict[k]);
             free(dict);
-        } else if (encoding_type == 2) {
+        } else if (encoding_type == 2 || encoding_type == 8) {
             // DELTA
+            const uint8_t* stream = decompressed;
+            size_t* stream_offset = &offset;
+            uint8_t* side_bytes = NULL;
+            size_t side_bytes_offset = 0;
+            if (encoding_type == 8) {
+                size_t len;
+                side_offset++;   // Coder tag (rANS, order is in the block)
+                side_bytes = rans_decode_block(side, &side_offset, &len);
+                stream = side_bytes;
+                stream_offset = &side_bytes_offset;
+            }
             long long prev = 0;
             for (size_t i = 0; i < line_count; i++) {
-                uint64_t zigzag = decode_varint(decompressed, &offset);
+                uint64_t zigzag = decode_varint(stream, stream_offset);
                 long long delta = (zigzag >> 1) ^ -(zigzag & 1);
                 long long val = prev + delta;
                 char buf[64];
@@ -434,6 +1342,7 @@ int ultra_decompress_file(const char* input_path, const char* output_path, doubl
                 columns[j][i] = strdup(buf);
                 prev = val;
             }
+            free(side_bytes);
         } else if (encoding_type == 3) {
             // IP XOR
             uint32_t prev_ip = 0;
@@ -446,6 +1355,39 @@ int ultra_decompress_file(const char* input_path, const char* output_path, doubl
                 columns[j][i] = strdup(buf);
                 prev_ip = ip;
             }
+        } else if (encoding_type == 4) {
+            // TEMPLATE
+            decode_template_column(decompressed, &offset, columns[j], line_count);
+        } else if (encoding_type == 5) {
+            // ADDRESS
+            AddrCodec codec;
+            addr_codec_init(&codec);
+            char text[ADDR_MAX_TEXT];
+            for (size_t i = 0; i < line_count; i++) {
+                size_t len;
+                if (addr_decode(&codec, decompressed, &offset, text, &len) == ADDR_FAMILY_NONE) {
+                    columns[j][i] = malloc(len + 1);
+                    memcpy(columns[j][i], decompressed + offset, len);
+                    columns[j][i][len] = '\0';
+                    offset += len;
+                } else {
+                    columns[j][i] = strdup(text);
+                }
+            }
+        } else if (encoding_type == 6) {
+            // BWT
+            uint64_t stream_len = decode_varint(decompressed, &offset);
+            size_t text_len;
+            uint8_t* text = bwt_decode_stream(decompressed + offset, stream_len, &text_len);
+            offset += stream_len;
+            char* p = (char*)text;
+            for (size_t i = 0; i < line_count; i++) {
+                char* end = strchr(p, '\n');
+                if (end) *end = '\0';
+                columns[j][i] = strdup(p);
+                p = end ? end + 1 : p + strlen(p);
+            }
+            free(text);
         } else {
             // RAW
             for (size_t i = 0; i < line_count; i++) {
@@ -459,14 +1401,23 @@ int ultra_decompress_file(const char* input_path, const char* output_path, doubl
     }
     
     free(decompressed);
+    free(compressed);
+    context_model_free(context);
     
     // Write output
-    FILE* out_fp = fopen(output_path, "w");
-    for (size_t i = 0; i < line_count; i++) {
-        for (size_t j = 0; j < max_fields; j++) {
+    FILE* out_fp = fopen(output_path, "wb");
+    const char* line_end = (flags & ULCU_FLAG_CRLF) ? "\r\n" : "\n";
+    char** frames = (flags & ULCU_FLAG_TRACES) ? columns[data_fields] : NULL;
+    char** messages = (flags & ULCU_FLAG_TRACES) ? columns[data_fields + 1] : NULL;
+    if (names) {
+        write_keyed_rows(out_fp, columns, names, frames, messages, line_count, line_end);
+        dict_free(names);
+    }
+    for (size_t i = 0; !names && i < line_count; i++) {
+        for (size_t j = 0; j < data_fields; j++) {
             if (columns[j][i] && strlen(columns[j][i]) > 0) {
                 fprintf(out_fp, "%s", columns[j][i]);
-                if (j < max_fields - 1) {
+                if (j < data_fields - 1) {
                     // This is tricky: we don't know the original separators
                     // ULC-C parser strips them. We'll assume space for now
                     // Ideally we'd store separators too
@@ -474,7 +1425,8 @@ int ultra_decompress_file(const char* input_path, const char* output_path, doubl
                 }
             }
         }
-        fprintf(out_fp, "\n");
+        if (frames) write_trace(out_fp, frames[i], messages[i], line_end);
+        fprintf(out_fp, "%s", line_end);
     }
     fclose(out_fp);
     
@@ -0,0 +1,220 @@
+#include "../include/ulc_ultra_context.h"
+#include "../../ulc-c/include/ulc_utils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Estimated cost of one per-context dictionary entry (a varint id before LZMA)
+#define CONTEXT_ENTRY_BITS 12.0
+
+// Share of the plain id bits a predictor has to save to be used
+#define CONTEXT_MIN_GAIN 0.25
+
+// A (context, id) pair of a column and its place in the context's dictionary
+typedef struct {
+    uint64_t key;      // context << 32 | id
+    uint32_t count;
+    uint32_t rank;
+} ContextPair;
+
+ContextModel* context_model_new(size_t field_count, size_t rows) {
+    ContextModel* model = calloc(1, sizeof(ContextModel));
+    size_t n = field_count ? field_count : 1;
+    model->field_count = field_count;
+    model->rows = rows;
+    model->field_counts = calloc(n, sizeof(int));
+    model->ids = calloc(n, sizeof(uint32_t*));
+    model->correlation_matrix = malloc(sizeof(int*) * n);
+    for (size_t j = 0; j < n; j++) model->correlation_matrix[j] = calloc(field_count + 1, sizeof(int));
+    return model;
+}
+
+void context_model_free(ContextModel* model) {
+    if (!model) return;
+    size_t n = model->field_count ? model->field_count : 1;
+    for (size_t j = 0; j < n; j++) {
+        free(model->ids[j]);
+        free(model->correlation_matrix[j]);
+    }
+    free(model->ids);
+    free(model->correlation_matrix);
+    free(model->field_counts);
+    free(model);
+}
+
+void context_model_set(ContextModel* model, size_t column, uint32_t* ids, size_t alphabet) {
+    free(model->ids[column]);
+    model->ids[column] = ids;
+    model->field_counts[column] = (int)alphabet;
+}
+
+// Context of row i (0 for every row without a predictor)
+static inline uint32_t context_of(const ContextModel* model, const uint32_t* ids, int predictor, size_t i) {
+    if (predictor == CONTEXT_PREVIOUS_ROW) return i ? ids[i - 1] : 0;
+    if (predictor < 0) return 0;
+    return model->ids[predictor][i];
+}
+
+static int u64_compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static int pair_key_compare(const void* a, const void* b) {
+    const ContextPair* x = a;
+    const ContextPair* y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+// Most frequent first, then by id
+static int pair_rank_compare(const void* a, const void* b) {
+    const ContextPair* x = a;
+    const ContextPair* y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+// Distinct (context, id) pairs of the first rows with their counts, by key
+static ContextPair* collect_pairs(const ContextModel* model, const uint32_t* ids, int predictor, size_t rows,
+                                  size_t* pair_count) {
+    uint64_t* keys = malloc(sizeof(uint64_t) * (rows ? rows : 1));
+    for (size_t i = 0; i < rows; i++) keys[i] = (uint64_t)context_of(model, ids, predictor, i) << 32 | ids[i];
+    qsort(keys, rows, sizeof(uint64_t), u64_compare);
+
+    ContextPair* pairs = malloc(sizeof(ContextPair) * (rows ? rows : 1));
+    size_t count = 0;
+    for (size_t i = 0; i < rows; ) {
+        size_t j = i;
+        while (j < rows && keys[j] == keys[i]) j++;
+        pairs[count].key = keys[i];
+        pairs[count].count = (uint32_t)(j - i);
+        pairs[count++].rank = 0;
+        i = j;
+    }
+    free(keys);
+    *pair_count = count;
+    return pairs;
+}
+
+// Bits of the ids given their contexts (entropy within each context) plus
+// the per-context dictionaries
+static double conditional_bits(const ContextPair* pairs, size_t pair_count, int with_tables) {
+    double bits = 0.0;
+    for (size_t i = 0; i < pair_count; ) {
+        size_t j = i;
+        uint64_t total = 0;
+        while (j < pair_count && pairs[j].key >> 32 == pairs[i].key >> 32) total += pairs[j++].count;
+        for (size_t k = i; k < j; k++) bits -= pairs[k].count * log2((double)pairs[k].count / total);
+        i = j;
+    }
+    if (with_tables) bits += pair_count * CONTEXT_ENTRY_BITS;
+    return bits;
+}
+
+static size_t context_count(const ContextModel* model, size_t column, int predictor) {
+    return (size_t)model->field_counts[predictor == CONTEXT_PREVIOUS_ROW ? (int)column : predictor];
+}
+
+int context_model_fit(ContextModel* model, size_t column) {
+    const uint32_t* ids = model->ids[column];
+    if (!ids || model->rows < CONTEXT_MIN_ROWS) return CONTEXT_NONE;
+    size_t rows = model->rows < CONTEXT_SAMPLE_ROWS ? model->rows : CONTEXT_SAMPLE_ROWS;
+
+    size_t pair_count;
+    ContextPair* pairs = collect_pairs(model, ids, CONTEXT_NONE, rows, &pair_count);
+    double plain = conditional_bits(pairs, pair_count, 0);
+    free(pairs);
+
+    int best = CONTEXT_NONE;
+    double best_bits = plain * (1.0 - CONTEXT_MIN_GAIN);
+    for (int predictor = CONTEXT_PREVIOUS_ROW; predictor < (int)column; predictor++) {
+        if (predictor >= 0 && !model->ids[predictor]) continue;
+        if (context_count(model, column, predictor) > CONTEXT_MAX_CONTEXTS) continue;
+        pairs = collect_pairs(model, ids, predictor, rows, &pair_count);
+        double bits = conditional_bits(pairs, pair_count, 1);
+        free(pairs);
+        model->correlation_matrix[column][predictor + 1] = (int)((plain - bits) * 1000.0 / rows);
+        if (bits < best_bits) {
+            best_bits = bits;
+            best = predictor;
+        }
+    }
+    return best;
+}
+
+void context_encode(ByteArray* out, const ContextModel* model, size_t column, int predictor, size_t rows) {
+    const uint32_t* ids = model->ids[column];
+    size_t contexts = context_count(model, column, predictor);
+    encode_varint(out, (uint64_t)(predictor + 1));   // 0: previous row, k + 1: column k
+
+    // Per-context dictionaries, in context order: each context's pairs are
+    // ranked, written, then put back in key order for the lookups below
+    size_t pair_count;
+    ContextPair* pairs = collect_pairs(model, ids, predictor, rows, &pair_count);
+    size_t next = 0;
+    for (size_t c = 0; c < contexts; c++) {
+        size_t end = next;
+        while (end < pair_count && pairs[end].key >> 32 == c) end++;
+        qsort(pairs + next, end - next, sizeof(ContextPair), pair_rank_compare);
+        encode_varint(out, end - next);
+        for (size_t k = next; k < end; k++) {
+            pairs[k].rank = (uint32_t)(k - next);
+            encode_varint(out, (uint32_t)pairs[k].key);
+        }
+        qsort(pairs + next, end - next, sizeof(ContextPair), pair_key_compare);
+        next = end;
+    }
+
+    // Hit bits (rank 0), then the other rows' ranks less one
+    size_t flag_bytes = (rows + 7) / 8;
+    uint8_t* flags = calloc(flag_bytes ? flag_bytes : 1, 1);
+    ByteArray* residuals = bytearray_new(rows / 4 + 16);
+    for (size_t i = 0; i < rows; i++) {
+        ContextPair probe = { .key = (uint64_t)context_of(model, ids, predictor, i) << 32 | ids[i] };
+        const ContextPair* pair = bsearch(&probe, pairs, pair_count, sizeof(ContextPair), pair_key_compare);
+        if (pair->rank == 0) flags[i >> 3] |= (uint8_t)(1 << (i & 7));
+        else encode_varint(residuals, pair->rank - 1);
+    }
+    bytearray_append(out, flags, flag_bytes);
+    bytearray_append(out, residuals->data, residuals->length);
+
+    free(flags);
+    bytearray_free(residuals);
+    free(pairs);
+}
+
+uint32_t* context_decode(const uint8_t* data, size_t* offset, const ContextModel* model, size_t alphabet) {
+    size_t rows = model->rows;
+    int predictor = (int)decode_varint(data, offset) - 1;
+    size_t contexts = predictor == CONTEXT_PREVIOUS_ROW ? alphabet : (size_t)model->field_counts[predictor];
+
+    // Dictionaries back to back: context c owns table[starts[c] .. starts[c + 1])
+    size_t* starts = malloc(sizeof(size_t) * (contexts + 1));
+    size_t table_cap = contexts + 16;
+    uint32_t* table = malloc(sizeof(uint32_t) * table_cap);
+    size_t total = 0;
+    for (size_t c = 0; c < contexts; c++) {
+        starts[c] = total;
+        uint64_t n = decode_varint(data, offset);
+        if (total + n > table_cap) {
+            while (total + n > table_cap) table_cap *= 2;
+            table = realloc(table, sizeof(uint32_t) * table_cap);
+        }
+        for (uint64_t k = 0; k < n; k++) table[total++] = (uint32_t)decode_varint(data, offset);
+    }
+    starts[contexts] = total;
+
+    const uint8_t* flags = data + *offset;
+    size_t residual_offset = *offset + (rows + 7) / 8;
+    uint32_t* ids = malloc(sizeof(uint32_t) * (rows ? rows : 1));
+    for (size_t i = 0; i < rows; i++) {
+        uint32_t c = context_of(model, ids, predictor, i);
+        uint64_t rank = (flags[i >> 3] >> (i & 7)) & 1 ? 0 : decode_varint(data, &residual_offset) + 1;
+        ids[i] = c < contexts && starts[c] + rank < starts[c + 1] ? table[starts[c] + rank] : 0;
+    }
+    *offset = residual_offset;
+
+    free(starts);
+    free(table);
+    return ids;
+}
@@ -1,62 +1,108 @@
 #include "../include/ulc_ultra_huffman.h"
+#include "../../ulc-c/include/ulc_utils.h"
 #include <stdlib.h>
 #include <string.h>
 
-// Bit stream implementation
+// Bit stream implementation (LSB-first, 64-bit buffer)
 BitStream* bitstream_new(size_t initial_capacity) {
     BitStream* stream = malloc(sizeof(BitStream));
     stream->capacity = initial_capacity > 0 ? initial_capacity : 1024;
-    stream->data = calloc(stream->capacity, 1);
+    stream->data = malloc(stream->capacity + 8);
     stream->byte_pos = 0;
-    stream->bit_pos = 0;
+    stream->length = 0;
+    stream->bit_buffer = 0;
+    stream->bit_count = 0;
     return stream;
 }
 
-void bitstream_write_bit(BitStream* stream, int bit) {
-    if (stream->byte_pos >= stream->capacity) {
-        stream->capacity *= 2;
-        stream->data = realloc(stream->data, stream->capacity);
-    }
-    
-    if (bit) {
-        stream->data[stream->byte_pos] |= (1 << (7 - stream->bit_pos));
-    }
-    
-    stream->bit_pos++;
-    if (stream->bit_pos == 8) {
-        stream->bit_pos = 0;
-        stream->byte_pos++;
-    }
+BitStream* bitstream_wrap(const uint8_t* data, size_t len) {
+    BitStream* stream = bitstream_new(len);
+    memcpy(stream->data, data, len);
+    stream->length = len;
+    return stream;
+}
+
+static void bitstream_init_reader(BitStream* stream, const uint8_t* data, size_t len) {
+    stream->data = (uint8_t*)data;
+    stream->capacity = len;
+    stream->length = len;
+    stream->byte_pos = 0;
+    stream->bit_buffer = 0;
+    stream->bit_count = 0;
+}
+
+static inline uint64_t load_le64(const uint8_t* p) {
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
 }
 
+// Writes whole 32-bit words once the buffer holds them (num_bits <= 32)
 void bitstream_write_bits(BitStream* stream, uint32_t value, int num_bits) {
-    for (int i = num_bits - 1; i >= 0; i--) {
-        bitstream_write_bit(stream, (value >> i) & 1);
+    stream->bit_buffer |= (uint64_t)value << stream->bit_count;
+    stream->bit_count += num_bits;
+    if (stream->bit_count >= 32) {
+        if (stream->byte_pos + 4 > stream->capacity) {
+            stream->capacity *= 2;
+            stream->data = realloc(stream->data, stream->capacity + 8);
+        }
+        uint8_t* p = stream->data + stream->byte_pos;
+        p[0] = (uint8_t)stream->bit_buffer;
+        p[1] = (uint8_t)(stream->bit_buffer >> 8);
+        p[2] = (uint8_t)(stream->bit_buffer >> 16);
+        p[3] = (uint8_t)(stream->bit_buffer >> 24);
+        stream->byte_pos += 4;
+        stream->bit_buffer >>= 32;
+        stream->bit_count -= 32;
     }
 }
 
-int bitstream_read_bit(BitStream* stream) {
-    if (stream->byte_pos >= stream->capacity) return 0;
-    
-    int bit = (stream->data[stream->byte_pos] >> (7 - stream->bit_pos)) & 1;
-    
-    stream->bit_pos++;
-    if (stream->bit_pos == 8) {
-        stream->bit_pos = 0;
+void bitstream_write_bit(BitStream* stream, int bit) {
+    bitstream_write_bits(stream, bit ? 1 : 0, 1);
+}
+
+// Pad the last byte with zeros; length is final afterwards
+void bitstream_flush(BitStream* stream) {
+    while (stream->bit_count > 0) {
+        if (stream->byte_pos >= stream->capacity) {
+            stream->capacity *= 2;
+            stream->data = realloc(stream->data, stream->capacity + 8);
+        }
+        stream->data[stream->byte_pos++] = (uint8_t)stream->bit_buffer;
+        stream->bit_buffer >>= 8;
+        stream->bit_count = stream->bit_count > 8 ? stream->bit_count - 8 : 0;
+    }
+    stream->length = stream->byte_pos;
+}
+
+// Top the buffer up to at least 56 bits (zeros past the end)
+static inline void bitstream_refill(BitStream* stream) {
+    if (stream->byte_pos + 8 <= stream->length) {
+        stream->bit_buffer |= load_le64(stream->data + stream->byte_pos) << stream->bit_count;
+        stream->byte_pos += (63 - stream->bit_count) >> 3;
+        stream->bit_count |= 56;
+        return;
+    }
+    while (stream->bit_count <= 56) {
+        uint64_t byte = stream->byte_pos < stream->length ? stream->data[stream->byte_pos] : 0;
         stream->byte_pos++;
+        stream->bit_buffer |= byte << stream->bit_count;
+        stream->bit_count += 8;
     }
-    
-    return bit;
 }
 
 uint32_t bitstream_read_bits(BitStream* stream, int num_bits) {
-    uint32_t value = 0;
-    for (int i = 0; i < num_bits; i++) {
-        value = (value << 1) | bitstream_read_bit(stream);
-    }
+    if (num_bits == 0) return 0;
+    if (stream->bit_count < num_bits) bitstream_refill(stream);
+    uint32_t value = (uint32_t)(stream->bit_buffer & ((1ULL << num_bits) - 1));
+    stream->bit_buffer >>= num_bits;
+    stream->bit_count -= num_bits;
     return value;
 }
 
+int bitstream_read_bit(BitStream* stream) {
+    return (int)bitstream_read_bits(stream, 1);
+}
+
 void bitstream_free(BitStream* stream) {
     if (stream) {
         free(stream->data);
@@ -64,116 +110,322 @@ void bitstream_free(BitStream* stream) {
     }
 }
 
-// Huffman tree node comparison for priority queue
-static int compare_nodes(const void* a, const void* b) {
-    HuffmanNode* na = *(HuffmanNode**)a;
-    HuffmanNode* nb = *(HuffmanNode**)b;
-    return na->frequency - nb->frequency;
+// --- Code construction ---
+
+// Package-merge item: a leaf (symbol >= 0) or a package of two items
+typedef struct {
+    uint64_t weight;
+    int symbol;
+    int left;
+    int right;
+} MergeItem;
+
+static int compare_leaves(const void* a, const void* b) {
+    const MergeItem* x = a;
+    const MergeItem* y = b;
+    if (x->weight != y->weight) return x->weight < y->weight ? -1 : 1;
+    return x->symbol - y->symbol;
 }
 
-// Build Huffman tree from frequencies
-static HuffmanNode* build_huffman_tree(int* frequencies, size_t symbol_count) {
-    // Create leaf nodes
-    HuffmanNode** nodes = malloc(sizeof(HuffmanNode*) * symbol_count * 2);
-    size_t node_count = 0;
-    
+static void count_item(const MergeItem* pool, int index, uint8_t* lengths) {
+    const MergeItem* item = &pool[index];
+    if (item->symbol >= 0) {
+        lengths[item->symbol]++;
+        return;
+    }
+    count_item(pool, item->left, lengths);
+    count_item(pool, item->right, lengths);
+}
+
+// Optimal code lengths bounded by max_bits (Larmore-Hirschberg package-merge)
+static void package_merge(const int* frequencies, size_t symbol_count, int max_bits, uint8_t* lengths) {
+    memset(lengths, 0, symbol_count);
+
+    size_t n = 0;
+    for (size_t i = 0; i < symbol_count; i++) n += frequencies[i] > 0;
+    if (n == 0) return;
+
+    // Leaves sit at the front of the pool, packages are appended per level
+    MergeItem* pool = malloc(sizeof(MergeItem) * (n + (size_t)max_bits * n));
+    size_t pool_count = 0;
     for (size_t i = 0; i < symbol_count; i++) {
         if (frequencies[i] > 0) {
-            HuffmanNode* node = malloc(sizeof(HuffmanNode));
-            node->symbol = i;
-            node->frequency = frequencies[i];
-            node->left = NULL;
-            node->right = NULL;
-            nodes[node_count++] = node;
+            pool[pool_count].weight = (uint64_t)frequencies[i];
+            pool[pool_count].symbol = (int)i;
+            pool[pool_count].left = pool[pool_count].right = -1;
+            pool_count++;
         }
     }
-    
-    if (node_count == 0) return NULL;
-    if (node_count == 1) return nodes[0];
-    
-    // Build tree
-    while (node_count > 1) {
-        qsort(nodes, node_count, sizeof(HuffmanNode*), compare_nodes);
-        
-        HuffmanNode* left = nodes[0];
-        HuffmanNode* right = nodes[1];
-        
-        HuffmanNode* parent = malloc(sizeof(HuffmanNode));
-        parent->symbol = -1;
-        parent->frequency = left->frequency + right->frequency;
-        parent->left = left;
-        parent->right = right;
-        
-        nodes[0] = parent;
-        for (size_t i = 1; i < node_count - 1; i++) {
-            nodes[i] = nodes[i + 1];
+    if (n == 1) {
+        lengths[pool[0].symbol] = 1;
+        free(pool);
+        return;
+    }
+    qsort(pool, n, sizeof(MergeItem), compare_leaves);
+
+    int* list = malloc(sizeof(int) * 2 * n);
+    int* next = malloc(sizeof(int) * 2 * n);
+    size_t list_len = n;
+    for (size_t i = 0; i < n; i++) list[i] = (int)i;
+
+    for (int level = 1; level < max_bits; level++) {
+        // Pair up the previous list and merge the packages with the leaves
+        size_t packages = list_len / 2;
+        size_t first_package = pool_count;
+        for (size_t p = 0; p < packages; p++) {
+            MergeItem* item = &pool[pool_count++];
+            item->left = list[2 * p];
+            item->right = list[2 * p + 1];
+            item->weight = pool[item->left].weight + pool[item->right].weight;
+            item->symbol = -1;
+        }
+
+        size_t a = 0, b = 0, k = 0;
+        while (a < n || b < packages) {
+            if (b >= packages || (a < n && pool[a].weight <= pool[first_package + b].weight)) {
+                next[k++] = (int)a++;
+            } else {
+                next[k++] = (int)(first_package + b++);
+            }
         }
-        node_count--;
+        int* tmp = list;
+        list = next;
+        next = tmp;
+        list_len = k;
     }
-    
-    HuffmanNode* root = nodes[0];
-    free(nodes);
-    return root;
+
+    // Every leaf inside the 2n - 2 cheapest items adds one bit to its code
+    for (size_t i = 0; i < 2 * n - 2; i++) count_item(pool, list[i], lengths);
+
+    free(list);
+    free(next);
+    free(pool);
 }
 
-// Generate codes from tree
-static void generate_codes(HuffmanNode* node, HuffmanCode* codes, uint32_t code, int length) {
-    if (!node) return;
-    
-    if (node->symbol != -1) {
-        codes[node->symbol].code = code;
-        codes[node->symbol].length = length;
-        return;
+// Canonical codes from lengths (DEFLATE order), bit-reversed for LSB-first
+static void assign_codes(HuffmanEncoder* encoder, const uint8_t* lengths) {
+    int bl_count[HUFF_MAX_BITS + 1] = {0};
+    uint32_t next_code[HUFF_MAX_BITS + 2];
+    for (size_t i = 0; i < encoder->code_count; i++) bl_count[lengths[i]]++;
+    bl_count[0] = 0;
+
+    uint32_t code = 0;
+    for (int bits = 1; bits <= HUFF_MAX_BITS; bits++) {
+        code = (code + bl_count[bits - 1]) << 1;
+        next_code[bits] = code;
+    }
+
+    for (size_t i = 0; i < encoder->code_count; i++) {
+        int len = lengths[i];
+        encoder->codes[i].length = len;
+        encoder->codes[i].code = 0;
+        if (len == 0) continue;
+        uint32_t c = next_code[len]++;
+        uint32_t reversed = 0;
+        for (int k = 0; k < len; k++) reversed |= ((c >> k) & 1) << (len - 1 - k);
+        encoder->codes[i].code = reversed;
     }
-    
-    generate_codes(node->left, codes, (code << 1) | 0, length + 1);
-    generate_codes(node->right, codes, (code << 1) | 1, length + 1);
 }
 
-HuffmanEncoder* huffman_create(int* frequencies, size_t symbol_count) {
+// Multi-symbol table: each entry holds as many whole codes as fit in the
+// next HUFF_MAX_BITS bits
+static void build_table(HuffmanEncoder* encoder) {
+    uint16_t* single_symbol = calloc(HUFF_TABLE_SIZE, sizeof(uint16_t));
+    uint8_t* single_length = malloc(HUFF_TABLE_SIZE);
+    memset(single_length, HUFF_MAX_BITS, HUFF_TABLE_SIZE);   // Unused patterns
+
+    for (size_t i = 0; i < encoder->code_count; i++) {
+        int len = encoder->codes[i].length;
+        if (len == 0) continue;
+        for (uint32_t x = encoder->codes[i].code; x < HUFF_TABLE_SIZE; x += 1u << len) {
+            single_symbol[x] = (uint16_t)i;
+            single_length[x] = (uint8_t)len;
+        }
+    }
+
+    encoder->table = malloc(sizeof(HuffmanTableEntry) * HUFF_TABLE_SIZE);
+    for (uint32_t x = 0; x < HUFF_TABLE_SIZE; x++) {
+        HuffmanTableEntry* entry = &encoder->table[x];
+        int bits = 0;
+        entry->count = 0;
+        while (entry->count < HUFF_MULTI) {
+            uint32_t index = x >> bits;
+            int len = single_length[index];
+            if (bits + len > HUFF_MAX_BITS) break;
+            entry->symbols[entry->count++] = single_symbol[index];
+            bits += len;
+        }
+        entry->bits = (uint8_t)bits;
+    }
+
+    free(single_symbol);
+    free(single_length);
+}
+
+HuffmanEncoder* huffman_from_lengths(const uint8_t* lengths, size_t symbol_count) {
     HuffmanEncoder* encoder = malloc(sizeof(HuffmanEncoder));
     encoder->code_count = symbol_count;
-    encoder->codes = calloc(symbol_count, sizeof(HuffmanCode));
-    
-    encoder->root = build_huffman_tree(frequencies, symbol_count);
-    if (encoder->root) {
-        generate_codes(encoder->root, encoder->codes, 0, 0);
-    }
-    
+    encoder->codes = calloc(symbol_count ? symbol_count : 1, sizeof(HuffmanCode));
+    assign_codes(encoder, lengths);
+    build_table(encoder);
     return encoder;
 }
 
-BitStream* huffman_encode(HuffmanEncoder* encoder, uint8_t* data, size_t data_len) {
-    BitStream* stream = bitstream_new(data_len * 2);
-    
+HuffmanEncoder* huffman_create(int* frequencies, size_t symbol_count) {
+    uint8_t* lengths = malloc(symbol_count ? symbol_count : 1);
+    package_merge(frequencies, symbol_count, HUFF_MAX_BITS, lengths);
+    HuffmanEncoder* encoder = huffman_from_lengths(lengths, symbol_count);
+    free(lengths);
+    return encoder;
+}
+
+BitStream* huffman_encode(HuffmanEncoder* encoder, const uint16_t* data, size_t data_len) {
+    BitStream* stream = bitstream_new(data_len / 2 + 16);
     for (size_t i = 0; i < data_len; i++) {
-        uint8_t symbol = data[i];
-        if (symbol < encoder->code_count) {
-            HuffmanCode code = encoder->codes[symbol];
-            bitstream_write_bits(stream, code.code, code.length);
-        }
+        const HuffmanCode* code = &encoder->codes[data[i]];
+        bitstream_write_bits(stream, code->code, code->length);
     }
-    
+    bitstream_flush(stream);
     return stream;
 }
 
-static void free_huffman_tree(HuffmanNode* node) {
-    if (!node) return;
-    free_huffman_tree(node->left);
-    free_huffman_tree(node->right);
-    free(node);
+void huffman_decode(HuffmanEncoder* encoder, BitStream* stream, uint16_t* out, size_t count) {
+    const HuffmanTableEntry* table = encoder->table;
+    size_t n = 0;
+    while (n + HUFF_MULTI <= count) {
+        if (stream->bit_count < HUFF_MAX_BITS) bitstream_refill(stream);
+        const HuffmanTableEntry* entry = &table[stream->bit_buffer & (HUFF_TABLE_SIZE - 1)];
+        memcpy(out + n, entry->symbols, sizeof(entry->symbols));
+        n += entry->count;
+        stream->bit_buffer >>= entry->bits;
+        stream->bit_count -= entry->bits;
+    }
+    // Tail: one symbol per probe so we never run past count
+    while (n < count) {
+        if (stream->bit_count < HUFF_MAX_BITS) bitstream_refill(stream);
+        uint16_t symbol = table[stream->bit_buffer & (HUFF_TABLE_SIZE - 1)].symbols[0];
+        int len = encoder->codes[symbol].length;
+        out[n++] = symbol;
+        stream->bit_buffer >>= len;
+        stream->bit_count -= len;
+    }
 }
 
 void huffman_free(HuffmanEncoder* encoder) {
     if (encoder) {
         free(encoder->codes);
-        free_huffman_tree(encoder->root);
+        free(encoder->table);
         free(encoder);
     }
 }
 
-uint8_t* huffman_decode(HuffmanEncoder* encoder, BitStream* stream, size_t* out_len) {
-    // Simplified decoder - full implementation would decode using tree
-    *out_len = 0;
-    return NULL;
+// --- Blocks ---
+// Layout: varint alphabet, code lengths as nibbles, varint byte length of
+// each of the HUFF_STREAMS streams, then the streams. Stream s carries the
+// s-th quarter of the symbols so the decoder can run all four at once.
+
+static size_t stream_start(size_t count, int s) {
+    return count * (size_t)s / HUFF_STREAMS;
+}
+
+static uint8_t* block_lengths(const uint16_t* symbols, size_t count, size_t alphabet) {
+    int* frequencies = calloc(alphabet ? alphabet : 1, sizeof(int));
+    for (size_t i = 0; i < count; i++) frequencies[symbols[i]]++;
+    uint8_t* lengths = malloc(alphabet ? alphabet : 1);
+    package_merge(frequencies, alphabet, HUFF_MAX_BITS, lengths);
+    free(frequencies);
+    return lengths;
+}
+
+static size_t varint_size(uint64_t value) {
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+size_t huffman_block_size(const uint16_t* symbols, size_t count, size_t alphabet) {
+    uint8_t* lengths = block_lengths(symbols, count, alphabet);
+    size_t size = varint_size(alphabet) + (alphabet + 1) / 2;
+    for (int s = 0; s < HUFF_STREAMS; s++) {
+        uint64_t bits = 0;
+        for (size_t i = stream_start(count, s); i < stream_start(count, s + 1); i++) {
+            bits += lengths[symbols[i]];
+        }
+        size += varint_size((bits + 7) / 8) + (bits + 7) / 8;
+    }
+    free(lengths);
+    return size;
+}
+
+void huffman_encode_block(ByteArray* out, const uint16_t* symbols, size_t count, size_t alphabet) {
+    uint8_t* lengths = block_lengths(symbols, count, alphabet);
+
+    encode_varint(out, alphabet);
+    for (size_t i = 0; i < alphabet; i += 2) {
+        uint8_t hi = i + 1 < alphabet ? lengths[i + 1] : 0;
+        bytearray_append_byte(out, (uint8_t)(lengths[i] | (hi << 4)));
+    }
+
+    HuffmanEncoder* encoder = huffman_from_lengths(lengths, alphabet);
+    BitStream* streams[HUFF_STREAMS];
+    for (int s = 0; s < HUFF_STREAMS; s++) {
+        size_t start = stream_start(count, s);
+        streams[s] = huffman_encode(encoder, symbols + start, stream_start(count, s + 1) - start);
+        encode_varint(out, streams[s]->length);
+    }
+    for (int s = 0; s < HUFF_STREAMS; s++) {
+        bytearray_append(out, streams[s]->data, streams[s]->length);
+        bitstream_free(streams[s]);
+    }
+
+    huffman_free(encoder);
+    free(lengths);
+}
+
+void huffman_decode_block(const uint8_t* data, size_t* offset, uint16_t* out, size_t count) {
+    size_t alphabet = decode_varint(data, offset);
+    uint8_t* lengths = malloc(alphabet ? alphabet : 1);
+    for (size_t i = 0; i < alphabet; i += 2) {
+        uint8_t packed = data[(*offset)++];
+        lengths[i] = packed & 0x0F;
+        if (i + 1 < alphabet) lengths[i + 1] = packed >> 4;
+    }
+    HuffmanEncoder* encoder = huffman_from_lengths(lengths, alphabet);
+    free(lengths);
+
+    size_t stream_len[HUFF_STREAMS];
+    for (int s = 0; s < HUFF_STREAMS; s++) stream_len[s] = decode_varint(data, offset);
+
+    BitStream streams[HUFF_STREAMS];
+    uint16_t* pos[HUFF_STREAMS];
+    size_t remaining[HUFF_STREAMS];
+    for (int s = 0; s < HUFF_STREAMS; s++) {
+        bitstream_init_reader(&streams[s], data + *offset, stream_len[s]);
+        *offset += stream_len[s];
+        pos[s] = out + stream_start(count, s);
+        remaining[s] = stream_start(count, s + 1) - stream_start(count, s);
+    }
+
+    // Interleaved main loop: the four streams are independent, so their
+    // table probes overlap in the pipeline
+    const HuffmanTableEntry* table = encoder->table;
+    while (remaining[0] >= HUFF_MULTI && remaining[1] >= HUFF_MULTI &&
+           remaining[2] >= HUFF_MULTI && remaining[3] >= HUFF_MULTI) {
+        for (int s = 0; s < HUFF_STREAMS; s++) {
+            BitStream* stream = &streams[s];
+            if (stream->bit_count < HUFF_MAX_BITS) bitstream_refill(stream);
+            const HuffmanTableEntry* entry = &table[stream->bit_buffer & (HUFF_TABLE_SIZE - 1)];
+            memcpy(pos[s], entry->symbols, sizeof(entry->symbols));
+            pos[s] += entry->count;
+            remaining[s] -= entry->count;
+            stream->bit_buffer >>= entry->bits;
+            stream->bit_count -= entry->bits;
+        }
+    }
+    for (int s = 0; s < HUFF_STREAMS; s++) huffman_decode(encoder, &streams[s], pos[s], remaining[s]);
+
+    huffman_free(encoder);
 }
@@ -45,70 +45,255 @@ int add_pattern(PatternDict* dict, const char* pattern, int frequency) {
     return id;
 }
 
-// Simple pattern mining: extract common substrings
-void mine_patterns(PatternDict* dict, char** lines, size_t line_count, int min_support) {
-    // For simplicity, extract common prefixes and suffixes
-    // A full implementation would use suffix trees or other advanced algorithms
-    
-    if (line_count < 2) return;
-    
-    // Find common prefix
-    size_t prefix_len = 0;
-    int all_match = 1;
+// --- Drain-style template mining ---
+
+#define TEMPLATE_WILDCARD "<*>"
+
+static int has_digit(const char* token) {
+    for (; *token; token++) {
+        if (*token >= '0' && *token <= '9') return 1;
+    }
+    return 0;
+}
+
+static TemplateNode* template_node_new(const char* key) {
+    TemplateNode* node = calloc(1, sizeof(TemplateNode));
+    node->key = strdup(key);
+    return node;
+}
+
+static void template_node_free(TemplateNode* node) {
+    if (!node) return;
+    for (size_t i = 0; i < node->child_count; i++) {
+        template_node_free(node->children[i]);
+    }
+    free(node->children);
+    free(node->template_ids);
+    free(node->key);
+    free(node);
+}
+
+static TemplateNode* template_node_child(TemplateNode* node, const char* key, size_t max_children) {
+    for (size_t i = 0; i < node->child_count; i++) {
+        if (strcmp(node->children[i]->key, key) == 0) return node->children[i];
+    }
+    // Full nodes route unseen tokens to the wildcard branch
+    if (node->child_count >= max_children && strcmp(key, TEMPLATE_WILDCARD) != 0) {
+        return template_node_child(node, TEMPLATE_WILDCARD, max_children + 1);
+    }
+    if (node->child_count >= node->child_capacity) {
+        node->child_capacity = node->child_capacity ? node->child_capacity * 2 : 4;
+        node->children = realloc(node->children, sizeof(TemplateNode*) * node->child_capacity);
+    }
+    TemplateNode* child = template_node_new(key);
+    node->children[node->child_count++] = child;
+    return child;
+}
+
+size_t template_tokenize(const char* message, char** buffer, char*** tokens) {
+    size_t count = 1;
+    for (const char* p = message; *p; p++) {
+        if (*p == ' ') count++;
+    }
     
-    while (all_match) {
-        if (prefix_len >= strlen(lines[0])) break;
-        
-        char c = lines[0][prefix_len];
-        for (size_t i = 1; i < line_count; i++) {
-            if (prefix_len >= strlen(lines[i]) || lines[i][prefix_len] != c) {
-                all_match = 0;
-                break;
-            }
+    *buffer = strdup(message);
+    *tokens = malloc(sizeof(char*) * count);
+    size_t n = 0;
+    char* start = *buffer;
+    for (char* p = *buffer; ; p++) {
+        if (*p == ' ' || *p == '\0') {
+            int end = (*p == '\0');
+            *p = '\0';
+            (*tokens)[n++] = start;
+            start = p + 1;
+            if (end) break;
         }
-        
-        if (all_match) prefix_len++;
     }
+    return count;
+}
+
+TemplateMiner* template_miner_new(int depth, double similarity) {
+    TemplateMiner* miner = malloc(sizeof(TemplateMiner));
+    miner->root = template_node_new("");
+    miner->template_capacity = 64;
+    miner->templates = malloc(sizeof(LogTemplate) * miner->template_capacity);
+    miner->template_count = 0;
+    miner->depth = depth < 3 ? 3 : depth;
+    miner->similarity = similarity;
+    miner->max_children = 100;
+    return miner;
+}
+
+void template_miner_free(TemplateMiner* miner) {
+    if (miner) {
+        for (size_t i = 0; i < miner->template_count; i++) {
+            LogTemplate* t = &miner->templates[i];
+            for (size_t k = 0; k < t->token_count; k++) free(t->tokens[k]);
+            free(t->tokens);
+        }
+        free(miner->templates);
+        template_node_free(miner->root);
+        free(miner);
+    }
+}
+
+// Share of positions where the template constant equals the token
+static double template_similarity(const LogTemplate* t, char** tokens, size_t* params) {
+    size_t same = 0;
+    *params = 0;
+    for (size_t k = 0; k < t->token_count; k++) {
+        if (!t->tokens[k]) {
+            (*params)++;
+        } else if (strcmp(t->tokens[k], tokens[k]) == 0) {
+            same++;
+        }
+    }
+    return t->token_count ? (double)same / t->token_count : 1.0;
+}
+
+int template_miner_add(TemplateMiner* miner, const char* message) {
+    char* buffer;
+    char** tokens;
+    size_t count = template_tokenize(message, &buffer, &tokens);
     
-    if (prefix_len > 3) {  // Minimum pattern length
-        char* prefix = malloc(prefix_len + 1);
-        strncpy(prefix, lines[0], prefix_len);
-        prefix[prefix_len] = '\0';
-        add_pattern(dict, prefix, line_count);
-        free(prefix);
+    // Descend: token count, then the first (depth - 2) tokens
+    char key[32];
+    snprintf(key, sizeof(key), "%zu", count);
+    TemplateNode* node = template_node_child(miner->root, key, (size_t)-1);
+    for (size_t level = 0; level + 2 < (size_t)miner->depth && level < count; level++) {
+        const char* token = has_digit(tokens[level]) ? TEMPLATE_WILDCARD : tokens[level];
+        node = template_node_child(node, token, miner->max_children);
     }
     
-    // Find common suffix
-    size_t suffix_len = 0;
-    all_match = 1;
-    size_t first_len = strlen(lines[0]);
+    // Best cluster in the leaf (ties go to the more general template)
+    int best = -1;
+    double best_sim = -1.0;
+    size_t best_params = 0;
+    for (size_t i = 0; i < node->template_count; i++) {
+        size_t params;
+        double sim = template_similarity(&miner->templates[node->template_ids[i]], tokens, &params);
+        if (sim > best_sim || (sim == best_sim && params > best_params)) {
+            best = node->template_ids[i];
+            best_sim = sim;
+            best_params = params;
+        }
+    }
     
-    while (all_match && suffix_len < first_len) {
-        char c = lines[0][first_len - suffix_len - 1];
-        for (size_t i = 1; i < line_count; i++) {
-            size_t len = strlen(lines[i]);
-            if (suffix_len >= len || lines[i][len - suffix_len - 1] != c) {
-                all_match = 0;
-                break;
+    if (best >= 0 && best_sim >= miner->similarity) {
+        // Generalize positions that differ
+        LogTemplate* t = &miner->templates[best];
+        for (size_t k = 0; k < t->token_count; k++) {
+            if (t->tokens[k] && strcmp(t->tokens[k], tokens[k]) != 0) {
+                free(t->tokens[k]);
+                t->tokens[k] = NULL;
+                t->param_count++;
+            }
+        }
+        t->frequency++;
+    } else {
+        if (miner->template_count >= miner->template_capacity) {
+            miner->template_capacity *= 2;
+            miner->templates = realloc(miner->templates, sizeof(LogTemplate) * miner->template_capacity);
+        }
+        LogTemplate* t = &miner->templates[miner->template_count];
+        t->tokens = malloc(sizeof(char*) * count);
+        t->token_count = count;
+        t->param_count = 0;
+        for (size_t k = 0; k < count; k++) {
+            // A literal "<*>" can never be told apart from a slot, keep it as a parameter
+            if (strcmp(tokens[k], TEMPLATE_WILDCARD) == 0) {
+                t->tokens[k] = NULL;
+                t->param_count++;
+            } else {
+                t->tokens[k] = strdup(tokens[k]);
             }
         }
+        t->frequency = 1;
+        t->id = (int)miner->template_count;
+        best = t->id;
+        miner->template_count++;
         
-        if (all_match) suffix_len++;
+        if (node->template_count >= node->template_capacity) {
+            node->template_capacity = node->template_capacity ? node->template_capacity * 2 : 4;
+            node->template_ids = realloc(node->template_ids, sizeof(int) * node->template_capacity);
+        }
+        node->template_ids[node->template_count++] = best;
+    }
+    
+    free(tokens);
+    free(buffer);
+    return best;
+}
+
+char* template_to_string(const LogTemplate* tmpl) {
+    size_t len = 0;
+    for (size_t k = 0; k < tmpl->token_count; k++) {
+        len += (tmpl->tokens[k] ? strlen(tmpl->tokens[k]) : strlen(TEMPLATE_WILDCARD)) + 1;
+    }
+    char* out = malloc(len + 1);
+    size_t pos = 0;
+    for (size_t k = 0; k < tmpl->token_count; k++) {
+        const char* token = tmpl->tokens[k] ? tmpl->tokens[k] : TEMPLATE_WILDCARD;
+        size_t n = strlen(token);
+        memcpy(out + pos, token, n);
+        pos += n;
+        if (k + 1 < tmpl->token_count) out[pos++] = ' ';
+    }
+    out[pos] = '\0';
+    return out;
+}
+
+// Mine message templates; templates seen at least min_support times are kept
+void mine_patterns(PatternDict* dict, char** lines, size_t line_count, int min_support) {
+    TemplateMiner* miner = template_miner_new(4, 0.5);
+    for (size_t i = 0; i < line_count; i++) {
+        template_miner_add(miner, lines[i]);
     }
     
-    if (suffix_len > 3) {
-        char* suffix = malloc(suffix_len + 1);
-        strncpy(suffix, lines[0] + first_len - suffix_len, suffix_len);
-        suffix[suffix_len] = '\0';
-        add_pattern(dict, suffix, line_count);
-        free(suffix);
+    for (size_t i = 0; i < miner->template_count; i++) {
+        LogTemplate* t = &miner->templates[i];
+        if (t->frequency < min_support) continue;
+        char* text = template_to_string(t);
+        if (find_pattern(dict, text) < 0) add_pattern(dict, text, t->frequency);
+        free(text);
     }
+    template_miner_free(miner);
 }
 
 char* replace_patterns(const char* text, PatternDict* dict, int** pattern_positions, int* position_count) {
-    // For now, return copy of original text
-    // Full implementation would replace patterns with markers
     *pattern_positions = NULL;
     *position_count = 0;
-    return strdup(text);
+    
+    char* buffer;
+    char** tokens;
+    size_t count = template_tokenize(text, &buffer, &tokens);
+    char* result = NULL;
+    
+    for (size_t i = 0; i < dict->count && !result; i++) {
+        char* tbuffer;
+        char** ttokens;
+        size_t tcount = template_tokenize(dict->patterns[i].pattern, &tbuffer, &ttokens);
+        if (tcount == count) {
+            int matches = 1, params = 0;
+            for (size_t k = 0; k < count && matches; k++) {
+                if (strcmp(ttokens[k], TEMPLATE_WILDCARD) == 0) params++;
+                else if (strcmp(ttokens[k], tokens[k]) != 0) matches = 0;
+            }
+            if (matches) {
+                *pattern_positions = malloc(sizeof(int) * (params ? params : 1));
+                for (size_t k = 0; k < count; k++) {
+                    if (strcmp(ttokens[k], TEMPLATE_WILDCARD) == 0) {
+                        (*pattern_positions)[(*position_count)++] = (int)k;
+                    }
+                }
+                result = strdup(dict->patterns[i].pattern);
+            }
+        }
+        free(ttokens);
+        free(tbuffer);
+    }
+    
+    free(tokens);
+    free(buffer);
+    return result ? result : strdup(text);
 }
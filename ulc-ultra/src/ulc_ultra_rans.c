@@ -0,0 +1,423 @@
+#include "../include/ulc_ultra_rans.h"
+#include "../../ulc-c/include/ulc_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 32-bit states kept in [RANS_L, RANS_L << 16), renormalized 16 bits at a time
+#define RANS_L (1u << 16)
+#define RANS_TOTAL (1u << RANS_PROB_BITS)
+
+// Normalized model for one context
+typedef struct {
+    uint16_t freq[256];
+    uint16_t start[256];
+} RansTable;
+
+// Segment k of the input goes through state k
+static size_t segment_start(size_t len, int k) {
+    return len * (size_t)k / RANS_STATES;
+}
+
+// Context of position i inside its segment (previous byte, 0 at the start)
+static inline uint8_t context_at(const uint8_t* data, size_t seg_start, size_t i, int order) {
+    return (order && i > seg_start) ? data[i - 1] : 0;
+}
+
+static void count_symbols(const uint8_t* data, size_t len, int order, uint32_t (*counts)[256]) {
+    for (int k = 0; k < RANS_STATES; k++) {
+        size_t start = segment_start(len, k);
+        for (size_t i = start; i < segment_start(len, k + 1); i++) {
+            counts[context_at(data, start, i, order)][data[i]]++;
+        }
+    }
+}
+
+// Scale counts to RANS_TOTAL, every present symbol keeps at least 1
+static void normalize(const uint32_t* counts, RansTable* table) {
+    uint64_t total = 0;
+    for (int s = 0; s < 256; s++) total += counts[s];
+    memset(table->freq, 0, sizeof(table->freq));
+    if (total == 0) return;
+
+    uint32_t sum = 0;
+    int largest = 0;
+    for (int s = 0; s < 256; s++) {
+        if (!counts[s]) continue;
+        uint32_t f = (uint32_t)((uint64_t)counts[s] * RANS_TOTAL / total);
+        table->freq[s] = (uint16_t)(f ? f : 1);
+        sum += table->freq[s];
+        if (counts[s] > counts[largest]) largest = s;
+    }
+
+    // Settle rounding on the most frequent symbol, then trim the largest
+    // frequencies if the minimum of 1 pushed us over
+    if (sum < RANS_TOTAL) {
+        table->freq[largest] += (uint16_t)(RANS_TOTAL - sum);
+    }
+    while (sum > RANS_TOTAL) {
+        int biggest = 0;
+        for (int s = 1; s < 256; s++) {
+            if (table->freq[s] > table->freq[biggest]) biggest = s;
+        }
+        table->freq[biggest]--;
+        sum--;
+    }
+
+    uint16_t cumulative = 0;
+    for (int s = 0; s < 256; s++) {
+        table->start[s] = cumulative;
+        cumulative += table->freq[s];
+    }
+}
+
+// log2(x) in 1/65536 bits (integer binary-log, x >= 1)
+static uint32_t fixed_log2(uint32_t x) {
+    uint32_t shift = 0;
+    while ((x >> shift) >= 2) shift++;
+    uint32_t result = shift << 16;
+
+    // Fraction bits by repeated squaring of x / 2^shift (Q30, in [1, 2))
+    uint64_t y = ((uint64_t)x << 30) >> shift;
+    for (int bit = 15; bit >= 0; bit--) {
+        y = (y * y) >> 30;
+        if (y >= (2ULL << 30)) {
+            y >>= 1;
+            result |= 1u << bit;
+        }
+    }
+    return result;
+}
+
+static size_t varint_size(uint64_t value) {
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+// Table layout: varint symbol count, then (symbol, varint freq) pairs
+static size_t table_size(const RansTable* table) {
+    size_t size = 0, present = 0;
+    for (int s = 0; s < 256; s++) {
+        if (table->freq[s]) {
+            size += 1 + varint_size(table->freq[s]);
+            present++;
+        }
+    }
+    return size + varint_size(present);
+}
+
+static void write_table(ByteArray* out, const RansTable* table) {
+    size_t present = 0;
+    for (int s = 0; s < 256; s++) present += table->freq[s] != 0;
+    encode_varint(out, present);
+    for (int s = 0; s < 256; s++) {
+        if (table->freq[s]) {
+            bytearray_append_byte(out, (uint8_t)s);
+            encode_varint(out, table->freq[s]);
+        }
+    }
+}
+
+static void read_table(const uint8_t* data, size_t* offset, RansTable* table) {
+    memset(table->freq, 0, sizeof(table->freq));
+    size_t present = decode_varint(data, offset);
+    for (size_t k = 0; k < present; k++) {
+        uint8_t s = data[(*offset)++];
+        table->freq[s] = (uint16_t)decode_varint(data, offset);
+    }
+    uint16_t cumulative = 0;
+    for (int s = 0; s < 256; s++) {
+        table->start[s] = cumulative;
+        cumulative += table->freq[s];
+    }
+}
+
+// Contexts in use: a bitmap (order 1) or just context 0
+static int context_count(int order) {
+    return order ? 256 : 1;
+}
+
+size_t rans_estimate(const uint8_t* data, size_t len, int order) {
+    int contexts = context_count(order);
+    uint32_t (*counts)[256] = calloc(contexts, sizeof(*counts));
+    count_symbols(data, len, order, counts);
+
+    RansTable table;
+    uint64_t bits = 0;   // In 1/65536 bits
+    size_t size = 1 + varint_size(len) + (order ? 32 : 0) + 4 * RANS_STATES;
+    for (int c = 0; c < contexts; c++) {
+        normalize(counts[c], &table);
+        int used = 0;
+        for (int s = 0; s < 256; s++) {
+            if (!counts[c][s]) continue;
+            used = 1;
+            bits += (uint64_t)counts[c][s] * ((RANS_PROB_BITS << 16) - fixed_log2(table.freq[s]));
+        }
+        if (used) size += table_size(&table);
+    }
+    free(counts);
+
+    size_t payload = (size_t)(bits >> 19) + 1;   // Bits -> bytes
+    return size + varint_size(payload) + payload;
+}
+
+void rans_encode_block(ByteArray* out, const uint8_t* data, size_t len, int order) {
+    int contexts = context_count(order);
+    uint32_t (*counts)[256] = calloc(contexts, sizeof(*counts));
+    count_symbols(data, len, order, counts);
+
+    RansTable* tables = malloc(sizeof(RansTable) * contexts);
+    uint8_t used[32] = {0};
+    for (int c = 0; c < contexts; c++) {
+        normalize(counts[c], &tables[c]);
+        for (int s = 0; s < 256; s++) {
+            if (counts[c][s]) {
+                used[c >> 3] |= (uint8_t)(1 << (c & 7));
+                break;
+            }
+        }
+    }
+    free(counts);
+
+    bytearray_append_byte(out, (uint8_t)order);
+    encode_varint(out, len);
+    if (order) bytearray_append(out, used, sizeof(used));
+    for (int c = 0; c < contexts; c++) {
+        if (!order || (used[c >> 3] >> (c & 7)) & 1) write_table(out, &tables[c]);
+    }
+
+    // Encode backwards: the decoder then reads words front to back in the
+    // order it visits (round, segment)
+    size_t capacity = len + 2 * RANS_STATES + 1;
+    uint16_t* words = malloc(sizeof(uint16_t) * capacity);
+    uint16_t* ptr = words + capacity;
+    uint32_t state[RANS_STATES];
+    size_t seg_start[RANS_STATES], seg_len[RANS_STATES];
+    size_t rounds = 0;
+    for (int k = 0; k < RANS_STATES; k++) {
+        state[k] = RANS_L;
+        seg_start[k] = segment_start(len, k);
+        seg_len[k] = segment_start(len, k + 1) - seg_start[k];
+        if (seg_len[k] > rounds) rounds = seg_len[k];
+    }
+
+    for (size_t r = rounds; r-- > 0; ) {
+        for (int k = RANS_STATES - 1; k >= 0; k--) {
+            if (r >= seg_len[k]) continue;
+            size_t i = seg_start[k] + r;
+            const RansTable* table = &tables[context_at(data, seg_start[k], i, order)];
+            uint32_t freq = table->freq[data[i]];
+            uint32_t x = state[k];
+            uint64_t x_max = (uint64_t)((RANS_L >> RANS_PROB_BITS) << 16) * freq;
+            if (x >= x_max) {
+                *--ptr = (uint16_t)x;
+                x >>= 16;
+            }
+            state[k] = ((x / freq) << RANS_PROB_BITS) + (x % freq) + table->start[data[i]];
+        }
+    }
+    for (int k = RANS_STATES - 1; k >= 0; k--) {
+        *--ptr = (uint16_t)(state[k] >> 16);
+        *--ptr = (uint16_t)state[k];
+    }
+
+    size_t word_count = (size_t)(words + capacity - ptr);
+    encode_varint(out, word_count * 2);
+    for (size_t w = 0; w < word_count; w++) {
+        bytearray_append_byte(out, (uint8_t)ptr[w]);
+        bytearray_append_byte(out, (uint8_t)(ptr[w] >> 8));
+    }
+
+    free(words);
+    free(tables);
+}
+
+// Decode-side table: slot -> symbol << 24 | (frequency - 1) << 12 | offset
+// inside the symbol, one 32-bit entry per lookup on either decode path.
+// Order 1 keeps the contexts back to back: context c, slot s is
+// entry c << RANS_PROB_BITS | s
+#define RANS_ENTRY_SYMBOL(e) ((e) >> 24)
+#define RANS_ENTRY_FREQ(e) ((((e) >> 12) & (RANS_TOTAL - 1)) + 1)
+#define RANS_ENTRY_BIAS(e) ((e) & (RANS_TOTAL - 1))
+
+static void build_decode_table(uint32_t* table, const RansTable* model) {
+    for (int s = 0; s < 256; s++) {
+        for (uint32_t k = 0; k < model->freq[s]; k++) {
+            table[model->start[s] + k] = (uint32_t)s << 24 | (uint32_t)(model->freq[s] - 1) << 12 | k;
+        }
+    }
+}
+
+static inline uint32_t read_word(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+// One decode step: resolve the slot, advance the state, renormalize
+#define RANS_DECODE_STEP(table, x, sym, in) do {                                   \
+        uint32_t entry_ = (table)[(x) & (RANS_TOTAL - 1)];                         \
+        (sym) = (uint8_t)RANS_ENTRY_SYMBOL(entry_);                                \
+        (x) = RANS_ENTRY_FREQ(entry_) * ((x) >> RANS_PROB_BITS) + RANS_ENTRY_BIAS(entry_); \
+        if ((x) < RANS_L) {                                                        \
+            (x) = ((x) << 16) | read_word(in);                                     \
+            (in) += 2;                                                             \
+        }                                                                          \
+    } while (0)
+
+// Full rounds [from, to): every state steps once per round, in order
+static void decode_rounds(const uint32_t* tables, int order, uint32_t* state, uint8_t* prev,
+                          const size_t* seg_start, size_t from, size_t to, uint8_t* out, const uint8_t** in_ptr) {
+    const uint8_t* in = *in_ptr;
+    for (size_t r = from; r < to; r++) {
+        for (int k = 0; k < RANS_STATES; k++) {
+            uint32_t x = state[k];
+            uint8_t sym;
+            RANS_DECODE_STEP(tables + ((size_t)prev[k] << RANS_PROB_BITS), x, sym, in);
+            state[k] = x;
+            out[seg_start[k] + r] = sym;
+            if (order) prev[k] = sym;
+        }
+    }
+    *in_ptr = in;
+}
+
+// AVX2: the 8 states are the 8 lanes of one register. A round looks up the
+// lanes' entries, steps them together, and the lanes that renormalize take
+// the next words in lane order, as the scalar loop would. The entries are
+// 8 scalar loads: vpgather was slower on the machines measured (it is
+// microcoded on CPUs with the gather data sampling fix)
+#if RANS_STATES == 8 && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RANS_AVX2 1
+
+__attribute__((target("avx2,popcnt")))
+static size_t decode_rounds_avx2(const uint32_t* tables, int order, uint32_t* state, uint8_t* prev,
+                                 const size_t* seg_start, size_t rounds, uint8_t* out,
+                                 const uint8_t** in_ptr, const uint8_t* in_end) {
+    // Renormalizing lanes by bitmask -> which of the next words each takes
+    uint8_t take[256][8];
+    for (int m = 0; m < 256; m++) {
+        int n = 0;
+        for (int k = 0; k < 8; k++) {
+            take[m][k] = (uint8_t)n;
+            n += (m >> k) & 1;
+        }
+    }
+
+    const uint8_t* in = *in_ptr;
+    __m256i x = _mm256_loadu_si256((const __m256i*)state);
+    __m256i ctx = _mm256_set1_epi32(0);
+    if (order) ctx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)prev));
+    const __m256i slot_mask = _mm256_set1_epi32(RANS_TOTAL - 1);
+    const __m256i zero = _mm256_setzero_si256();
+    uint32_t syms[8];
+    size_t r = 0;
+
+    // Each round reads at most 8 words; stop while 16 bytes remain loadable
+    while (r < rounds && in_end - in >= 16) {
+        __m256i index = _mm256_and_si256(x, slot_mask);
+        if (order) index = _mm256_or_si256(index, _mm256_slli_epi32(ctx, RANS_PROB_BITS));
+        uint32_t slot[8];
+        _mm256_storeu_si256((__m256i*)slot, index);
+        __m256i entry = _mm256_setr_epi32(tables[slot[0]], tables[slot[1]], tables[slot[2]], tables[slot[3]],
+                                          tables[slot[4]], tables[slot[5]], tables[slot[6]], tables[slot[7]]);
+        __m256i sym = _mm256_srli_epi32(entry, 24);
+        __m256i freq = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(entry, 12), slot_mask),
+                                        _mm256_set1_epi32(1));
+        __m256i bias = _mm256_and_si256(entry, slot_mask);
+        x = _mm256_add_epi32(_mm256_mullo_epi32(freq, _mm256_srli_epi32(x, RANS_PROB_BITS)), bias);
+
+        // Branch-free: whether a lane renormalizes is data, not a pattern
+        __m256i renorm = _mm256_cmpeq_epi32(_mm256_srli_epi32(x, 16), zero);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(renorm));
+        __m256i words = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)in));
+        __m256i order_of = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)take[mask]));
+        words = _mm256_permutevar8x32_epi32(words, order_of);
+        x = _mm256_blendv_epi8(x, _mm256_or_si256(_mm256_slli_epi32(x, 16), words), renorm);
+        in += 2 * __builtin_popcount(mask);
+
+        _mm256_storeu_si256((__m256i*)syms, sym);
+        for (int k = 0; k < 8; k++) out[seg_start[k] + r] = (uint8_t)syms[k];
+        ctx = sym;
+        r++;
+    }
+
+    _mm256_storeu_si256((__m256i*)state, x);
+    if (order && r > 0) {
+        for (int k = 0; k < 8; k++) prev[k] = out[seg_start[k] + r - 1];
+    }
+    *in_ptr = in;
+    return r;
+}
+#endif
+
+uint8_t* rans_decode_block(const uint8_t* data, size_t* offset, size_t* out_len) {
+    int order = data[(*offset)++];
+    size_t len = decode_varint(data, offset);
+    int contexts = context_count(order);
+
+    uint8_t used[32];
+    memset(used, 0xFF, sizeof(used));
+    if (order) {
+        memcpy(used, data + *offset, sizeof(used));
+        *offset += sizeof(used);
+    }
+    uint32_t* tables = calloc((size_t)contexts << RANS_PROB_BITS, sizeof(uint32_t));
+    for (int c = 0; c < contexts; c++) {
+        if ((used[c >> 3] >> (c & 7)) & 1) {
+            RansTable model;
+            read_table(data, offset, &model);
+            build_decode_table(tables + ((size_t)c << RANS_PROB_BITS), &model);
+        }
+    }
+
+    size_t payload_len = decode_varint(data, offset);
+    const uint8_t* in = data + *offset;
+    const uint8_t* in_end = in + payload_len;
+    *offset += payload_len;
+
+    uint8_t* out = malloc(len + 1);
+    uint32_t state[RANS_STATES];
+    size_t seg_start[RANS_STATES], seg_len[RANS_STATES];
+    size_t min_len = len, rounds = 0;
+    for (int k = 0; k < RANS_STATES; k++) {
+        state[k] = read_word(in) | (read_word(in + 2) << 16);
+        in += 4;
+        seg_start[k] = segment_start(len, k);
+        seg_len[k] = segment_start(len, k + 1) - seg_start[k];
+        if (seg_len[k] < min_len) min_len = seg_len[k];
+        if (seg_len[k] > rounds) rounds = seg_len[k];
+    }
+
+    // Full rounds: all states step together with no bounds checks, on the
+    // vector path while the CPU has one, the rest scalar
+    uint8_t prev[RANS_STATES] = {0};
+    size_t done = 0;
+#ifdef RANS_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        done = decode_rounds_avx2(tables, order, state, prev, seg_start, min_len, out, &in, in_end);
+    }
+#else
+    (void)in_end;
+#endif
+    decode_rounds(tables, order, state, prev, seg_start, done, min_len, out, &in);
+
+    // Ragged last round
+    for (size_t r = min_len; r < rounds; r++) {
+        for (int k = 0; k < RANS_STATES; k++) {
+            if (r >= seg_len[k]) continue;
+            size_t i = seg_start[k] + r;
+            uint8_t sym;
+            RANS_DECODE_STEP(tables + ((size_t)context_at(out, seg_start[k], i, order) << RANS_PROB_BITS),
+                             state[k], sym, in);
+            out[i] = sym;
+        }
+    }
+
+    free(tables);
+    out[len] = 0;
+    *out_len = len;
+    return out;
+}